@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+
+"""
+Compares the results of choreonoid-benchmark output by two builds.
+
+Usage: compare-benchmarks.py [--threshold <percent>] <base.json> <new.json>
+
+The benchmarks whose times per operation increased more than the threshold
+are reported as regressions and the exit status becomes 1.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as f:
+        return { b["name"]: b for b in json.load(f)["benchmarks"] }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare the results of choreonoid-benchmark.")
+    parser.add_argument("base", help="JSON file of the base build")
+    parser.add_argument("new", help="JSON file of the new build")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="Regression threshold of the increase of the time in percent (default: 10)")
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+
+    regressions = []
+    print("{:<56} {:>14} {:>14} {:>9} {:>12}".format(
+        "Benchmark", "Base [ns]", "New [ns]", "Change", "Allocs"))
+
+    for name, result in new.items():
+        if name not in base:
+            print("{:<56} {:>14} {:>14.1f}".format(name, "-", result["ns_per_op"]))
+            continue
+        baseResult = base[name]
+        change = (result["ns_per_op"] / baseResult["ns_per_op"] - 1.0) * 100.0
+        allocs = "{:.1f}->{:.1f}".format(baseResult["allocations_per_op"], result["allocations_per_op"])
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions.append(name)
+        print("{:<56} {:>14.1f} {:>14.1f} {:>+8.1f}% {:>12}{}".format(
+            name, baseResult["ns_per_op"], result["ns_per_op"], change, allocs, mark))
+
+    for name in base:
+        if name not in new:
+            print("{:<56} {:>14.1f} {:>14}".format(name, base[name]["ns_per_op"], "-"))
+
+    if regressions:
+        print("\n{} regression(s) over {:.1f}%: {}".format(
+            len(regressions), args.threshold, ", ".join(regressions)))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
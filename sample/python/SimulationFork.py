@@ -0,0 +1,56 @@
+from cnoid.Base import *
+from cnoid.BodyPlugin import *
+from cnoid.QtCore import *
+
+# Takes a snapshot of the simulation in the current project at snapshotTime and continues it
+# in copies of the world with different gravity. Each copy is simulated by its own freshly
+# started simulator item, which restores the snapshot taken by the original one.
+
+snapshotTime = 1.0
+numForks = 3
+
+class SimulationFork:
+    def __init__(self):
+        self.simulatorItem = Item.find("AISTSimulator")
+        self.worldItem = self.simulatorItem.parentItem
+        self.simulatorItem.setRealtimeSyncMode(SimulatorItem.NonRealtimeSync)
+        self.timer = QTimer()
+        self.timer.setInterval(10)
+        self.timer.timeout.connect(self.checkTime)
+        RootItem.instance.selectItem(self.simulatorItem)
+        self.simulatorItem.startSimulation()
+        self.timer.start()
+
+    def checkTime(self):
+        if not self.simulatorItem.isRunning():
+            self.timer.stop()
+            return
+        if self.simulatorItem.currentTime >= snapshotTime:
+            self.timer.stop()
+            self.fork()
+
+    def fork(self):
+        snapshot = self.simulatorItem.takeSnapshot()
+        self.simulatorItem.stopSimulation(True)
+        if not snapshot:
+            print("The snapshot cannot be taken.")
+            return
+        print("The snapshot has been taken at {:.3f} [s].".format(snapshot.time))
+
+        gravity = 9.8
+        for i in range(numForks):
+            gravity -= 2.0
+            world = self.worldItem.duplicateSubTree()
+            world.name = "{}-Fork{}".format(self.worldItem.name, i + 1)
+            self.worldItem.parentItem.addChildItem(world)
+            simulator = world.findItem(AISTSimulatorItem)
+            simulator.setGravity([0, 0, -gravity])
+            simulator.startSimulation()
+            if simulator.restoreSnapshot(snapshot):
+                print("{} continues the simulation from {:.3f} [s] with gravity {:.1f}.".format(
+                    world.name, simulator.currentTime, gravity))
+            else:
+                print("{} failed to restore the snapshot.".format(world.name))
+                simulator.stopSimulation(True)
+
+simulationFork = SimulationFork()
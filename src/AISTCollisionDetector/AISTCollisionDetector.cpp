@@ -4,9 +4,16 @@
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshExtractor>
 #include <cnoid/ThreadPool>
+#include <cnoid/GeometryRegistry>
+#include <cnoid/DynamicAABBTree>
 #include <algorithm>
 #include <random>
 #include <set>
+#include <unordered_map>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -15,6 +22,9 @@ namespace {
 
 const bool ENABLE_SHUFFLE = false;
 
+// The distance queries are computed in the calling thread when the number of them is less than this
+const int MinNumDistanceQueriesForThreads = 8;
+
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
 CollisionDetector* factory()
@@ -35,16 +45,163 @@ typedef ref_ptr<ColdetModelEx> ColdetModelExPtr;
 class ColdetModelEx : public ColdetModel
 {
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     ReferencedPtr object;
     int groupId;
     bool isEnabled;
     bool isStatic;
     stdx::optional<Isometry3> localPosition;
     ColdetModelExPtr sibling;
+
+    // Variables for the incremental detection
+    Isometry3 position;
+    stdx::optional<BoundingBox> localBoundingBox;
+    int index;
+    int proxyId;
+    int positionStamp;
+    bool isUpdated;
     
-    ColdetModelEx() : groupId(0), isEnabled(true), isStatic(false) { }
+    ColdetModelEx() { initializeMembers(); }
+
+    // The internal model including the AABB tree is shared with org
+    ColdetModelEx(const ColdetModel& org) : ColdetModel(org) { initializeMembers(); }
+
+    void initializeMembers() {
+        groupId = 0;
+        isEnabled = true;
+        isStatic = false;
+        position.setIdentity();
+        index = -1;
+        proxyId = -1;
+        positionStamp = 0;
+        isUpdated = false;
+    }
+
+    BoundingBox calcWorldBoundingBox();
+};
+
+/**
+   The built models are shared between the detectors when the same meshes are
+   added with the same transforms. Only the meshes registered in GeometryRegistry
+   are targeted because they are treated as immutable objects, so the meshes are
+   identified by their pointers without checking the contents.
+   The registry keeps its own copy of each model, which shares the model data with
+   the models of the detectors, so the model can be shared after the detector that
+   has built it is destroyed. The entry is removed when any of its meshes is released.
+*/
+struct SharedModelKey
+{
+    vector<SgMesh*> meshes;
+    vector<Affine3, Eigen::aligned_allocator<Affine3>> transforms;
+
+    uint64_t calcHash() const {
+        uint64_t hash = 14695981039346656037ULL;
+        auto combine = [&](uint64_t value){
+            hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        };
+        for(size_t i=0; i < meshes.size(); ++i){
+            combine(reinterpret_cast<uintptr_t>(meshes[i]));
+            const double* m = transforms[i].data();
+            for(int j=0; j < 12; ++j){
+                combine(std::hash<double>()(m[j]));
+            }
+        }
+        return hash;
+    }
 };
 
+struct SharedModelInfo
+{
+    vector<weak_ref_ptr<SgMesh>> meshes;
+    vector<Affine3, Eigen::aligned_allocator<Affine3>> transforms;
+    ColdetModelPtr model;
+
+    bool isExpired() const {
+        for(auto& mesh : meshes){
+            if(mesh.expired()){
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    bool matches(const SharedModelKey& key) const {
+        if(meshes.size() != key.meshes.size()){
+            return false;
+        }
+        for(size_t i=0; i < meshes.size(); ++i){
+            if(meshes[i].lock() != key.meshes[i] ||
+               transforms[i].matrix() != key.transforms[i].matrix()){
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+std::mutex sharedModelMutex;
+unordered_multimap<uint64_t, SharedModelInfo> sharedModelMap;
+/*
+  The expired entries of the other hash values are only purged when the map size reaches the
+  following value, which is updated to twice the number of the remaining entries, so that the
+  registration does not scan the whole map every time.
+*/
+const size_t MinSharedModelPurgeSize = 256;
+size_t sharedModelPurgeSize = MinSharedModelPurgeSize;
+
+void removeExpiredSharedModels(uint64_t hash)
+{
+    auto range = sharedModelMap.equal_range(hash);
+    auto p = range.first;
+    while(p != range.second){
+        if(p->second.isExpired()){
+            p = sharedModelMap.erase(p);
+        } else {
+            ++p;
+        }
+    }
+}
+
+ColdetModelPtr findSharedModel(uint64_t hash, const SharedModelKey& key)
+{
+    std::lock_guard<std::mutex> lock(sharedModelMutex);
+    auto range = sharedModelMap.equal_range(hash);
+    for(auto p = range.first; p != range.second; ++p){
+        if(p->second.matches(key)){
+            return p->second.model;
+        }
+    }
+    return nullptr;
+}
+
+void registerSharedModel(uint64_t hash, const SharedModelKey& key, ColdetModel* model)
+{
+    std::lock_guard<std::mutex> lock(sharedModelMutex);
+
+    removeExpiredSharedModels(hash);
+
+    if(sharedModelMap.size() >= sharedModelPurgeSize){
+        auto p = sharedModelMap.begin();
+        while(p != sharedModelMap.end()){
+            if(p->second.isExpired()){
+                p = sharedModelMap.erase(p);
+            } else {
+                ++p;
+            }
+        }
+        sharedModelPurgeSize = std::max(MinSharedModelPurgeSize, sharedModelMap.size() * 2);
+    }
+
+    SharedModelInfo info;
+    for(auto& mesh : key.meshes){
+        info.meshes.push_back(mesh);
+    }
+    info.transforms = key.transforms;
+    info.model = new ColdetModel(*model);
+    sharedModelMap.emplace(hash, std::move(info));
+}
+
 class ColdetModelPairEx;
 typedef ref_ptr<ColdetModelPairEx> ColdetModelPairExPtr;
 
@@ -66,6 +223,9 @@ public:
     ColdetModelPairEx(ColdetModelEx* model1, ColdetModelEx* model2)
         : ColdetModelPair(model1, model2)
     {
+        cacheStamp = -1;
+        isInCollidingPairList = false;
+        
         ColdetModelPairEx* last = this;
         for(auto sibling1 = model1->sibling; sibling1; sibling1 = sibling1->sibling){
             for(auto sibling2 = model2->sibling; sibling2; sibling2 = sibling2->sibling){
@@ -81,6 +241,12 @@ public:
     }
 
     ColdetModelPairExPtr sibling;
+
+    // The result of the last detection which is reused in the incremental detection
+    CollisionPair cachedCollisionPair;
+    int cachedPositionStamps[2];
+    int cacheStamp;
+    bool isInCollidingPairList;
 };
 
 
@@ -120,6 +286,37 @@ bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& dest
     return !collisions.empty();
 }
 
+
+BoundingBox ColdetModelEx::calcWorldBoundingBox()
+{
+    if(sibling){
+        // The siblings may have different positions
+        const double m = std::numeric_limits<double>::max();
+        return BoundingBox(Vector3::Constant(-m), Vector3::Constant(m));
+    }
+    if(!localBoundingBox){
+        vector<Vector3> boxData;
+        getBoundingBoxData(0, boxData);
+        BoundingBox bbox;
+        if(boxData.size() >= 2){
+            bbox.set(boxData[0] - boxData[1], boxData[0] + boxData[1]);
+        }
+        localBoundingBox = bbox;
+    }
+    const Vector3 c = localBoundingBox->center();
+    // A small tolerance is added for the single precision positions of the models
+    const Vector3 e = localBoundingBox->size() / 2.0 + Vector3::Constant(1.0e-5);
+    Isometry3 T;
+    if(localPosition){
+        T = position * (*localPosition);
+    } else {
+        T = position;
+    }
+    const Vector3 center = T * c;
+    const Vector3 extents = T.linear().cwiseAbs() * e;
+    return BoundingBox(center - extents, center + extents);
+}
+
 }
 
 namespace cnoid {
@@ -136,19 +333,54 @@ public:
     bool isReady;
     bool isDynamicGeometryPairChangeEnabled;
     CollisionPair collisionPair;
+
+    // for the incremental detection
+    bool isIncrementalDetectionEnabled;
+    DynamicAABBTree aabbTree;
+    unordered_map<IdPair<GeometryHandle>, int> pairIndexMap;
+    vector<ColdetModelEx*> updatedModels;
+    vector<int> collidingPairIndices;
+    vector<int> candidatePairIndices;
+    int cacheStamp;
+    bool areAllModelsUpdated;
         
     Impl();
     Impl(const AISTCollisionDetector::Impl& org);
     ~Impl();
     void initialize();
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
-    void addMesh(ColdetModelEx* model);
+    void addMesh(ColdetModelEx* model, SgMesh* mesh, const Affine3& T);
     void makeReady();
     bool checkIfGroupPairEnabled(int groupId1, int groupId2);
     bool checkIfModelPairEnabled(ColdetModelPairEx* modelPair);
     void detectCollisions(GeometryHandle geometry, const std::function<void(const CollisionPair&)>& callback);
     void detectCollisions(const std::function<void(const CollisionPair&)>& callback);
     void detectCollisionsInParallel(const std::function<void(const CollisionPair&)>& callback);
+    void updateModelPosition(ColdetModelEx* model, const Isometry3& T);
+    void setModelUpdated(ColdetModelEx* model);
+    void invalidateCachedCollisions();
+    void initializeIncrementalDetection();
+    void updateBroadPhase();
+    void findCandidatePairs(ColdetModelEx* model);
+    bool isCachedCollisionPairValid(ColdetModelPairEx* modelPair);
+    void updateCachedCollisionPair(int pairIndex);
+    void detectCollisionsIncrementally(GeometryHandle geometry, const std::function<void(const CollisionPair&)>& callback);
+    void detectCollisionsIncrementally(const std::function<void(const CollisionPair&)>& callback);
+
+    // for the batched distance queries
+    struct DistanceTask
+    {
+        int queryIndex;
+        int triangles[2];
+    };
+    vector<DistanceTask> distanceTasks;
+    // The closest triangles of the geometry pairs in the previous queries
+    unordered_map<IdPair<GeometryHandle>, pair<int, int>> closestTriangleMap;
+    unique_ptr<ThreadPool> distanceThreadPool;
+
+    void detectDistances(vector<DistanceQuery>& queries, double maxDistance);
+    void computeDistance(DistanceQuery& query, DistanceTask& task, double maxDistance);
+    void removeClosestTriangles(GeometryHandle geometry);
 
     // for multithread version
     int numThreads;
@@ -174,6 +406,7 @@ AISTCollisionDetector::AISTCollisionDetector()
 AISTCollisionDetector::Impl::Impl()
 {
     isDynamicGeometryPairChangeEnabled = false;
+    isIncrementalDetectionEnabled = false;
     maxNumThreads = 0;
 
     initialize();
@@ -189,6 +422,9 @@ AISTCollisionDetector::AISTCollisionDetector(const AISTCollisionDetector& org)
 AISTCollisionDetector::Impl::Impl(const AISTCollisionDetector::Impl& org)
 {
     isDynamicGeometryPairChangeEnabled = org.isDynamicGeometryPairChangeEnabled;
+    // The incremental detection is specific to the usage of each detector and is not inherited by
+    // the clones such as the detectors of the simulations, where all the geometries move every step
+    isIncrementalDetectionEnabled = false;
     maxNumThreads = org.maxNumThreads;
 
     initialize();
@@ -200,6 +436,8 @@ void AISTCollisionDetector::Impl::initialize()
     isReady = false;
     numThreads = 0;
     meshExtractor = new MeshExtractor;
+    cacheStamp = 0;
+    areAllModelsUpdated = false;
 
     if(ENABLE_SHUFFLE){
         random_device seed;
@@ -245,6 +483,7 @@ void AISTCollisionDetector::clearGeometries()
     impl->modelPairs.clear();
     impl->ignoredPairs.clear();
     impl->ignoredGroupPairs.clear();
+    impl->closestTriangleMap.clear();
     impl->isReady = false;
 }
 
@@ -264,10 +503,39 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::addGeometry(SgNode* geomet
 stdx::optional<GeometryHandle> AISTCollisionDetector::Impl::addGeometry(SgNode* geometry)
 {
     if(geometry){
-        ColdetModelExPtr model = new ColdetModelEx;
-        if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
-            model->setName(geometry->name());
-            model->build();
+        SharedModelKey key;
+        bool isSharable = true;
+        bool extracted = meshExtractor->extract(
+            geometry,
+            [&](){
+                auto mesh = meshExtractor->currentMesh();
+                if(!GeometryRegistry::checkIfRegisteredMesh(mesh)){
+                    isSharable = false;
+                }
+                key.meshes.push_back(mesh);
+                key.transforms.push_back(meshExtractor->currentTransform());
+            });
+        if(extracted){
+            ColdetModelExPtr model;
+            const uint64_t hash = isSharable ? key.calcHash() : 0;
+            ColdetModelPtr sharedModel;
+            if(isSharable){
+                sharedModel = findSharedModel(hash, key);
+            }
+            if(sharedModel){
+                model = new ColdetModelEx(*sharedModel);
+                model->setName(geometry->name());
+            } else {
+                model = new ColdetModelEx;
+                for(size_t i=0; i < key.meshes.size(); ++i){
+                    addMesh(model, key.meshes[i], key.transforms[i]);
+                }
+                model->setName(geometry->name());
+                model->build();
+                if(isSharable && model->isValid()){
+                    registerSharedModel(hash, key, model);
+                }
+            }
             if(model->isValid()){
                 models.push_back(model);
                 isReady = false;
@@ -279,11 +547,8 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::Impl::addGeometry(SgNode*
 }
 
 
-void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model)
+void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model, SgMesh* mesh, const Affine3& T)
 {
-    SgMesh* mesh = meshExtractor->currentMesh();
-    const Affine3& T = meshExtractor->currentTransform();
-    
     const int vertexIndexTop = model->getNumVertices();
     
     const SgVertexArray& vertices = *mesh->vertices();
@@ -320,6 +585,9 @@ void AISTCollisionDetector::setGeometryStatic(GeometryHandle geometry, bool isSt
 void AISTCollisionDetector::setGroup(GeometryHandle geometry, int groupId)
 {
     getColdetModel(geometry)->groupId = groupId;
+    if(impl->isIncrementalDetectionEnabled){
+        impl->invalidateCachedCollisions();
+    }
 }
 
 
@@ -330,6 +598,9 @@ void AISTCollisionDetector::setGroupPairEnabled(int groupId1, int groupId2, bool
     } else {
         impl->ignoredGroupPairs.insert(IdPair<int>(groupId1, groupId2));
     }
+    if(impl->isIncrementalDetectionEnabled){
+        impl->invalidateCachedCollisions();
+    }
 }
 
 
@@ -348,12 +619,23 @@ void AISTCollisionDetector::ignoreGeometryPair(GeometryHandle geometry1, Geometr
             impl->isReady = false;
         }
     }
+    if(impl->isIncrementalDetectionEnabled){
+        impl->invalidateCachedCollisions();
+    }
 }
 
 
 void AISTCollisionDetector::setGeometryEnabled(GeometryHandle geometry, bool isEnabled)
 {
-    getColdetModel(geometry)->isEnabled = isEnabled;
+    auto model = getColdetModel(geometry);
+    if(isEnabled != model->isEnabled){
+        model->isEnabled = isEnabled;
+        if(impl->isIncrementalDetectionEnabled && impl->isReady){
+            // The pairs of the geometry are detected again
+            ++model->positionStamp;
+            impl->setModelUpdated(model);
+        }
+    }
 }
 
 
@@ -372,6 +654,21 @@ bool AISTCollisionDetector::isDynamicGeometryPairChangeEnabled() const
 }
 
 
+void AISTCollisionDetector::setIncrementalDetectionEnabled(bool on)
+{
+    if(on != impl->isIncrementalDetectionEnabled){
+        impl->isIncrementalDetectionEnabled = on;
+        impl->isReady = false;
+    }
+}
+
+
+bool AISTCollisionDetector::isIncrementalDetectionEnabled() const
+{
+    return impl->isIncrementalDetectionEnabled;
+}
+
+
 bool AISTCollisionDetector::removeGeometry(GeometryHandle geometry)
 {
     bool removed = false;
@@ -397,6 +694,10 @@ bool AISTCollisionDetector::removeGeometry(GeometryHandle geometry)
                 ++pi;
             }
         }
+        if(impl->isIncrementalDetectionEnabled){
+            // The pair indices are changed
+            impl->isReady = false;
+        }
         auto ii = impl->ignoredPairs.begin();
         while(ii != impl->ignoredPairs.end()){
             auto& idPair = *ii;
@@ -406,6 +707,7 @@ bool AISTCollisionDetector::removeGeometry(GeometryHandle geometry)
                 ++ii;
             }
         }
+        impl->removeClosestTriangles(geometry);
     }
 
     return removed;
@@ -468,6 +770,10 @@ void AISTCollisionDetector::Impl::makeReady()
         collisionPairArrays.resize(numThreads);
     }
 
+    if(isIncrementalDetectionEnabled){
+        initializeIncrementalDetection();
+    }
+
     isReady = true;
 }
 
@@ -498,7 +804,9 @@ bool AISTCollisionDetector::Impl::checkIfModelPairEnabled(ColdetModelPairEx* mod
 void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Isometry3& position)
 {
     auto model = getColdetModel(geometry);
-    do {
+    impl->updateModelPosition(model, position);
+    model = model->sibling;
+    while(model){
         if(model->localPosition){
             Isometry3 T = position * (*model->localPosition);
             model->setPosition(T);
@@ -506,7 +814,35 @@ void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Isomet
             model->setPosition(position);
         }
         model = model->sibling;
-    } while(model);
+    }
+}
+
+
+void AISTCollisionDetector::Impl::updateModelPosition(ColdetModelEx* model, const Isometry3& T)
+{
+    if(isIncrementalDetectionEnabled){
+        if(T.matrix() == model->position.matrix()){
+            return;
+        }
+        ++model->positionStamp;
+        setModelUpdated(model);
+    }
+    model->position = T;
+    if(model->localPosition){
+        Isometry3 T2 = T * (*model->localPosition);
+        model->setPosition(T2);
+    } else {
+        model->setPosition(T);
+    }
+}
+
+
+void AISTCollisionDetector::Impl::setModelUpdated(ColdetModelEx* model)
+{
+    if(!model->isUpdated){
+        model->isUpdated = true;
+        updatedModels.push_back(model);
+    }
 }
 
 
@@ -514,8 +850,11 @@ void AISTCollisionDetector::updatePositions
 (std::function<void(Referenced* object, Isometry3*& out_Position)> positionQuery)
 {
     for(ColdetModelEx* model : impl->models){ // Do not use auto&
-        do {
-            Isometry3* T;
+        Isometry3* T;
+        positionQuery(model->object, T);
+        impl->updateModelPosition(model, *T);
+        model = model->sibling;
+        while(model){
             positionQuery(model->object, T);
             if(model->localPosition){
                 Isometry3 T2 = (*T) * (*model->localPosition);
@@ -524,7 +863,7 @@ void AISTCollisionDetector::updatePositions
                 model->setPosition(*T);
             }
             model = model->sibling; // Elements in models are overridden here if auto& is used
-        } while(model);
+        }
     }
 }
 
@@ -534,7 +873,11 @@ void AISTCollisionDetector::detectCollisions(GeometryHandle geometry, std::funct
     if(!impl->isReady){
         impl->makeReady();
     }
-    impl->detectCollisions(geometry, callback);
+    if(impl->isIncrementalDetectionEnabled){
+        impl->detectCollisionsIncrementally(geometry, callback);
+    } else {
+        impl->detectCollisions(geometry, callback);
+    }
 }
 
 
@@ -572,7 +915,9 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
     if(!impl->isReady){
         impl->makeReady();
     }
-    if(impl->numThreads > 0){
+    if(impl->isIncrementalDetectionEnabled){
+        impl->detectCollisionsIncrementally(callback);
+    } else if(impl->numThreads > 0){
         impl->detectCollisionsInParallel(callback);
     } else {
         impl->detectCollisions(callback);
@@ -580,10 +925,6 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
 } 
 
 
-/**
-   \todo Remeber which geometry positions are updated after the last collision detection
-   and do the actual collision detection only for the updated geometry pairs.
-*/
 void AISTCollisionDetector::Impl::detectCollisions(const std::function<void(const CollisionPair&)>& callback)
 {
     auto& collisions = collisionPair.collisions();
@@ -682,9 +1023,289 @@ void AISTCollisionDetector::Impl::dispatchCollisionsInCollisionPairArrays
 }
 
 
+void AISTCollisionDetector::Impl::invalidateCachedCollisions()
+{
+    ++cacheStamp;
+    areAllModelsUpdated = true;
+}
+
+
+void AISTCollisionDetector::Impl::initializeIncrementalDetection()
+{
+    pairIndexMap.clear();
+    for(size_t i=0; i < modelPairs.size(); ++i){
+        auto& modelPair = modelPairs[i];
+        modelPair->cacheStamp = -1;
+        modelPair->isInCollidingPairList = false;
+        pairIndexMap[IdPair<GeometryHandle>(getHandle(modelPair->model(0)), getHandle(modelPair->model(1)))] = i;
+    }
+    collidingPairIndices.clear();
+    ++cacheStamp;
+
+    aabbTree.clear();
+    updatedModels.clear();
+    areAllModelsUpdated = false;
+    for(size_t i=0; i < models.size(); ++i){
+        auto& model = models[i];
+        model->index = i;
+        model->proxyId = aabbTree.insert(model->calcWorldBoundingBox(), i);
+        model->isUpdated = true;
+        updatedModels.push_back(model);
+    }
+}
+
+
+void AISTCollisionDetector::Impl::updateBroadPhase()
+{
+    if(areAllModelsUpdated){
+        for(ColdetModelEx* model : models){
+            setModelUpdated(model);
+        }
+        areAllModelsUpdated = false;
+    }
+    for(auto& model : updatedModels){
+        aabbTree.update(model->proxyId, model->calcWorldBoundingBox());
+    }
+}
+
+
+/**
+   The indices of the model pairs which include the model and whose bounding boxes overlap
+   are added to candidatePairIndices.
+*/
+void AISTCollisionDetector::Impl::findCandidatePairs(ColdetModelEx* model)
+{
+    const GeometryHandle handle = getHandle(model);
+    aabbTree.query(
+        model->calcWorldBoundingBox(),
+        [&](int proxyId){
+            ColdetModelEx* another = models[aabbTree.userId(proxyId)];
+            if(another != model){
+                auto p = pairIndexMap.find(IdPair<GeometryHandle>(handle, getHandle(another)));
+                if(p != pairIndexMap.end()){
+                    candidatePairIndices.push_back(p->second);
+                }
+            }
+            return true;
+        });
+}
+
+
+bool AISTCollisionDetector::Impl::isCachedCollisionPairValid(ColdetModelPairEx* modelPair)
+{
+    return (modelPair->cacheStamp == cacheStamp &&
+            modelPair->cachedPositionStamps[0] == modelPair->model(0)->positionStamp &&
+            modelPair->cachedPositionStamps[1] == modelPair->model(1)->positionStamp);
+}
+
+
+void AISTCollisionDetector::Impl::updateCachedCollisionPair(int pairIndex)
+{
+    ColdetModelPairEx* modelPair = modelPairs[pairIndex];
+    if(isCachedCollisionPairValid(modelPair)){
+        return;
+    }
+    auto& cachedPair = modelPair->cachedCollisionPair;
+    cachedPair.clearCollisions();
+    auto pair = modelPair;
+    do {
+        if(pair->model(0)->isEnabled && pair->model(1)->isEnabled){
+            if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(pair)){
+                if(!pair->detectCollisions().empty()){
+                    copyCollisionPairCollisions(pair, cachedPair);
+                }
+            }
+        }
+        pair = pair->sibling;
+    } while(pair);
+
+    modelPair->cacheStamp = cacheStamp;
+    modelPair->cachedPositionStamps[0] = modelPair->model(0)->positionStamp;
+    modelPair->cachedPositionStamps[1] = modelPair->model(1)->positionStamp;
+
+    if(!cachedPair.empty() && !modelPair->isInCollidingPairList){
+        collidingPairIndices.push_back(pairIndex);
+        modelPair->isInCollidingPairList = true;
+    }
+}
+
+
+void AISTCollisionDetector::Impl::detectCollisionsIncrementally
+(GeometryHandle geometry, const std::function<void(const CollisionPair&)>& callback)
+{
+    updateBroadPhase();
+
+    candidatePairIndices.clear();
+    findCandidatePairs(getColdetModel(geometry));
+    // The pairs are processed in the same order as the non-incremental detection
+    std::sort(candidatePairIndices.begin(), candidatePairIndices.end());
+
+    for(auto& index : candidatePairIndices){
+        updateCachedCollisionPair(index);
+        auto& cachedPair = modelPairs[index]->cachedCollisionPair;
+        if(!cachedPair.empty()){
+            callback(cachedPair);
+        }
+    }
+}
+
+
+/**
+   Only the pairs including the models updated after the last detection are detected again.
+   The results of the other pairs are reused because they are not changed.
+*/
+void AISTCollisionDetector::Impl::detectCollisionsIncrementally
+(const std::function<void(const CollisionPair&)>& callback)
+{
+    updateBroadPhase();
+
+    candidatePairIndices.clear();
+    for(auto& model : updatedModels){
+        findCandidatePairs(model);
+        model->isUpdated = false;
+    }
+    updatedModels.clear();
+    for(auto& index : candidatePairIndices){
+        updateCachedCollisionPair(index);
+    }
+
+    /*
+      The cached results of the pairs which include the updated models but are not detected
+      again are not valid, and the bounding boxes of the pairs do not overlap in that case.
+    */
+    auto validEnd = std::remove_if(
+        collidingPairIndices.begin(), collidingPairIndices.end(),
+        [&](int index){
+            ColdetModelPairEx* modelPair = modelPairs[index];
+            if(isCachedCollisionPairValid(modelPair) && !modelPair->cachedCollisionPair.empty()){
+                return false;
+            }
+            modelPair->isInCollidingPairList = false;
+            return true;
+        });
+    collidingPairIndices.erase(validEnd, collidingPairIndices.end());
+    std::sort(collidingPairIndices.begin(), collidingPairIndices.end());
+
+    for(auto& index : collidingPairIndices){
+        callback(modelPairs[index]->cachedCollisionPair);
+    }
+}
+
+
 double AISTCollisionDetector::detectDistance
 (GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2)
 {
     return ColdetModelPair::computeDistance(
         getColdetModel(geometry1), getColdetModel(geometry2), out_point1.data(), out_point2.data());
 }
+
+
+void AISTCollisionDetector::detectDistances(std::vector<DistanceQuery>& queries, double maxDistance)
+{
+    impl->detectDistances(queries, maxDistance);
+}
+
+
+/**
+   The pairs whose bounding boxes are farther than maxDistance are excluded first, and the
+   distances of the other pairs are computed in the worker threads. The number of the threads
+   is the one given by setNumThreads, or the number of the hardware threads by default.
+*/
+void AISTCollisionDetector::Impl::detectDistances(vector<DistanceQuery>& queries, double maxDistance)
+{
+    distanceTasks.clear();
+    
+    for(size_t i=0; i < queries.size(); ++i){
+        auto& query = queries[i];
+        auto model1 = getColdetModel(query.geometry1);
+        auto model2 = getColdetModel(query.geometry2);
+        if(!model1->isValid() || !model2->isValid()){
+            query.distance = -1.0;
+            continue;
+        }
+        const BoundingBox bbox1 = model1->calcWorldBoundingBox();
+        const BoundingBox bbox2 = model2->calcWorldBoundingBox();
+        const Vector3 gap =
+            (bbox1.min() - bbox2.max()).cwiseMax(bbox2.min() - bbox1.max()).cwiseMax(0.0);
+        const double lowerBound = gap.norm();
+        if(lowerBound >= maxDistance){
+            query.distance = lowerBound;
+            continue;
+        }
+        distanceTasks.emplace_back();
+        auto& task = distanceTasks.back();
+        task.queryIndex = i;
+        task.triangles[0] = -1;
+        task.triangles[1] = -1;
+        auto p = closestTriangleMap.find(IdPair<GeometryHandle>(query.geometry1, query.geometry2));
+        if(p != closestTriangleMap.end()){
+            // The triangles are stored in the order of the handles
+            const bool isSwapped = query.geometry1 > query.geometry2;
+            task.triangles[0] = isSwapped ? p->second.second : p->second.first;
+            task.triangles[1] = isSwapped ? p->second.first : p->second.second;
+        }
+    }
+
+    const int numTasks = distanceTasks.size();
+    int numThreads = (maxNumThreads > 0) ? maxNumThreads : std::thread::hardware_concurrency();
+    if(numThreads > numTasks / MinNumDistanceQueriesForThreads){
+        numThreads = numTasks / MinNumDistanceQueriesForThreads;
+    }
+
+    if(numThreads <= 1){
+        for(auto& task : distanceTasks){
+            computeDistance(queries[task.queryIndex], task, maxDistance);
+        }
+    } else {
+        if(!distanceThreadPool || distanceThreadPool->size() < numThreads - 1){
+            distanceThreadPool.reset(new ThreadPool(numThreads - 1));
+        }
+        // The tasks are taken one by one because their costs vary widely
+        std::atomic<int> nextTaskIndex(0);
+        auto computeDistances = [&](){
+            int index;
+            while((index = nextTaskIndex++) < numTasks){
+                auto& task = distanceTasks[index];
+                computeDistance(queries[task.queryIndex], task, maxDistance);
+            }
+        };
+        for(int i=0; i < numThreads - 1; ++i){
+            distanceThreadPool->start(computeDistances);
+        }
+        computeDistances();
+        distanceThreadPool->wait();
+    }
+
+    for(auto& task : distanceTasks){
+        auto& query = queries[task.queryIndex];
+        if(task.triangles[0] >= 0 && task.triangles[1] >= 0){
+            auto& triangles = closestTriangleMap[IdPair<GeometryHandle>(query.geometry1, query.geometry2)];
+            if(query.geometry1 > query.geometry2){
+                triangles = make_pair(task.triangles[1], task.triangles[0]);
+            } else {
+                triangles = make_pair(task.triangles[0], task.triangles[1]);
+            }
+        }
+    }
+}
+
+
+void AISTCollisionDetector::Impl::computeDistance(DistanceQuery& query, DistanceTask& task, double maxDistance)
+{
+    query.distance = ColdetModelPair::computeDistance(
+        getColdetModel(query.geometry1), getColdetModel(query.geometry2), maxDistance,
+        task.triangles[0], task.triangles[1], query.point1.data(), query.point2.data());
+}
+
+
+void AISTCollisionDetector::Impl::removeClosestTriangles(GeometryHandle geometry)
+{
+    auto p = closestTriangleMap.begin();
+    while(p != closestTriangleMap.end()){
+        if(p->first.hasId(geometry)){
+            p = closestTriangleMap.erase(p);
+        } else {
+            ++p;
+        }
+    }
+}
@@ -25,6 +25,8 @@ public:
     virtual void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore = true) override;
     virtual void setDynamicGeometryPairChangeEnabled(bool on) override;
     virtual bool isDynamicGeometryPairChangeEnabled() const override;
+    virtual void setIncrementalDetectionEnabled(bool on) override;
+    virtual bool isIncrementalDetectionEnabled() const override;
     virtual bool removeGeometry(GeometryHandle geometry) override;
     virtual bool isGeometryRemovalSupported() const override;
     virtual bool makeReady() override;
@@ -36,6 +38,8 @@ public:
 
     // CollisionDetectorDistanceAPI
     virtual double detectDistance(GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2) override;
+    virtual void detectDistances(
+        std::vector<DistanceQuery>& queries, double maxDistance = std::numeric_limits<double>::max()) override;
 
     // experimental
     void setNumThreads(int n);
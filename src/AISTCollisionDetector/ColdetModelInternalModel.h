@@ -8,6 +8,7 @@
 #include "ColdetModel.h"
 #include "Opcode/Opcode.h"
 #include <vector>
+#include <atomic>
 
 namespace cnoid {
 
@@ -71,7 +72,7 @@ public:
     };
 
 private:
-    int refCounter;
+    std::atomic<int> refCounter;
     int AABBTreeMaxDepth;
     std::vector<int> numBBMap;
     std::vector<int> numLeafMap;
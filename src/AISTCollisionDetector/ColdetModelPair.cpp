@@ -615,6 +615,47 @@ double ColdetModelPair::computeDistance(ColdetModel* model0, ColdetModel* model1
 }
 
 
+double ColdetModelPair::computeDistance
+(ColdetModel* model0, ColdetModel* model1, double maxDistance,
+ int& triangle0, int& triangle1, double* point0, double* point1)
+{
+    if(model0->isValid() && model1->isValid()){
+
+        Opcode::BVTCache colCache;
+
+        colCache.Model0 = &model1->internalModel->model;
+        colCache.Model1 = &model0->internalModel->model;
+
+        bool useCachedIds = (triangle0 >= 0 && triangle1 >= 0);
+        if(useCachedIds){
+            colCache.id0 = triangle1;
+            colCache.id1 = triangle0;
+        }
+        
+        Opcode::SSVTreeCollider collider;
+
+        float maxD = (maxDistance < MAX_FLOAT) ? static_cast<float>(maxDistance) : MAX_FLOAT;
+        float d;
+        Point p0, p1;
+        if(!collider.Distance(colCache, maxD, useCachedIds, d, p0, p1,
+                              model1->transform, model0->transform)){
+            return maxDistance;
+        }
+        point0[0] = p1.x;
+        point0[1] = p1.y;
+        point0[2] = p1.z;
+        point1[0] = p0.x;
+        point1[1] = p0.y;
+        point1[2] = p0.z;
+        triangle1 = colCache.id0;
+        triangle0 = colCache.id1;
+        return d;
+    }
+
+    return -1.0;
+}
+
+
 double ColdetModelPair::computeDistance(double* point0, double* point1)
 {
     return computeDistance(models[0], models[1], point0, point1);
@@ -50,6 +50,17 @@ public:
     */
     double computeDistance(int& out_triangle0, double* out_point0, int& out_triangle1, double* out_point1);
 
+    /**
+       The distance is only computed when it is less than maxDistance. Otherwise maxDistance is
+       returned and the points are not set.
+       @param io_triangle0, io_triangle1 The closest triangle pair of the previous computation,
+       which is used as the initial candidate to exploit the temporal coherence. A negative index
+       means that there is no candidate. The indices are updated when the distance is found.
+    */
+    static double computeDistance(
+        ColdetModel* model0, ColdetModel* model1, double maxDistance,
+        int& io_triangle0, int& io_triangle1, double* out_point0, double* out_point1);
+
     bool detectIntersection();
 
     double tolerance() const { return tolerance_; }
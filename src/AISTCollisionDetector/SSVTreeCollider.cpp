@@ -15,6 +15,15 @@ bool SSVTreeCollider::Distance(BVTCache& cache,
                                float& minD, Point &point0, Point&point1,
                                const Matrix4x4* world0, const Matrix4x4* world1)
 {
+    return Distance(cache, MAX_FLOAT, false, minD, point0, point1, world0, world1);
+}
+
+bool SSVTreeCollider::Distance(BVTCache& cache, float maxD, bool useCachedIds,
+                               float& minD, Point &point0, Point&point1,
+                               const Matrix4x4* world0, const Matrix4x4* world1)
+{
+    minD = maxD;
+
     // Checkings
     if(!cache.Model0 || !cache.Model1)                             return false;
     if(cache.Model0->HasLeafNodes()!=cache.Model1->HasLeafNodes()) return false;
@@ -26,50 +35,62 @@ bool SSVTreeCollider::Distance(BVTCache& cache,
     // Simple double-dispatch
     const AABBCollisionTree* T0 = (const AABBCollisionTree*)cache.Model0->GetTree();
     const AABBCollisionTree* T1 = (const AABBCollisionTree*)cache.Model1->GetTree();
-    Distance(T0, T1, world0, world1, &cache, minD, point0, point1);
-    return true;
+    Distance(T0, T1, world0, world1, &cache, maxD, useCachedIds, minD, point0, point1);
+    return minD < maxD;
 }
 
 void SSVTreeCollider::Distance(const AABBCollisionTree* tree0, 
                                const AABBCollisionTree* tree1, 
                                const Matrix4x4* world0, const Matrix4x4* world1, 
-                               Pair* cache, float& minD, Point &point0, Point&point1)
+                               Pair* cache, float maxD, bool useCachedIds,
+                               float& minD, Point &point0, Point&point1)
 {
     if (debug) std::cout << "Distance()" << std::endl;
     // Init collision query
     InitQuery(world0, world1);
     
     // Compute initial value using temporal coherency
-    // todo : cache should be used 
-
-    const AABBCollisionNode *n;
-    for (unsigned int i=0; i<tree0->GetNbNodes(); i++){
-        n = tree0->GetNodes()+i;
-        if (n->IsLeaf()){
-            mId0 = n->GetPrimitive();
-            break;
+    if (useCachedIds &&
+        cache->id0 < mIMesh0->GetNbTriangles() && cache->id1 < mIMesh1->GetNbTriangles()){
+        mId0 = cache->id0;
+        mId1 = cache->id1;
+    } else {
+        const AABBCollisionNode *n;
+        for (unsigned int i=0; i<tree0->GetNbNodes(); i++){
+            n = tree0->GetNodes()+i;
+            if (n->IsLeaf()){
+                mId0 = n->GetPrimitive();
+                break;
+            }
+        } 
+        for (unsigned int i=0; i<tree1->GetNbNodes(); i++){
+            n = tree1->GetNodes()+i;
+            if (n->IsLeaf()){
+                mId1 = n->GetPrimitive();
+                break;
+            }
         }
-    } 
-    for (unsigned int i=0; i<tree1->GetNbNodes(); i++){
-        n = tree1->GetNodes()+i;
-        if (n->IsLeaf()){
-            mId1 = n->GetPrimitive();
-            break;
-        }
-    } 
+    }
     Point p0, p1;
     minD = PrimDist(mId0, mId1, p0, p1);
+
+    // The subtrees farther than the upper bound are pruned
+    if (minD >= maxD){
+        minD = maxD;
+    }
     
     // Perform distance computation
     _Distance(tree0->GetNodes(), tree1->GetNodes(), minD, p0, p1);
 
-    // transform points
-    TransformPoint4x3(point0, p0, *world1);
-    TransformPoint4x3(point1, p1, *world1);
+    if (minD < maxD){
+        // transform points
+        TransformPoint4x3(point0, p0, *world1);
+        TransformPoint4x3(point1, p1, *world1);
 
-    // update cache
-    cache->id0 = mId0;
-    cache->id1 = mId1;
+        // update cache
+        cache->id0 = mId0;
+        cache->id1 = mId1;
+    }
 }
 
 bool SSVTreeCollider::Collide(BVTCache& cache, double tolerance,
@@ -33,6 +33,22 @@ public:
     bool Distance(BVTCache& cache, float& minD, Point &point0, Point&point1,
                   const Matrix4x4* world0=null, const Matrix4x4* world1=null);
 
+    /**
+     * @brief compute the minimum distance if it is less than the given upper bound
+     * @param cache The primitive ids in the cache are used as the initial candidates
+     * when useCachedIds is true, and they are updated when the distance is found
+     * @param maxD the upper bound of the distance
+     * @param minD the minimum distance, or maxD if the distance is not less than maxD
+     * @param point0 the closest point on the first link
+     * @param point1 the closest point on the second link
+     * @param world0 transformation of the first link
+     * @param world1 transformation of the second link
+     * @return true if the distance less than maxD is found, false otherwise
+     */
+    bool Distance(BVTCache& cache, float maxD, bool useCachedIds,
+                  float& minD, Point &point0, Point&point1,
+                  const Matrix4x4* world0, const Matrix4x4* world1);
+
     /**
      * @brief detect collision between links. 
      * @param cache 
@@ -67,7 +83,8 @@ private:
     void Distance(const AABBCollisionTree* tree0, 
                   const AABBCollisionTree* tree1, 
                   const Matrix4x4* world0, const Matrix4x4* world1, 
-                  Pair* cache, float& minD,  Point &point0, Point&point1);
+                  Pair* cache, float maxD, bool useCachedIds,
+                  float& minD,  Point &point0, Point&point1);
 
     void _Distance(const AABBCollisionNode* b0, const AABBCollisionNode* b1,
                    float& minD, Point& point0, Point& point1);
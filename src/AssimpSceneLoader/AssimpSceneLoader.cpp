@@ -2,12 +2,14 @@
 #include <cnoid/SceneLoader>
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshFilter>
-#include <cnoid/ImageIO>
+#include <cnoid/AsyncImageLoader>
 #include <cnoid/NullOut>
 #include <cnoid/UTF8>
+#include <cnoid/ZipFileSystem>
 #include <cnoid/stdx/filesystem>
 #include <cnoid/stdx/optional>
 #include <assimp/Importer.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <fmt/format.h>
@@ -34,6 +36,26 @@ const bool USE_AFFINE_TRANSFORM = false;
 const bool ENABLE_FLIPPED_COORDINATE_EXPANSION = false;
 const bool ENABLE_WARNING_FOR_FLIPPED_COORDINATE = false;
 
+/*
+  The files of the mounted archives such as the material files and the binary buffers referred
+  by the model file are extracted when they are accessed by Assimp.
+*/
+class ArchivePreparingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+    virtual bool Exists(const char* filename) const override
+    {
+        ZipFileSystem::prepareFile(filename);
+        return Assimp::DefaultIOSystem::Exists(filename);
+    }
+    
+    virtual Assimp::IOStream* Open(const char* filename, const char* mode) override
+    {
+        ZipFileSystem::prepareFile(filename);
+        return Assimp::DefaultIOSystem::Open(filename, mode);
+    }
+};
+
 }
 
 namespace cnoid {
@@ -46,7 +68,7 @@ public:
     Assimp::Importer importer;
     const aiScene* scene;
     filesystem::path directoryPath;
-    ImageIO imageIO;
+    AsyncImageLoader imageLoader;
 
     stdx::optional<Affine3f> T_local;
     
@@ -102,8 +124,10 @@ AssimpSceneLoader::Impl::Impl()
 #ifdef AI_CONFIG_IMPORT_COLLADA_IGNORE_UP_DIRECTION
     importer.SetPropertyBool(AI_CONFIG_IMPORT_COLLADA_IGNORE_UP_DIRECTION, true);
 #endif
+    // The importer takes the ownership of the IO system
+    importer.SetIOHandler(new ArchivePreparingIOSystem);
 
-    imageIO.setUpsideDown(true);
+    imageLoader.setUpsideDown(true);
     os_ = &nullout();
 }
 
@@ -512,12 +536,10 @@ SgTexture* AssimpSceneLoader::Impl::convertAiTexture(unsigned int index)
             if(p != imagePathToSgImageMap.end()){
                 image = p->second;
             } else {
-                image = new SgImage;
-                if(imageIO.load(image->image(), textureFile, os())){
+                image = imageLoader.loadImage(textureFile, os());
+                if(image){
                     image->setUri(path.data, textureFile);
                     imagePathToSgImageMap[textureFile] = image;
-                } else {
-                    image.reset();
                 }
             }
             if(image){
@@ -67,6 +67,7 @@
 #include <cnoid/Config>
 #include <cnoid/ValueTree>
 #include <cnoid/FilePathVariableProcessor>
+#include <cnoid/AsyncImageLoader>
 #include <cnoid/UTF8>
 #include <fmt/format.h>
 #include <Eigen/Core>
@@ -355,6 +356,9 @@ void App::Impl::initialize()
     fpvp->restoreUserVariables(AppConfig::archive()->findMapping({ "path_variables", "pathVariables" }));
     FilePathVariableProcessor::setCurrentInstance(fpvp);
 
+    AsyncImageLoader::setMainThreadDispatcher(
+        [](const std::function<void()>& func){ callLater(func); });
+
     ext = new ExtensionManager("Base", false);
 
     setUTF8ToModuleTextDomain("Util");
@@ -12,7 +12,6 @@
 #include <cnoid/SceneNodeClassRegistry>
 #include <cnoid/SceneRenderer>
 #include <cnoid/CollisionDetector>
-#include <cnoid/ThreadPool>
 #include <cnoid/MathUtil>
 #include <cnoid/EigenUtil>
 #include <cnoid/EigenArchive>
@@ -104,8 +103,7 @@ public:
     CollisionDetectorPtr collisionDetector;
     CollisionDetectorDistanceAPI* collisionDetectorDistanceAPI;
     typedef CollisionDetector::GeometryHandle GeometryHandle;
-    vector<std::pair<GeometryHandle, GeometryHandle>> handlePairs;
-    unique_ptr<ThreadPool> threadPool;
+    vector<CollisionDetectorDistanceAPI::DistanceQuery> distanceQueries;
     LazyCaller calcDistanceLater;
     double distance;
     Signal<void(bool isValid)> sigDistanceUpdated;
@@ -521,18 +519,19 @@ void DistanceMeasurementItem::Impl::initializeCollisionDetector()
         updateCollisionDetectionPositions(i);
     }
 
-    handlePairs.clear();
+    distanceQueries.clear();
     for(auto& handle1 : targetInfos[0]->geometryHandles){
         if(handle1){
             for(auto& handle2 : targetInfos[1]->geometryHandles){
                 if(handle2){
-                    handlePairs.emplace_back(*handle1, *handle2);
+                    distanceQueries.emplace_back();
+                    auto& query = distanceQueries.back();
+                    query.geometry1 = *handle1;
+                    query.geometry2 = *handle2;
                 }
             }
         }
     }
-    int numThreads = std::min(static_cast<unsigned int>(handlePairs.size()), thread::hardware_concurrency());
-    threadPool = make_unique<ThreadPool>(numThreads);
     
     collisionDetector->makeReady();
 }
@@ -563,28 +562,20 @@ void DistanceMeasurementItem::Impl::updateCollisionDetectionPositions(int which)
 */
 void DistanceMeasurementItem::Impl::calcShortestDistance()
 {
+    // The pairs are computed in parallel by the collision detector
+    collisionDetectorDistanceAPI->detectDistances(distanceQueries);
+
     double shortestDistance = std::numeric_limits<double>::max();
     Vector3 p1s, p2s;
-    std::mutex distanceMutex;
     bool detected = false;
-    
-    for(auto& handlePair : handlePairs){
-        threadPool->start([&](){
-            Vector3 p1, p2;
-            auto distance = collisionDetectorDistanceAPI->detectDistance(
-                handlePair.first, handlePair.second, p1, p2);
-            {
-                std::lock_guard<std::mutex> guard(distanceMutex);
-                if(distance < shortestDistance){
-                    shortestDistance = distance;
-                    p1s = p1;
-                    p2s = p2;
-                    detected = true;
-                }
-            }
-        });
+    for(auto& query : distanceQueries){
+        if(query.distance >= 0.0 && query.distance < shortestDistance){
+            shortestDistance = query.distance;
+            p1s = query.point1;
+            p2s = query.point2;
+            detected = true;
+        }
     }
-    threadPool->wait();
 
     hasValidDistance = detected;
 
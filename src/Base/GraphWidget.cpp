@@ -47,6 +47,147 @@ struct EditHistory
 typedef std::shared_ptr<EditHistory> EditHistoryPtr;
 typedef deque<EditHistoryPtr> EditHistoryList;
 
+/**
+   Multi-resolution minimum and maximum values of a sequence.
+   The level k stores the values of the blocks of 2^(k+1) frames.
+*/
+class MinMaxPyramid
+{
+public:
+    struct Entry
+    {
+        double min;
+        double max;
+        int minFrame;
+        int maxFrame;
+    };
+    vector<vector<Entry>> levels;
+
+    MinMaxPyramid() : isValid(false), dirtyFrameBegin(0), dirtyFrameEnd(0) { }
+
+    void invalidate() { isValid = false; }
+
+    void invalidate(int frameBegin, int frameEnd) {
+        if(isValid && frameBegin < frameEnd){
+            if(dirtyFrameBegin < dirtyFrameEnd){
+                dirtyFrameBegin = std::min(dirtyFrameBegin, frameBegin);
+                dirtyFrameEnd = std::max(dirtyFrameEnd, frameEnd);
+            } else {
+                dirtyFrameBegin = frameBegin;
+                dirtyFrameEnd = frameEnd;
+            }
+        }
+    }
+
+    template<class ValueFunc>
+    void update(int numFrames, ValueFunc getValue) {
+        if(!isValid){
+            build(numFrames, getValue);
+        } else if(dirtyFrameBegin < dirtyFrameEnd){
+            updateRange(numFrames, getValue);
+        }
+    }
+
+    //! \return The level index whose block size is equal to or larger than the given frame count
+    int findLevel(double numFramesInBlock) const {
+        int level = 0;
+        int blockSize = 2;
+        while(blockSize < numFramesInBlock && level + 1 < static_cast<int>(levels.size())){
+            blockSize *= 2;
+            ++level;
+        }
+        return level;
+    }
+
+private:
+    bool isValid;
+    int dirtyFrameBegin;
+    int dirtyFrameEnd;
+
+    static void merge(Entry& entry, const Entry& other){
+        if(other.min < entry.min){
+            entry.min = other.min;
+            entry.minFrame = other.minFrame;
+        }
+        if(other.max > entry.max){
+            entry.max = other.max;
+            entry.maxFrame = other.maxFrame;
+        }
+    }
+
+    template<class ValueFunc>
+    void updateBaseEntry(int index, int numFrames, ValueFunc& getValue){
+        auto& entry = levels[0][index];
+        const int frame = index * 2;
+        const double v = getValue(frame);
+        entry.min = entry.max = v;
+        entry.minFrame = entry.maxFrame = frame;
+        if(frame + 1 < numFrames){
+            const double v2 = getValue(frame + 1);
+            if(v2 < entry.min){
+                entry.min = v2;
+                entry.minFrame = frame + 1;
+            } else if(v2 > entry.max){
+                entry.max = v2;
+                entry.maxFrame = frame + 1;
+            }
+        }
+    }
+
+    void updateEntry(int level, int index){
+        auto& lower = levels[level - 1];
+        auto& entry = levels[level][index];
+        entry = lower[index * 2];
+        if(index * 2 + 1 < static_cast<int>(lower.size())){
+            merge(entry, lower[index * 2 + 1]);
+        }
+    }
+
+    template<class ValueFunc>
+    void build(int numFrames, ValueFunc& getValue){
+        levels.clear();
+        if(numFrames > 0){
+            levels.emplace_back((numFrames + 1) / 2);
+            const int n = levels[0].size();
+            for(int i=0; i < n; ++i){
+                updateBaseEntry(i, numFrames, getValue);
+            }
+            while(levels.back().size() > 1){
+                const int level = levels.size();
+                const int m = (levels.back().size() + 1) / 2;
+                levels.emplace_back(m);
+                for(int i=0; i < m; ++i){
+                    updateEntry(level, i);
+                }
+            }
+        }
+        isValid = true;
+        dirtyFrameBegin = dirtyFrameEnd = 0;
+    }
+
+    template<class ValueFunc>
+    void updateRange(int numFrames, ValueFunc& getValue){
+        const int frameBegin = std::max(0, dirtyFrameBegin);
+        const int frameEnd = std::min(numFrames, dirtyFrameEnd);
+        dirtyFrameBegin = dirtyFrameEnd = 0;
+        if(levels.empty() || frameBegin >= frameEnd){
+            return;
+        }
+        int indexBegin = frameBegin / 2;
+        int indexEnd = (frameEnd - 1) / 2 + 1;
+        for(int i = indexBegin; i < indexEnd; ++i){
+            updateBaseEntry(i, numFrames, getValue);
+        }
+        for(size_t level = 1; level < levels.size(); ++level){
+            indexBegin /= 2;
+            indexEnd = (indexEnd - 1) / 2 + 1;
+            for(int i = indexBegin; i < indexEnd; ++i){
+                updateEntry(level, i);
+            }
+        }
+    }
+};
+
 }
 
 namespace cnoid {
@@ -66,6 +207,9 @@ public:
     */
     vector<double> values;
     int numFrames; // the actual number of frames (values.size() - 2)
+
+    MinMaxPyramid valuePyramid;
+    MinMaxPyramid velocityPyramid;
         
     int prevNumValues;
     double offset;
@@ -87,6 +231,16 @@ public:
 
     GraphDataHandler::DataRequestCallback dataRequestCallback;
     GraphDataHandler::DataModifiedCallback dataModifiedCallback;
+
+    void invalidateMinMaxPyramids(){
+        valuePyramid.invalidate();
+        velocityPyramid.invalidate();
+    }
+    void invalidateMinMaxPyramids(int frameBegin, int frameEnd){
+        valuePyramid.invalidate(frameBegin, frameEnd);
+        // The velocity of a frame depends on the values of the adjacent frames
+        velocityPyramid.invalidate(frameBegin - 1, frameEnd + 1);
+    }
 };
 
 class GraphWidgetImpl
@@ -229,6 +383,8 @@ public:
     void selectEditTargetByClicking(double screenX, double screenY);
     bool onScreenPaintEvent(QPaintEvent* event);
     void drawTrajectory(QPainter& painter, const QRect& rect, GraphDataHandlerImpl* data);
+    void setMinMaxPolyline(
+        const MinMaxPyramid& pyramid, int frame, int frame_begin, int frame_end, double screenOffsetX, double xratio);
     void drawLimits(QPainter& painter, GraphDataHandlerImpl* data);
     void updateControlPoints(GraphDataHandlerImpl* data);
     void drawGrid(QPainter& painter);
@@ -291,6 +447,7 @@ void GraphDataHandler::setFrameProperties(int numFrames, double frameRate, doubl
 {
     impl->values.resize(numFrames + 2);
     impl->numFrames = numFrames;
+    impl->invalidateMinMaxPyramids();
     impl->stepRatio = 1.0 / frameRate;
     impl->offset = offset;
     impl->isControlPointUpdateNeeded = true;
@@ -535,6 +692,7 @@ void GraphWidgetImpl::updateData(GraphDataHandlerPtr handler)
     if(data->dataRequestCallback){
         vector<double>& values = data->values;
         data->dataRequestCallback(0, data->numFrames, &(values[1]));
+        data->invalidateMinMaxPyramids();
     }
     screen->update();
 }
@@ -1401,6 +1559,7 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
     if(editMode == GraphWidget::LINE_MODE){
         EditHistoryPtr& history = editTarget->editHistories.back();
         std::copy(history->orgValues.begin(), history->orgValues.end(), &values[history->frame]);
+        editTarget->invalidateMinMaxPyramids(history->frame, history->frame + history->orgValues.size());
     }
 
     if(frameBegin < frameEnd){
@@ -1441,6 +1600,8 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
             }
         }
 
+        editTarget->invalidateMinMaxPyramids(frameBegin, frameEnd);
+
         editedFrameBegin = std::min(editedFrameBegin, frameBegin);
         editedFrameEnd = std::max(editedFrameEnd, frameEnd);
 
@@ -1501,6 +1662,7 @@ void GraphWidgetImpl::undoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->orgValues.begin(), history->orgValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->invalidateMinMaxPyramids(history->frame, history->frame + history->orgValues.size());
             editTarget->dataModifiedCallback(history->frame, history->orgValues.size(), &history->orgValues[0]);
             screen->update();
         }
@@ -1517,6 +1679,7 @@ void GraphWidgetImpl::redoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->newValues.begin(), history->newValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->invalidateMinMaxPyramids(history->frame, history->frame + history->newValues.size());
             editTarget->dataModifiedCallback(history->frame, history->newValues.size(), &history->newValues[0]);
             currentHistory++;
             screen->update();
@@ -1698,37 +1861,9 @@ void GraphWidgetImpl::drawTrajectory
                     ++frame;
                 }
             } else {
-                const int m = (int)(0.5 / xratio);
-                const int n = ceil(double(frame_end - frame) / m);
-                polyline.resize(n * 2);
-                for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
-                    const int next = std::min(frame + m, frame_end);
-                    double min = calcVelocity(frame++, values, stepRatio2);
-                    double max = min;
-                    while(frame < next){
-                        const double v = calcVelocity(frame, values, stepRatio2);
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                        frame++;
-                    }
-                    const double upper = screenCenterY - (max + centerY) * scaleY;
-                    const double lower = screenCenterY - (min + centerY) * scaleY;
-
-                    if(px_min <= px_max){
-                        polyline[i*2] = QPointF(px_min, lower);
-                        polyline[i*2+1] = QPointF(px_max, upper);
-                    } else {
-                        polyline[i*2] = QPointF(px_max, upper);
-                        polyline[i*2+1] = QPointF(px_min, lower);
-                    }
-                }
+                data->velocityPyramid.update(
+                    numFrames, [&](int frame){ return calcVelocity(frame, values, stepRatio2); });
+                setMinMaxPolyline(data->velocityPyramid, frame, frame_begin, frame_end, screenOffsetX, xratio);
             }
 
             painter.drawPolyline(polyline);
@@ -1754,35 +1889,8 @@ void GraphWidgetImpl::drawTrajectory
                     ++frame;
                 }
             } else {
-                const int m = (int)(0.5 / xratio);
-                const int n = ceil(double(frame_end - frame) / m);
-                polyline.resize(n * 2);
-                for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
-                    const int next = std::min(frame + m, frame_end);
-                    double min = values[frame++];
-                    double max = min;
-                    while(frame < next){
-                        const double v = values[frame++];
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                    }
-                    const double upper = screenCenterY - (max + centerY) * scaleY;
-                    const double lower = screenCenterY - (min + centerY) * scaleY;
-                    if(px_min <= px_max){
-                        polyline[i*2] = QPointF(px_min, lower);
-                        polyline[i*2+1] = QPointF(px_max, upper);
-                    } else {
-                        polyline[i*2] = QPointF(px_max, upper);
-                        polyline[i*2+1] = QPointF(px_min, lower);
-                    }
-                }
+                data->valuePyramid.update(numFrames, [&](int frame){ return values[frame]; });
+                setMinMaxPolyline(data->valuePyramid, frame, frame_begin, frame_end, screenOffsetX, xratio);
             }
 
             painter.drawPolyline(polyline);
@@ -1823,6 +1931,41 @@ void GraphWidgetImpl::updateControlPoints(GraphDataHandlerImpl* data)
 }
 
 
+/**
+   At most two points per pixel are given to the polyline from the pyramid level
+   whose block size corresponds to the frames in a pixel.
+*/
+void GraphWidgetImpl::setMinMaxPolyline
+(const MinMaxPyramid& pyramid, int frame, int frame_begin, int frame_end, double screenOffsetX, double xratio)
+{
+    if(pyramid.levels.empty()){
+        polyline.clear();
+        return;
+    }
+    const int level = pyramid.findLevel(1.0 / xratio);
+    const auto& entries = pyramid.levels[level];
+    const int blockSize = 2 << level;
+    const int index_begin = frame / blockSize;
+    const int index_end = std::min((frame_end - 1) / blockSize + 1, static_cast<int>(entries.size()));
+    const int n = std::max(0, index_end - index_begin);
+    polyline.resize(n * 2);
+    for(int i=0; i < n; ++i){
+        const auto& entry = entries[index_begin + i];
+        const double px_min = screenOffsetX + (entry.minFrame - frame_begin) * xratio;
+        const double px_max = screenOffsetX + (entry.maxFrame - frame_begin) * xratio;
+        const double upper = screenCenterY - (entry.max + centerY) * scaleY;
+        const double lower = screenCenterY - (entry.min + centerY) * scaleY;
+        if(px_min <= px_max){
+            polyline[i*2] = QPointF(px_min, lower);
+            polyline[i*2+1] = QPointF(px_max, upper);
+        } else {
+            polyline[i*2] = QPointF(px_max, upper);
+            polyline[i*2+1] = QPointF(px_min, lower);
+        }
+    }
+}
+
+
 void GraphWidgetImpl::drawLimits(QPainter& painter, GraphDataHandlerImpl* data)
 {
     pen.setDashPattern(limitValueDashes);
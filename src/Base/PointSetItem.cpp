@@ -5,14 +5,20 @@
 #include "MenuManager.h"
 #include "PutPropertyFunction.h"
 #include "Archive.h"
+#include "LazyCaller.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/SceneWidget>
 #include <cnoid/SceneWidgetEventHandler>
 #include <cnoid/SceneDrawables>
 #include <cnoid/SceneMarkers>
 #include <cnoid/PointSetUtil>
+#include <cnoid/PointSetOctree>
 #include <cnoid/PolyhedralRegion>
+#include <cnoid/SceneNodeClassRegistry>
+#include <cnoid/SceneRenderer>
 #include <cnoid/CloneMap>
+#include <unordered_map>
+#include <algorithm>
 #include <stdexcept>
 #include "gettext.h"
 
@@ -21,6 +27,28 @@ using namespace cnoid;
 
 namespace {
 
+const int DefaultMaxNumRenderedPoints = 5000000;
+
+//! The elements of the given indices are removed without copying the whole array
+template<class ElementContainer>
+void removeElements(ElementContainer& elements, const vector<int>& sortedIndicesToRemove)
+{
+    const int n = elements.size();
+    auto p = sortedIndicesToRemove.begin();
+    int j = 0;
+    for(int i=0; i < n; ++i){
+        if(p != sortedIndicesToRemove.end() && *p == i){
+            ++p;
+        } else {
+            if(j < i){
+                elements[j] = elements[i];
+            }
+            ++j;
+        }
+    }
+    elements.resize(j);
+}
+
 class PointSetItemPcdFileIo : public ItemFileIoBase<PointSetItem>
 {
 public:
@@ -29,6 +57,78 @@ public:
     virtual bool save(PointSetItem* item, const std::string& filename) override;
 };
 
+class ScenePointSet;
+
+/**
+   This node renders the points selected with the octree depending on the viewpoint of
+   each renderer when the number of the points exceeds the maximum number of rendered points.
+   The points for a new viewpoint are selected after the rendering so that the scene graph
+   is not modified in the rendering, and the points selected for the previous viewpoint or
+   the initial points selected for a distant viewpoint are rendered until then.
+*/
+class PointSetLodGroup : public SgGroup
+{
+public:
+    PointSetLodGroup(SgPointSet* orgPointSet, PointSetOctree* octree, int maxNumPoints, double pointSize);
+    PointSetLodGroup(const PointSetLodGroup& org, CloneMap* cloneMap);
+    ~PointSetLodGroup();
+
+    struct View
+    {
+        Vector3f viewpoint;
+        SgPointSetPtr pointSet;
+        bool isUpdateRequested;
+        View() : isUpdateRequested(false) { }
+    };
+    typedef shared_ptr<View> ViewPtr;
+
+    // The group has no children, so the bounding box of the whole point set is returned
+    virtual const BoundingBox& boundingBox() const override;
+    void addView(const ViewPtr& view);
+    void render(SceneRenderer* renderer, const ViewPtr& view);
+
+protected:
+    virtual Referenced* doClone(CloneMap* cloneMap) const override;
+
+private:
+    // The arrays are referred instead of the original point set so that the clones are not
+    // affected by the replacement of the arrays of the original point set
+    SgVertexArrayPtr orgVertices;
+    SgColorArrayPtr orgColors;
+    SgIndexArray orgColorIndices;
+    BoundingBox bbox;
+    PointSetOctreePtr octree;
+    int maxNumPoints;
+    SgPointSetPtr initialPointSet;
+    // The views are owned by the renderers
+    vector<weak_ptr<View>> views;
+    vector<int> indices;
+
+    bool checkIfViewpointMoved(const Vector3f& viewpoint, const Vector3f& prevViewpoint) const;
+    void selectPoints(const Vector3f& viewpoint, SgPointSet* pointSet);
+    void updateView(View& view, const Vector3f& viewpoint);
+};
+
+typedef ref_ptr<PointSetLodGroup> PointSetLodGroupPtr;
+
+/**
+   The views of the LOD groups rendered by a renderer. This object is owned by the rendering
+   function of the renderer so that the selected points are released with the renderer.
+*/
+class PointSetLodViewMap
+{
+public:
+    PointSetLodGroup::ViewPtr findOrCreateView(PointSetLodGroup* group);
+
+private:
+    struct Entry
+    {
+        weak_ref_ptr<PointSetLodGroup> group;
+        PointSetLodGroup::ViewPtr view;
+    };
+    unordered_map<PointSetLodGroup*, Entry> entries;
+};
+
 class ScenePointSet : public SgPosTransform, public SceneWidgetEventHandler
 {
 public:
@@ -37,6 +137,11 @@ public:
     weak_ref_ptr<PointSetItem> weakPointSetItem;
     SgPointSetPtr orgPointSet;
     SgPointSetPtr visiblePointSet;
+    PointSetLodGroupPtr lodGroup;
+    int maxNumRenderedPoints;
+    PointSetOctreePtr octree;
+    // True when the octree has been updated for the next content update
+    bool isOctreeUpdatedForContents;
     SgUpdate update;
     SgShapePtr voxels;
     float voxelSize;
@@ -53,6 +158,9 @@ public:
 
     void setPointSize(double size);
     void setVoxelSize(double size);
+    void setMaxNumRenderedPoints(int n);
+    PointSetOctree* getOrCreateOctree();
+    Vector3 findNearestPoint(const Vector3& point);
     int numAttentionPoints() const;
     Vector3 attentionPoint(int index) const;
     void clearAttentionPoints(bool doNotify);
@@ -110,6 +218,7 @@ public:
     void removePoints(const PolyhedralRegion& region);
     template<class ElementContainer>
     void removeSubElements(ElementContainer& elements, SgIndexArray& indices, const vector<int>& indicesToRemove);
+    bool onMaxNumRenderedPointsPropertyChanged(int n);
     bool onTranslationPropertyChanged(const std::string& value);
     bool onRotationPropertyChanged(const std::string& value);
 };
@@ -357,6 +466,28 @@ void PointSetItem::setVoxelSize(double size)
 }
 
 
+void PointSetItem::setMaxNumRenderedPoints(int n)
+{
+    impl->scene->setMaxNumRenderedPoints(n);
+}
+
+
+int PointSetItem::maxNumRenderedPoints() const
+{
+    return impl->scene->maxNumRenderedPoints;
+}
+
+
+bool PointSetItem::Impl::onMaxNumRenderedPointsPropertyChanged(int n)
+{
+    if(n >= 0){
+        scene->setMaxNumRenderedPoints(n);
+        return true;
+    }
+    return false;
+}
+
+
 void PointSetItem::setEditable(bool on)
 {
     impl->scene->setEditable(on);
@@ -454,37 +585,22 @@ void PointSetItem::removePoints(const PolyhedralRegion& region)
 void PointSetItem::Impl::removePoints(const PolyhedralRegion& region)
 {
     vector<int> indicesToRemove;
-    const Isometry3 T = scene->T();
-    SgVertexArray orgPoints(*pointSet->vertices());
-    const int numOrgPoints = orgPoints.size();
-
-    for(int i=0; i < numOrgPoints; ++i){
-        if(region.checkInside(T * orgPoints[i].cast<Vector3::Scalar>())){
-            indicesToRemove.push_back(i);
-        }
+    PointSetOctree* octree = nullptr;
+    if(pointSet->hasVertices()){
+        octree = scene->getOrCreateOctree();
+        octree->findPointsInRegion(*pointSet->vertices(), region, scene->T(), indicesToRemove);
     }
 
     if(!indicesToRemove.empty()){
-        SgVertexArray& points = *pointSet->vertices();
-        points.clear();
-        int j = 0;
-        int nextIndexToRemove = indicesToRemove[j++];
-        for(int i=0; i < numOrgPoints; ++i){
-            if(i == nextIndexToRemove){
-                if(j < static_cast<int>(indicesToRemove.size())){
-                    nextIndexToRemove = indicesToRemove[j++];
-                }
-            } else {
-                points.push_back(orgPoints[i]);
-                
-            }
-        }
+        removeElements(*pointSet->vertices(), indicesToRemove);
         if(pointSet->hasNormals()){
             removeSubElements(*pointSet->normals(), pointSet->normalIndices(), indicesToRemove);
         }
         if(pointSet->hasColors()){
             removeSubElements(*pointSet->colors(), pointSet->colorIndices(), indicesToRemove);
         }
+        octree->removePoints(indicesToRemove);
+        scene->isOctreeUpdatedForContents = true;
 
         pointSet->notifyUpdate(scene->update.withAction(SgUpdate::Modified));
     }
@@ -496,23 +612,12 @@ void PointSetItem::Impl::removePoints(const PolyhedralRegion& region)
 template<class ElementContainer>
 void PointSetItem::Impl::removeSubElements(ElementContainer& elements, SgIndexArray& indices, const vector<int>& indicesToRemove)
 {
-    const ElementContainer orgElements(elements);
-    const int numOrgElements = orgElements.size();
-    elements.clear();
-    
     if(indices.empty()){
-        int j = 0;
-        int nextIndexToRemove = indicesToRemove[j++];
-        for(int i=0; i < numOrgElements; ++i){
-            if(i == nextIndexToRemove){
-                if(j < static_cast<int>(indicesToRemove.size())){
-                    nextIndexToRemove = indicesToRemove[j++];
-                }
-            } else {
-                elements.push_back(orgElements[i]);
-            }
-        }
+        removeElements(elements, indicesToRemove);
     } else {
+        const ElementContainer orgElements(elements);
+        const int numOrgElements = orgElements.size();
+        elements.clear();
         const SgIndexArray orgIndices(indices);
         const int numOrgIndices = orgIndices.size();
         indices.clear();
@@ -561,6 +666,9 @@ void PointSetItem::doPutProperties(PutPropertyFunction& putProperty)
         (_("Voxel size"), voxelSize(),
          [=](double size){ scene->setVoxelSize(size); return true; });
     
+    putProperty.min(0)
+        (_("Max rendered points"), maxNumRenderedPoints(),
+         [&](int n){ return impl->onMaxNumRenderedPointsPropertyChanged(n); });
     putProperty(_("Editable"), isEditable(), [&](bool on){ return impl->onEditableChanged(on); });
     const SgVertexArray* points = impl->pointSet->vertices();
     putProperty(_("Num points"), static_cast<int>(points ? points->size() : 0));
@@ -608,6 +716,7 @@ bool PointSetItem::store(Archive& archive)
     archive.write("rendering_mode", scene->renderingMode.selectedSymbol());
     archive.write("point_size", pointSize());
     archive.write("voxel_size", scene->voxelSize);
+    archive.write("max_rendered_points", scene->maxNumRenderedPoints);
     archive.write("is_editable", isEditable());
     
     return true;
@@ -651,6 +760,7 @@ bool PointSetItem::restore(const Archive& archive)
     }
     scene->setPointSize(archive.get({ "point_size", "pointSize" }, pointSize()));
     scene->setVoxelSize(archive.get({ "voxel_size", "voxelSize" }, voxelSize()));
+    scene->setMaxNumRenderedPoints(archive.get("max_rendered_points", scene->maxNumRenderedPoints));
     setEditable(archive.get({ "is_editable", "isEditable" }, isEditable()));
 
     return true;
@@ -663,12 +773,195 @@ SgNode* PointSetItem::getScene()
 }
 
 
+PointSetLodGroup::PointSetLodGroup
+(SgPointSet* orgPointSet, PointSetOctree* octree, int maxNumPoints, double pointSize)
+    : SgGroup(findClassId<PointSetLodGroup>()),
+      orgVertices(orgPointSet->vertices()),
+      orgColors(orgPointSet->colors()),
+      orgColorIndices(orgPointSet->colorIndices()),
+      bbox(orgPointSet->boundingBox()),
+      octree(octree),
+      maxNumPoints(maxNumPoints)
+{
+    initialPointSet = new SgPointSet;
+    initialPointSet->setPointSize(pointSize);
+    if(!bbox.empty()){
+        const Vector3f distantViewpoint =
+            (bbox.center() + Vector3::UnitZ() * (100.0 * bbox.size().norm())).cast<float>();
+        selectPoints(distantViewpoint, initialPointSet);
+    }
+}
+
+
+PointSetLodGroup::PointSetLodGroup(const PointSetLodGroup& org, CloneMap* cloneMap)
+    : SgGroup(org, cloneMap),
+      orgVertices(org.orgVertices),
+      orgColors(org.orgColors),
+      orgColorIndices(org.orgColorIndices),
+      bbox(org.bbox),
+      octree(org.octree),
+      maxNumPoints(org.maxNumPoints),
+      initialPointSet(org.initialPointSet)
+{
+
+}
+
+
+PointSetLodGroup::~PointSetLodGroup()
+{
+    // The selected points are released even if the views are still owned by the renderers
+    for(auto& weakView : views){
+        if(auto view = weakView.lock()){
+            view->pointSet.reset();
+        }
+    }
+}
+
+
+Referenced* PointSetLodGroup::doClone(CloneMap* cloneMap) const
+{
+    return new PointSetLodGroup(*this, cloneMap);
+}
+
+
+const BoundingBox& PointSetLodGroup::boundingBox() const
+{
+    return bbox;
+}
+
+
+void PointSetLodGroup::addView(const ViewPtr& view)
+{
+    views.erase(
+        std::remove_if(views.begin(), views.end(), [](const weak_ptr<View>& view){ return view.expired(); }),
+        views.end());
+    views.push_back(view);
+}
+
+
+bool PointSetLodGroup::checkIfViewpointMoved(const Vector3f& viewpoint, const Vector3f& prevViewpoint) const
+{
+    if(bbox.empty()){
+        return false;
+    }
+    const Vector3f bmin = bbox.min().cast<float>();
+    const Vector3f bmax = bbox.max().cast<float>();
+    const float distanceToPoints =
+        (prevViewpoint.cwiseMax(bmin).cwiseMin(bmax) - prevViewpoint).norm();
+    const float d = std::max(distanceToPoints, 0.05f * (bmax - bmin).norm());
+    return (viewpoint - prevViewpoint).norm() > 0.1f * d;
+}
+
+
+//! The arrays of the point set are reused.
+void PointSetLodGroup::selectPoints(const Vector3f& viewpoint, SgPointSet* pointSet)
+{
+    octree->selectLodPoints(viewpoint, maxNumPoints, indices);
+    const int n = indices.size();
+
+    auto& vertices = *pointSet->getOrCreateVertices();
+    vertices.resize(n);
+    for(int i=0; i < n; ++i){
+        vertices[i] = (*orgVertices)[indices[i]];
+    }
+    // The normals are not copied because they are not used in rendering the points
+    if(orgColors){
+        auto& colors = *pointSet->getOrCreateColors();
+        colors.resize(n);
+        for(int i=0; i < n; ++i){
+            const int index = orgColorIndices.empty() ? indices[i] : orgColorIndices[indices[i]];
+            colors[i] = (*orgColors)[index];
+        }
+    }
+}
+
+
+void PointSetLodGroup::render(SceneRenderer* renderer, const ViewPtr& view)
+{
+    const Affine3& M = renderer->currentModelTransform();
+    const Vector3f viewpoint = (M.inverse() * renderer->currentCameraPosition().translation()).cast<float>();
+
+    if(!view->isUpdateRequested && (!view->pointSet || checkIfViewpointMoved(viewpoint, view->viewpoint))){
+        view->isUpdateRequested = true;
+        weak_ref_ptr<PointSetLodGroup> weakSelf(this);
+        weak_ptr<View> weakView(view);
+        callLater(
+            [weakSelf, weakView, viewpoint](){
+                auto self = weakSelf.lock();
+                auto view = weakView.lock();
+                if(self && view){
+                    self->updateView(*view, viewpoint);
+                }
+            });
+    }
+
+    renderer->renderNode(view->pointSet ? view->pointSet : initialPointSet);
+}
+
+
+void PointSetLodGroup::updateView(View& view, const Vector3f& viewpoint)
+{
+    if(!view.pointSet){
+        view.pointSet = new SgPointSet;
+        view.pointSet->setPointSize(initialPointSet->pointSize());
+    }
+    selectPoints(viewpoint, view.pointSet);
+    view.viewpoint = viewpoint;
+    view.isUpdateRequested = false;
+
+    // The point set is not a child of this node, so the update of this node is also notified
+    // to redraw the scene
+    view.pointSet->notifyUpdate();
+    notifyUpdate();
+}
+
+
+PointSetLodGroup::ViewPtr PointSetLodViewMap::findOrCreateView(PointSetLodGroup* group)
+{
+    auto it = entries.find(group);
+    if(it != entries.end()){
+        if(!it->second.group.expired()){
+            return it->second.view;
+        }
+        entries.erase(it);
+    }
+    for(auto it = entries.begin(); it != entries.end(); ){
+        if(it->second.group.expired()){
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto& entry = entries[group];
+    entry.group = weak_ref_ptr<PointSetLodGroup>(group);
+    entry.view = make_shared<PointSetLodGroup::View>();
+    group->addView(entry.view);
+    return entry.view;
+}
+
+
 ScenePointSet::ScenePointSet(PointSetItem::Impl* pointSetItemImpl)
     : weakPointSetItem(pointSetItemImpl->self),
       orgPointSet(pointSetItemImpl->pointSet),
       renderingMode(PointSetItem::N_RENDERING_MODES)
 {
+    auto& registry = SceneNodeClassRegistry::instance();
+    if(!registry.hasRegistration<PointSetLodGroup>()){
+        registry.registerClass<PointSetLodGroup, SgGroup>();
+        SceneRenderer::addExtension(
+            [](SceneRenderer* renderer){
+                auto viewMap = make_shared<PointSetLodViewMap>();
+                renderer->renderingFunctions()->setFunction<PointSetLodGroup>(
+                    [renderer, viewMap](SgNode* node){
+                        auto group = static_cast<PointSetLodGroup*>(node);
+                        group->render(renderer, viewMap->findOrCreateView(group));
+                    });
+            });
+    }
+
     visiblePointSet = new SgPointSet;
+    maxNumRenderedPoints = DefaultMaxNumRenderedPoints;
+    isOctreeUpdatedForContents = false;
 
     voxels = new SgShape;
     voxels->getOrCreateMaterial();
@@ -710,6 +1003,47 @@ void ScenePointSet::setVoxelSize(double size)
 }
 
 
+void ScenePointSet::setMaxNumRenderedPoints(int n)
+{
+    if(n != maxNumRenderedPoints){
+        maxNumRenderedPoints = n;
+        if(renderingMode.is(PointSetItem::POINT) && invariant){
+            updateVisualization(false);
+        }
+    }
+}
+
+
+PointSetOctree* ScenePointSet::getOrCreateOctree()
+{
+    if(!octree){
+        octree = new PointSetOctree;
+        if(orgPointSet->hasVertices()){
+            octree->build(*orgPointSet->vertices());
+        }
+    }
+    return octree;
+}
+
+
+/**
+   \return The position of the point nearest to the given position in the global coordinate.
+   The given position is returned if there is no point near the position.
+*/
+Vector3 ScenePointSet::findNearestPoint(const Vector3& point)
+{
+    if(orgPointSet->hasVertices()){
+        const float maxDistance = renderingMode.is(PointSetItem::VOXEL) ? voxelSize : 0.01f;
+        const Vector3f p = (T().inverse() * point).cast<float>();
+        int index = getOrCreateOctree()->findNearestPoint(*orgPointSet->vertices(), p, maxDistance);
+        if(index >= 0){
+            return T() * (*orgPointSet->vertices())[index].cast<double>();
+        }
+    }
+    return point;
+}
+
+
 int ScenePointSet::numAttentionPoints() const
 {
     return attentionPointMarkerGroup ? attentionPointMarkerGroup->numChildren() : 0;
@@ -805,14 +1139,33 @@ void ScenePointSet::updateVisualization(bool updateContents)
         removeChild(invariant);
         invariant->removeChild(visiblePointSet);
         invariant->removeChild(voxels);
+        if(lodGroup){
+            invariant->removeChild(lodGroup);
+            lodGroup.reset();
+        }
     }
     invariant = new SgInvariantGroup;
+
+    if(updateContents){
+        if(!isOctreeUpdatedForContents){
+            octree.reset();
+        }
+        isOctreeUpdatedForContents = false;
+    }
     
     if(renderingMode.is(PointSetItem::POINT)){
         if(updateContents){
             updateVisiblePointSet();
         }
-        invariant->addChild(visiblePointSet);
+        auto vertices = orgPointSet->vertices();
+        if(maxNumRenderedPoints > 0 && vertices &&
+           static_cast<int>(vertices->size()) > maxNumRenderedPoints){
+            lodGroup = new PointSetLodGroup(
+                orgPointSet, getOrCreateOctree(), maxNumRenderedPoints, visiblePointSet->pointSize());
+            invariant->addChild(lodGroup);
+        } else {
+            invariant->addChild(visiblePointSet);
+        }
     } else {
         if(updateContents){
             updateVoxels();
@@ -932,12 +1285,13 @@ bool ScenePointSet::onButtonPressEvent(SceneWidgetEvent* event)
     bool processed = false;
     
     if(event->button() == Qt::LeftButton){
+        const Vector3 point = findNearestPoint(event->point());
         if(event->modifiers() & Qt::ControlModifier){
-            if(!removeAttentionPoint(event->point(), 0.01, true)){
-                addAttentionPoint(event->point(), true);
+            if(!removeAttentionPoint(point, 0.01, true)){
+                addAttentionPoint(point, true);
             }
         } else {
-            setAttentionPoint(event->point(), true);
+            setAttentionPoint(point, true);
         }
         processed = true;
     }
@@ -50,6 +50,13 @@ public:
     static double defaultVoxelSize();
     double voxelSize() const;
     void setVoxelSize(double size);
+
+    /**
+       The points rendered in the point mode are selected depending on the viewpoint so that
+       the number of the points does not exceed this value. Zero means no limit.
+    */
+    void setMaxNumRenderedPoints(int n);
+    int maxNumRenderedPoints() const;
     
     void setEditable(bool on);
     bool isEditable() const;
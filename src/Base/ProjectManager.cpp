@@ -1,4 +1,5 @@
 #include "ProjectManager.h"
+#include "ProjectPacker.h"
 #include "RootItem.h"
 #include "ItemManager.h"
 #include "ViewManager.h"
@@ -40,6 +41,8 @@ int projectBeingLoadedCounter = 0;
 MainWindow* mainWindow = nullptr;
 MessageView* mv = nullptr;
 vector<string> projectFilesToLoad;
+vector<string> projectPackFilesToLoad;
+bool isOnDemandUnpackingMode = false;
 
 class SaveDialog : public FileDialog
 {
@@ -174,8 +177,14 @@ ProjectManager::Impl::Impl(ProjectManager* self, ExtensionManager* ext)
     saveDialog = nullptr;
     isMainInstance = true;
 
+    ::isOnDemandUnpackingMode = config->get("on_demand_unpacking", false);
+
     auto om = OptionManager::instance();
     om->add_option("--project", projectFilesToLoad, "load a project file");
+    om->add_option("--project-pack", projectPackFilesToLoad, "load a project pack file");
+    om->add_flag(
+        "--unpack-on-demand", ::isOnDemandUnpackingMode,
+        "extract the files of the project packs only when they are loaded");
     om->sigInputFileOptionsParsed().connect(
         [this](std::vector<std::string>& inputFiles){ onInputFileOptionsParsed(inputFiles); });
     om->sigOptionsParsed().connect(
@@ -767,6 +776,11 @@ void ProjectManager::Impl::onProjectOptionsParsed()
     for(auto& file : projectFilesToLoad){
         loadProject(file, nullptr, true, false, false);
     }
+    for(auto& file : projectPackFilesToLoad){
+        ProjectPacker packer;
+        packer.setOnDemandUnpackingEnabled(::isOnDemandUnpackingMode);
+        packer.loadPackedProject(file);
+    }
 }
 
 
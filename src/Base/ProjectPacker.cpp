@@ -7,6 +7,8 @@
 #include <cnoid/FileUtil>
 #include <cnoid/UTF8>
 #include <cnoid/Config>
+#include <cnoid/ZipArchiver>
+#include <cnoid/ZipFileSystem>
 #include <fmt/format.h>
 #include <zip.h>
 #include <map>
@@ -51,6 +53,7 @@ public:
 
     vector<fs::path> refDirPaths;
     string unpackingDir;
+    bool isOnDemandUnpackingEnabled;
 
     Impl(ProjectPacker* self);
     fs::path getUnifiedFormatPath(const std::string& pathString, bool& out_isAbsolute);
@@ -61,10 +64,10 @@ public:
     void updatePackingItmes(Item* item);
     std::string getRelocatedFilePath(const std::string& pathString);
     bool createProjectZipFile(const string& zipFilename);
-    bool addDirectoryToZip(zip_t * zip, fs::path dirPath, const fs::path& zipTopDirPath);
     bool unpackProject(const std::string& projectPackFile);
     bool extractFiles(
         zip_t* zip, const string& zipFilename, const fs::path&  zipFilePath, const fs::path& topDirPath);
+    bool loadPackedProjectOnDemand(const std::string& projectPackFile);
     bool loadUnpackedProject(const std::string& projectFile);    
 };
 
@@ -81,6 +84,7 @@ ProjectPacker::Impl::Impl(ProjectPacker* self)
     : self(self)
 {
     topItemForPacking = nullptr;
+    isOnDemandUnpackingEnabled = false;
     
     mout = MessageOut::master();
     self->mout_ = mout;
@@ -493,100 +497,14 @@ Item* ProjectPacker::getPackingItem(Item* item)
 
 bool ProjectPacker::Impl::createProjectZipFile(const string& zipFilename)
 {
-    fs::path zipFilePath(fromUTF8(zipFilename));
-
-    stdx::error_code ec;
-    if(fs::exists(zipFilePath)){
-        fs::remove(zipFilePath, ec);
-        if(ec){
-            mout->putErrorln(
-                format(_("The project pack file \"{0}\" already exists and cannot be removed: {1}."),
-                       zipFilename, toUTF8(ec.message())));
-            return false;
-        }
-    }
-        
-    int errorp;
-    zip_t* zip = zip_open(toUTF8(zipFilePath.make_preferred().string()).c_str(), ZIP_CREATE, &errorp);
-    if(!zip){
-        zip_error_t error;
-        zip_error_init_with_code(&error, errorp);
-        mout->putErrorln(
-            format(_("Failed to create the project pack file \"{0}\": {1}"),
-                   zipFilename, zip_error_strerror(&error)));
-        return false;
-    }
-
-    fs::path zipTopDirPath(zipFilePath.stem());
-    bool zipped = addDirectoryToZip(zip, packingDirPath, zipTopDirPath);
-    zip_close(zip);
-
-    if(!zipped){
-        if(fs::exists(zipFilePath)){
-            fs::remove(zipFilePath, ec);
-        }
+    // The files are compressed in parallel by ZipArchiver
+    ZipArchiver archiver;
+    if(!archiver.createZipFile(zipFilename, toUTF8(packingDirPath.string()))){
+        mout->putErrorln(archiver.errorMessage());
         mout->putErrorln(
             format(_("Failed to create the project pack file \"{0}\"."), zipFilename));
-    }
-
-    return zipped;
-}
-
-
-bool ProjectPacker::Impl::addDirectoryToZip(zip_t* zip, fs::path dirPath, const fs::path& zipTopDirPath)
-{
-    auto relDirPath = getRelativePath(dirPath, packingDirPath);
-    if(!relDirPath){
-        return false;
-    }
-    fs::path localDirPath = (zipTopDirPath / *relDirPath).lexically_normal();
-    string localDirStr = toUTF8(localDirPath.generic_string());
-    int index = zip_dir_add(zip, localDirStr.c_str(), ZIP_FL_ENC_UTF_8);
-    if(index < 0){
-        mout->putErrorln(
-            format(_("Failed to add directory \"{0}\" to the project pack: {1}"),
-                   localDirStr, zip_strerror(zip)));
         return false;
     }
-
-    for(const fs::directory_entry& entry : fs::directory_iterator(dirPath)){
-        auto entryPath = entry.path();
-        if(fs::is_directory(entryPath)){
-            if(!addDirectoryToZip(zip, entryPath, zipTopDirPath)){
-                return false;
-            }
-        } else {
-            auto localPath = zipTopDirPath / *getRelativePath(entryPath, packingDirPath);
-            auto localPathStr = toUTF8(localPath.generic_string());
-            auto sourcePath = toUTF8(entryPath.make_preferred().string());
-            zip_source_t* source = zip_source_file(zip, sourcePath.c_str(), 0, 0);
-            if(!source){
-                mout->putErrorln(
-                    format(_("Failed to add file \"{0}\" to the project pack: {1}"),
-                           localPathStr, zip_strerror(zip)));
-                return false;
-            }
-            int index = zip_file_add(zip, localPathStr.c_str(), source, ZIP_FL_ENC_UTF_8);
-            if(index < 0){
-                zip_source_free(source);
-                mout->putErrorln(
-                    format(_("Failed to add file \"{0}\" to the project pack: {1}"),
-                           localPathStr, zip_strerror(zip)));
-                return false;
-            }
-            // The deflate compression is applied by default. The following code is not necessary.
-            /*
-            if(zip_set_file_compression(zip, index, ZIP_CM_DEFLATE, 0) < 0){
-                zip_source_free(source);
-                mout->putErrorln(
-                    format(_("Failed to compress file \"{0}\" in the project pack: {1}"),
-                           localPathStr, zip_strerror(zip)));
-                return false;
-            }
-            */
-        }
-    }
-
     return true;
 }
 
@@ -703,8 +621,23 @@ bool ProjectPacker::Impl::extractFiles
 }
 
 
+void ProjectPacker::setOnDemandUnpackingEnabled(bool on)
+{
+    impl->isOnDemandUnpackingEnabled = on;
+}
+
+
+bool ProjectPacker::isOnDemandUnpackingEnabled() const
+{
+    return impl->isOnDemandUnpackingEnabled;
+}
+
+
 bool ProjectPacker::loadPackedProject(const std::string& projectPackFile)
 {
+    if(impl->isOnDemandUnpackingEnabled){
+        return impl->loadPackedProjectOnDemand(projectPackFile);
+    }
     if(impl->unpackProject(projectPackFile)){
         if(impl->unpackedProjectFile.empty()){
             mout_->putErrorln(
@@ -717,6 +650,58 @@ bool ProjectPacker::loadPackedProject(const std::string& projectPackFile)
 }
 
 
+/**
+   The project pack is mounted on the unpacking directory, and only the project file is extracted here.
+   The other files are extracted by ZipFileSystem when their paths are resolved in loading the items.
+*/
+bool ProjectPacker::Impl::loadPackedProjectOnDemand(const std::string& projectPackFile)
+{
+    string errorMessage;
+    auto archive = ZipFileSystem::open(projectPackFile, errorMessage);
+    if(!archive){
+        mout->putErrorln(errorMessage);
+        return false;
+    }
+
+    fs::path projectPackFilePath(fromUTF8(projectPackFile));
+    fs::path topDirPath;
+    if(!unpackingDir.empty()){
+        topDirPath = fromUTF8(unpackingDir);
+    } else {
+        topDirPath = projectPackFilePath.parent_path();
+    }
+    if(!archive->mount(toUTF8(topDirPath.string()), errorMessage)){
+        mout->putErrorln(errorMessage);
+        return false;
+    }
+
+    fs::path projectFile(projectPackFilePath.stem());
+    projectFile += ".cnoid";
+    unpackedProjectFile.clear();
+    const int numEntries = archive->numEntries();
+    for(int i=0; i < numEntries; ++i){
+        fs::path entryPath(fromUTF8(archive->entryName(i)));
+        if(entryPath.empty()){
+            continue;
+        }
+        if(*getRelativePath(entryPath, *entryPath.begin()) == projectFile){
+            unpackedProjectFile = archive->mountDirectory() + archive->entryName(i);
+            break;
+        }
+    }
+    if(unpackedProjectFile.empty()){
+        mout->putErrorln(
+            format(_("The project pack file \"{0}\" does not include a project file."), projectPackFile));
+        return false;
+    }
+    if(!ZipFileSystem::prepareFile(unpackedProjectFile, errorMessage)){
+        mout->putErrorln(errorMessage);
+        return false;
+    }
+    return loadUnpackedProject(unpackedProjectFile);
+}
+
+
 bool ProjectPacker::loadUnpackedProject(const std::string& projectFile)
 {
     return impl->loadUnpackedProject(projectFile);
@@ -24,6 +24,12 @@ public:
     bool packProjectToZipFile(const std::string& filename, const std::string& projectName);
     bool packProjectToDirectory(const std::string& packingDirectory);
     bool packProjectToDirectory(const std::string& packingDirectory, const std::string& projectName);
+    /**
+       When this mode is enabled, loadPackedProject does not extract all the files in the project pack
+       in advance, and each file is extracted when it is loaded by an item for the first time.
+    */
+    void setOnDemandUnpackingEnabled(bool on);
+    bool isOnDemandUnpackingEnabled() const;
     bool loadPackedProject(const std::string& projectPackFile);
     bool unpackProject(const std::string& projectPackFile);
     bool loadUnpackedProject(const std::string& projectFile);
@@ -0,0 +1,21 @@
+#ifndef CNOID_BENCHMARK_BENCHMARK_H
+#define CNOID_BENCHMARK_BENCHMARK_H
+
+#include <string>
+#include <functional>
+
+namespace cnoid {
+
+/**
+   The setup function of a benchmark prepares the data of the scenario and returns the operation
+   function, which is measured by calling it repeatedly. The setup is not included in the measurement.
+   \param unit The unit of an operation such as "op" or "step"
+*/
+void registerBenchmark(
+    const std::string& name, const std::string& unit, std::function<std::function<void()>()> setup);
+
+void registerCoreBenchmarks();
+
+}
+
+#endif
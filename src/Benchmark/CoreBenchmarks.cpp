@@ -0,0 +1,276 @@
+#include "Benchmark.h"
+#include <cnoid/BodyLoader>
+#include <cnoid/Body>
+#include <cnoid/DyBody>
+#include <cnoid/DyWorld>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/BodyCollisionDetector>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MaterialTable>
+#include <cnoid/LinkTraverse>
+#include <cnoid/JointPath>
+#include <cnoid/YAMLReader>
+#include <cnoid/STLSceneLoader>
+#include <cnoid/ExecutablePath>
+#include <cnoid/UTF8>
+#include <fmt/format.h>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+/*
+  All the scenarios use the models in the share directory and the fixed random seeds
+  so that the results of different builds can be compared.
+*/
+const unsigned int RandomSeed = 1;
+const double TimeStep = 0.001;
+
+string modelFile(const string& path)
+{
+    return toUTF8((shareDirPath() / "model" / fromUTF8(path)).string());
+}
+
+template<class BodyType>
+ref_ptr<BodyType> loadBody(const string& path)
+{
+    ref_ptr<BodyType> body = new BodyType;
+    BodyLoader loader;
+    if(!loader.load(body, modelFile(path))){
+        throw std::runtime_error(format("{} cannot be loaded.", path));
+    }
+    return body;
+}
+
+//! Random joint displacements within the joint ranges
+vector<vector<double>> generateJointDisplacements(Body* body, int numSamples, double ratio)
+{
+    std::mt19937 engine(RandomSeed);
+    std::uniform_real_distribution<> dist(-1.0, 1.0);
+    vector<vector<double>> samples(numSamples);
+    for(auto& q : samples){
+        for(auto& joint : body->joints()){
+            double qmin = std::max(joint->q_lower(), -M_PI);
+            double qmax = std::min(joint->q_upper(), M_PI);
+            double center = (qmin + qmax) / 2.0;
+            q.push_back(center + dist(engine) * ratio * (qmax - center));
+        }
+    }
+    return samples;
+}
+
+void setJointDisplacements(Body* body, const vector<double>& q)
+{
+    for(int i=0; i < body->numJoints(); ++i){
+        body->joint(i)->q() = q[i];
+    }
+}
+
+std::function<void()> setupForwardKinematics()
+{
+    auto body = loadBody<Body>("SR1/SR1.body");
+    auto samples = generateJointDisplacements(body, 100, 0.5);
+    auto traverse = make_shared<LinkTraverse>(body->rootLink());
+    int index = 0;
+    return [body, samples, traverse, index]() mutable {
+        setJointDisplacements(body, samples[index++ % samples.size()]);
+        traverse->calcForwardKinematics(true, true);
+    };
+}
+
+std::function<void()> setupInverseKinematics()
+{
+    auto body = loadBody<Body>("SR1/SR1.body");
+    auto path = JointPath::getCustomPath(body->link("WAIST"), body->link("RLEG_ANKLE_R"));
+    body->calcForwardKinematics();
+    const vector<double> q0(body->numJoints(), 0.0);
+
+    // The targets are the reachable poses of the ankle
+    vector<Isometry3> targets;
+    for(auto& q : generateJointDisplacements(body, 100, 0.3)){
+        setJointDisplacements(body, q);
+        body->calcForwardKinematics();
+        targets.push_back(path->endLink()->T());
+    }
+    int index = 0;
+    return [body, path, q0, targets, index]() mutable {
+        setJointDisplacements(body, q0);
+        path->calcForwardKinematics();
+        path->calcInverseKinematics(targets[index++ % targets.size()]);
+    };
+}
+
+class WorldScenario
+{
+public:
+    DyWorld<ConstraintForceSolver> world;
+
+    WorldScenario(){
+        world.setGravityAcceleration(Vector3(0.0, 0.0, -9.80665));
+        world.setTimeStep(TimeStep);
+        world.setCurrentTime(0.0);
+        world.enableSensors(true);
+        auto materialTable = new MaterialTable;
+        materialTable->load(toUTF8((shareDirPath() / "default" / "materials.yaml").string()));
+        world.constraintForceSolver.setMaterialTable(materialTable);
+        world.constraintForceSolver.setCollisionDetector(new AISTCollisionDetector);
+    }
+
+    DyBody* addBody(const string& path, const Vector3& p, bool isStatic = false){
+        auto body = loadBody<DyBody>(path);
+        body->rootLink()->p() = p;
+        if(isStatic){
+            body->rootLink()->setJointType(Link::FixedJoint);
+        }
+        body->calcForwardKinematics();
+        int index = world.addBody(body);
+        world.constraintForceSolver.setBodyCollisionDetectionMode(index, true, false);
+        return body;
+    }
+
+    void step(){
+        world.constraintForceSolver.clearExternalForces();
+        world.calcNextState();
+    }
+};
+
+std::function<void()> setupForwardDynamics()
+{
+    // The robot floats without any contact to measure the forward dynamics only
+    auto scenario = make_shared<WorldScenario>();
+    scenario->world.setGravityAcceleration(Vector3::Zero());
+    auto body = scenario->addBody("SR1/SR1.body", Vector3(0.0, 0.0, 1.0));
+    scenario->world.initialize();
+    std::mt19937 engine(RandomSeed);
+    std::uniform_real_distribution<> dist(-1.0, 1.0);
+    vector<double> torques;
+    for(int i=0; i < body->numJoints(); ++i){
+        torques.push_back(dist(engine));
+    }
+    int counter = 0;
+    return [scenario, body, torques, counter]() mutable {
+        // The direction of the torques is reversed periodically to keep the posture bounded
+        double sign = ((counter++ / 500) % 2 == 0) ? 1.0 : -1.0;
+        for(int i=0; i < body->numJoints(); ++i){
+            body->joint(i)->u() = sign * torques[i];
+        }
+        scenario->step();
+    };
+}
+
+std::function<void()> setupBoxesOnFloor()
+{
+    auto scenario = make_shared<WorldScenario>();
+    scenario->addBody("misc/floor.body", Vector3(0.0, 0.0, -0.1), true);
+    for(int i=0; i < 4; ++i){
+        for(int j=0; j < 4; ++j){
+            for(int k=0; k < 2; ++k){
+                scenario->addBody("misc/box1.body", Vector3(i * 0.5, j * 1.0, 0.1 + k * 0.21));
+            }
+        }
+    }
+    scenario->world.initialize();
+
+    // Settle the boxes so that the contact state does not change in the measurement
+    for(int i=0; i < 1000; ++i){
+        scenario->step();
+    }
+    return [scenario](){ scenario->step(); };
+}
+
+std::function<void()> setupCollisionDetection()
+{
+    struct Scenario {
+        vector<BodyPtr> bodies;
+        BodyCollisionDetector detector;
+        vector<vector<double>> samples;
+        int index = 0;
+        int numCollisions = 0;
+    };
+    auto scenario = make_shared<Scenario>();
+    scenario->detector.setCollisionDetector(new AISTCollisionDetector);
+    auto floor = loadBody<Body>("misc/floor.body");
+    floor->rootLink()->p() << 0.0, 0.0, -0.1;
+    floor->calcForwardKinematics();
+    scenario->detector.addBody(floor, false);
+
+    // Two robots are placed so close that their arms and legs interfere with each other
+    for(int i=0; i < 2; ++i){
+        auto body = loadBody<Body>("SR1/SR1.body");
+        body->rootLink()->p() << 0.0, i * 0.35, 0.7135;
+        scenario->bodies.push_back(body);
+        scenario->detector.addBody(body, true);
+    }
+    scenario->detector.makeReady();
+    scenario->samples = generateJointDisplacements(scenario->bodies[0], 100, 0.5);
+
+    return [scenario](){
+        auto& q = scenario->samples[scenario->index++ % scenario->samples.size()];
+        for(auto& body : scenario->bodies){
+            setJointDisplacements(body, q);
+            body->calcForwardKinematics();
+        }
+        scenario->detector.updatePositions();
+        scenario->detector.detectCollisions(
+            [scenario](const CollisionPair&){ ++scenario->numCollisions; });
+    };
+}
+
+std::function<void()> setupYAMLReader()
+{
+    const string filename = modelFile("SR1/SR1.body");
+    ifstream ifs(fromUTF8(filename));
+    if(!ifs){
+        throw std::runtime_error(format("{} cannot be opened.", filename));
+    }
+    stringstream ss;
+    ss << ifs.rdbuf();
+    auto text = make_shared<string>(ss.str());
+    auto reader = make_shared<YAMLReader>();
+    return [reader, text](){
+        reader->parse(*text);
+        reader->clearDocuments();
+    };
+}
+
+std::function<void()> setupBodyLoader()
+{
+    const string filename = modelFile("SR1/SR1.body");
+    auto loader = make_shared<BodyLoader>();
+    // Shared meshes would skip loading them from the second time
+    loader->setMeshSharingEnabled(false);
+    return [loader, filename](){
+        BodyPtr body = new Body;
+        loader->load(body, filename);
+    };
+}
+
+std::function<void()> setupSTLSceneLoader()
+{
+    const string filename = modelFile("JACO2/parts/SHOULDER.stl");
+    auto loader = make_shared<STLSceneLoader>();
+    return [loader, filename](){
+        SgNodePtr scene = loader->load(filename);
+    };
+}
+
+}
+
+
+void cnoid::registerCoreBenchmarks()
+{
+    registerBenchmark("LinkTraverse::calcForwardKinematics/SR1", "op", setupForwardKinematics);
+    registerBenchmark("JointPath::calcInverseKinematics/SR1-right-leg", "op", setupInverseKinematics);
+    registerBenchmark("ForwardDynamicsABM/SR1-floating", "step", setupForwardDynamics);
+    registerBenchmark("ConstraintForceSolver/32-boxes-on-floor", "step", setupBoxesOnFloor);
+    registerBenchmark("AISTCollisionDetector/2-SR1s-and-floor", "op", setupCollisionDetection);
+    registerBenchmark("YAMLReader/SR1.body", "op", setupYAMLReader);
+    registerBenchmark("StdBodyLoader/SR1.body", "op", setupBodyLoader);
+    registerBenchmark("STLSceneLoader/JACO2-SHOULDER.stl", "op", setupSTLSceneLoader);
+}
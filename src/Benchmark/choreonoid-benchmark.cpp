@@ -0,0 +1,247 @@
+/**
+   This command measures the performance of the core libraries with the scenarios
+   registered by registerBenchmark and outputs the results in JSON.
+   The results of two builds can be compared with misc/script/compare-benchmarks.py.
+*/
+
+#include "Benchmark.h"
+#include <cnoid/Config>
+#include <fmt/format.h>
+#include <vector>
+#include <string>
+#include <regex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+/*
+  The global allocation functions are replaced to count the number of the dynamic memory
+  allocations done in the measured operations including the ones in the shared libraries.
+*/
+static std::atomic<long long> numAllocations(0);
+
+static void* allocate(std::size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+namespace {
+
+struct Benchmark
+{
+    string name;
+    string unit;
+    std::function<std::function<void()>()> setup;
+};
+
+vector<Benchmark>& benchmarks()
+{
+    static vector<Benchmark> benchmarks_;
+    return benchmarks_;
+}
+
+struct Result
+{
+    string name;
+    string unit;
+    long long numIterations;
+    double nsPerOp;
+    double minNsPerOp;
+    double allocationsPerOp;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double measure(const std::function<void()>& op, long long numIterations, long long& out_numAllocations)
+{
+    const long long allocations0 = numAllocations.load();
+    auto time0 = Clock::now();
+    for(long long i=0; i < numIterations; ++i){
+        op();
+    }
+    auto time1 = Clock::now();
+    out_numAllocations = numAllocations.load() - allocations0;
+    return std::chrono::duration<double, std::nano>(time1 - time0).count();
+}
+
+Result run(Benchmark& benchmark, double minTime, int numRepetitions)
+{
+    auto op = benchmark.setup();
+
+    // Warm up the caches and find the number of iterations that takes the minimum time
+    long long numIterations = 1;
+    long long allocations;
+    while(true){
+        double time = measure(op, numIterations, allocations);
+        if(time >= minTime * 1.0e9 || numIterations >= (1LL << 40)){
+            break;
+        }
+        double scale = (time > 0.0) ? (minTime * 1.0e9 * 1.2 / time) : 10.0;
+        numIterations = std::max(numIterations + 1, (long long)(numIterations * std::min(scale, 10.0)));
+    }
+
+    vector<double> times;
+    long long totalAllocations = 0;
+    for(int i=0; i < numRepetitions; ++i){
+        times.push_back(measure(op, numIterations, allocations) / numIterations);
+        totalAllocations += allocations;
+    }
+    std::sort(times.begin(), times.end());
+
+    Result result;
+    result.name = benchmark.name;
+    result.unit = benchmark.unit;
+    result.numIterations = numIterations;
+    result.nsPerOp = times[times.size() / 2];
+    result.minNsPerOp = times.front();
+    result.allocationsPerOp = (double)totalAllocations / (numIterations * numRepetitions);
+    return result;
+}
+
+string escapeJsonString(const string& s)
+{
+    string escaped;
+    for(auto& c : s){
+        if(c == '"' || c == '\\'){
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void putResults(ostream& os, const vector<Result>& results)
+{
+    os << "{\n";
+    os << format("  \"version\": \"{}\",\n", CNOID_FULL_VERSION_STRING);
+    os << "  \"benchmarks\": [";
+    for(size_t i=0; i < results.size(); ++i){
+        auto& r = results[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << format("    {{ \"name\": \"{}\", \"unit\": \"{}\", \"iterations\": {}, "
+                     "\"ns_per_op\": {:.1f}, \"min_ns_per_op\": {:.1f}, "
+                     "\"ops_per_sec\": {:.1f}, \"allocations_per_op\": {:.2f} }}",
+                     escapeJsonString(r.name), r.unit, r.numIterations, r.nsPerOp, r.minNsPerOp,
+                     1.0e9 / r.nsPerOp, r.allocationsPerOp);
+    }
+    os << "\n  ]\n}\n";
+}
+
+void showUsage()
+{
+    cout <<
+        "Usage: choreonoid-benchmark [options]\n"
+        "  --list               List the benchmarks\n"
+        "  --filter <regex>     Run the benchmarks whose names match the regular expression\n"
+        "  --min-time <sec>     Minimum time of a measurement (default: 0.5)\n"
+        "  --repetitions <n>    Number of the measurements of each benchmark (default: 5)\n"
+        "  --output <file>      Output the results to the JSON file instead of the standard output\n";
+}
+
+}
+
+
+void cnoid::registerBenchmark
+(const std::string& name, const std::string& unit, std::function<std::function<void()>()> setup)
+{
+    benchmarks().push_back({ name, unit, setup });
+}
+
+
+int main(int argc, char* argv[])
+{
+    bool doList = false;
+    string filter;
+    double minTime = 0.5;
+    int numRepetitions = 5;
+    string outputFile;
+
+    for(int i=1; i < argc; ++i){
+        string arg(argv[i]);
+        bool hasValue = (i + 1 < argc);
+        if(arg == "--list"){
+            doList = true;
+        } else if(arg == "--filter" && hasValue){
+            filter = argv[++i];
+        } else if(arg == "--min-time" && hasValue){
+            minTime = std::atof(argv[++i]);
+        } else if(arg == "--repetitions" && hasValue){
+            numRepetitions = std::max(1, std::atoi(argv[++i]));
+        } else if(arg == "--output" && hasValue){
+            outputFile = argv[++i];
+        } else {
+            showUsage();
+            return (arg == "--help") ? 0 : 1;
+        }
+    }
+
+    registerCoreBenchmarks();
+
+    if(doList){
+        for(auto& benchmark : benchmarks()){
+            cout << benchmark.name << "\n";
+        }
+        return 0;
+    }
+
+    std::regex pattern(filter.empty() ? string(".*") : filter);
+    vector<Result> results;
+    for(auto& benchmark : benchmarks()){
+        if(!std::regex_search(benchmark.name, pattern)){
+            continue;
+        }
+        try {
+            auto result = run(benchmark, minTime, numRepetitions);
+            cerr << format("{:<56} {:>14.1f} ns/{:<4} {:>10.2f} allocs/{}",
+                           result.name, result.nsPerOp, result.unit, result.allocationsPerOp, result.unit)
+                 << endl;
+            results.push_back(result);
+        }
+        catch(const std::exception& ex){
+            cerr << format("{}: {}", benchmark.name, ex.what()) << endl;
+            return 1;
+        }
+    }
+
+    if(outputFile.empty()){
+        putResults(cout, results);
+    } else {
+        ofstream ofs(outputFile);
+        if(!ofs){
+            cerr << format("\"{}\" cannot be opened.", outputFile) << endl;
+            return 1;
+        }
+        putResults(ofs, results);
+    }
+
+    return 0;
+}
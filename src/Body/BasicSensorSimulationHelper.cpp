@@ -1,5 +1,6 @@
 #include "BasicSensorSimulationHelper.h"
 #include "Body.h"
+#include <cnoid/TraceProfiler>
 
 using namespace std;
 using namespace cnoid;
@@ -159,6 +160,8 @@ void BasicSensorSimulationHelper::Impl::initialize
 
 void BasicSensorSimulationHelper::updateGyroAndAccelerationSensors()
 {
+    CNOID_TRACE_ZONE("Sensor simulation");
+
     // update angular velocity
     for(size_t i=0; i < rateGyroSensors_.size(); ++i){
         RateGyroSensor* gyro = rateGyroSensors_[i];
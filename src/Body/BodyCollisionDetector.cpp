@@ -3,6 +3,7 @@
 #include "Body.h"
 #include "Link.h"
 #include <cnoid/SceneGraph>
+#include <cnoid/ValueTree>
 #include <cnoid/ConnectionSet>
 #include <unordered_map>
 #include <vector>
@@ -33,6 +34,7 @@ public:
     LinkAssociatedObjectFunc linkAssociatedObjectFunc;
     vector<GeometryHandle> linkIndexToGeometryHandleMap;
     BodyCollisionLinkFilter bodyCollisionLinkFilter;
+    CollisionProxyBuilder::Spec defaultCollisionProxySpec;
     bool needToMakeCollisionDetectorReady;
     bool hasCustomObjectsAssociatedWithLinks;
     bool isGeometryHandleMapEnabled;
@@ -43,6 +45,7 @@ public:
     bool addBody(Body* body, bool isSelfCollisionDetectionEnabled, int groupId, bool isMultiplexBody);
     bool addLinkRecursively(Link* link, bool isParentStatic, int groupId);
     stdx::optional<CollisionDetector::GeometryHandle> addLink(Link* link, bool isStatic, int groupId);
+    SgNode* getCollisionGeometry(Link* link, SgNodePtr& out_proxy);
     bool removeBody(Body* body, bool isMultiplexBody);
     void onMultiplexBodyAddedOrRemoved(Body* body, bool isAdded, bool isSelfCollisionDetectionEnabled, int groupId);
     double findClosestPoints(Link* link1, Link* link2, Vector3& out_point1, Vector3& out_point2);
@@ -147,6 +150,18 @@ void BodyCollisionDetector::setLinkAssociatedObjectFunction(LinkAssociatedObject
 }
 
 
+void BodyCollisionDetector::setDefaultCollisionProxy(const CollisionProxyBuilder::Spec& spec)
+{
+    impl->defaultCollisionProxySpec = spec;
+}
+
+
+const CollisionProxyBuilder::Spec& BodyCollisionDetector::defaultCollisionProxy() const
+{
+    return impl->defaultCollisionProxySpec;
+}
+
+
 bool BodyCollisionDetector::isMultiplexBodySupported() const
 {
     return impl->isGeometryRemovalSupported;
@@ -247,9 +262,8 @@ bool BodyCollisionDetector::Impl::addLinkRecursively(Link* link, bool isParentSt
 
 stdx::optional<CollisionDetector::GeometryHandle> BodyCollisionDetector::Impl::addLink(Link* link, bool isStatic, int groupId)
 {
-    bool added = false;
-
-    stdx::optional<GeometryHandle> handle = collisionDetector->addGeometry(link->collisionShape());
+    SgNodePtr proxy;
+    stdx::optional<GeometryHandle> handle = collisionDetector->addGeometry(getCollisionGeometry(link, proxy));
     
     if(handle){
         Referenced* object;
@@ -274,6 +288,29 @@ stdx::optional<CollisionDetector::GeometryHandle> BodyCollisionDetector::Impl::a
 }
 
 
+SgNode* BodyCollisionDetector::Impl::getCollisionGeometry(Link* link, SgNodePtr& out_proxy)
+{
+    SgNode* shape = link->collisionShape();
+    CollisionProxyBuilder::Spec spec = defaultCollisionProxySpec;
+    
+    if(!CollisionProxyBuilder::readSpec(link->info()->find("collision_proxy"), spec)){
+        // The body level specification is not applied to the dedicated collision shapes
+        if(link->hasDedicatedCollisionShape()){
+            spec.type = CollisionProxyBuilder::NoProxy;
+        } else if(auto body = link->body()){
+            CollisionProxyBuilder::readSpec(body->info()->find("collision_proxy"), spec);
+        }
+    }
+    if(spec.type != CollisionProxyBuilder::NoProxy){
+        out_proxy = CollisionProxyBuilder::getOrCreateProxy(shape, spec);
+        if(out_proxy){
+            return out_proxy;
+        }
+    }
+    return shape;
+}
+
+
 void BodyCollisionDetector::addLink(Link* link, int groupId)
 {
     impl->addLink(link, link->isStatic(), groupId);
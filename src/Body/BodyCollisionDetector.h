@@ -2,6 +2,7 @@
 #define CNOID_BODY_BODY_COLLISION_DETECTOR_H
 
 #include <cnoid/CollisionDetector>
+#include <cnoid/CollisionProxyBuilder>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -30,6 +31,14 @@ public:
     typedef std::function<Referenced*(Link* link, GeometryHandle geometry)> LinkAssociatedObjectFunc;
     void setLinkAssociatedObjectFunction(LinkAssociatedObjectFunc func);
 
+    /**
+       The collision proxy specified with the "collision_proxy" key of the link or body information
+       is used instead of the original collision shape. This function sets the proxy used for the links
+       that do not have the specification nor the dedicated collision shapes.
+    */
+    void setDefaultCollisionProxy(const CollisionProxyBuilder::Spec& spec);
+    const CollisionProxyBuilder::Spec& defaultCollisionProxy() const;
+
     bool isMultiplexBodySupported() const;
     bool isMultiplexBodySupportEnabled() const;
     void setMultiplexBodySupportEnabled(bool on);
@@ -3,6 +3,7 @@
 #include "VRMLBodyLoader.h"
 #include "Body.h"
 #include <cnoid/SceneLoader>
+#include <cnoid/GeometryRegistry>
 #include <cnoid/ValueTree>
 #include <cnoid/NullOut>
 #include <cnoid/UTF8>
@@ -153,6 +154,8 @@ public:
     shared_ptr<SceneLoaderAdapter> loaderAdapter;
     bool isVerbose;
     bool isShapeLoadingEnabled;
+    bool isMeshSharingEnabled;
+    CollisionProxyBuilder::Spec collisionProxySpec;
     int defaultDivisionNumber;
     double defaultCreaseAngle;
     BodyLoader::LengthUnit lengthUnitHint;
@@ -161,6 +164,7 @@ public:
     Impl();
     ~Impl();
     bool load(Body* body, const std::string& filename);
+    void shareMeshes(Body* body);
     void mergeExtraLinkInfos(Body* body, Mapping* info);
 };
 
@@ -178,6 +182,7 @@ BodyLoader::Impl::Impl()
     os = &nullout();
     isVerbose = false;
     isShapeLoadingEnabled = true;
+    isMeshSharingEnabled = false;
     defaultDivisionNumber = -1;
     defaultCreaseAngle = -1.0;
 }
@@ -232,6 +237,18 @@ void BodyLoader::setMeshImportHint(LengthUnit unit, UpperAxis upperAxis)
 }
 
 
+void BodyLoader::setMeshSharingEnabled(bool on)
+{
+    impl->isMeshSharingEnabled = on;
+}
+
+
+void BodyLoader::setCollisionProxy(const CollisionProxyBuilder::Spec& spec)
+{
+    impl->collisionProxySpec = spec;
+}
+
+
 bool BodyLoader::load(Body* body, const std::string& filename)
 {
     body->info()->clear();    
@@ -297,11 +314,33 @@ bool BodyLoader::Impl::load(Body* body, const std::string& filename)
         (*os) << ex.what();
     }
     os->flush();
+
+    if(result && isShapeLoadingEnabled && isMeshSharingEnabled){
+        shareMeshes(body);
+    }
+
+    if(result && collisionProxySpec.type != CollisionProxyBuilder::NoProxy){
+        auto info = body->info();
+        if(!info->find("collision_proxy")->isValid()){
+            info->insert("collision_proxy", CollisionProxyBuilder::writeSpec(collisionProxySpec));
+        }
+    }
     
     return result;
 }
 
 
+void BodyLoader::Impl::shareMeshes(Body* body)
+{
+    for(auto& link : body->links()){
+        GeometryRegistry::shareMeshes(link->visualShape());
+        if(link->collisionShape() != link->visualShape()){
+            GeometryRegistry::shareMeshes(link->collisionShape());
+        }
+    }
+}
+
+
 AbstractBodyLoaderPtr BodyLoader::lastActualBodyLoader() const
 {
     return impl->actualLoader;
@@ -7,6 +7,7 @@
 #define CNOID_BODY_BODY_LOADER_H
 
 #include "AbstractBodyLoader.h"
+#include <cnoid/CollisionProxyBuilder>
 #include <functional>
 #include <initializer_list>
 #include "exportdecl.h"
@@ -32,6 +33,23 @@ public:
     enum LengthUnit { Meter, Millimeter, Inch, NumLengthUnitIds };
     enum UpperAxis { Z, Y, NumUpperAxisIds };
     void setMeshImportHint(LengthUnit unit, UpperAxis axis);
+
+    /**
+       The meshes that have the same URI and contents as the meshes of the already loaded bodies
+       are shared with those bodies. This is disabled by default because a shared mesh must not
+       be modified by the body that has loaded it. The collision models built from the shared
+       meshes are also shared by AISTCollisionDetector. The body items loaded in the application
+       use this function when the "--share-body-meshes" option is given.
+    */
+    void setMeshSharingEnabled(bool on);
+
+    /**
+       The collision proxy is written to the "collision_proxy" key of the information of the loaded
+       bodies that do not specify it in their files, so that BodyCollisionDetector uses it for the
+       links without their own specifications nor dedicated collision shapes.
+       No proxy is given by default.
+    */
+    void setCollisionProxy(const CollisionProxyBuilder::Spec& spec);
     
     virtual bool load(Body* body, const std::string& filename);
     Body* load(const std::string& filename);
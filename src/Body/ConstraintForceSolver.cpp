@@ -13,6 +13,7 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/CloneMap>
 #include <cnoid/TimeMeasure>
+#include <cnoid/TraceProfiler>
 #include <cnoid/stdx/clamp>
 #include <fmt/format.h>
 #include <random>
@@ -363,6 +364,8 @@ public:
     }
 
     shared_ptr<CollisionLinkPairList> getCollisions();
+    void storeWarmStartData(vector<double>& out_data) const;
+    int restoreWarmStartData(const double* data, int size);
 };
 
 }
@@ -576,6 +579,7 @@ void ConstraintForceSolver::Impl::initialize(void)
 
     bodyCollisionDetector.makeReady();
 
+    globalNumContactNormalVectors = 0;
     prevGlobalNumConstraintVectors = 0;
     prevGlobalNumFrictionVectors = 0;
     numUnconverged = 0;
@@ -656,15 +660,17 @@ void ConstraintForceSolver::Impl::solve()
         }
     }
 
-    bodyCollisionDetector.updatePositions();
-
     globalNumConstraintVectors = 0;
     globalNumFrictionVectors = 0;
     areThereImpacts = false;
 
     constrainedLinkPairs.clear();
 
-    setConstraintPoints();
+    {
+        CNOID_TRACE_ZONE("Collision detection");
+        bodyCollisionDetector.updatePositions();
+        setConstraintPoints();
+    }
 
     if(CFS_PUT_NUM_CONTACT_POINTS){
         cout << globalNumContactNormalVectors;
@@ -672,6 +678,8 @@ void ConstraintForceSolver::Impl::solve()
 
     if(globalNumConstraintVectors > 0){
 
+        CNOID_TRACE_ZONE("Constraint solving");
+
         if(CFS_DEBUG){
             os << "Num Collisions: " << globalNumContactNormalVectors << std::endl;
         }
@@ -2376,3 +2384,63 @@ shared_ptr<CollisionLinkPairList> ConstraintForceSolver::Impl::getCollisions()
 
     return collisionPairs;
 }
+
+
+void ConstraintForceSolver::storeWarmStartData(std::vector<double>& out_data) const
+{
+    impl->storeWarmStartData(out_data);
+}
+
+
+void ConstraintForceSolver::Impl::storeWarmStartData(vector<double>& out_data) const
+{
+    out_data.push_back(prevGlobalNumConstraintVectors);
+    out_data.push_back(prevGlobalNumFrictionVectors);
+    out_data.push_back(globalNumContactNormalVectors);
+    out_data.push_back(solution.size());
+    out_data.insert(out_data.end(), solution.data(), solution.data() + solution.size());
+}
+
+
+int ConstraintForceSolver::restoreWarmStartData(const double* data, int size)
+{
+    return impl->restoreWarmStartData(data, size);
+}
+
+
+int ConstraintForceSolver::checkWarmStartData(const double* data, int size)
+{
+    if(size < 4 || data[0] < 0.0 || data[1] < 0.0 || data[2] < 0.0){
+        return 0;
+    }
+    const int solutionSize = data[3];
+    if(solutionSize < 0 || size < 4 + solutionSize){
+        return 0;
+    }
+    return 4 + solutionSize;
+}
+
+
+int ConstraintForceSolver::Impl::restoreWarmStartData(const double* data, int size)
+{
+    const int dataSize = checkWarmStartData(data, size);
+    if(dataSize == 0){
+        return 0;
+    }
+    const int solutionSize = data[3];
+
+    /*
+      The matrices are resized for the restored numbers of the constraints because they are
+      only resized when the numbers change from the previous step.
+    */
+    globalNumConstraintVectors = data[0];
+    globalNumFrictionVectors = data[1];
+    globalNumContactNormalVectors = data[2];
+    initMatrices();
+    prevGlobalNumConstraintVectors = globalNumConstraintVectors;
+    prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+
+    solution = Eigen::Map<const VectorX>(data + 4, solutionSize);
+
+    return dataSize;
+}
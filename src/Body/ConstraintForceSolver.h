@@ -2,6 +2,7 @@
 #define CNOID_BODY_CONSTRAINT_FORCE_SOLVER_H
 
 #include <cnoid/CollisionSeq>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -61,6 +62,16 @@ public:
 
     std::shared_ptr<CollisionLinkPairList> getCollisions();
 
+    /**
+       The solution of the previous step is used as the initial solution of the iterative solver.
+       These functions store and restore the data to resume a simulation from a snapshot.
+    */
+    void storeWarmStartData(std::vector<double>& out_data) const;
+    //! \return The number of the elements read from the data, or zero if the data is invalid
+    int restoreWarmStartData(const double* data, int size);
+    //! \return The number of the elements of the data to restore, or zero if the data is invalid
+    static int checkWarmStartData(const double* data, int size);
+
     // experimental functions
     typedef std::function<bool(Link* link1, Link* link2,
                                const std::vector<Collision>& collisions,
@@ -1,4 +1,5 @@
 #include "DyWorld.h"
+#include <cnoid/TraceProfiler>
 
 using namespace std;
 using namespace cnoid;
@@ -105,6 +106,7 @@ void DyWorldBase::setVirtualJointForces()
 
 void DyWorldBase::calcNextState()
 {
+    CNOID_TRACE_ZONE("Forward dynamics");
     for(auto& subBody : subBodies_){
         subBody->forwardDynamics()->calcNextState();
     }
@@ -357,6 +357,46 @@ void ForwardDynamicsCBM::preserveHighGainModeJointState()
 }
 
 
+void ForwardDynamicsCBM::storeHighGainModeJointState(std::vector<double>& out_data) const
+{
+    if(given_rootDof){
+        out_data.insert(out_data.end(), pGivenPrev.data(), pGivenPrev.data() + 3);
+        out_data.insert(out_data.end(), RGivenPrev.data(), RGivenPrev.data() + 9);
+        out_data.insert(out_data.end(), voGivenPrev.data(), voGivenPrev.data() + 3);
+        out_data.insert(out_data.end(), wGivenPrev.data(), wGivenPrev.data() + 3);
+    }
+    out_data.insert(out_data.end(), qGivenPrev.data(), qGivenPrev.data() + qGivenPrev.size());
+    out_data.insert(out_data.end(), dqGivenPrev.data(), dqGivenPrev.data() + dqGivenPrev.size());
+}
+
+
+int ForwardDynamicsCBM::highGainModeJointStateSize() const
+{
+    return (given_rootDof ? 18 : 0) + qGivenPrev.size() * 2;
+}
+
+
+int ForwardDynamicsCBM::restoreHighGainModeJointState(const double* data, int size)
+{
+    const int m = qGivenPrev.size();
+    const int requiredSize = highGainModeJointStateSize();
+    if(size < requiredSize){
+        return 0;
+    }
+    const double* p = data;
+    if(given_rootDof){
+        pGivenPrev = Eigen::Map<const Vector3>(p);
+        RGivenPrev = Eigen::Map<const Matrix3>(p + 3);
+        voGivenPrev = Eigen::Map<const Vector3>(p + 12);
+        wGivenPrev = Eigen::Map<const Vector3>(p + 15);
+        p += 18;
+    }
+    qGivenPrev = Eigen::Map<const VectorXd>(p, m);
+    dqGivenPrev = Eigen::Map<const VectorXd>(p + m, m);
+    return requiredSize;
+}
+
+
 void ForwardDynamicsCBM::calcPositionAndVelocityFK()
 {
     auto root = subBody->rootLink();
@@ -2,6 +2,7 @@
 #define CNOID_BODY_FORWARD_DYNAMICS_CBM_H
 
 #include "ForwardDynamics.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -30,6 +31,15 @@ public:
 
     void complementHighGainModeCommandValues();
 
+    /**
+       The joint states of the previous step, which are used to complement the command values
+       of the high-gain mode joints, are stored and restored to resume a simulation from a snapshot.
+       \return The restore function returns the number of the read elements or zero if the data is invalid.
+    */
+    void storeHighGainModeJointState(std::vector<double>& out_data) const;
+    int restoreHighGainModeJointState(const double* data, int size);
+    int highGainModeJointStateSize() const;
+
     void initializeAccelSolver();
     void sumExternalForces();
     void solveUnknownAccels();
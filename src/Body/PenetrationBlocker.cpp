@@ -61,6 +61,8 @@ PenetrationBlockerImpl::PenetrationBlockerImpl(CollisionDetectorPtr& collisionDe
       targetLink(targetLink)
 {
     collisionDetector->clearGeometries();
+    // Only the pairs of the target link are detected again when the target link is moved
+    collisionDetector->setIncrementalDetectionEnabled(true);
     targetLinkGeometry = collisionDetector->addGeometry(targetLink->collisionShape());
     isCollisionDetectorReady = false;
     pPrevGiven = targetLink->p();
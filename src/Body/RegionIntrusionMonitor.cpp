@@ -0,0 +1,405 @@
+#include "RegionIntrusionMonitor.h"
+#include "Body.h"
+#include "Link.h"
+#include "DigitalIoDevice.h"
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneDrawables>
+#include <cnoid/DynamicAABBTree>
+#include <vector>
+#include <limits>
+#include <mutex>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct Region
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Isometry3 position;
+    Vector3 halfSize;
+    int proxyId;
+    bool isIntruding;
+    bool isSignalOn;
+    DigitalIoDevicePtr device;
+    int signalNumber;
+};
+
+struct LinkMesh
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    LinkPtr link;
+    // The link position copied by updatePositions
+    Isometry3 position;
+    Vector3 localCenter;
+    Vector3 localExtents;
+    vector<Vector3> vertices;
+    vector<int> triangles;
+};
+
+/**
+   The separating axis test of a triangle and an axis-aligned box centered at the origin.
+*/
+bool checkTriangleBoxOverlap(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector3& h)
+{
+    if((v0.cwiseMin(v1).cwiseMin(v2).array() > h.array()).any() ||
+       (v0.cwiseMax(v1).cwiseMax(v2).array() < -h.array()).any()){
+        return false;
+    }
+
+    const Vector3 edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+
+    const Vector3 n = edges[0].cross(edges[1]);
+    if(std::abs(n.dot(v0)) > h.dot(n.cwiseAbs())){
+        return false;
+    }
+
+    for(auto& edge : edges){
+        for(int i=0; i < 3; ++i){
+            const Vector3 axis = Vector3::Unit(i).cross(edge);
+            const double p0 = axis.dot(v0);
+            const double p1 = axis.dot(v1);
+            const double p2 = axis.dot(v2);
+            const double r = h.dot(axis.cwiseAbs());
+            if(std::min({ p0, p1, p2 }) > r || std::max({ p0, p1, p2 }) < -r){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+   The intersection test of a triangle and the ray from the origin in the x-axis direction.
+*/
+bool checkRayTriangleIntersection(const Vector3& v0, const Vector3& v1, const Vector3& v2)
+{
+    const Vector3 e1 = v1 - v0;
+    const Vector3 e2 = v2 - v0;
+    const Vector3 p = Vector3::UnitX().cross(e2);
+    const double det = e1.dot(p);
+    if(std::abs(det) < 1.0e-12){
+        return false;
+    }
+    const Vector3 s = -v0;
+    const double u = s.dot(p) / det;
+    if(u < 0.0 || u > 1.0){
+        return false;
+    }
+    const Vector3 q = s.cross(e1);
+    const double v = Vector3::UnitX().dot(q) / det;
+    if(v < 0.0 || u + v > 1.0){
+        return false;
+    }
+    return e2.dot(q) / det > 0.0;
+}
+
+}
+
+namespace cnoid {
+
+class RegionIntrusionMonitor::Impl
+{
+public:
+    vector<BodyPtr> bodies;
+    vector<LinkMesh, Eigen::aligned_allocator<LinkMesh>> linkMeshes;
+    vector<Region, Eigen::aligned_allocator<Region>> regions;
+    int numRegions;
+    DynamicAABBTree regionTree;
+    double lastDetectionTime;
+    double lastPositionUpdateTime;
+    vector<Vector3> regionVertices;
+    std::mutex mutex;
+
+    Impl();
+    void addBody(Body* body);
+    void updateRegionProxy(int regionId);
+    void updatePositions();
+    void detectIntrusions();
+    bool checkIntrusion(const LinkMesh& linkMesh, const Region& region);
+};
+
+}
+
+
+RegionIntrusionMonitor::RegionIntrusionMonitor()
+{
+    impl = new Impl;
+}
+
+
+RegionIntrusionMonitor::Impl::Impl()
+{
+    numRegions = 0;
+    lastDetectionTime = std::numeric_limits<double>::quiet_NaN();
+    lastPositionUpdateTime = std::numeric_limits<double>::quiet_NaN();
+
+    // The regions are static in most cases
+    regionTree.setMargin(0.0);
+}
+
+
+RegionIntrusionMonitor::~RegionIntrusionMonitor()
+{
+    delete impl;
+}
+
+
+void RegionIntrusionMonitor::clearBodies()
+{
+    impl->bodies.clear();
+    impl->linkMeshes.clear();
+    impl->lastDetectionTime = std::numeric_limits<double>::quiet_NaN();
+    impl->lastPositionUpdateTime = std::numeric_limits<double>::quiet_NaN();
+}
+
+
+void RegionIntrusionMonitor::addBody(Body* body)
+{
+    impl->addBody(body);
+}
+
+
+void RegionIntrusionMonitor::Impl::addBody(Body* body)
+{
+    bodies.push_back(body);
+    lastDetectionTime = std::numeric_limits<double>::quiet_NaN();
+    lastPositionUpdateTime = std::numeric_limits<double>::quiet_NaN();
+
+    MeshExtractor meshExtractor;
+    for(auto& link : body->links()){
+        LinkMesh linkMesh;
+        meshExtractor.extract(
+            link->collisionShape(),
+            [&](SgMesh* mesh){
+                const int vertexIndexTop = linkMesh.vertices.size();
+                const Affine3& T = meshExtractor.currentTransform();
+                for(auto& v : *mesh->vertices()){
+                    linkMesh.vertices.push_back(T * v.cast<double>());
+                }
+                const int numTriangles = mesh->numTriangles();
+                for(int i=0; i < numTriangles; ++i){
+                    auto triangle = mesh->triangle(i);
+                    for(int j=0; j < 3; ++j){
+                        linkMesh.triangles.push_back(vertexIndexTop + triangle[j]);
+                    }
+                }
+            });
+        if(linkMesh.triangles.empty()){
+            continue;
+        }
+        BoundingBox bbox;
+        for(auto& v : linkMesh.vertices){
+            bbox.expandBy(v);
+        }
+        linkMesh.link = link;
+        linkMesh.position = link->T();
+        linkMesh.localCenter = bbox.center();
+        linkMesh.localExtents = bbox.size() / 2.0;
+        linkMeshes.push_back(std::move(linkMesh));
+    }
+}
+
+
+void RegionIntrusionMonitor::clearRegions()
+{
+    impl->regions.clear();
+    impl->numRegions = 0;
+    impl->regionTree.clear();
+}
+
+
+int RegionIntrusionMonitor::addBoxRegion(const Vector3& size, const Isometry3& position)
+{
+    int regionId = impl->regions.size();
+    impl->regions.emplace_back();
+    auto& region = impl->regions.back();
+    region.position = position;
+    region.halfSize = size / 2.0;
+    region.proxyId = -1;
+    region.isIntruding = false;
+    region.isSignalOn = false;
+    region.signalNumber = 0;
+    impl->updateRegionProxy(regionId);
+    ++impl->numRegions;
+    return regionId;
+}
+
+
+void RegionIntrusionMonitor::setBoxRegion(int regionId, const Vector3& size, const Isometry3& position)
+{
+    auto& region = impl->regions[regionId];
+    if(region.proxyId >= 0){
+        region.position = position;
+        region.halfSize = size / 2.0;
+        impl->updateRegionProxy(regionId);
+    }
+}
+
+
+void RegionIntrusionMonitor::Impl::updateRegionProxy(int regionId)
+{
+    auto& region = regions[regionId];
+    const Vector3 center = region.position.translation();
+    const Vector3 extents = region.position.linear().cwiseAbs() * region.halfSize;
+    BoundingBox bbox(center - extents, center + extents);
+    if(region.proxyId < 0){
+        region.proxyId = regionTree.insert(bbox, regionId);
+    } else {
+        regionTree.update(region.proxyId, bbox);
+    }
+}
+
+
+void RegionIntrusionMonitor::removeRegion(int regionId)
+{
+    auto& region = impl->regions[regionId];
+    if(region.proxyId >= 0){
+        impl->regionTree.remove(region.proxyId);
+        region.proxyId = -1;
+        region.isIntruding = false;
+        region.device.reset();
+        --impl->numRegions;
+    }
+}
+
+
+int RegionIntrusionMonitor::numRegions() const
+{
+    return impl->numRegions;
+}
+
+
+void RegionIntrusionMonitor::setRegionSignal(int regionId, DigitalIoDevice* device, int signalNumber)
+{
+    auto& region = impl->regions[regionId];
+    region.device = device;
+    region.signalNumber = signalNumber;
+    region.isSignalOn = false;
+}
+
+
+void RegionIntrusionMonitor::updatePositions()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->updatePositions();
+}
+
+
+void RegionIntrusionMonitor::updatePositions(double time)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    if(time != impl->lastPositionUpdateTime){
+        impl->updatePositions();
+        impl->lastPositionUpdateTime = time;
+    }
+}
+
+
+void RegionIntrusionMonitor::Impl::updatePositions()
+{
+    for(auto& linkMesh : linkMeshes){
+        linkMesh.position = linkMesh.link->T();
+    }
+}
+
+
+void RegionIntrusionMonitor::detectIntrusions()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->detectIntrusions();
+}
+
+
+void RegionIntrusionMonitor::detectIntrusions(double time)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    if(time != impl->lastDetectionTime){
+        impl->detectIntrusions();
+        impl->lastDetectionTime = time;
+    }
+}
+
+
+void RegionIntrusionMonitor::Impl::detectIntrusions()
+{
+    for(auto& region : regions){
+        region.isIntruding = false;
+    }
+    if(numRegions == 0){
+        return;
+    }
+
+    for(auto& linkMesh : linkMeshes){
+        const Isometry3& T = linkMesh.position;
+        const Vector3 center = T * linkMesh.localCenter;
+        const Vector3 extents = T.linear().cwiseAbs() * linkMesh.localExtents;
+        regionTree.query(
+            BoundingBox(center - extents, center + extents),
+            [&](int proxyId){
+                auto& region = regions[regionTree.userId(proxyId)];
+                if(!region.isIntruding){
+                    region.isIntruding = checkIntrusion(linkMesh, region);
+                }
+                return true;
+            });
+    }
+}
+
+
+bool RegionIntrusionMonitor::Impl::checkIntrusion(const LinkMesh& linkMesh, const Region& region)
+{
+    // The vertices are transformed into the box frame of the region
+    const Isometry3 T = region.position.inverse(Eigen::Isometry) * linkMesh.position;
+    const Vector3& h = region.halfSize;
+    const int numVertices = linkMesh.vertices.size();
+    regionVertices.resize(numVertices);
+    for(int i=0; i < numVertices; ++i){
+        const Vector3 v = T * linkMesh.vertices[i];
+        if((v.cwiseAbs().array() <= h.array()).all()){
+            return true;
+        }
+        regionVertices[i] = v;
+    }
+    const int n = linkMesh.triangles.size();
+    for(int i=0; i < n; i += 3){
+        if(checkTriangleBoxOverlap(
+               regionVertices[linkMesh.triangles[i]],
+               regionVertices[linkMesh.triangles[i + 1]],
+               regionVertices[linkMesh.triangles[i + 2]], h)){
+            return true;
+        }
+    }
+
+    // The region may be enclosed by the mesh without intersecting the triangles
+    int numCrossings = 0;
+    for(int i=0; i < n; i += 3){
+        if(checkRayTriangleIntersection(
+               regionVertices[linkMesh.triangles[i]],
+               regionVertices[linkMesh.triangles[i + 1]],
+               regionVertices[linkMesh.triangles[i + 2]])){
+            ++numCrossings;
+        }
+    }
+    return (numCrossings % 2) == 1;
+}
+
+
+bool RegionIntrusionMonitor::isIntruding(int regionId) const
+{
+    return impl->regions[regionId].isIntruding;
+}
+
+
+void RegionIntrusionMonitor::outputSignals()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    for(auto& region : impl->regions){
+        if(region.device && region.isIntruding != region.isSignalOn){
+            region.device->setOut(region.signalNumber, region.isIntruding, true);
+            region.isSignalOn = region.isIntruding;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef CNOID_BODY_REGION_INTRUSION_MONITOR_H
+#define CNOID_BODY_REGION_INTRUSION_MONITOR_H
+
+#include <cnoid/Referenced>
+#include <cnoid/EigenTypes>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class DigitalIoDevice;
+
+/**
+   This class detects the intrusions of the links of bodies into box regions. The regions are
+   indexed by a bounding box tree, and only the regions overlapping the bounding boxes of the
+   links are tested with the link meshes. The monitor can be shared by the controllers that
+   monitor the regions for the same bodies so that the detection is done once in a step.
+*/
+class CNOID_EXPORT RegionIntrusionMonitor : public Referenced
+{
+public:
+    RegionIntrusionMonitor();
+    ~RegionIntrusionMonitor();
+
+    void clearBodies();
+    void addBody(Body* body);
+
+    void clearRegions();
+
+    /**
+       \param position The position of the center of the box
+       \return The id of the region
+    */
+    int addBoxRegion(const Vector3& size, const Isometry3& position);
+    void setBoxRegion(int regionId, const Vector3& size, const Isometry3& position);
+    void removeRegion(int regionId);
+    int numRegions() const;
+
+    //! The signal of the device is turned on while the region is intruded.
+    void setRegionSignal(int regionId, DigitalIoDevice* device, int signalNumber);
+
+    /**
+       The link positions of the bodies are copied to be used in the detection. In a simulation,
+       this must be called while the positions are not updated by the simulator, such as in the
+       input function of a controller.
+    */
+    void updatePositions();
+
+    //! The update is skipped when it has already been done at the same time.
+    void updatePositions(double time);
+
+    //! The link positions copied by updatePositions are used in the detection.
+    void detectIntrusions();
+
+    /**
+       The detection is skipped when it has already been done at the same time so that the
+       monitor can be shared by the controllers running in the same simulation step.
+    */
+    void detectIntrusions(double time);
+
+    bool isIntruding(int regionId) const;
+
+    //! The signals of the regions whose intrusion states differ from the signal states are updated.
+    void outputSignals();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<RegionIntrusionMonitor> RegionIntrusionMonitorPtr;
+
+}
+
+#endif
@@ -77,11 +77,12 @@ public:
     SgGroupPtr multiplexSceneBodyGroup;
     std::vector<SceneBodyPtr> multiplexSceneBodies;
     std::list<SceneBodyPtr> multiplexSceneBodyCache;
+    SgUpdateTransaction updateTransaction;
     ScopedConnection existenceConnection;
 
     Impl(SceneBody* self);
     void setBody(Body* body);
-    void updateLinkPositions(Body* body, vector<SceneLinkPtr>& sceneLinks, SgUpdateRef& update);
+    void updateLinkPositions(Body* body, vector<SceneLinkPtr>& sceneLinks);
     void updateMultiplexBodyPositions(SgUpdateRef& update);
     SceneBody* addMultiplexSceneBody(Body* multiplexBody, SgUpdateRef& update);
     void removeSubsequentMultiplexSceneBodies(int index, SgUpdateRef& update, bool doCache);
@@ -451,7 +452,7 @@ void SceneBody::updateSceneModel()
         impl->lastEffectGroup->addChild(sLink);
         sceneLinks_.push_back(sLink);
     }
-    impl->updateLinkPositions(body_, sceneLinks_, noUpdate);
+    impl->updateLinkPositions(body_, sceneLinks_);
 
     updateSceneDeviceModels(false);
     
@@ -486,23 +487,31 @@ void SceneBody::cloneShapes(CloneMap& cloneMap)
 
 void SceneBody::updateLinkPositions(SgUpdateRef update)
 {
+    /*
+      The updates of the links are notified in a transaction so that the upper nodes
+      are notified only once instead of the number of the links.
+    */
+    if(update){
+        impl->updateTransaction.begin(*update);
+    }
+    
     // Main body
-    impl->updateLinkPositions(body_, sceneLinks_, update);
+    impl->updateLinkPositions(body_, sceneLinks_);
 
     impl->updateMultiplexBodyPositions(update);
+
+    impl->updateTransaction.commit();
 }
 
 
-void SceneBody::Impl::updateLinkPositions(Body* body, vector<SceneLinkPtr>& sceneLinks, SgUpdateRef& update)
+void SceneBody::Impl::updateLinkPositions(Body* body, vector<SceneLinkPtr>& sceneLinks)
 {
     int n = std::min(body->numLinks(), static_cast<int>(sceneLinks.size()));
     for(int i=0; i < n; ++i){
         SceneLink* sceneLink = sceneLinks[i];
         Link* link = body->link(i);
         sceneLink->setPosition(link->position());
-        if(update){
-            sceneLink->notifyUpdate(*update);
-        }
+        updateTransaction.addUpdatedObject(sceneLink);
     }
 }
 
@@ -520,7 +529,7 @@ void SceneBody::Impl::updateMultiplexBodyPositions(SgUpdateRef& update)
             sceneBody = addMultiplexSceneBody(multiplexBody, update);
         }
         auto& sceneLinks = sceneBody->sceneLinks_;
-        updateLinkPositions(multiplexBody, sceneLinks, update);
+        updateLinkPositions(multiplexBody, sceneLinks);
         multiplexBody = multiplexBody->nextMultiplexBody();
         ++multiplexBodyIndex;
     }
@@ -0,0 +1,321 @@
+#include "SimulationSnapshot.h"
+#include "Body.h"
+#include "Link.h"
+#include "Device.h"
+#include <cnoid/UTF8>
+#include <fmt/format.h>
+#include <fstream>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const char* const FileSignature = "CNOIDSNAPSHOT";
+const int FileFormatVersion = 1;
+
+/*
+  The state of a link consists of the position (3), the attitude (9), the linear and angular
+  velocities and accelerations (12), the joint displacement, velocity, acceleration, effort,
+  target displacement and target velocity (6) and the external wrench (6).
+*/
+const int LinkStateSize = 36;
+
+class WriteBuf
+{
+public:
+    ofstream& ofs;
+    WriteBuf(ofstream& ofs) : ofs(ofs) { }
+    void writeInt(int value){
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void writeDouble(double value){
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void writeString(const string& str){
+        writeInt(str.size());
+        ofs.write(str.data(), str.size());
+    }
+    void writeDoubles(const vector<double>& values){
+        writeInt(values.size());
+        ofs.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+    }
+};
+
+class ReadBuf
+{
+public:
+    ifstream& ifs;
+    std::streamoff fileSize;
+    ReadBuf(ifstream& ifs) : ifs(ifs) {
+        ifs.seekg(0, ios::end);
+        fileSize = ifs.tellg();
+        ifs.seekg(0, ios::beg);
+    }
+    int readInt(){
+        int value = 0;
+        ifs.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+    double readDouble(){
+        double value = 0.0;
+        ifs.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+    //! The size is checked with the remaining bytes to avoid the allocation for broken data
+    int readSize(int minElementSize = 1){
+        int size = readInt();
+        if(!ifs || size < 0 ||
+           static_cast<std::streamoff>(size) * minElementSize > fileSize - ifs.tellg()){
+            ifs.setstate(ios::failbit);
+            return 0;
+        }
+        return size;
+    }
+    void readString(string& out_str){
+        out_str.resize(readSize());
+        ifs.read(&out_str[0], out_str.size());
+    }
+    void readDoubles(vector<double>& out_values){
+        out_values.resize(readSize(sizeof(double)));
+        ifs.read(reinterpret_cast<char*>(out_values.data()), out_values.size() * sizeof(double));
+    }
+};
+
+}
+
+
+SimulationSnapshot::SimulationSnapshot()
+{
+    frame_ = 0;
+    time_ = 0.0;
+}
+
+
+SimulationSnapshot::SimulationSnapshot(const SimulationSnapshot& org)
+    : bodyStates(org.bodyStates),
+      frame_(org.frame_),
+      time_(org.time_),
+      engineType_(org.engineType_),
+      engineData_(org.engineData_)
+{
+
+}
+
+
+void SimulationSnapshot::clearBodyStates()
+{
+    bodyStates.clear();
+}
+
+
+void SimulationSnapshot::addBodyState(const Body* body)
+{
+    bodyStates.emplace_back();
+    auto& state = bodyStates.back();
+    state.name = body->name();
+
+    const int numLinks = body->numLinks();
+    state.numLinks = numLinks;
+    state.linkStates.resize(numLinks * LinkStateSize);
+    double* p = state.linkStates.data();
+    for(int i=0; i < numLinks; ++i){
+        auto link = body->link(i);
+        auto& T = link->T();
+        Vector3::Map(p) = T.translation();
+        Matrix3::Map(p + 3) = T.linear();
+        Vector3::Map(p + 12) = link->v();
+        Vector3::Map(p + 15) = link->w();
+        Vector3::Map(p + 18) = link->dv();
+        Vector3::Map(p + 21) = link->dw();
+        p[24] = link->q();
+        p[25] = link->dq();
+        p[26] = link->ddq();
+        p[27] = link->u();
+        p[28] = link->q_target();
+        p[29] = link->dq_target();
+        Vector6::Map(p + 30) = link->F_ext();
+        p += LinkStateSize;
+    }
+
+    const auto& devices = body->devices();
+    int totalSize = 0;
+    state.deviceInfos.resize(devices.size());
+    for(size_t i=0; i < devices.size(); ++i){
+        auto& info = state.deviceInfos[i];
+        info.typeName = devices[i]->typeName();
+        info.size = devices[i]->stateSize();
+        totalSize += info.size;
+    }
+    state.deviceStates.resize(totalSize);
+    p = state.deviceStates.data();
+    for(auto& device : devices){
+        p = device->writeState(p);
+    }
+}
+
+
+int SimulationSnapshot::findBodyState(const std::string& name) const
+{
+    for(size_t i=0; i < bodyStates.size(); ++i){
+        if(bodyStates[i].name == name){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+bool SimulationSnapshot::checkBodyState(int index, const Body* body) const
+{
+    auto& state = bodyStates[index];
+    if(body->numLinks() != state.numLinks){
+        return false;
+    }
+    const auto& devices = body->devices();
+    if(devices.size() != state.deviceInfos.size()){
+        return false;
+    }
+    for(size_t i=0; i < devices.size(); ++i){
+        auto& info = state.deviceInfos[i];
+        if(devices[i]->stateSize() != info.size || info.typeName != devices[i]->typeName()){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void SimulationSnapshot::restoreBodyState(int index, Body* body) const
+{
+    auto& state = bodyStates[index];
+
+    const double* p = state.linkStates.data();
+    for(int i=0; i < state.numLinks; ++i){
+        auto link = body->link(i);
+        auto& T = link->T();
+        T.translation() = Eigen::Map<const Vector3>(p);
+        T.linear() = Eigen::Map<const Matrix3>(p + 3);
+        link->v() = Eigen::Map<const Vector3>(p + 12);
+        link->w() = Eigen::Map<const Vector3>(p + 15);
+        link->dv() = Eigen::Map<const Vector3>(p + 18);
+        link->dw() = Eigen::Map<const Vector3>(p + 21);
+        link->q() = p[24];
+        link->dq() = p[25];
+        link->ddq() = p[26];
+        link->u() = p[27];
+        link->q_target() = p[28];
+        link->dq_target() = p[29];
+        link->F_ext() = Eigen::Map<const Vector6>(p + 30);
+        p += LinkStateSize;
+    }
+
+    p = state.deviceStates.data();
+    for(auto& device : body->devices()){
+        p = device->readState(p);
+        device->notifyStateChange();
+    }
+}
+
+
+bool SimulationSnapshot::save(const std::string& filename, std::ostream& os) const
+{
+    ofstream ofs(fromUTF8(filename).c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs){
+        os << format(_("Simulation snapshot file \"{0}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+    WriteBuf buf(ofs);
+    buf.writeString(FileSignature);
+    buf.writeInt(FileFormatVersion);
+    buf.writeInt(frame_);
+    buf.writeDouble(time_);
+    buf.writeInt(bodyStates.size());
+    for(auto& state : bodyStates){
+        buf.writeString(state.name);
+        buf.writeInt(state.numLinks);
+        buf.writeDoubles(state.linkStates);
+        buf.writeInt(state.deviceInfos.size());
+        for(auto& info : state.deviceInfos){
+            buf.writeString(info.typeName);
+            buf.writeInt(info.size);
+        }
+        buf.writeDoubles(state.deviceStates);
+    }
+    buf.writeString(engineType_);
+    buf.writeDoubles(engineData_);
+
+    if(!ofs){
+        os << format(_("Simulation snapshot file \"{0}\" cannot be written."), filename) << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool SimulationSnapshot::load(const std::string& filename, std::ostream& os)
+{
+    ifstream ifs(fromUTF8(filename).c_str(), ios::in | ios::binary);
+    if(!ifs){
+        os << format(_("Simulation snapshot file \"{0}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+    ReadBuf buf(ifs);
+    string signature(FileSignature);
+    if(buf.readInt() == static_cast<int>(signature.size())){
+        ifs.read(&signature[0], signature.size());
+    } else {
+        ifs.setstate(ios::failbit);
+    }
+    if(!ifs || signature != FileSignature){
+        os << format(_("\"{0}\" is not a simulation snapshot file."), filename) << endl;
+        return false;
+    }
+    int version = buf.readInt();
+    if(version != FileFormatVersion){
+        os << format(_("The version {0} of simulation snapshot file \"{1}\" is not supported."),
+                     version, filename) << endl;
+        return false;
+    }
+
+    SimulationSnapshot snapshot;
+    snapshot.frame_ = buf.readInt();
+    snapshot.time_ = buf.readDouble();
+    // A body state consists of at least five size values
+    int numBodies = buf.readSize(sizeof(int) * 5);
+    for(int i=0; ifs && i < numBodies; ++i){
+        snapshot.bodyStates.emplace_back();
+        auto& state = snapshot.bodyStates.back();
+        buf.readString(state.name);
+        state.numLinks = buf.readSize(LinkStateSize * sizeof(double));
+        buf.readDoubles(state.linkStates);
+        state.deviceInfos.resize(buf.readSize(sizeof(int) * 2));
+        int64_t totalDeviceStateSize = 0;
+        for(auto& info : state.deviceInfos){
+            buf.readString(info.typeName);
+            info.size = buf.readSize(sizeof(double));
+            totalDeviceStateSize += info.size;
+        }
+        buf.readDoubles(state.deviceStates);
+        if(state.linkStates.size() != static_cast<size_t>(state.numLinks * LinkStateSize) ||
+           state.deviceStates.size() != static_cast<size_t>(totalDeviceStateSize)){
+            ifs.setstate(ios::failbit);
+        }
+    }
+    buf.readString(snapshot.engineType_);
+    buf.readDoubles(snapshot.engineData_);
+
+    if(!ifs){
+        os << format(_("Simulation snapshot file \"{0}\" is broken."), filename) << endl;
+        return false;
+    }
+
+    bodyStates.swap(snapshot.bodyStates);
+    frame_ = snapshot.frame_;
+    time_ = snapshot.time_;
+    engineType_.swap(snapshot.engineType_);
+    engineData_.swap(snapshot.engineData_);
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef CNOID_BODY_SIMULATION_SNAPSHOT_H
+#define CNOID_BODY_SIMULATION_SNAPSHOT_H
+
+#include <cnoid/Referenced>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class stores the state of a simulation at the beginning of a simulation step so that
+   the simulation can be resumed from the step. The link states and the device states of the
+   bodies are stored in flat arrays, and the internal state of the physics engine such as the
+   warm-start data of the constraint solver is stored as a sequence of values given by the simulator.
+*/
+class CNOID_EXPORT SimulationSnapshot : public Referenced
+{
+public:
+    SimulationSnapshot();
+    SimulationSnapshot(const SimulationSnapshot& org);
+
+    void setFrame(int frame, double time){
+        frame_ = frame;
+        time_ = time;
+    }
+    int frame() const { return frame_; }
+    double time() const { return time_; }
+
+    void clearBodyStates();
+    void addBodyState(const Body* body);
+    int numBodyStates() const { return static_cast<int>(bodyStates.size()); }
+    const std::string& bodyName(int index) const { return bodyStates[index].name; }
+    int findBodyState(const std::string& name) const;
+
+    //! \return false if the body does not have the same links and devices as the stored body
+    bool checkBodyState(int index, const Body* body) const;
+
+    //! \note The links and devices of the body must be checked by checkBodyState in advance.
+    void restoreBodyState(int index, Body* body) const;
+
+    /**
+       The identifier of the simulator that stores the engine data. SimulatorItem uses the module
+       and class names registered in ItemManager such as "Body::AISTSimulatorItem".
+    */
+    const std::string& engineType() const { return engineType_; }
+    void setEngineType(const std::string& type) { engineType_ = type; }
+    std::vector<double>& engineData() { return engineData_; }
+    const std::vector<double>& engineData() const { return engineData_; }
+
+    /**
+       The snapshot is saved in a binary format with the native byte order, which is intended
+       to be loaded in the same environment.
+    */
+    bool save(const std::string& filename, std::ostream& os) const;
+    bool load(const std::string& filename, std::ostream& os);
+
+private:
+    struct DeviceStateInfo
+    {
+        std::string typeName;
+        int size;
+    };
+    struct BodyState
+    {
+        std::string name;
+        int numLinks;
+        std::vector<double> linkStates;
+        std::vector<DeviceStateInfo> deviceInfos;
+        std::vector<double> deviceStates;
+    };
+    std::vector<BodyState> bodyStates;
+    int frame_;
+    double time_;
+    std::string engineType_;
+    std::vector<double> engineData_;
+};
+
+typedef ref_ptr<SimulationSnapshot> SimulationSnapshotPtr;
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <cnoid/YAMLReader>
 #include <cnoid/NullOut>
 #include <cnoid/UTF8>
+#include <cnoid/ZipFileSystem>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <unordered_map>
@@ -719,6 +720,7 @@ bool StdBodyLoader::Impl::loadAnotherFormatBodyFile(Mapping* topNode)
     if(!path.has_root_path()){
         path = mainFilePath.parent_path() / path;
     }
+    ZipFileSystem::prepareFile(toUTF8(path.string()));
     if(!bodyLoader){
         bodyLoader.reset(new BodyLoader);
     }
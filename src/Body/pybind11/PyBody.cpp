@@ -5,6 +5,7 @@
 #include <cnoid/CloneMap>
 #include <cnoid/PyUtil>
 #include <pybind11/operators.h>
+#include <pybind11/numpy.h>
 
 using namespace std;
 using namespace cnoid;
@@ -25,6 +26,77 @@ py::object Body_getInfo(Body& self, const std::string& key, py::object defaultVa
     return py::cast(self.info(key, v));
 }
 
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+
+/*
+  The joint states and the link positions are stored in the link objects, so they are
+  packed into a new array by a single call instead of accessing the links one by one.
+*/
+template<class Accessor>
+py::array_t<double> getJointStates(Body& body, Accessor accessor)
+{
+    const int n = body.numJoints();
+    py::array_t<double> states(n);
+    auto r = states.mutable_unchecked<1>();
+    for(int i=0; i < n; ++i){
+        r(i) = accessor(body.joint(i));
+    }
+    return states;
+}
+
+template<class Accessor>
+void setJointStates(Body& body, DoubleArray states, Accessor accessor)
+{
+    const int n = body.numJoints();
+    if(states.ndim() != 1 || states.shape(0) != n){
+        throw py::value_error("The size of the array must be the number of joints");
+    }
+    auto r = states.unchecked<1>();
+    for(int i=0; i < n; ++i){
+        accessor(body.joint(i)) = r(i);
+    }
+}
+
+template<class Accessor>
+void defJointStateProperty(py::class_<Body, BodyPtr, Referenced>& body, const char* name, Accessor accessor)
+{
+    body.def_property(
+        name,
+        [accessor](Body& self){ return getJointStates(self, accessor); },
+        [accessor](Body& self, DoubleArray states){ setJointStates(self, states, accessor); });
+}
+
+//! The positions are returned as an array of the shape (numLinks, 4, 4)
+py::array_t<double> getLinkPositions(Body& body)
+{
+    const int n = body.numLinks();
+    py::array_t<double> positions({ n, 4, 4 });
+    auto r = positions.mutable_unchecked<3>();
+    for(int i=0; i < n; ++i){
+        auto& T = body.link(i)->T();
+        for(int j=0; j < 4; ++j){
+            for(int k=0; k < 4; ++k){
+                r(i, j, k) = T(j, k);
+            }
+        }
+    }
+    return positions;
+}
+
+void setLinkPositions(Body& body, DoubleArray positions)
+{
+    const int n = body.numLinks();
+    if(positions.ndim() != 3 || positions.shape(0) != n || positions.shape(1) != 4 || positions.shape(2) != 4){
+        throw py::value_error("The shape of the array must be (numLinks, 4, 4)");
+    }
+    const double* data = positions.data();
+    for(int i=0; i < n; ++i){
+        Isometry3 T;
+        T.matrix() = Eigen::Map<const Matrix4RM>(data + i * 16);
+        body.link(i)->setPosition(T);
+    }
+}
+
 }
 
 namespace cnoid {
@@ -105,6 +177,7 @@ void exportPyBody(py::module& m)
         .def("resetLinkName", &Body::resetLinkName)
         .def("resetJointSpecificName", (void(Body::*)(Link *)) &Body::resetLinkName)
         .def("resetJointSpecificName", (void(Body::*)(Link *, const std::string &name)) &Body::resetLinkName)
+        .def_property("linkPositions", getLinkPositions, setLinkPositions)
 
         // deprecated
         .def("getName", &Body::name)
@@ -125,6 +198,12 @@ void exportPyBody(py::module& m)
         .def("getNumExtraJoints", &Body::numExtraJoints)
         ;
 
+    defJointStateProperty(body, "jointDisplacements", [](Link* joint) -> double& { return joint->q(); });
+    defJointStateProperty(body, "jointVelocities", [](Link* joint) -> double& { return joint->dq(); });
+    defJointStateProperty(body, "jointEfforts", [](Link* joint) -> double& { return joint->u(); });
+    defJointStateProperty(body, "targetJointDisplacements", [](Link* joint) -> double& { return joint->q_target(); });
+    defJointStateProperty(body, "targetJointVelocities", [](Link* joint) -> double& { return joint->dq_target(); });
+
     py::class_<ExtraJoint, ExtraJointPtr, Referenced> extraJoint(m, "ExtraJoint");
     extraJoint
         .def(py::init<>())
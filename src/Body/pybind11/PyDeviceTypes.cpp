@@ -6,7 +6,11 @@
 #include "../Device.h"
 #include "../Link.h"
 #include "../ForceSensor.h"
+#include "../Camera.h"
+#include "../RangeCamera.h"
+#include "../RangeSensor.h"
 #include <cnoid/PyUtil>
+#include <pybind11/numpy.h>
 
 using namespace std;
 using namespace cnoid;
@@ -16,6 +20,46 @@ namespace {
 
 using Matrix4RM = Eigen::Matrix<double, 4, 4, Eigen::RowMajor>;
 
+/**
+   The returned array is a read-only view of the data without copying it. The array keeps the
+   shared pointer of the data so that the data is valid even if the device replaces it with new one.
+*/
+template<class Scalar, class DataPtr>
+py::array getConstArrayView(DataPtr data, const Scalar* elements, std::vector<py::ssize_t> shape)
+{
+    if(!elements){
+        return py::array_t<Scalar>(shape);
+    }
+    py::capsule holder(new DataPtr(data), [](void* p){ delete reinterpret_cast<DataPtr*>(p); });
+    py::array_t<Scalar> array(shape, elements, holder);
+    py::detail::array_proxy(array.ptr())->flags &= ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    return array;
+}
+
+py::array getCameraImageView(Camera& self)
+{
+    auto image = self.sharedImage();
+    return getConstArrayView<unsigned char>(
+        image, image->empty() ? nullptr : image->pixels(),
+        { image->height(), image->width(), image->numComponents() });
+}
+
+py::array getRangeCameraPointsView(RangeCamera& self)
+{
+    auto points = self.sharedPoints();
+    return getConstArrayView<float>(
+        points, points->empty() ? nullptr : points->front().data(),
+        { static_cast<py::ssize_t>(points->size()), 3 });
+}
+
+py::array getRangeDataView(RangeSensor& self)
+{
+    auto rangeData = self.sharedRangeData();
+    return getConstArrayView<double>(
+        rangeData, rangeData->empty() ? nullptr : rangeData->data(),
+        { static_cast<py::ssize_t>(rangeData->size()) });
+}
+
 }
 
 namespace cnoid {
@@ -49,6 +93,26 @@ void exportPyDeviceTypes(py::module& m)
         .def("getLink", (Link*(Device::*)())&Device::link)
         ;
 
+    py::class_<VisionSensor, VisionSensorPtr, Device>(m, "VisionSensor")
+        .def_property("frameRate", &VisionSensor::frameRate, &VisionSensor::setFrameRate)
+        .def_property("delay", &VisionSensor::delay, &VisionSensor::setDelay)
+        ;
+
+    py::class_<Camera, CameraPtr, VisionSensor>(m, "Camera")
+        .def_property_readonly("resolutionX", &Camera::resolutionX)
+        .def_property_readonly("resolutionY", &Camera::resolutionY)
+        .def_property_readonly("image", getCameraImageView)
+        ;
+
+    py::class_<RangeCamera, RangeCameraPtr, Camera>(m, "RangeCamera")
+        .def_property_readonly("numPoints", &RangeCamera::numPoints)
+        .def_property_readonly("points", getRangeCameraPointsView)
+        ;
+
+    py::class_<RangeSensor, RangeSensorPtr, VisionSensor>(m, "RangeSensor")
+        .def_property_readonly("rangeData", getRangeDataView)
+        ;
+
     PyDeviceList<Device>(m, "DeviceList");
     PyDeviceList<ForceSensor>(m, "ForceSensorList");
 }
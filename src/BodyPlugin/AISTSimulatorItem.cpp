@@ -36,6 +36,21 @@ const bool TRACE_FUNCTIONS = false;
 const bool ENABLE_DEBUG_OUTPUT = false;
 const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
 
+/*
+  The body name is stored in the engine state as the two 32-bit halves of its hash value
+  so that the values are exactly represented by double.
+*/
+void putBodyNameHash(const string& name, vector<double>& out_data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(auto c : name){
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    out_data.push_back(static_cast<double>(hash >> 32));
+    out_data.push_back(static_cast<double>(hash & 0xffffffffULL));
+}
+
 class AISTSimBody : public SimulationBody
 {
 public:
@@ -107,6 +122,18 @@ public:
     void addBody(AISTSimBody* simBody);
     void clearExternalForces();
     void stepKinematicsSimulation(const std::vector<SimulationBody*>& activeSimBodies);
+    void storeEngineState(vector<double>& out_data);
+
+    struct EngineState
+    {
+        double time;
+        vector<pair<DyBody*, const double*>> bodyStates;
+        const double* warmStartData;
+        int warmStartDataSize;
+        bool isSameOrder;
+    };
+    bool readEngineState(const vector<double>& data, EngineState& out_state);
+    bool restoreEngineState(const vector<double>& data);
     void setForcedPosition(BodyItem* bodyItem, const Isometry3& T);
     void doSetForcedPosition();
     void doPutProperties(PutPropertyFunction& putProperty);
@@ -626,6 +653,160 @@ std::shared_ptr<CollisionLinkPairList> AISTSimulatorItem::getCollisions()
 }
 
 
+bool AISTSimulatorItem::storeEngineState(std::vector<double>& out_data)
+{
+    impl->storeEngineState(out_data);
+    return true;
+}
+
+
+/*
+  The engine state consists of the current time, the states of the bodies and the warm-start
+  data of the constraint force solver. The state of a body is stored with its name hash and
+  size, and consists of the spatial velocities and accelerations of the links and the previous
+  states of the high-gain mode joints.
+*/
+void AISTSimulatorItem::Impl::storeEngineState(vector<double>& out_data)
+{
+    out_data.push_back(world.currentTime());
+    out_data.push_back(world.bodies().size());
+    for(auto& body : world.bodies()){
+        putBodyNameHash(body->name(), out_data);
+        const size_t sizeIndex = out_data.size();
+        out_data.push_back(0.0);
+        for(auto& link : body->links()){
+            out_data.insert(out_data.end(), link->vo().data(), link->vo().data() + 3);
+            out_data.insert(out_data.end(), link->dvo().data(), link->dvo().data() + 3);
+        }
+        for(auto& subBody : body->subBodies()){
+            if(auto cbm = subBody->forwardDynamicsCBM()){
+                cbm->storeHighGainModeJointState(out_data);
+            }
+        }
+        out_data[sizeIndex] = out_data.size() - sizeIndex - 1;
+    }
+    world.constraintForceSolver.storeWarmStartData(out_data);
+}
+
+
+bool AISTSimulatorItem::checkEngineState(const std::vector<double>& data)
+{
+    Impl::EngineState state;
+    return impl->readEngineState(data, state);
+}
+
+
+bool AISTSimulatorItem::restoreEngineState(const std::vector<double>& data)
+{
+    return impl->restoreEngineState(data);
+}
+
+
+/*
+  The body states are matched with the bodies by their names because the bodies of the
+  simulator restoring the snapshot may be in a different order. The bodies with the same
+  name are matched in order. The whole data is validated here so that nothing is modified
+  when the data cannot be restored.
+*/
+bool AISTSimulatorItem::Impl::readEngineState(const vector<double>& data, EngineState& out_state)
+{
+    const double* p = data.data();
+    const double* end = p + data.size();
+    auto& bodies = world.bodies();
+    if(end - p < 2 || p[1] != bodies.size()){
+        return false;
+    }
+    out_state.time = p[0];
+    p += 2;
+
+    vector<double> nameHashes;
+    for(auto& body : bodies){
+        putBodyNameHash(body->name(), nameHashes);
+    }
+    vector<bool> isMatched(bodies.size(), false);
+    out_state.bodyStates.clear();
+    out_state.isSameOrder = true;
+    for(size_t i=0; i < bodies.size(); ++i){
+        if(end - p < 3){
+            return false;
+        }
+        const int size = p[2];
+        if(size < 0 || end - p - 3 < size){
+            return false;
+        }
+        DyBody* body = nullptr;
+        for(size_t j=0; j < bodies.size(); ++j){
+            if(!isMatched[j] && nameHashes[j * 2] == p[0] && nameHashes[j * 2 + 1] == p[1]){
+                body = bodies[j];
+                isMatched[j] = true;
+                if(j != i){
+                    out_state.isSameOrder = false;
+                }
+                break;
+            }
+        }
+        if(!body){
+            return false;
+        }
+        int requiredSize = body->numLinks() * 6;
+        for(auto& subBody : body->subBodies()){
+            if(auto cbm = subBody->forwardDynamicsCBM()){
+                requiredSize += cbm->highGainModeJointStateSize();
+            }
+        }
+        if(size != requiredSize){
+            return false;
+        }
+        out_state.bodyStates.emplace_back(body, p + 3);
+        p += 3 + size;
+    }
+
+    out_state.warmStartData = p;
+    out_state.warmStartDataSize = end - p;
+    // The warm-start solution depends on the order of the bodies
+    if(out_state.isSameOrder &&
+       ConstraintForceSolver::checkWarmStartData(p, end - p) == 0){
+        return false;
+    }
+    return true;
+}
+
+
+bool AISTSimulatorItem::Impl::restoreEngineState(const vector<double>& data)
+{
+    EngineState state;
+    if(!readEngineState(data, state)){
+        return false;
+    }
+
+    for(auto& bodyState : state.bodyStates){
+        auto body = bodyState.first;
+        const double* q = bodyState.second;
+        const double* bodyStateEnd = q + static_cast<int>(q[-1]);
+        for(auto& link : body->links()){
+            link->vo() = Eigen::Map<const Vector3>(q);
+            link->dvo() = Eigen::Map<const Vector3>(q + 3);
+            q += 6;
+        }
+        for(auto& subBody : body->subBodies()){
+            if(auto cbm = subBody->forwardDynamicsCBM()){
+                q += cbm->restoreHighGainModeJointState(q, bodyStateEnd - q);
+            }
+        }
+    }
+    world.setCurrentTime(state.time);
+
+    if(state.isSameOrder){
+        world.constraintForceSolver.restoreWarmStartData(state.warmStartData, state.warmStartDataSize);
+    }
+
+    if(dynamicsMode.is(ForwardDynamicsMode)){
+        world.refreshState();
+    }
+    return true;
+}
+
+
 Vector3 AISTSimulatorItem::getGravity() const
 {
     return impl->gravity;
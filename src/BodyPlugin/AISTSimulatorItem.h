@@ -79,6 +79,9 @@ protected:
     virtual bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies) override;
     virtual void finalizeSimulation() override;
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions() override;
+    virtual bool storeEngineState(std::vector<double>& out_data) override;
+    virtual bool checkEngineState(const std::vector<double>& data) override;
+    virtual bool restoreEngineState(const std::vector<double>& data) override;
         
     virtual Item* doCloneItem(CloneMap* cloneMap) const override;
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
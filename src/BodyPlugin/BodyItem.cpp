@@ -4,6 +4,7 @@
 #include "BodyItemKinematicsKitManager.h"
 #include "BodyItemKinematicsKit.h"
 #include "KinematicsBar.h"
+#include "BodyItemFileIO.h"
 #include <cnoid/Archive>
 #include <cnoid/RootItem>
 #include <cnoid/ConnectionSet>
@@ -242,6 +243,23 @@ void BodyItem::initializeClass(ExtensionManager* ext)
 
     auto om = OptionManager::instance();
     om->add_option("--body", bodyFilesToLoad, "load a body file");
+    om->add_flag_callback(
+        "--share-body-meshes", [](){ BodyItem::bodyFileIO()->setMeshSharingEnabled(true); },
+        "share the identical meshes and collision models of the loaded bodies");
+    om->add_option_function<string>(
+        "--body-collision-proxy",
+        [](const string& type){
+            CollisionProxyBuilder::Spec spec;
+            ScalarNodePtr node = new ScalarNode(type);
+            if(CollisionProxyBuilder::readSpec(node, spec)){
+                BodyItem::bodyFileIO()->setCollisionProxy(spec);
+            } else {
+                MessageView::instance()->putln(
+                    format(_("\"{0}\" is not a valid collision proxy type."), type), MessageView::Warning);
+            }
+        },
+        "use the collision proxy (simplified, convex_hull or box) for the loaded bodies "
+        "that do not specify it");
     om->sigOptionsParsed(1).connect(onSigOptionsParsed);
 }
 
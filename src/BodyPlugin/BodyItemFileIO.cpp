@@ -168,6 +168,7 @@ BodyItemBodyFileIO::BodyItemBodyFileIO()
 
     bodyLoader_ = nullptr;
     bodyWriter_ = nullptr;
+    isMeshSharingEnabled_ = false;
 }
 
 
@@ -195,7 +196,10 @@ BodyLoader* BodyItemBodyFileIO::ensureBodyLoader()
 bool BodyItemBodyFileIO::load(BodyItem* item, const std::string& filename)
 {
     BodyPtr newBody = new Body;
-    if(!ensureBodyLoader()->load(newBody, filename)){
+    auto loader = ensureBodyLoader();
+    loader->setMeshSharingEnabled(isMeshSharingEnabled_);
+    loader->setCollisionProxy(collisionProxySpec_);
+    if(!loader->load(newBody, filename)){
         return false;
     }
     item->setBody(newBody);
@@ -3,6 +3,7 @@
 
 #include "BodyItem.h"
 #include <cnoid/ItemFileIO>
+#include <cnoid/CollisionProxyBuilder>
 #include <QBoxLayout>
 #include <QComboBox>
 #include <QCheckBox>
@@ -40,6 +41,14 @@ public:
 
     StdBodyWriter* bodyWriter(){ return ensureBodyWriter(); }
 
+    //! \see BodyLoader::setMeshSharingEnabled
+    void setMeshSharingEnabled(bool on) { isMeshSharingEnabled_ = on; }
+    bool isMeshSharingEnabled() const { return isMeshSharingEnabled_; }
+
+    //! \see BodyLoader::setCollisionProxy
+    void setCollisionProxy(const CollisionProxyBuilder::Spec& spec) { collisionProxySpec_ = spec; }
+    const CollisionProxyBuilder::Spec& collisionProxy() const { return collisionProxySpec_; }
+
 protected:
     BodyLoader* ensureBodyLoader();
     StdBodyWriter* ensureBodyWriter();
@@ -52,6 +61,8 @@ protected:
 private:
     BodyLoader* bodyLoader_;
     StdBodyWriter* bodyWriter_;
+    bool isMeshSharingEnabled_;
+    CollisionProxyBuilder::Spec collisionProxySpec_;
 };
 
 }
@@ -4,13 +4,171 @@
 #include <cnoid/CollisionSeqItem>
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/UTF8>
+#include <fmt/format.h>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
+
 static const string mdskey("CollisionPairLsit");
+
+const char* const BinaryFileSignature = "CNOIDCOLLISIONSEQ";
+const int BinaryFileFormatVersion = 1;
+
+/*
+  The packed data of a link pair consists of the link pair index, the number of collisions,
+  the base point, the point scale and the depth scale, which are followed by the quantized
+  point (3), normal (2) and depth (1) of each collision.
+*/
+const int PackedLinkPairHeaderSize = sizeof(int32_t) * 2 + sizeof(float) * 5;
+const int PackedCollisionSize = sizeof(int16_t) * 6;
+const double QuantizationMax = 32767.0;
+
+const PackedCollisionFramePtr emptyFrame = std::make_shared<PackedCollisionFrame>();
+
+template<class T> void putValue(vector<unsigned char>& data, T value)
+{
+    size_t pos = data.size();
+    data.resize(pos + sizeof(T));
+    std::memcpy(&data[pos], &value, sizeof(T));
+}
+
+template<class T> T getValue(const unsigned char*& p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+int16_t quantize(double value, double scale)
+{
+    double q = std::round(value / scale);
+    if(q > QuantizationMax){
+        q = QuantizationMax;
+    } else if(q < -QuantizationMax){
+        q = -QuantizationMax;
+    }
+    return static_cast<int16_t>(q);
+}
+
+//! The normal is encoded by the octahedral mapping
+void putNormal(vector<unsigned char>& data, const Vector3& n)
+{
+    double x = 0.0;
+    double y = 0.0;
+    const double l1 = std::abs(n.x()) + std::abs(n.y()) + std::abs(n.z());
+    if(l1 > 0.0){
+        x = n.x() / l1;
+        y = n.y() / l1;
+        if(n.z() < 0.0){
+            const double fx = (1.0 - std::abs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+            const double fy = (1.0 - std::abs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+            x = fx;
+            y = fy;
+        }
+    }
+    putValue(data, quantize(x, 1.0 / QuantizationMax));
+    putValue(data, quantize(y, 1.0 / QuantizationMax));
+}
+
+Vector3 getNormal(const unsigned char*& p)
+{
+    double x = getValue<int16_t>(p) / QuantizationMax;
+    double y = getValue<int16_t>(p) / QuantizationMax;
+    const double z = 1.0 - std::abs(x) - std::abs(y);
+    if(z < 0.0){
+        const double fx = (1.0 - std::abs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+        const double fy = (1.0 - std::abs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+        x = fx;
+        y = fy;
+    }
+    return Vector3(x, y, z).normalized();
+}
+
+//! \return false if the data is broken
+bool checkPackedData(const PackedCollisionFrame& frame, int numLinkPairsInTable)
+{
+    const auto& data = frame.data();
+    const unsigned char* p = data.data();
+    const unsigned char* end = p + data.size();
+    for(int i=0; i < frame.numLinkPairs(); ++i){
+        if(end - p < PackedLinkPairHeaderSize){
+            return false;
+        }
+        const int index = getValue<int32_t>(p);
+        const int numCollisions = getValue<int32_t>(p);
+        p += sizeof(float) * 5;
+        if(index < 0 || index >= numLinkPairsInTable || numCollisions < 0 ||
+           (end - p) / PackedCollisionSize < numCollisions){
+            return false;
+        }
+        p += numCollisions * PackedCollisionSize;
+    }
+    return p == end;
+}
+
+class WriteBuf
+{
+public:
+    ofstream& ofs;
+    WriteBuf(ofstream& ofs) : ofs(ofs) { }
+    void writeInt(int value){
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void writeDouble(double value){
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void writeString(const string& str){
+        writeInt(str.size());
+        ofs.write(str.data(), str.size());
+    }
+};
+
+class ReadBuf
+{
+public:
+    ifstream& ifs;
+    std::streamoff fileSize;
+    ReadBuf(ifstream& ifs) : ifs(ifs) {
+        ifs.seekg(0, ios::end);
+        fileSize = ifs.tellg();
+        ifs.seekg(0, ios::beg);
+    }
+    int readInt(){
+        int value = 0;
+        ifs.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+    double readDouble(){
+        double value = 0.0;
+        ifs.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+    //! The size is checked with the remaining bytes to avoid the allocation for broken data
+    int readSize(int minElementSize = 1){
+        int size = readInt();
+        if(!ifs || size < 0 ||
+           static_cast<std::streamoff>(size) * minElementSize > fileSize - ifs.tellg()){
+            ifs.setstate(ios::failbit);
+            return 0;
+        }
+        return size;
+    }
+    void readString(string& out_str){
+        out_str.resize(readSize());
+        ifs.read(&out_str[0], out_str.size());
+    }
+};
+
 }
 
 CollisionSeq::CollisionSeq(CollisionSeqItem* collisionSeqItem)
@@ -18,6 +176,155 @@ CollisionSeq::CollisionSeq(CollisionSeqItem* collisionSeqItem)
 {
     collisionSeqItem_ = collisionSeqItem;
     setSeqContentName(mdskey);
+    hasUnresolvedLinks = false;
+}
+
+
+void CollisionSeq::clearLinkPairTable()
+{
+    linkPairTable.clear();
+    linkPairIndexMap.clear();
+    hasUnresolvedLinks = false;
+}
+
+
+int CollisionSeq::getLinkPairIndex(Link* link0, Link* link1)
+{
+    auto inserted = linkPairIndexMap.emplace(std::make_pair(link0, link1), linkPairTable.size());
+    if(inserted.second){
+        linkPairTable.emplace_back();
+        auto& info = linkPairTable.back();
+        info.links[0] = link0;
+        info.links[1] = link1;
+        for(int i=0; i < 2; ++i){
+            info.bodyNames[i] = info.links[i]->body()->name();
+            info.linkNames[i] = info.links[i]->name();
+        }
+    }
+    return inserted.first->second;
+}
+
+
+void CollisionSeq::resolveLinks()
+{
+    auto worldItem = collisionSeqItem_ ? collisionSeqItem_->findOwnerItem<WorldItem>() : nullptr;
+    if(!worldItem){
+        return;
+    }
+    for(size_t i=0; i < linkPairTable.size(); ++i){
+        auto& info = linkPairTable[i];
+        for(int j=0; j < 2; ++j){
+            if(!info.links[j]){
+                if(auto bodyItem = worldItem->findChildItem<BodyItem>(info.bodyNames[j])){
+                    info.links[j] = bodyItem->body()->link(info.linkNames[j]);
+                }
+            }
+        }
+        if(info.links[0] && info.links[1]){
+            linkPairIndexMap.emplace(std::make_pair(info.links[0].get(), info.links[1].get()), i);
+        }
+    }
+    hasUnresolvedLinks = false;
+}
+
+
+PackedCollisionFramePtr CollisionSeq::packCollisions
+(const CollisionLinkPairList& collisionPairs, PackedCollisionFramePtr prevFrame)
+{
+    auto frame = std::make_shared<PackedCollisionFrame>();
+    auto& data = frame->data_;
+
+    for(auto& linkPair : collisionPairs){
+        auto& collisions = linkPair->collisions();
+        if(collisions.empty() || !linkPair->link(0) || !linkPair->link(1)){
+            continue;
+        }
+        Vector3 min = collisions.front().point;
+        Vector3 max = min;
+        double maxDepth = 0.0;
+        for(auto& collision : collisions){
+            min = min.cwiseMin(collision.point);
+            max = max.cwiseMax(collision.point);
+            maxDepth = std::max(maxDepth, std::abs(collision.depth));
+        }
+        // The values stored in single precision are used in the quantization
+        const Vector3f base = ((min + max) / 2.0).cast<float>();
+        const Vector3 base_d = base.cast<double>();
+        const double maxOffset = std::max((max - base_d).cwiseAbs().maxCoeff(), (min - base_d).cwiseAbs().maxCoeff());
+        float pointScale = maxOffset / QuantizationMax;
+        if(!(pointScale > 0.0f)){
+            pointScale = 1.0f;
+        }
+        float depthScale = maxDepth / QuantizationMax;
+        if(!(depthScale > 0.0f)){
+            depthScale = 1.0f;
+        }
+
+        putValue<int32_t>(data, getLinkPairIndex(linkPair->link(0), linkPair->link(1)));
+        putValue<int32_t>(data, collisions.size());
+        putValue(data, base.x());
+        putValue(data, base.y());
+        putValue(data, base.z());
+        putValue(data, pointScale);
+        putValue(data, depthScale);
+        for(auto& collision : collisions){
+            const Vector3 offset = collision.point - base_d;
+            putValue(data, quantize(offset.x(), pointScale));
+            putValue(data, quantize(offset.y(), pointScale));
+            putValue(data, quantize(offset.z(), pointScale));
+            putNormal(data, collision.normal);
+            putValue(data, quantize(collision.depth, depthScale));
+        }
+        ++frame->numLinkPairs_;
+    }
+
+    if(frame->numLinkPairs_ == 0){
+        return emptyFrame;
+    }
+    if(prevFrame && *prevFrame == *frame){
+        return prevFrame;
+    }
+    data.shrink_to_fit();
+    return frame;
+}
+
+
+void CollisionSeq::unpackCollisions(const PackedCollisionFrame& frame, CollisionLinkPairList& out_collisionPairs)
+{
+    out_collisionPairs.clear();
+
+    if(hasUnresolvedLinks){
+        resolveLinks();
+    }
+    
+    const unsigned char* p = frame.data_.data();
+    for(int i=0; i < frame.numLinkPairs_; ++i){
+        auto& info = linkPairTable[getValue<int32_t>(p)];
+        const int numCollisions = getValue<int32_t>(p);
+        if(!info.links[0] || !info.links[1]){
+            p += sizeof(float) * 5 + numCollisions * PackedCollisionSize;
+            continue;
+        }
+        Vector3 base;
+        base.x() = getValue<float>(p);
+        base.y() = getValue<float>(p);
+        base.z() = getValue<float>(p);
+        const double pointScale = getValue<float>(p);
+        const double depthScale = getValue<float>(p);
+        
+        auto linkPair = std::make_shared<CollisionLinkPair>(info.links[0], info.links[1]);
+        auto& collisions = linkPair->collisions();
+        collisions.resize(numCollisions);
+        for(auto& collision : collisions){
+            collision.point.x() = base.x() + getValue<int16_t>(p) * pointScale;
+            collision.point.y() = base.y() + getValue<int16_t>(p) * pointScale;
+            collision.point.z() = base.z() + getValue<int16_t>(p) * pointScale;
+            collision.normal = getNormal(p);
+            collision.depth = getValue<int16_t>(p) * depthScale;
+            collision.id = 0;
+        }
+        out_collisionPairs.push_back(linkPair);
+    }
 }
 
 
@@ -85,11 +392,12 @@ void CollisionSeq::readCollisionData(int nFrames, const Listing& values)
         return;
     }
 
+    PackedCollisionFramePtr prevFrame;
+    CollisionLinkPairList collisionPairs;
     for(int i=0; i < nFrames; ++i){
         const Mapping& frameNode = *values[i].toMapping();
         const Listing& linkPairs = *frameNode.findListing("LinkPairs");
-        Frame f = frame(i);
-        f[0] = std::make_shared<CollisionLinkPairList>();
+        collisionPairs.clear();
         for(int j=0; j<linkPairs.size(); j++){
             auto destLinkPair = std::make_shared<CollisionLinkPair>();
             const Mapping& linkPair = *linkPairs[j].toMapping();
@@ -121,8 +429,11 @@ void CollisionSeq::readCollisionData(int nFrames, const Listing& values)
                 destCol.normal = Vector3(collision[3].toDouble(), collision[4].toDouble(), collision[5].toDouble());
                 destCol.depth = collision[6].toDouble();
             }
-            f[0]->push_back(destLinkPair);
+            collisionPairs.push_back(destLinkPair);
         }
+        Frame f = frame(i);
+        f[0] = packCollisions(collisionPairs, prevFrame);
+        prevFrame = f[0];
     }
 }
 
@@ -178,10 +489,144 @@ bool CollisionSeq::doWriteSeq(YAMLWriter& writer, std::function<void()> addition
             writer.putKey("frames");
             writer.startListing();
             const int n = numFrames();
+            auto collisionPairs = std::make_shared<CollisionLinkPairList>();
             for(int i=0; i < n; ++i){
                 Frame f = frame(i);
-                writeCollsionData(writer, f[0]);
+                if(f[0]){
+                    unpackCollisions(*f[0], *collisionPairs);
+                } else {
+                    collisionPairs->clear();
+                }
+                writeCollsionData(writer, collisionPairs);
             }
             writer.endListing();
         });
 }
+
+
+bool CollisionSeq::saveAsBinaryFormat(const std::string& filename, std::ostream& os)
+{
+    ofstream ofs(fromUTF8(filename).c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs){
+        os << format(_("Collision data file \"{0}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+
+    // The frames sharing the same data are stored as a single block
+    const int n = numFrames();
+    vector<int> blockIndices(n);
+    vector<const PackedCollisionFrame*> blocks;
+    std::map<const PackedCollisionFrame*, int> blockIndexMap;
+    for(int i=0; i < n; ++i){
+        auto& packed = frame(i)[0];
+        if(!packed || packed->numLinkPairs() == 0){
+            blockIndices[i] = -1;
+        } else {
+            auto inserted = blockIndexMap.emplace(packed.get(), blocks.size());
+            if(inserted.second){
+                blocks.push_back(packed.get());
+            }
+            blockIndices[i] = inserted.first->second;
+        }
+    }
+    
+    WriteBuf buf(ofs);
+    buf.writeString(BinaryFileSignature);
+    buf.writeInt(BinaryFileFormatVersion);
+    buf.writeDouble(frameRate());
+    buf.writeInt(offsetTimeFrame());
+    buf.writeInt(linkPairTable.size());
+    for(auto& info : linkPairTable){
+        for(int i=0; i < 2; ++i){
+            buf.writeString(info.bodyNames[i]);
+            buf.writeString(info.linkNames[i]);
+        }
+    }
+    buf.writeInt(n);
+    ofs.write(reinterpret_cast<const char*>(blockIndices.data()), n * sizeof(int));
+    buf.writeInt(blocks.size());
+    for(auto& block : blocks){
+        buf.writeInt(block->numLinkPairs());
+        buf.writeInt(block->data().size());
+        ofs.write(reinterpret_cast<const char*>(block->data().data()), block->data().size());
+    }
+
+    if(!ofs){
+        os << format(_("Collision data file \"{0}\" cannot be written."), filename) << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool CollisionSeq::loadBinaryFormat(const std::string& filename, std::ostream& os)
+{
+    ifstream ifs(fromUTF8(filename).c_str(), ios::in | ios::binary);
+    if(!ifs){
+        os << format(_("Collision data file \"{0}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+    ReadBuf buf(ifs);
+    string signature(BinaryFileSignature);
+    if(buf.readInt() == static_cast<int>(signature.size())){
+        ifs.read(&signature[0], signature.size());
+    } else {
+        ifs.setstate(ios::failbit);
+    }
+    if(!ifs || signature != BinaryFileSignature){
+        os << format(_("\"{0}\" is not a collision data file."), filename) << endl;
+        return false;
+    }
+    int version = buf.readInt();
+    if(version != BinaryFileFormatVersion){
+        os << format(_("The version {0} of collision data file \"{1}\" is not supported."),
+                     version, filename) << endl;
+        return false;
+    }
+
+    const double rate = buf.readDouble();
+    const int offset = buf.readInt();
+    vector<LinkPairInfo> table(buf.readSize(sizeof(int) * 4));
+    for(auto& info : table){
+        for(int i=0; ifs && i < 2; ++i){
+            buf.readString(info.bodyNames[i]);
+            buf.readString(info.linkNames[i]);
+        }
+    }
+    const int n = buf.readSize(sizeof(int));
+    vector<int> blockIndices(n);
+    ifs.read(reinterpret_cast<char*>(blockIndices.data()), n * sizeof(int));
+    const int numBlocks = buf.readSize(sizeof(int) * 2);
+    vector<PackedCollisionFramePtr> blocks;
+    for(int i=0; ifs && i < numBlocks; ++i){
+        auto block = std::make_shared<PackedCollisionFrame>();
+        block->numLinkPairs_ = buf.readSize();
+        block->data_.resize(buf.readSize());
+        ifs.read(reinterpret_cast<char*>(block->data_.data()), block->data_.size());
+        if(ifs && !checkPackedData(*block, table.size())){
+            ifs.setstate(ios::failbit);
+        }
+        blocks.push_back(block);
+    }
+    for(auto& index : blockIndices){
+        if(index < -1 || index >= numBlocks){
+            ifs.setstate(ios::failbit);
+        }
+    }
+    if(!ifs){
+        os << format(_("Collision data file \"{0}\" is broken."), filename) << endl;
+        return false;
+    }
+
+    setDimension(n, 1);
+    setFrameRate(rate);
+    setOffsetTimeFrame(offset);
+    for(int i=0; i < n; ++i){
+        frame(i)[0] = (blockIndices[i] >= 0) ? blocks[blockIndices[i]] : emptyFrame;
+    }
+    linkPairTable.swap(table);
+    linkPairIndexMap.clear();
+    hasUnresolvedLinks = true;
+
+    return true;
+}
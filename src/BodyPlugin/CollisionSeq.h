@@ -5,6 +5,7 @@
 #include <cnoid/MultiSeq>
 #include <cnoid/YAMLWriter>
 #include <memory>
+#include <map>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -14,9 +15,33 @@ class CollisionSeqItem;
 
 typedef std::vector<std::shared_ptr<CollisionLinkPair>> CollisionLinkPairList;
 
-class CNOID_EXPORT CollisionSeq : public MultiSeq<std::shared_ptr<CollisionLinkPairList>>
+/**
+   The collisions of a frame packed into a flat buffer. The link pairs are referred by the
+   indices of the link pair table of CollisionSeq, and the points, normals and depths of the
+   collisions are quantized into 16-bit integers in the ranges of each link pair.
+*/
+class CNOID_EXPORT PackedCollisionFrame
 {
-    typedef MultiSeq<std::shared_ptr<CollisionLinkPairList>> BaseSeqType;
+public:
+    PackedCollisionFrame() : numLinkPairs_(0) { }
+    int numLinkPairs() const { return numLinkPairs_; }
+    const std::vector<unsigned char>& data() const { return data_; }
+    bool operator==(const PackedCollisionFrame& rhs) const {
+        return numLinkPairs_ == rhs.numLinkPairs_ && data_ == rhs.data_;
+    }
+
+private:
+    int numLinkPairs_;
+    std::vector<unsigned char> data_;
+
+    friend class CollisionSeq;
+};
+
+typedef std::shared_ptr<const PackedCollisionFrame> PackedCollisionFramePtr;
+
+class CNOID_EXPORT CollisionSeq : public MultiSeq<PackedCollisionFramePtr>
+{
+    typedef MultiSeq<PackedCollisionFramePtr> BaseSeqType;
 
 public:
     CollisionSeqItem* collisionSeqItem_;
@@ -24,14 +49,51 @@ public:
 
     using BaseSeqType::operator=;
 
+    void clearLinkPairTable();
+    int numLinkPairsInTable() const { return static_cast<int>(linkPairTable.size()); }
+
+    /**
+       \param prevFrame The previous frame whose data is shared by the returned frame if the
+       packed collisions are the same as those of the previous frame.
+    */
+    PackedCollisionFramePtr packCollisions(
+        const CollisionLinkPairList& collisionPairs, PackedCollisionFramePtr prevFrame = nullptr);
+
+    /**
+       The link pairs whose links are not found in the world are skipped.
+       The ids of the collisions are not stored in the packed frames.
+    */
+    void unpackCollisions(const PackedCollisionFrame& frame, CollisionLinkPairList& out_collisionPairs);
+
     bool loadStandardYAMLformat(const std::string& filename, std::ostream& os = nullout());
     bool saveAsStandardYAMLformat(const std::string& filename);
     void writeCollsionData(YAMLWriter& writer, std::shared_ptr<const CollisionLinkPairList> ptr);
     void readCollisionData(int nFrames, const Listing& values);
 
+    /**
+       The binary format stores the link pair table, the index from the frames to the packed
+       data blocks and the blocks, where the frames sharing the same data refer to a single block.
+    */
+    bool loadBinaryFormat(const std::string& filename, std::ostream& os = nullout());
+    bool saveAsBinaryFormat(const std::string& filename, std::ostream& os = nullout());
+
 protected:
     virtual bool doReadSeq(const Mapping* archive, std::ostream& os) override;
     virtual bool doWriteSeq(YAMLWriter& writer, std::function<void()> additionalPartCallback) override;
+
+private:
+    struct LinkPairInfo
+    {
+        std::string bodyNames[2];
+        std::string linkNames[2];
+        LinkPtr links[2];
+    };
+    std::vector<LinkPairInfo> linkPairTable;
+    std::map<std::pair<Link*, Link*>, int> linkPairIndexMap;
+    bool hasUnresolvedLinks;
+
+    int getLinkPairIndex(Link* link0, Link* link1);
+    void resolveLinks();
 };
 
 }
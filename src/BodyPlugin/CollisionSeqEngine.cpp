@@ -91,9 +91,11 @@ bool CollisionSeqEngine::Impl::onTimeChanged(double time)
                 const int clampedFrame = colSeq->clampFrameIndex(frame);
                 const CollisionSeq::Frame collisionPairs0 = colSeq->frame(clampedFrame);
                 CollisionLinkPairList& collisionPairs = worldItem->collisions();
-                collisionPairs.clear();
-                for(size_t i=0; i < collisionPairs0[0]->size(); i++){
-                    collisionPairs.push_back(collisionPairs0[0]->at(i));
+                // The packed collisions are only decoded for the displayed frame
+                if(collisionPairs0[0]){
+                    colSeq->unpackCollisions(*collisionPairs0[0], collisionPairs);
+                } else {
+                    collisionPairs.clear();
                 }
             }
         }
@@ -62,6 +62,14 @@ void CollisionSeqItem::initislizeClass(ExtensionManager* ext)
         [](CollisionSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
             return saveAsStandardYamlFormat(item, filename, os);
         });
+    im.addLoaderAndSaver<CollisionSeqItem>(
+        _("Collision Data (Binary)"), "COLLISION-DATA-BINARY", "colseq",
+        [](CollisionSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->collisionSeq()->loadBinaryFormat(filename, os);
+        },
+        [](CollisionSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->collisionSeq()->saveAsBinaryFormat(filename, os);
+        });
 
     initialized = true;
 }
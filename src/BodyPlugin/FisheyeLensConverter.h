@@ -9,9 +9,13 @@
 #include <cnoid/Image>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <cstdint>
 
 namespace cnoid {
 
+class ThreadPool;
+
 class FisheyeLensConverter
 {
 public:
@@ -20,6 +24,7 @@ public:
     };
 
     FisheyeLensConverter();
+    ~FisheyeLensConverter();
     void initialize(int width, int height, double fov, int screenWidth);
     void addScreenImage(std::shared_ptr<Image> image);
     void setImageRotationEnabled(bool on);
@@ -36,21 +41,26 @@ private:
     bool isImageRotationEnabled;
     bool isAntiAliasingEnabled;
 
-    struct ScreenIndex{
-        int screenId;
-        int ix;
-        int iy;
+    // The source pixel of each output pixel
+    struct RemapEntry {
+        int8_t screenId;
+        int offset;
+    };
+    std::vector<RemapEntry> remapTable;
+
+    // The source pixels and the fixed-point bilinear weights of each output pixel
+    struct InterpolationRemapEntry {
+        int8_t screenIds[4];
+        uint16_t weights[4];
+        int offsets[4];
     };
-    std::vector<std::vector<ScreenIndex>> fisheyeLensMap;
+    std::vector<InterpolationRemapEntry> interpolationRemapTable;
+
+    std::unique_ptr<ThreadPool> threadPool;
 
     // for Interpolation
     int screenId[4];
     int npx[4],npy[4];
-    struct ScreenIndex4 {
-        ScreenIndex screenIndex[4];
-        double bias[4];
-    };
-    std::vector<std::vector<ScreenIndex4>> fisheyeLensInterpolationMap;
 
     enum Corner {
         FRONT_UR,  FRONT_UL,  FRONT_DR,  FRONT_DL,
@@ -66,6 +76,9 @@ private:
     void setCenter(int id, double sx, double sy);
     void setVerticalBorder(int id0, int id1, double sy);
     void setHorizontalBorder(int id0, int id1, double sx);
+    void buildRemapTable();
+    void buildInterpolationRemapTable();
+    void processRows(const std::function<void(int beginRow, int endRow)>& func);
     void convertImageWithoutAntiAliasing(Image* image);
     void convertImageWithAntiAliasing(Image* image);
 };
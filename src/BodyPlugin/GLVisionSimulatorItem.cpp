@@ -648,9 +648,9 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItem::Impl* simImpl, Device* dev
                 }
             }
 
-            fisheyeLensConverter.initialize(width, height, fov, resolution);
             fisheyeLensConverter.setImageRotationEnabled(camera->lensType() == Camera::DUAL_FISHEYE_LENS);
             fisheyeLensConverter.setAntiAliasingEnabled(simImpl->isAntiAliasingEnabled);
+            fisheyeLensConverter.initialize(width, height, fov, resolution);
             
             for(int i=0; i < numScreens; ++i){
                 auto cameraForRendering = new Camera(*camera);
@@ -989,6 +989,10 @@ bool SensorScreenRenderer::initializeGL(SgCamera* sceneCamera)
     if(!renderer){
         renderer = GLSceneRenderer::create();
         renderer->setFlagVariableToUpdatePreprocessedNodeTree(flagToUpdatePreprocessedNodeTree);
+        // The simulated images must not depend on the timing of decoding the texture images
+        if(auto glslRenderer = dynamic_cast<GLSLSceneRenderer*>(renderer)){
+            glslRenderer->setPendingImageWaitEnabled(true);
+        }
     }
 
     renderer->setDefaultFramebufferObject(frameBuffer->handle());
@@ -223,7 +223,9 @@ bool KinematicSimulatorItem::Impl::initializeSimulation(const std::vector<Simula
 
     if(hasHolderDevicesWithCollisionCondition || !conveyorInfos.empty()){
         if(!bodyCollisionDetector){
-            bodyCollisionDetector = make_unique<BodyCollisionDetector>(new AISTCollisionDetector);
+            auto collisionDetector = new AISTCollisionDetector;
+            collisionDetector->setIncrementalDetectionEnabled(true);
+            bodyCollisionDetector = make_unique<BodyCollisionDetector>(collisionDetector);
             bodyCollisionDetector->setGeometryHandleMapEnabled(true);
             bodyCollisionDetector->setMultiplexBodySupportEnabled(true);
         }
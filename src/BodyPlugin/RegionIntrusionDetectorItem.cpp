@@ -1,15 +1,14 @@
 #include "RegionIntrusionDetectorItem.h"
 #include <cnoid/ItemManager>
-#include <cnoid/AISTCollisionDetector>
 #include <cnoid/Body>
-#include <cnoid/BodyCollisionDetector>
+#include <cnoid/RegionIntrusionMonitor>
 #include <cnoid/DigitalIoDevice>
-#include <cnoid/MeshGenerator>
 #include <cnoid/SceneDrawables>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
 #include <cnoid/EigenArchive>
 #include <fmt/format.h>
+#include <map>
 #include "gettext.h"
 
 using namespace std;
@@ -31,6 +30,29 @@ public:
     virtual SignalProxy<void()> sigLocationChanged() override;
 };
 
+// The monitors are shared by the detector items of the same bodies
+map<Body*, weak_ref_ptr<RegionIntrusionMonitor>> sharedMonitors;
+
+RegionIntrusionMonitorPtr getOrCreateSharedMonitor(Body* body)
+{
+    auto p = sharedMonitors.begin();
+    while(p != sharedMonitors.end()){
+        if(p->second.expired()){
+            p = sharedMonitors.erase(p);
+        } else {
+            ++p;
+        }
+    }
+    auto& sharedMonitor = sharedMonitors[body];
+    RegionIntrusionMonitorPtr monitor = sharedMonitor.lock();
+    if(!monitor){
+        monitor = new RegionIntrusionMonitor;
+        monitor->addBody(body);
+        sharedMonitor = monitor;
+    }
+    return monitor;
+}
+
 }
 
 namespace cnoid {
@@ -39,20 +61,12 @@ class RegionIntrusionDetectorItem::Impl
 {
 public:
     RegionIntrusionDetectorItem* self;
-    unique_ptr<BodyCollisionDetector> bodyCollisionDetector;
-    DigitalIoDevicePtr ioDevice;
+    ControllerIO* io;
+    RegionIntrusionMonitorPtr monitor;
+    int regionId;
     int ioSignalNumber;
-    bool isIntruding;
-    bool intrusionChanged;
-
-    // Region model members for the collision detection
     Vector3 boxRegionSize;
     Isometry3 regionOffset;
-    BodyPtr regionBody;
-    LinkPtr regionLink;
-    MeshGenerator meshGenerator;
-    SgPosTransformPtr regionShapeLocalOffset;
-    SgShapePtr regionShape;
 
     ref_ptr<RegionLocation> regionLocation;
 
@@ -63,7 +77,6 @@ public:
     
     Impl(RegionIntrusionDetectorItem* self);
     Impl(RegionIntrusionDetectorItem* self, Impl& org);
-    void initializeCollisionDetector();
     bool initialize(ControllerIO* io);
     void createRegionMarker();
     void updateMarkerVertices();
@@ -97,6 +110,8 @@ RegionIntrusionDetectorItem::RegionIntrusionDetectorItem(const RegionIntrusionDe
 RegionIntrusionDetectorItem::Impl::Impl(RegionIntrusionDetectorItem* self)
     : self(self)
 {
+    io = nullptr;
+    regionId = -1;
     boxRegionSize.setOnes();
     regionOffset.setIdentity();
     ioSignalNumber = 0;
@@ -169,19 +184,6 @@ int RegionIntrusionDetectorItem::digitalIoSignalNumber() const
 }
 
 
-void RegionIntrusionDetectorItem::Impl::initializeCollisionDetector()
-{
-    bodyCollisionDetector = make_unique<BodyCollisionDetector>(new AISTCollisionDetector);
-    regionBody = new Body;
-    regionLink = regionBody->rootLink();
-    regionLink->setJointType(Link::FixedJoint);
-    regionShapeLocalOffset = new SgPosTransform;
-    regionShape = new SgShape;
-    regionShapeLocalOffset->addChild(regionShape);
-    regionLink->addCollisionShapeNode(regionShapeLocalOffset);
-}    
-
-
 bool RegionIntrusionDetectorItem::initialize(ControllerIO* io)
 {
     return impl->initialize(io);
@@ -190,30 +192,22 @@ bool RegionIntrusionDetectorItem::initialize(ControllerIO* io)
 
 bool RegionIntrusionDetectorItem::Impl::initialize(ControllerIO* io)
 {
-    if(!bodyCollisionDetector){
-        initializeCollisionDetector();
-    }
-    
     auto body = io->body();
-    ioDevice = body->findDevice<DigitalIoDevice>();
+    auto ioDevice = body->findDevice<DigitalIoDevice>();
     if(!ioDevice){
         io->os() << format(_("\"{0}\" cannot work with \"{1}\" because it does not have a digital IO device."),
                            self->name(), body->name()) << endl;
         return false;
     }
 
-    bodyCollisionDetector->clearBodies();
+    this->io = io;
+    monitor = getOrCreateSharedMonitor(body);
 
-    regionShapeLocalOffset->setTranslation(Vector3(0.0, 0.0, boxRegionSize.z() / 2.0));
-    regionShape->setMesh(meshGenerator.generateBox(boxRegionSize));
-    regionLink->setPosition(regionOffset);
-    bodyCollisionDetector->addBody(regionBody, false);
-
-    bodyCollisionDetector->addBody(io->body(), false);
-    bodyCollisionDetector->makeReady();
-
-    isIntruding = false;
-    intrusionChanged = false;
+    // The origin of the box region is the center of the bottom face
+    Isometry3 T = regionOffset;
+    T.translate(Vector3(0.0, 0.0, boxRegionSize.z() / 2.0));
+    regionId = monitor->addBoxRegion(boxRegionSize, T);
+    monitor->setRegionSignal(regionId, ioDevice, ioSignalNumber);
 
     return true;
 }
@@ -221,34 +215,36 @@ bool RegionIntrusionDetectorItem::Impl::initialize(ControllerIO* io)
 
 void RegionIntrusionDetectorItem::input()
 {
-    impl->bodyCollisionDetector->updatePositions();
+    /*
+      The link positions are copied here because the control function may be executed while
+      the simulator is updating them.
+    */
+    impl->monitor->updatePositions(impl->io->currentTime());
 }
 
 
 bool RegionIntrusionDetectorItem::control()
 {
-    bool prevIntrusion = impl->isIntruding;
-    impl->isIntruding = false;
-    impl->bodyCollisionDetector->detectCollisions(
-        [this](const CollisionPair&){ impl->isIntruding = true; });
-    impl->intrusionChanged = (impl->isIntruding != prevIntrusion);
+    // The detection for all the regions of the body is done by the first detector in the step
+    impl->monitor->detectIntrusions(impl->io->currentTime());
     return false;
 }
 
 
 void RegionIntrusionDetectorItem::output()
 {
-    if(impl->intrusionChanged){
-        impl->ioDevice->setOut(impl->ioSignalNumber, impl->isIntruding, true);
-        impl->intrusionChanged = false;
-    }
+    impl->monitor->outputSignals();
 }
 
 
 void RegionIntrusionDetectorItem::stop()
 {
-    impl->ioDevice.reset();
-    impl->bodyCollisionDetector->clearBodies();
+    if(impl->monitor){
+        impl->monitor->removeRegion(impl->regionId);
+        impl->monitor.reset();
+    }
+    impl->regionId = -1;
+    impl->io = nullptr;
 }
 
 
@@ -32,6 +32,7 @@
 #include <cnoid/SceneView>
 #include <cnoid/CloneMap>
 #include <cnoid/CollisionDetector>
+#include <cnoid/TraceProfiler>
 #include <QThread>
 #include <QMutex>
 #include <QElapsedTimer>
@@ -56,6 +57,13 @@ static const char* timeRangeModeSymbols[] = { "unlimited", "specified", "timebar
 
 typedef map<weak_ref_ptr<BodyItem>, SimulationBodyPtr> BodyItemToSimBodyMap;
 
+/*
+  The step profiles of the simulations running at the same time are recorded in the same
+  trace profiler, so the profile files of the simulations are exported when the last one ends.
+  The pairs of the simulator item names and the files are kept until then.
+*/
+vector<pair<string, string>> pendingStepProfileFiles;
+
 struct FunctionSet
 {
     struct FunctionInfo {
@@ -174,6 +182,32 @@ public:
 
 typedef ref_ptr<SimulationLogEngine> SimulationLogEnginePtr;
 
+//! Discard the frames of a record sequence after the specified frame
+template<class SeqType>
+void rewindRecordSeq(SeqType& seq, int frame)
+{
+    const int offset = seq.offsetTimeFrame();
+    if(frame <= offset){
+        seq.setNumFrames(0);
+        seq.setOffsetTimeFrame(frame);
+    } else if(frame - offset < seq.numFrames()){
+        seq.setNumFrames(frame - offset);
+    }
+}
+
+/**
+   Restart a record sequence at the specified frame if the frame is later than the end of the
+   sequence. This happens when a snapshot taken by another simulation is restored to fork it.
+*/
+template<class SeqType>
+void resumeRecordSeq(SeqType& seq, int frame)
+{
+    if(frame - seq.offsetTimeFrame() > seq.numFrames()){
+        seq.setNumFrames(0);
+        seq.setOffsetTimeFrame(frame);
+    }
+}
+
 }
 
 namespace cnoid {
@@ -193,6 +227,7 @@ public:
     bool isDynamic;
     bool areShapesCloned;
 
+    // The buffers written in the simulation thread
     unique_ptr<BodyPositionSeq> positionBuf;
     int currentPositionBufIndex;
     int numLinksToRecord;
@@ -202,6 +237,11 @@ public:
     vector<bool> deviceStateChangeFlag;
     unique_ptr<MultiDeviceStateSeq> deviceStateBuf;
 
+    // The buffers swapped with the above ones and flushed in the main thread
+    unique_ptr<BodyPositionSeq> positionBufToFlush;
+    int numPositionFramesToFlush;
+    unique_ptr<MultiDeviceStateSeq> deviceStateBufToFlush;
+
     // For the direct output without recording mode
     unique_ptr<BodyMotionEngineCore> bodyMotionEngine;
     unique_ptr<BodyPositionSeq> lastPositionBuf;
@@ -227,6 +267,10 @@ public:
     void initializeRecordItems();
     void bufferRecords();
     void bufferBodyPosition(Body* body, BodyPositionSeqFrameBlock& block);
+    void swapRecordBuffers();
+    void discardBufferedRecords();
+    void rewindRecords(int frame);
+    void resumeRecords(int frame);
     void flushRecords();
     void flushRecordsToBodyMotionItems();
     void flushRecordsToLastStateBuffers();
@@ -257,7 +301,16 @@ public:
     double worldFrameRate;
     double worldTimeStep_;
     int frameAtLastBufferWriting;
+    int frameAtLastCollisionBufferWriting;
     int numBufferedFrames;
+    int maxNumBufferedFrames;
+    double maxRecordBufferWaitTime;
+    int frameToFlush;
+    int collisionFrameToFlush;
+    // The frame to which the records are rewound by restoring a snapshot. This is -1 when not rewound.
+    int frameToRewindRecords;
+    // The frame from which the records are resumed by restoring a snapshot. This is -1 when not restored.
+    int frameToResumeRecords;
     Timer flushTimer;
     Signal<void()> sigLogFlushRequested;
 
@@ -276,6 +329,7 @@ public:
 
     shared_ptr<CollisionSeq> collisionSeq;
     deque<shared_ptr<CollisionLinkPairList>> collisionPairsBuf;
+    deque<shared_ptr<CollisionLinkPairList>> collisionPairsBufToFlush;
 
     Selection recordingMode;
     Selection timeRangeMode;
@@ -297,8 +351,11 @@ public:
     bool isCollisionDataRecordingEnabled;
     bool doRecordCollisionData;
     bool isSceneViewEditModeBlockedDuringSimulation;
+    bool isStepProfilingEnabled;
+    bool isStepProfilingActive;
 
     string controllerOptionString_;
+    string stepProfileFile;
 
     TimeBar* timeBar;
     QMutex recordBufMutex;
@@ -309,6 +366,15 @@ public:
     bool isSimulationFromInitialState;
     bool isWaitingForSimulationToStop;
     bool isForcedToStopSimulation;
+
+    // The function requested from another thread to be called by the simulation thread between steps
+    std::mutex stepBoundaryRequestMutex;
+    std::condition_variable stepBoundaryRequestCondition;
+    std::function<void()> stepBoundaryRequest;
+    SimulationSnapshotPtr snapshotToRestore;
+    volatile bool hasStepBoundaryRequest;
+    bool isAcceptingStepBoundaryRequests;
+
     Signal<void()> sigSimulationAboutToBeStarted;
     Signal<void()> sigSimulationStarted;
     Signal<void()> sigSimulationPaused;
@@ -358,11 +424,19 @@ public:
     bool startSimulation(bool doReset);
     bool initializeSimulation(bool doReset);
     virtual void run() override;
+    void processStepBoundaryRequest();
+    void finishStepBoundaryRequests();
+    bool callInSimulationThread(const std::function<void()>& func);
+    std::string getEngineType();
+    SimulationSnapshotPtr takeSnapshot();
+    bool checkSnapshot(SimulationSnapshot* snapshot, vector<int>& out_stateIndices);
+    bool restoreSnapshot(SimulationSnapshot* snapshot);
     void onSimulationLoopStarted();
     void updateSimBodyLists();
     bool stepSimulationMain();
     void bufferRecords();
     void bufferCollisionRecords();
+    void lockRecordBuffers();
     void startFlushTimer();
     void flushRecords();
     int flushMainRecords();
@@ -870,6 +944,7 @@ void SimulationBody::initializeRecordBuffers()
 void SimulationBody::Impl::initializeRecordBuffers()
 {
     currentPositionBufIndex = 0;
+    numPositionFramesToFlush = 0;
 
     bodyMotionEngine.reset();
     lastPositionBuf.reset();
@@ -879,10 +954,12 @@ void SimulationBody::Impl::initializeRecordBuffers()
         numLinksToRecord = 0;
         numJointsToRecord = 0;
         positionBuf.reset();
+        positionBufToFlush.reset();
     } else {
         numLinksToRecord = simImpl->isAllLinkPositionOutputMode ? body_->numLinks() : 1;
         numJointsToRecord = body_->numAllJoints();
         positionBuf = make_unique<BodyPositionSeq>();
+        positionBufToFlush = make_unique<BodyPositionSeq>();
 
         if(!simImpl->isRecordingEnabled){
             bodyMotionEngine = make_unique<BodyMotionEngineCore>(bodyItem);
@@ -896,6 +973,7 @@ void SimulationBody::Impl::initializeRecordBuffers()
     deviceStateChangeFlag.clear();
     deviceStateChangeFlag.resize(numDevices, true); // set all the bits to store the initial states
     deviceStateBuf.reset();
+    deviceStateBufToFlush.reset();
     
     deviceStateEngine.reset();
     lastDeviceStateBuf.reset();
@@ -910,6 +988,10 @@ void SimulationBody::Impl::initializeRecordBuffers()
 
         // This buf always has the first element to keep unchanged states
         deviceStateBuf->setDimension(1, numDevices); 
+        // This buf is empty until it is swapped with the above one
+        deviceStateBufToFlush = make_unique<MultiDeviceStateSeq>(100, numDevices);
+        deviceStateBufToFlush->setDimension(1, numDevices);
+        deviceStateBufToFlush->popFrontFrame();
         for(size_t i=0; i < devices.size(); ++i){
             deviceStateConnections.add(
                 devices[i]->sigStateChanged().connect(
@@ -1060,6 +1142,77 @@ void SimulationBody::flushRecords()
 }
 
 
+/**
+   This function is called with the record buffer mutex locked, and only the buffers are
+   swapped so that the simulation thread is not blocked while the records are flushed.
+*/
+void SimulationBody::swapRecordBuffers()
+{
+    impl->swapRecordBuffers();
+}
+
+
+void SimulationBody::Impl::swapRecordBuffers()
+{
+    if(positionBuf){
+        positionBuf.swap(positionBufToFlush);
+        numPositionFramesToFlush = currentPositionBufIndex;
+        currentPositionBufIndex = 0;
+    }
+    if(deviceStateBuf){
+        deviceStateBuf.swap(deviceStateBufToFlush);
+        // keep the last state so that unchanged states can be shared
+        auto lastFrame = deviceStateBufToFlush->lastFrame();
+        std::copy(lastFrame.begin(), lastFrame.end(), deviceStateBuf->appendFrame().begin());
+    }
+}
+
+
+/**
+   This function is called in the simulation thread with the record buffer mutex locked to discard
+   the frames that have not been flushed when the simulation is rewound.
+*/
+void SimulationBody::Impl::discardBufferedRecords()
+{
+    if(positionBuf){
+        currentPositionBufIndex = 0;
+    }
+    if(deviceStateBuf){
+        // The first frame is kept as the previous states, which are updated by the restored states
+        if(deviceStateBuf->numFrames() > 1){
+            deviceStateBuf->setNumFrames(1);
+        }
+        std::fill(deviceStateChangeFlag.begin(), deviceStateChangeFlag.end(), true);
+    }
+}
+
+
+void SimulationBody::Impl::rewindRecords(int frame)
+{
+    if(simImpl->isRecordingEnabled){
+        if(positionRecord){
+            rewindRecordSeq(*positionRecord, frame);
+        }
+        if(deviceStateRecord){
+            rewindRecordSeq(*deviceStateRecord, frame);
+        }
+    }
+}
+
+
+void SimulationBody::Impl::resumeRecords(int frame)
+{
+    if(simImpl->isRecordingEnabled){
+        if(positionRecord){
+            resumeRecordSeq(*positionRecord, frame);
+        }
+        if(deviceStateRecord){
+            resumeRecordSeq(*deviceStateRecord, frame);
+        }
+    }
+}
+
+
 void SimulationBody::Impl::flushRecords()
 {
     if(simImpl->isRecordingEnabled){
@@ -1068,13 +1221,10 @@ void SimulationBody::Impl::flushRecords()
         flushRecordsToLastStateBuffers();
     }
 
-    currentPositionBufIndex = 0;
+    numPositionFramesToFlush = 0;
 
-    if(deviceStateBuf){
-        // keep the last state so that unchanged states can be shared
-        const int numFrames = deviceStateBuf->numFrames();
-        const int numPops = (numFrames >= 2) ? (numFrames - 1) : 0;
-        deviceStateBuf->popFrontFrames(numPops);
+    if(deviceStateBufToFlush){
+        deviceStateBufToFlush->popFrontFrames(deviceStateBufToFlush->numFrames());
     }
 }
 
@@ -1084,21 +1234,21 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
     const int ringBufferSize = simImpl->ringBufferSize;
     bool offsetChanged = false;
 
-    for(int i=0; i < currentPositionBufIndex; ++i){
+    for(int i=0; i < numPositionFramesToFlush; ++i){
         if(positionRecord->numFrames() < ringBufferSize){
             positionRecord->append();
         } else {
             positionRecord->rotate();
             offsetChanged = true;
         }
-        auto& srcFrame = positionBuf->frame(i);
+        auto& srcFrame = positionBufToFlush->frame(i);
         positionRecord->back() = srcFrame;
     }
 
-    if(deviceStateBuf){
+    if(deviceStateBufToFlush){
         // This loop begins with the second element to skip the first element to keep the unchanged states
-        for(int i=1; i < deviceStateBuf->numFrames(); ++i){ 
-            auto buf = deviceStateBuf->frame(i);
+        for(int i=1; i < deviceStateBufToFlush->numFrames(); ++i){ 
+            auto buf = deviceStateBufToFlush->frame(i);
             if(deviceStateRecord->numFrames() >= ringBufferSize){
                 deviceStateRecord->popFrontFrame();
                 offsetChanged = true;
@@ -1108,12 +1258,12 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
     }
     
     if(offsetChanged){
-        const int nextFrame = simImpl->currentFrame + 1;
+        const int nextFrame = simImpl->frameToFlush + 1;
         int offset = nextFrame - ringBufferSize;
         if(positionRecord){
             positionRecord->setOffsetTimeFrame(offset);
         }
-        if(deviceStateBuf){
+        if(deviceStateRecord){
             deviceStateRecord->setOffsetTimeFrame(offset);
         }
     }
@@ -1123,17 +1273,17 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
 // This function is called in the no-recording mode.
 void SimulationBody::Impl::flushRecordsToLastStateBuffers()
 {
-    if(currentPositionBufIndex > 0){
-        int lastFrame = currentPositionBufIndex - 1;
-        lastPositionBuf->frame(0) = positionBuf->frame(lastFrame);
+    if(numPositionFramesToFlush > 0){
+        int lastFrame = numPositionFramesToFlush - 1;
+        lastPositionBuf->frame(0) = positionBufToFlush->frame(lastFrame);
         hasLastPosition = true;
     } else {
         hasLastPosition = false;
     }
     
-    if(deviceStateBuf){
-        if(!deviceStateBuf->empty()){
-            auto lastFrame = deviceStateBuf->lastFrame();
+    if(deviceStateBufToFlush){
+        if(!deviceStateBufToFlush->empty()){
+            auto lastFrame = deviceStateBufToFlush->lastFrame();
             std::copy(lastFrame.begin(), lastFrame.end(), lastDeviceStateBuf->begin());
             hasLastDeviceStates = true;
         } else {
@@ -1161,8 +1311,8 @@ void SimulationBody::Impl::flushRecordsToWorldLogFile(int bufferFrame)
 
     log->beginBodyStateOutput();
 
-    if(positionBuf){
-        auto& frame = positionBuf->frame(bufferFrame);
+    if(positionBufToFlush){
+        auto& frame = positionBufToFlush->frame(bufferFrame);
         if(numLinksToRecord > 0){
             log->outputLinkPositions(frame.linkPositionData(), numLinksToRecord);
         }
@@ -1171,9 +1321,9 @@ void SimulationBody::Impl::flushRecordsToWorldLogFile(int bufferFrame)
         }
     }
     
-    if(deviceStateBuf){
+    if(deviceStateBufToFlush){
         // Skip the first element because it is used for sharing an unchanged state
-        auto states = deviceStateBuf->frame(bufferFrame + 1);
+        auto states = deviceStateBufToFlush->frame(bufferFrame + 1);
         log->beginDeviceStateOutput();
         for(int i=0; i < states.size(); ++i){
             log->outputDeviceState(states[i]);
@@ -1222,6 +1372,15 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     worldFrameRate = 1.0;
     worldTimeStep_ = 1.0;
     frameAtLastBufferWriting = 0;
+    frameAtLastCollisionBufferWriting = 0;
+    maxNumBufferedFrames = 0;
+    maxRecordBufferWaitTime = 0.0;
+    frameToFlush = 0;
+    collisionFrameToFlush = 0;
+    frameToRewindRecords = -1;
+    frameToResumeRecords = -1;
+    hasStepBoundaryRequest = false;
+    isAcceptingStepBoundaryRequests = false;
     flushTimer.sigTimeout().connect([&](){ flushRecords(); });
 
     recordingMode.setSymbol(FullRecording, N_("full"));
@@ -1247,6 +1406,8 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     isDoingSimulationLoop = false;
     isCollisionDataRecordingEnabled = false;
     isSceneViewEditModeBlockedDuringSimulation = false;
+    isStepProfilingEnabled = false;
+    isStepProfilingActive = false;
     isSimulationFromInitialState = false;
 
     timeBar = TimeBar::instance();
@@ -1278,6 +1439,8 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
     isDeviceStateOutputEnabled = org.isDeviceStateOutputEnabled;
     isCollisionDataRecordingEnabled = org.isCollisionDataRecordingEnabled;
     controllerOptionString_ = org.controllerOptionString_;
+    isStepProfilingEnabled = org.isStepProfilingEnabled;
+    stepProfileFile = org.stepProfileFile;
     isSimulationFromInitialState = false;
 }
     
@@ -1685,6 +1848,12 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
     }
 
     cloneMap.clear();
+    /*
+      The meshes and other non-node objects of the original bodies are shared with the bodies for
+      the simulation because they are not modified in the simulation. A simulator that needs its own
+      copies, such as GLVisionSimulatorItem, clones them with its own clone map.
+    */
+    SgObject::setNonNodeCloning(cloneMap, false);
 
     currentFrame = 0;
     currentTime_ = 0.0;
@@ -1819,6 +1988,11 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
     // Initialize recording
     numBufferedFrames = 0;
     frameAtLastBufferWriting = 0;
+    frameAtLastCollisionBufferWriting = 0;
+    frameToRewindRecords = -1;
+    frameToResumeRecords = -1;
+    maxNumBufferedFrames = 0;
+    maxRecordBufferWaitTime = 0.0;
     for(auto& simBody : activeSimBodies){
         if(simBody->body()){
             simBody->impl->initializeRecording();
@@ -1828,6 +2002,7 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
     doRecordCollisionData = (isRecordingEnabled && isCollisionDataRecordingEnabled);
     if(doRecordCollisionData){
         collisionPairsBuf.clear();
+        collisionPairsBufToFlush.clear();
         string collisionSeqName = self->name() + "-collisions";
         auto collisionSeqItem = worldItem->findChildItem<CollisionSeqItem>(collisionSeqName);
         if(collisionSeqItem){
@@ -1846,8 +2021,9 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
         collisionSeq->setFrameRate(worldFrameRate);
         collisionSeq->setNumParts(1);
         collisionSeq->setNumFrames(1);
+        collisionSeq->clearLinkPairTable();
         CollisionSeq::Frame frame0 = collisionSeq->frame(0);
-        frame0[0]  = std::make_shared<CollisionLinkPairList>();
+        frame0[0] = collisionSeq->packCollisions(CollisionLinkPairList());
     }
 
     for(auto& simBody : allSimBodies){
@@ -1897,9 +2073,19 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
     isDoingSimulationLoop = true;
     isWaitingForSimulationToStop = false;
     isForcedToStopSimulation = false;
+    {
+        std::lock_guard<std::mutex> lock(stepBoundaryRequestMutex);
+        isAcceptingStepBoundaryRequests = true;
+    }
     stopRequested = false;
     pauseRequested = false;
 
+    // The flag must be set before the controller threads which refer to it are created
+    isStepProfilingActive = isStepProfilingEnabled;
+    if(isStepProfilingActive){
+        TraceProfiler::beginSession();
+    }
+
     useControllerThreads = useControllerThreadsProperty;
     if(useControllerThreads){
         for(auto& info : activeControllerInfos){
@@ -1907,7 +2093,13 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
             info->isControlRequested = false;
             info->isControlFinished = false;
             info->isControlToBeContinued = false;
-            info->controlThread = std::thread([info](){ info->concurrentControlLoop(); });
+            info->controlThread = std::thread([this, info](){
+                if(isStepProfilingActive){
+                    TraceProfiler::setCurrentThreadName(
+                        format("Controller ({})", info->controller->displayName()));
+                }
+                info->concurrentControlLoop();
+            });
         }
     }
 
@@ -1950,6 +2142,7 @@ bool SimulatorItem::Impl::initializeSimulation(bool doReset)
 
     logEngine->startOngoingTimeUpdate(0.0);
     flushRecords();
+
     start();
     startFlushTimer();
 
@@ -2034,17 +2227,23 @@ SimulationBody* SimulatorItem::findSimulationBody(const std::string& name)
 // Simulation loop
 void SimulatorItem::Impl::run()
 {
+    if(isStepProfilingActive){
+        TraceProfiler::setCurrentThreadName(format("Simulation ({})", self->displayName()));
+    }
+
     self->initializeSimulationThread();
 
     double elapsedTime = 0.0;
     QElapsedTimer timer;
     timer.start();
 
-    int frame = 0;
     bool isOnPause = false;
 
     if(currentRealtimeSyncMode == NonRealtimeSync){
         while(true){
+            if(hasStepBoundaryRequest){
+                processStepBoundaryRequest();
+            }
             if(pauseRequested){
                 if(stopRequested){
                     break;
@@ -2061,7 +2260,7 @@ void SimulatorItem::Impl::run()
                     isOnPause = false;
                     sigSimulationResumed();
                 }
-                if(!stepSimulationMain() || stopRequested || frame++ >= maxFrame){
+                if(!stepSimulationMain() || stopRequested || currentFrame > maxFrame){
                     break;
                 }
             }
@@ -2072,6 +2271,9 @@ void SimulatorItem::Impl::run()
         const double dtms = dt * 1000.0;
         double compensatedSimulationTime = 0.0;
         while(true){
+            if(hasStepBoundaryRequest){
+                processStepBoundaryRequest();
+            }
             if(pauseRequested){
                 if(stopRequested){
                     break;
@@ -2088,7 +2290,7 @@ void SimulatorItem::Impl::run()
                     isOnPause = false;
                     sigSimulationResumed();
                 }
-                if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
+                if(!stepSimulationMain() || stopRequested || currentFrame > maxFrame){
                     break;
                 }
                 double diff = (double)compensatedSimulationTime - (elapsedTime + timer.elapsed());
@@ -2112,7 +2314,6 @@ void SimulatorItem::Impl::run()
                     }
                 }
                 compensatedSimulationTime += dtms;
-                ++frame;
             }
         }
     }
@@ -2121,7 +2322,10 @@ void SimulatorItem::Impl::run()
     	elapsedTime += timer.elapsed();
     }
     actualSimulationTime = (elapsedTime / 1000.0);
-    finishTime = frame / worldFrameRate;
+    // The current time is used because the frame may be rewound by restoring a snapshot
+    finishTime = currentTime_;
+
+    finishStepBoundaryRequests();
 
     isDoingSimulationLoop = false;
 
@@ -2146,19 +2350,31 @@ void SimulatorItem::Impl::run()
 
 bool SimulatorItem::Impl::stepSimulationMain()
 {
+    CNOID_TRACE_ZONE("Simulation step");
+
     // Recored the positions at the beginning of the current frame
     bufferRecords();
 
     bool doContinue = !doStopSimulationWhenNoActiveControllers;
 
-    preDynamicsFunctions.call();
+    {
+        CNOID_TRACE_ZONE("Pre-dynamics functions");
+        preDynamicsFunctions.call();
+    }
 
     if(!useControllerThreads){
         for(auto& info : activeControllerInfos){
             auto& controller = info->controller;
-            controller->input();
-            doContinue |= controller->control();
+            {
+                CNOID_TRACE_ZONE("Controller input");
+                controller->input();
+            }
+            {
+                CNOID_TRACE_ZONE("Controller control");
+                doContinue |= controller->control();
+            }
             if(controller->isNoDelayMode()){
+                CNOID_TRACE_ZONE("Controller output");
                 controller->output();
             }
         }
@@ -2169,7 +2385,10 @@ bool SimulatorItem::Impl::stepSimulationMain()
             if(controller->isNoDelayMode()){
                 hasNoDelayModeControllers = true;
             }
-            info->controller->input();
+            {
+                CNOID_TRACE_ZONE("Controller input");
+                info->controller->input();
+            }
             {
                 std::lock_guard<std::mutex> lock(info->controlMutex);                
                 info->isControlRequested = true;
@@ -2184,21 +2403,29 @@ bool SimulatorItem::Impl::stepSimulationMain()
                     if(info->waitForControlInThreadToFinish()){
                         doContinue = true;
                     }
+                    CNOID_TRACE_ZONE("Controller output");
                     info->controller->output();
                 }
             }
         }
     }
 
-    midDynamicsFunctions.call();
+    {
+        CNOID_TRACE_ZONE("Mid-dynamics functions");
+        midDynamicsFunctions.call();
+    }
 
-    self->stepSimulation(activeSimBodies);
+    {
+        CNOID_TRACE_ZONE("Step simulation");
+        self->stepSimulation(activeSimBodies);
+    }
 
     if(doRecordCollisionData){
         bufferCollisionRecords();
     }
     
     if(useControllerThreads){
+        CNOID_TRACE_ZONE("Wait for controllers");
         for(auto& info : activeControllerInfos){
             if(!info->controller->isNoDelayMode()){
                 if(info->waitForControlInThreadToFinish()){
@@ -2208,10 +2435,14 @@ bool SimulatorItem::Impl::stepSimulationMain()
         }
     }
 
-    postDynamicsFunctions.call();
+    {
+        CNOID_TRACE_ZONE("Post-dynamics functions");
+        postDynamicsFunctions.call();
+    }
 
     for(auto& info : activeControllerInfos){
         if(!info->controller->isNoDelayMode()){
+            CNOID_TRACE_ZONE("Controller output");
             info->controller->output();
         }
     }
@@ -2252,7 +2483,11 @@ void ControllerInfo::concurrentControlLoop()
             }
         }
 
-        bool doContinue = controller->control();
+        bool doContinue;
+        {
+            CNOID_TRACE_ZONE("Controller control");
+            doContinue = controller->control();
+        }
         
         {
             std::lock_guard<std::mutex> lock(controlMutex);
@@ -2269,7 +2504,9 @@ exitConcurrentControlLoop:
 
 void SimulatorItem::Impl::bufferRecords()
 {
-    recordBufMutex.lock();
+    CNOID_TRACE_ZONE("Buffer records");
+
+    lockRecordBuffers();
 
     for(size_t i=0; i < activeSimBodies.size(); ++i){
         activeSimBodies[i]->bufferRecords();
@@ -2283,12 +2520,29 @@ void SimulatorItem::Impl::bufferRecords()
 
 void SimulatorItem::Impl::bufferCollisionRecords()
 {
-    recordBufMutex.lock();
+    CNOID_TRACE_ZONE("Buffer collision records");
+
+    lockRecordBuffers();
     collisionPairsBuf.push_back(self->getCollisions());
+    frameAtLastCollisionBufferWriting = currentFrame;
     recordBufMutex.unlock();
 }
 
 
+void SimulatorItem::Impl::lockRecordBuffers()
+{
+    if(!recordBufMutex.tryLock()){
+        QElapsedTimer timer;
+        timer.start();
+        recordBufMutex.lock();
+        double waitTime = timer.nsecsElapsed() / 1.0e9;
+        if(waitTime > maxRecordBufferWaitTime){
+            maxRecordBufferWaitTime = waitTime;
+        }
+    }
+}
+
+
 void SimulatorItem::Impl::startFlushTimer()
 {
     if(timeBar->isIdleEventDrivenMode()){
@@ -2324,10 +2578,54 @@ int SimulatorItem::Impl::flushMainRecords()
 {
     recordBufMutex.lock();
 
+    for(auto& simBody : activeSimBodies){
+        simBody->swapRecordBuffers();
+    }
+    collisionPairsBuf.swap(collisionPairsBufToFlush);
+    const int numFramesToFlush = numBufferedFrames;
+    frameToFlush = frameAtLastBufferWriting;
+    collisionFrameToFlush = frameAtLastCollisionBufferWriting;
+    if(numBufferedFrames > maxNumBufferedFrames){
+        maxNumBufferedFrames = numBufferedFrames;
+    }
+    numBufferedFrames = 0;
+    const int frameToRewind = frameToRewindRecords;
+    frameToRewindRecords = -1;
+    const int frameToResume = frameToResumeRecords;
+    frameToResumeRecords = -1;
+    
+    recordBufMutex.unlock();
+
+    // The following operations are done without blocking the simulation thread
+
+    if(frameToRewind >= 0){
+        for(auto& simBody : activeSimBodies){
+            simBody->impl->rewindRecords(frameToRewind);
+        }
+        if(doRecordCollisionData){
+            rewindRecordSeq(*collisionSeq, frameToRewind);
+        }
+    }
+    if(frameToResume >= 0){
+        for(auto& simBody : activeSimBodies){
+            simBody->impl->resumeRecords(frameToResume);
+        }
+        if(doRecordCollisionData){
+            resumeRecordSeq(*collisionSeq, frameToResume);
+        }
+        // The log frames skipped by the restoration are not output
+        if(worldLogFileItem){
+            const double time = frameToResume * worldTimeStep_;
+            while(nextLogTime < time){
+                nextLogTime = ++nextLogFrame * logTimeStep;
+            }
+        }
+    }
+    
     if(worldLogFileItem){
-        if(numBufferedFrames > 0){
-            int firstFrame = frameAtLastBufferWriting - (numBufferedFrames - 1);
-            for(int bufFrame = 0; bufFrame < numBufferedFrames; ++bufFrame){
+        if(numFramesToFlush > 0){
+            int firstFrame = frameToFlush - (numFramesToFlush - 1);
+            for(int bufFrame = 0; bufFrame < numFramesToFlush; ++bufFrame){
                 double time = (firstFrame + bufFrame) * worldTimeStep_;
                 while(time >= nextLogTime){
                     worldLogFileItem->beginFrameOutput(time);
@@ -2348,27 +2646,27 @@ int SimulatorItem::Impl::flushMainRecords()
     bool offsetChanged;
     if(doRecordCollisionData){
         offsetChanged = false;
-        for(size_t i=0 ; i < collisionPairsBuf.size(); ++i){
+        for(size_t i=0 ; i < collisionPairsBufToFlush.size(); ++i){
             if(collisionSeq->numFrames() >= ringBufferSize){
                 collisionSeq->popFrontFrame();
                 offsetChanged = true;
             }
+            // The collisions are packed in the main thread because the link pair table is shared with the playback
+            PackedCollisionFramePtr prevFrame;
+            if(collisionSeq->numFrames() > 0){
+                prevFrame = collisionSeq->frame(collisionSeq->numFrames() - 1)[0];
+            }
+            auto packed = collisionSeq->packCollisions(*collisionPairsBufToFlush[i], prevFrame);
             CollisionSeq::Frame collisionSeq0 = collisionSeq->appendFrame();
-            collisionSeq0[0] = collisionPairsBuf[i];
+            collisionSeq0[0] = packed;
         }
         if(offsetChanged){
-            collisionSeq->setOffsetTimeFrame(currentFrame + 1 - collisionSeq->numFrames());
+            collisionSeq->setOffsetTimeFrame(collisionFrameToFlush + 1 - collisionSeq->numFrames());
         }
     }
-    collisionPairsBuf.clear();
-
-    int frame = frameAtLastBufferWriting;
-    
-    numBufferedFrames = 0;
-    
-    recordBufMutex.unlock();
+    collisionPairsBufToFlush.clear();
 
-    return frame;
+    return frameToFlush;
 }
 
 
@@ -2437,6 +2735,29 @@ void SimulatorItem::finalizeSimulation()
 void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
 {
     flushTimer.stop();
+
+    if(isStepProfilingActive){
+        isStepProfilingActive = false;
+        if(!stepProfileFile.empty()){
+            pendingStepProfileFiles.emplace_back(self->displayName(), stepProfileFile);
+        }
+        if(TraceProfiler::endSession()){
+            for(auto& nameAndFile : pendingStepProfileFiles){
+                string message;
+                if(TraceProfiler::exportChromeTrace(nameAndFile.second, message)){
+                    mv->putln(format(_("The step profile of {0} has been exported to \"{1}\"."),
+                                     nameAndFile.first, nameAndFile.second));
+                } else {
+                    mv->putln(message, MessageView::Error);
+                }
+            }
+            pendingStepProfileFiles.clear();
+        } else if(!stepProfileFile.empty()){
+            mv->putln(format(_("The step profile of {0} will be exported to \"{1}\" when the other "
+                               "simulations being profiled end."),
+                             self->displayName(), stepProfileFile));
+        }
+    }
     
     for(auto& simBody : allSimBodies){
         for(auto& info : simBody->impl->controllerInfos){
@@ -2524,6 +2845,214 @@ double SimulatorItem::simulationTime() const
 }
 
 
+int SimulatorItem::maxNumBufferedRecordFrames() const
+{
+    QMutexLocker locker(&impl->recordBufMutex);
+    return std::max(impl->maxNumBufferedFrames, impl->numBufferedFrames);
+}
+
+
+double SimulatorItem::maxRecordBufferWaitTime() const
+{
+    QMutexLocker locker(&impl->recordBufMutex);
+    return impl->maxRecordBufferWaitTime;
+}
+
+
+void SimulatorItem::Impl::processStepBoundaryRequest()
+{
+    std::lock_guard<std::mutex> lock(stepBoundaryRequestMutex);
+    if(snapshotToRestore){
+        restoreSnapshot(snapshotToRestore);
+        snapshotToRestore.reset();
+    }
+    if(stepBoundaryRequest){
+        stepBoundaryRequest();
+        stepBoundaryRequest = nullptr;
+    }
+    hasStepBoundaryRequest = false;
+    stepBoundaryRequestCondition.notify_all();
+}
+
+
+void SimulatorItem::Impl::finishStepBoundaryRequests()
+{
+    std::lock_guard<std::mutex> lock(stepBoundaryRequestMutex);
+    isAcceptingStepBoundaryRequests = false;
+    stepBoundaryRequest = nullptr;
+    snapshotToRestore.reset();
+    hasStepBoundaryRequest = false;
+    stepBoundaryRequestCondition.notify_all();
+}
+
+
+/**
+   \return false if the function is not called because the simulation loop is not running
+*/
+bool SimulatorItem::Impl::callInSimulationThread(const std::function<void()>& func)
+{
+    if(QThread::currentThread() == this){
+        func();
+        return true;
+    }
+    bool isCalled = false;
+    std::unique_lock<std::mutex> lock(stepBoundaryRequestMutex);
+    if(isAcceptingStepBoundaryRequests){
+        // Wait for the previous request from another thread to be processed
+        stepBoundaryRequestCondition.wait(
+            lock, [&](){ return !hasStepBoundaryRequest || !isAcceptingStepBoundaryRequests; });
+        if(isAcceptingStepBoundaryRequests){
+            stepBoundaryRequest = [&](){ func(); isCalled = true; };
+            hasStepBoundaryRequest = true;
+            stepBoundaryRequestCondition.wait(lock, [&](){ return !hasStepBoundaryRequest; });
+        }
+    }
+    return isCalled;
+}
+
+
+SimulationSnapshotPtr SimulatorItem::takeSnapshot()
+{
+    SimulationSnapshotPtr snapshot;
+    impl->callInSimulationThread([&](){ snapshot = impl->takeSnapshot(); });
+    return snapshot;
+}
+
+
+/**
+   The registered class name is used as the engine type because the type name given by RTTI
+   depends on the compiler.
+   \return An empty string if the class is not registered.
+*/
+std::string SimulatorItem::Impl::getEngineType()
+{
+    string moduleName, className;
+    if(ItemManager::getClassIdentifier(self, moduleName, className)){
+        return moduleName + "::" + className;
+    }
+    return string();
+}
+
+
+SimulationSnapshotPtr SimulatorItem::Impl::takeSnapshot()
+{
+    auto engineType = getEngineType();
+    SimulationSnapshotPtr snapshot = new SimulationSnapshot;
+    if(engineType.empty() || !self->storeEngineState(snapshot->engineData())){
+        mv->putln(format(_("{0} does not support the simulation snapshot."), self->displayName()),
+                  MessageView::Error);
+        return nullptr;
+    }
+    snapshot->setEngineType(engineType);
+    snapshot->setFrame(currentFrame, currentTime_);
+    for(auto& simBody : simBodiesWithBody){
+        snapshot->addBodyState(simBody->body());
+    }
+    return snapshot;
+}
+
+
+bool SimulatorItem::restoreSnapshot(SimulationSnapshot* snapshot)
+{
+    if(QThread::currentThread() == impl){
+        // The snapshot is restored after the current step is finished
+        vector<int> stateIndices;
+        if(!impl->checkSnapshot(snapshot, stateIndices)){
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(impl->stepBoundaryRequestMutex);
+        impl->snapshotToRestore = snapshot;
+        impl->hasStepBoundaryRequest = true;
+        return true;
+    }
+    
+    bool restored = false;
+    impl->callInSimulationThread([&](){ restored = impl->restoreSnapshot(snapshot); });
+    if(restored && isPausing()){
+        // Update the records and the time bar to the restored frame
+        impl->flushRecords();
+    }
+    return restored;
+}
+
+
+bool SimulatorItem::Impl::checkSnapshot(SimulationSnapshot* snapshot, vector<int>& out_stateIndices)
+{
+    auto engineType = getEngineType();
+    if(engineType.empty() || snapshot->engineType() != engineType){
+        mv->putln(format(_("The snapshot cannot be restored by {0} because it was taken by another type "
+                           "of simulator."), self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+    for(auto& simBody : simBodiesWithBody){
+        auto body = simBody->body();
+        int index = snapshot->findBodyState(body->name());
+        if(index < 0 || !snapshot->checkBodyState(index, body)){
+            mv->putln(format(_("The snapshot cannot be restored by {0} because the state of {1} "
+                               "does not match the body."), self->displayName(), body->name()),
+                      MessageView::Error);
+            return false;
+        }
+        out_stateIndices.push_back(index);
+    }
+    if(!self->checkEngineState(snapshot->engineData())){
+        mv->putln(format(_("The engine state of the snapshot cannot be restored by {0}."),
+                         self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+    return true;
+}
+
+
+bool SimulatorItem::Impl::restoreSnapshot(SimulationSnapshot* snapshot)
+{
+    vector<int> stateIndices;
+    if(!checkSnapshot(snapshot, stateIndices)){
+        return false;
+    }
+
+    // The records after the snapshot frame are discarded
+    lockRecordBuffers();
+    for(auto& simBody : activeSimBodies){
+        simBody->impl->discardBufferedRecords();
+    }
+    collisionPairsBuf.clear();
+    numBufferedFrames = 0;
+    /*
+       The pending rewind is kept if it is earlier than the snapshot frame because the records
+       after the pending frame belong to the discarded timeline.
+    */
+    if(frameToRewindRecords < 0 || snapshot->frame() < frameToRewindRecords){
+        frameToRewindRecords = snapshot->frame();
+    }
+    /*
+       When the snapshot frame is later than the end of the records, which is the case in forking
+       a simulation from a snapshot taken by another simulator item, the records are restarted
+       at the snapshot frame.
+    */
+    frameToResumeRecords = snapshot->frame();
+    frameAtLastBufferWriting = snapshot->frame();
+    frameAtLastCollisionBufferWriting = snapshot->frame();
+    recordBufMutex.unlock();
+
+    for(size_t i=0; i < simBodiesWithBody.size(); ++i){
+        snapshot->restoreBodyState(stateIndices[i], simBodiesWithBody[i]->body());
+    }
+    currentFrame = snapshot->frame();
+    currentTime_ = currentFrame / worldFrameRate;
+
+    if(!self->restoreEngineState(snapshot->engineData())){
+        mv->putln(format(_("The engine state of the snapshot cannot be restored by {0}."),
+                         self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+    return true;
+}
+
+
 SignalProxy<void()> SimulatorItem::sigSimulationAboutToBeStarted()
 {
     return impl->sigSimulationAboutToBeStarted;
@@ -2705,12 +3234,54 @@ std::shared_ptr<CollisionLinkPairList> SimulatorItem::getCollisions()
 }
 
 
+bool SimulatorItem::storeEngineState(std::vector<double>& /* out_data */)
+{
+    return false;
+}
+
+
+bool SimulatorItem::restoreEngineState(const std::vector<double>& /* data */)
+{
+    return false;
+}
+
+
+bool SimulatorItem::checkEngineState(const std::vector<double>& /* data */)
+{
+    return true;
+}
+
+
 void SimulatorItem::setSceneViewEditModeBlockedDuringSimulation(bool on)
 {
     impl->isSceneViewEditModeBlockedDuringSimulation = on;
 }
 
 
+void SimulatorItem::setStepProfilingEnabled(bool on)
+{
+    impl->isStepProfilingEnabled = on;
+}
+
+
+bool SimulatorItem::isStepProfilingEnabled() const
+{
+    return impl->isStepProfilingEnabled;
+}
+
+
+void SimulatorItem::setStepProfileFile(const std::string& filename)
+{
+    impl->stepProfileFile = filename;
+}
+
+
+const std::string& SimulatorItem::stepProfileFile() const
+{
+    return impl->stepProfileFile;
+}
+
+
 void SimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     impl->doPutProperties(putProperty);
@@ -2753,6 +3324,13 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(controllerOptionString_));
     putProperty(_("Block scene view edit mode"), isSceneViewEditModeBlockedDuringSimulation,
                 [&](bool on){ self->setSceneViewEditModeBlockedDuringSimulation(on); return true; });
+    putProperty(_("Step profiling"), isStepProfilingEnabled, changeProperty(isStepProfilingEnabled));
+    if(isStepProfilingEnabled){
+        FilePathProperty fileProperty(stepProfileFile, { string(_("Chrome Trace File (*.json)")) });
+        fileProperty.setExistingFileMode(false);
+        putProperty(_("Step profile file"), fileProperty,
+                    [&](const string& filename){ stepProfileFile = filename; return true; });
+    }
 }
 
 
@@ -2781,6 +3359,10 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("record_collision_data", isCollisionDataRecordingEnabled);
     archive.write("controller_options", controllerOptionString_, DOUBLE_QUOTED);
     archive.write("block_scene_view_edit_mode", isSceneViewEditModeBlockedDuringSimulation);
+    archive.write("step_profiling", isStepProfilingEnabled);
+    if(!stepProfileFile.empty()){
+        archive.writeRelocatablePath("step_profile_file", stepProfileFile);
+    }
     
     ListingPtr idseq = new Listing;
     idseq->setFlowStyle(true);
@@ -2871,6 +3453,10 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
     archive.read({ "controller_options", "controllerOptions" }, controllerOptionString_);
     archive.read({ "block_scene_view_edit_mode", "scene_view_edit_mode_blocking" },
                  isSceneViewEditModeBlockedDuringSimulation);
+    archive.read("step_profiling", isStepProfilingEnabled);
+    if(archive.read("step_profile_file", symbol)){
+        stepProfileFile = archive.resolveRelocatablePath(symbol);
+    }
 
     archive.addPostProcess([&](){ restoreTimeSyncItemEngines(archive); });
     
@@ -4,6 +4,7 @@
 #include "CollisionSeq.h"
 #include <cnoid/Item>
 #include <cnoid/EigenTypes>
+#include <cnoid/SimulationSnapshot>
 #include <vector>
 #include <memory>
 #include "exportdecl.h"
@@ -48,13 +49,28 @@ public:
     void notifyUnrecordedDeviceStateChange(Device* device);
     
     /**
-       Called from the simulation loop thread.
+       Called from the simulation loop thread with the record buffers locked to store the
+       states of the current frame.
     */
     virtual void bufferRecords();
+
+    /**
+       Called from the main thread without locking the record buffers to output the records
+       moved by swapRecordBuffers. The buffers written by bufferRecords must not be accessed
+       in this function because the simulation thread may be writing to them.
+    */
     virtual void flushRecords();
 
     class Impl;
 
+protected:
+    /**
+       Called from the main thread with the record buffers locked before flushRecords is called.
+       A subclass that buffers its own records should override this function to move them to
+       the buffers read by flushRecords, and call the function of this class.
+    */
+    virtual void swapRecordBuffers();
+
 private:
     Impl* impl;
 
@@ -96,6 +112,32 @@ public:
 
     //! This can be called from non simulation threads
     double simulationTime() const;
+
+    /**
+       The maximum number of the frames buffered in the simulation thread before they
+       are flushed in the main thread. This is reset when a simulation is started.
+    */
+    int maxNumBufferedRecordFrames() const;
+
+    //! The longest time [s] that the simulation thread waited for the record buffers
+    double maxRecordBufferWaitTime() const;
+
+    /**
+       A snapshot is taken and restored at the beginning of a simulation step.
+       These functions can be called from the simulation thread such as in the pre-dynamics
+       functions and controllers. When they are called from another thread while the simulation
+       is running or pausing, they wait for the simulation thread to process them.
+       Restoring a snapshot rewinds the simulation to the frame of the snapshot, and the records
+       after the frame are discarded. A snapshot can also be restored by another simulator item
+       of the same type that simulates the same bodies to fork the simulation. If the snapshot
+       frame is later than the records of the simulator item, the records are restarted at the
+       snapshot frame.
+       \note The internal states of the controllers and sub simulators are not included.
+       \return nullptr or false if the simulation is not running or the simulator does not
+       support the snapshot.
+    */
+    SimulationSnapshotPtr takeSnapshot();
+    bool restoreSnapshot(SimulationSnapshot* snapshot);
     
     SignalProxy<void()> sigSimulationAboutToBeStarted();
     SignalProxy<void()> sigSimulationStarted();
@@ -174,6 +216,15 @@ public:
     const std::string& controllerOptionString() const;
 
     void setSceneViewEditModeBlockedDuringSimulation(bool on);    
+
+    /**
+       The phases of the simulation steps are recorded with TraceProfiler during the simulation
+       and exported to the file in the Chrome trace event format when the simulation finishes.
+    */
+    void setStepProfilingEnabled(bool on);
+    bool isStepProfilingEnabled() const;
+    void setStepProfileFile(const std::string& filename);
+    const std::string& stepProfileFile() const;
     
     /**
        For sub simulators
@@ -283,6 +334,23 @@ protected:
 
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions();
 
+    /**
+       These functions are called from the simulation thread to store and restore the internal
+       state of the physics engine that is not included in the link and device states of the bodies.
+       The data is restored after the states of the bodies are restored.
+       \return false if the simulator does not support the snapshot. The default implementations
+       return false.
+    */
+    virtual bool storeEngineState(std::vector<double>& out_data);
+    virtual bool restoreEngineState(const std::vector<double>& data);
+
+    /**
+       This function is called before any state of the simulation is modified to restore a snapshot,
+       and it must return false if restoreEngineState cannot restore the data. The default
+       implementation returns true.
+    */
+    virtual bool checkEngineState(const std::vector<double>& data);
+
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
     virtual bool store(Archive& archive) override;
     virtual bool restore(const Archive& archive) override;
@@ -164,7 +164,15 @@ WorldItem::Impl::Impl(WorldItem* self, const Impl& org)
 void WorldItem::Impl::init()
 {
     kinematicsBar = KinematicsBar::instance();
-    bodyCollisionDetector.setCollisionDetector(CollisionDetector::create(collisionDetectorType.selectedIndex()));
+    auto collisionDetector = CollisionDetector::create(collisionDetectorType.selectedIndex());
+    if(collisionDetector){
+        /*
+          Only the collisions of the moved bodies are detected again in the interactive operations
+          if the collision detector supports the incremental detection.
+        */
+        collisionDetector->setIncrementalDetectionEnabled(true);
+    }
+    bodyCollisionDetector.setCollisionDetector(collisionDetector);
     bodyCollisionDetector.setGeometryHandleMapEnabled(true);
     collisions = std::make_shared<vector<CollisionLinkPairPtr>>();
     sceneCollision = new SceneCollision(collisions);
@@ -248,6 +256,7 @@ bool WorldItem::Impl::selectCollisionDetector(int index)
     if(index >= 0 && index < collisionDetectorType.size()){
         CollisionDetector* newCollisionDetector = CollisionDetector::create(index);
         if(newCollisionDetector){
+            newCollisionDetector->setIncrementalDetectionEnabled(true);
             bodyCollisionDetector.setCollisionDetector(newCollisionDetector);
             collisionDetectorType.select(index);
             if(isCollisionDetectionEnabled){
@@ -8,6 +8,8 @@
 #include "../SimpleControllerItem.h"
 #include "../BodyContactPointLoggerItem.h"
 #include "../BodyContactPointLogItem.h"
+#include <cnoid/SimulationSnapshot>
+#include <cnoid/MessageOut>
 #include <cnoid/PyBase>
 
 using namespace cnoid;
@@ -17,6 +19,17 @@ namespace cnoid {
 
 void exportSimulationClasses(py::module m)
 {
+    py::class_<SimulationSnapshot, SimulationSnapshotPtr, Referenced>(m, "SimulationSnapshot")
+        .def(py::init<>())
+        .def_property_readonly("frame", &SimulationSnapshot::frame)
+        .def_property_readonly("time", &SimulationSnapshot::time)
+        .def_property_readonly("engineType", &SimulationSnapshot::engineType)
+        .def("save", [](SimulationSnapshot& self, const std::string& filename){
+                return self.save(filename, MessageOut::master()->cerr()); })
+        .def("load", [](SimulationSnapshot& self, const std::string& filename){
+                return self.load(filename, MessageOut::master()->cerr()); })
+        ;
+
     py::class_<SimulatorItem, SimulatorItemPtr, Item> simulatorItemClass(m, "SimulatorItem");
 
     simulatorItemClass
@@ -52,6 +65,8 @@ void exportSimulationClasses(py::module m)
         .def("clearExternalForces", &SimulatorItem::clearExternalForces)
         .def("setForcedPosition", &SimulatorItem::setForcedPosition)
         .def("clearForcedPositions", &SimulatorItem::clearForcedPositions)
+        .def("takeSnapshot", &SimulatorItem::takeSnapshot, py::call_guard<py::gil_scoped_release>())
+        .def("restoreSnapshot", &SimulatorItem::restoreSnapshot, py::call_guard<py::gil_scoped_release>())
 
         // deprecated
         .def("setRealtimeSyncMode",
@@ -11,6 +11,8 @@
 #include <cnoid/BasicSensorSimulationHelper>
 #include <cnoid/MeshExtractor>
 #include <cnoid/SceneDrawables>
+#include <cnoid/MessageOut>
+#include <cnoid/TraceProfiler>
 #include <btBulletDynamicsCommon.h>
 #include <HACD/hacdHACD.h>
 #include <BulletCollision/Gimpact/btGImpactShape.h>
@@ -24,10 +26,21 @@
 #include <BulletDynamics/Featherstone/btMultiBodyJointMotor.h>
 #include <BulletDynamics/Featherstone/btMultiBodyPoint2Point.h>
 #include <BulletDynamics/Featherstone/btMultiBodyJointFeedback.h>
+#ifdef BT_VER_GT_287
+#include <LinearMath/btThreads.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/Dynamics/btSimulationIslandManagerMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#endif
+#include <QElapsedTimer>
+#include <mutex>
+#include <fmt/format.h>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 #define DEBUG_OUT 0
 
@@ -44,6 +57,64 @@ const btScalar DEFAULT_COLLISION_MARGIN = 0.0001;
 const bool meshOnly = false;             // not use primitive Shape
 const bool mixedPrimitiveMesh = true;   // mixed of Primitive and Mesh on one link
 
+// The narrow phase collision detection is measured by the dispatcher
+template<class DispatcherBase>
+class TimeMeasuredDispatcher : public DispatcherBase
+{
+public:
+    double& time;
+    QElapsedTimer timer;
+
+    TimeMeasuredDispatcher(btCollisionConfiguration* configuration, double& time)
+        : DispatcherBase(configuration), time(time) { }
+
+    virtual void dispatchAllCollisionPairs(
+        btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher) override {
+        CNOID_TRACE_ZONE("Bullet collision detection");
+        timer.start();
+        DispatcherBase::dispatchAllCollisionPairs(pairCache, info, dispatcher);
+        time += timer.nsecsElapsed();
+    }
+};
+
+#ifdef BT_VER_GT_287
+/*
+  The task scheduler is global in Bullet and its parallelFor function is not reentrant,
+  so the multi-threaded scheduler is only used by one simulator item at a time.
+*/
+std::mutex taskSchedulerMutex;
+bool isMultiThreadedTaskSchedulerInUse = false;
+
+btITaskScheduler* getMultiThreadedTaskScheduler()
+{
+    static btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+    return scheduler;
+}
+
+/**
+   \return The number of the threads used by the scheduler, or zero if the scheduler is used by
+   another simulator item.
+*/
+int acquireMultiThreadedTaskScheduler(btITaskScheduler* scheduler, int numThreads)
+{
+    std::lock_guard<std::mutex> lock(taskSchedulerMutex);
+    if(isMultiThreadedTaskSchedulerInUse){
+        return 0;
+    }
+    scheduler->setNumThreads(std::min(numThreads, scheduler->getMaxNumThreads()));
+    btSetTaskScheduler(scheduler);
+    isMultiThreadedTaskSchedulerInUse = true;
+    return scheduler->getNumThreads();
+}
+
+void releaseMultiThreadedTaskScheduler()
+{
+    std::lock_guard<std::mutex> lock(taskSchedulerMutex);
+    btSetTaskScheduler(btGetSequentialTaskScheduler());
+    isMultiThreadedTaskSchedulerInUse = false;
+}
+#endif
+
 void diagonalizeInertia(const Vector3& c, const Matrix3& I, btVector3& localInertia, btTransform& shift)
 {
     shift.setIdentity();
@@ -142,6 +213,7 @@ public:
     btCollisionDispatcher* dispatcher;
     btBroadphaseInterface* broadphase;
     btConstraintSolver* solver;
+    btConstraintSolver* solverMt;
     btDynamicsWorld* dynamicsWorld;
 
     Vector3 gravity;
@@ -155,12 +227,28 @@ public:
     bool useHACD;                           // Hierarchical Approximate Convex Decomposition
     double collisionMargin;
     bool usefeatherstoneAlgorithm;
+    int numThreads;
+    bool isIslandParallelSolvingEnabled;
+    bool isMultiThreaded;
+    // The number of the threads actually used by the current or last simulation
+    int numThreadsInUse;
+
+    double collisionTime;
+    double stepTime;
+    QElapsedTimer stepTimer;
+    int numSteps;
+    // The average times of the last simulation in milliseconds per step
+    double averageCollisionTime;
+    double averageDynamicsTime;
 
     BulletSimulatorItemImpl(BulletSimulatorItem* self);
     BulletSimulatorItemImpl(BulletSimulatorItem* self, const BulletSimulatorItemImpl& org);
     ~BulletSimulatorItemImpl();
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
+    bool initializeTaskScheduler();
+    void createDynamicsWorld();
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
+    void finalizeSimulation();
     void doPutProperties(PutPropertyFunction& putProperty);
     void store(Archive& archive);
     void restore(const Archive& archive);
@@ -1312,7 +1400,8 @@ BulletSimulatorItemImpl::BulletSimulatorItemImpl(BulletSimulatorItem* self)
     useHACD = false;
     collisionMargin = DEFAULT_COLLISION_MARGIN;
     usefeatherstoneAlgorithm = true;
-
+    numThreads = 1;
+    isIslandParallelSolvingEnabled = true;
 }
 
 
@@ -1337,7 +1426,8 @@ BulletSimulatorItemImpl::BulletSimulatorItemImpl(BulletSimulatorItem* self, cons
     useHACD = org.useHACD;
     collisionMargin = org.collisionMargin;
     usefeatherstoneAlgorithm = org.usefeatherstoneAlgorithm;
-
+    numThreads = org.numThreads;
+    isIslandParallelSolvingEnabled = org.isIslandParallelSolvingEnabled;
 }
 
 void BulletSimulatorItemImpl::initialize()
@@ -1346,7 +1436,12 @@ void BulletSimulatorItemImpl::initialize()
     dispatcher = 0;
     broadphase = 0;
     solver =0;
+    solverMt = 0;
     dynamicsWorld = 0;
+    isMultiThreaded = false;
+    numThreadsInUse = 1;
+    averageCollisionTime = 0.0;
+    averageDynamicsTime = 0.0;
 
     gContactAddedCallback = 0;
 
@@ -1399,19 +1494,12 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
 {
     clear();
 
-    collisionConfiguration = new btDefaultCollisionConfiguration();
-    dispatcher = new btCollisionDispatcher(collisionConfiguration);
-    broadphase = new btDbvtBroadphase();
+    isMultiThreaded = initializeTaskScheduler();
+    createDynamicsWorld();
 
-    if(usefeatherstoneAlgorithm){
-        btMultiBodyConstraintSolver* solver_ = new btMultiBodyConstraintSolver;
-        solver = solver_;
-        dynamicsWorld = new btMultiBodyDynamicsWorld(dispatcher,broadphase,solver_,collisionConfiguration);
-    }else{
-        solver = new btSequentialImpulseConstraintSolver();
-        dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
-        self->setAllLinkPositionOutputMode(true);
-    }
+    collisionTime = 0.0;
+    stepTime = 0.0;
+    numSteps = 0;
 
     btVector3 g(gravity.x(), gravity.y(), gravity.z());
     dynamicsWorld->setGravity(g);
@@ -1434,18 +1522,115 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
     return true;
 }
 
+bool BulletSimulatorItemImpl::initializeTaskScheduler()
+{
+#ifdef BT_VER_GT_287
+    if(isMultiThreaded){
+        releaseMultiThreadedTaskScheduler();
+        isMultiThreaded = false;
+    }
+    numThreadsInUse = 1;
+    if(numThreads >= 2){
+        auto scheduler = getMultiThreadedTaskScheduler();
+        if(!scheduler){
+            MessageOut::master()->putWarningln(
+                format(_("The multi-threaded simulation of {0} is not available because Bullet is built without "
+                         "the BT_THREADSAFE option. The simulation is processed by a single thread."),
+                       self->displayName()));
+        } else {
+            int n = acquireMultiThreadedTaskScheduler(scheduler, numThreads);
+            if(n > 0){
+                numThreadsInUse = n;
+                return true;
+            }
+            MessageOut::master()->putWarningln(
+                format(_("The multi-threaded simulation of {0} is not available because the task scheduler "
+                         "of Bullet is used by another simulation. The simulation is processed by a single thread."),
+                       self->displayName()));
+        }
+    }
+#else
+    if(numThreads >= 2){
+        MessageOut::master()->putWarningln(
+            format(_("The multi-threaded simulation of {0} requires Bullet 2.88 or later. "
+                     "The simulation is processed by a single thread."),
+                   self->displayName()));
+    }
+#endif
+    return false;
+}
+
+
+/**
+   In the multi-threaded mode, the narrow phase collision detection is processed in parallel by
+   btCollisionDispatcherMt. When the Featherstone algorithm is not used, btDiscreteDynamicsWorldMt
+   also processes the islands in parallel if the island parallel solving is enabled, and otherwise
+   the constraints of each island are solved in parallel by btSequentialImpulseConstraintSolverMt.
+   The multi-body dynamics world of the Featherstone algorithm does not have a multi-threaded version.
+*/
+void BulletSimulatorItemImpl::createDynamicsWorld()
+{
+    collisionConfiguration = new btDefaultCollisionConfiguration();
+    broadphase = new btDbvtBroadphase();
+
+#ifdef BT_VER_GT_287
+    if(isMultiThreaded){
+        dispatcher = new TimeMeasuredDispatcher<btCollisionDispatcherMt>(collisionConfiguration, collisionTime);
+        if(!usefeatherstoneAlgorithm){
+            auto solverPool = new btConstraintSolverPoolMt(numThreadsInUse);
+            solver = solverPool;
+            solverMt = new btSequentialImpulseConstraintSolverMt;
+            auto world = new btDiscreteDynamicsWorldMt(
+                dispatcher, broadphase, solverPool, solverMt, collisionConfiguration);
+            auto islandManager = static_cast<btSimulationIslandManagerMt*>(world->getSimulationIslandManager());
+            if(isIslandParallelSolvingEnabled){
+                islandManager->setIslandDispatchFunction(btSimulationIslandManagerMt::parallelIslandDispatch);
+            } else {
+                islandManager->setIslandDispatchFunction(btSimulationIslandManagerMt::serialIslandDispatch);
+            }
+            dynamicsWorld = world;
+            self->setAllLinkPositionOutputMode(true);
+            return;
+        }
+    }
+#endif
+    if(!dispatcher){
+        dispatcher = new TimeMeasuredDispatcher<btCollisionDispatcher>(collisionConfiguration, collisionTime);
+    }
+
+    if(usefeatherstoneAlgorithm){
+        btMultiBodyConstraintSolver* solver_ = new btMultiBodyConstraintSolver;
+        solver = solver_;
+        dynamicsWorld = new btMultiBodyDynamicsWorld(dispatcher,broadphase,solver_,collisionConfiguration);
+    }else{
+        solver = new btSequentialImpulseConstraintSolver();
+        dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
+        self->setAllLinkPositionOutputMode(true);
+    }
+}
+
+
 void BulletSimulatorItemImpl::clear()
 {
     if(dynamicsWorld)
         delete dynamicsWorld;
     if(solver)
         delete solver;
+    if(solverMt)
+        delete solverMt;
     if(dispatcher)
         delete dispatcher;
     if(collisionConfiguration)
         delete collisionConfiguration;
     if(broadphase)
         delete broadphase;
+
+    dynamicsWorld = 0;
+    solver = 0;
+    solverMt = 0;
+    dispatcher = 0;
+    collisionConfiguration = 0;
+    broadphase = 0;
 }
 
 void BulletSimulatorItemImpl::addBody(BulletBody* bulletBody, short group)
@@ -1493,8 +1678,14 @@ bool BulletSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>&
         bulletBody->setControlValToBullet();
     }
 
-    //dynamicsWorld->stepSimulation(timeStep,2,timeStep/2.);
-    dynamicsWorld->stepSimulation(timeStep,1,timeStep);
+    {
+        CNOID_TRACE_ZONE("Bullet world step");
+        stepTimer.start();
+        //dynamicsWorld->stepSimulation(timeStep,2,timeStep/2.);
+        dynamicsWorld->stepSimulation(timeStep,1,timeStep);
+        stepTime += stepTimer.nsecsElapsed();
+        ++numSteps;
+    }
 
 #if DEBUG_OUT
     int numManifolds = dispatcher->getNumManifolds();
@@ -1534,6 +1725,52 @@ bool BulletSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>&
 }
 
 
+void BulletSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void BulletSimulatorItemImpl::finalizeSimulation()
+{
+    if(numSteps > 0){
+        averageCollisionTime = collisionTime * 1.0e-6 / numSteps;
+        averageDynamicsTime = (stepTime - collisionTime) * 1.0e-6 / numSteps;
+        self->notifyUpdate();
+    }
+#ifdef BT_VER_GT_287
+    if(isMultiThreaded){
+        releaseMultiThreadedTaskScheduler();
+        isMultiThreaded = false;
+    }
+#endif
+}
+
+
+void BulletSimulatorItem::setNumThreads(int n)
+{
+    impl->numThreads = std::max(1, n);
+}
+
+
+void BulletSimulatorItem::setIslandParallelSolvingEnabled(bool on)
+{
+    impl->isIslandParallelSolvingEnabled = on;
+}
+
+
+double BulletSimulatorItem::averageCollisionDetectionTime() const
+{
+    return impl->averageCollisionTime;
+}
+
+
+double BulletSimulatorItem::averageDynamicsTime() const
+{
+    return impl->averageDynamicsTime;
+}
+
+
 void BulletSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     SimulatorItem::doPutProperties(putProperty);
@@ -1555,6 +1792,13 @@ void BulletSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("use HACD"), useHACD, changeProperty(useHACD));
     putProperty(_("Collision Margin"), collisionMargin, changeProperty(collisionMargin));
     putProperty(_("use Featherstone Algorithm"), usefeatherstoneAlgorithm, changeProperty(usefeatherstoneAlgorithm));
+    putProperty.min(1).max(256);
+    putProperty(_("Threads"), numThreads, changeProperty(numThreads));
+    putProperty(_("Parallel island solving"), isIslandParallelSolvingEnabled,
+                changeProperty(isIslandParallelSolvingEnabled));
+    putProperty(_("Threads in use"), numThreadsInUse);
+    putProperty(_("Collision detection time [ms/step]"), format("{:.4f}", averageCollisionTime));
+    putProperty(_("Dynamics time [ms/step]"), format("{:.4f}", averageDynamicsTime));
 }
 
 
@@ -1577,6 +1821,8 @@ void BulletSimulatorItemImpl::store(Archive& archive)
     archive.write("useHACD", useHACD);
     archive.write("CollisionMargin", collisionMargin);
     archive.write("usefeatherstoneAlgorithm", usefeatherstoneAlgorithm);
+    archive.write("numThreads", numThreads);
+    archive.write("islandParallelSolving", isIslandParallelSolvingEnabled);
 }
 
 
@@ -1599,6 +1845,8 @@ void BulletSimulatorItemImpl::restore(const Archive& archive)
     archive.read("useHACD", useHACD);
     archive.read("CollisionMargin", collisionMargin);
     archive.read("usefeatherstoneAlgorithm", usefeatherstoneAlgorithm);
+    archive.read("numThreads", numThreads);
+    archive.read("islandParallelSolving", isIslandParallelSolvingEnabled);
 }
 
 void BulletSimulatorItemImpl::setSolverParameter()
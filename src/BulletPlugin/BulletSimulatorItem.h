@@ -18,6 +18,17 @@ public:
     virtual ~BulletSimulatorItem();
     virtual Vector3 getGravity() const override;
 
+    /**
+       The collision detection and the constraint solving are processed by multiple threads when
+       the number of threads is more than one. This requires Bullet built with the BT_THREADSAFE option.
+    */
+    void setNumThreads(int n);
+    void setIslandParallelSolvingEnabled(bool on);
+
+    //! The average computation time of the last simulation in milliseconds per step
+    double averageCollisionDetectionTime() const;
+    double averageDynamicsTime() const;
+
 //    virtual void setAllLinkPositionOutputMode(bool on);
 
 protected:
@@ -26,6 +37,7 @@ protected:
     virtual bool initializeSimulation(const std::vector<SimulationBody*>& simBodies) override;
     virtual void initializeSimulationThread() override;
     virtual bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies) override;
+    virtual void finalizeSimulation() override;
         
     virtual Item* doCloneItem(CloneMap* cloneMap) const override;
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
@@ -11,12 +11,14 @@
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
 #include <cnoid/EigenUtil>
+#include <cnoid/ViewFrustum>
 #include <cnoid/NullOut>
 #include <fmt/format.h>
-#include <GL/glu.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <deque>
+#include <algorithm>
+#include <tuple>
 #include <mutex>
 #include <regex>
 #include <stdexcept>
@@ -39,6 +41,20 @@ constexpr int DepthTextureUnit = 0;
 constexpr int ImageTextureUnit = 1;
 constexpr int ShadowMapTextureUnit = 2;
 
+/*
+  The resources of the nodes culled by the view frustum are not marked as used,
+  so the unused resource check is done without the culling at this interval.
+*/
+constexpr unsigned int UnusedResourceCheckIntervalWithViewFrustumCulling = 64;
+
+constexpr int MinNumShapesForInstancing = 4;
+
+/*
+  The data of each instance consists of the model matrix and the normal matrix,
+  which are stored in the column major order.
+*/
+constexpr int NumInstanceDataElements = 16 + 9;
+
 typedef vector<Affine3, Eigen::aligned_allocator<Affine3>> Affine3Array;
 
 std::mutex extensionMutex;
@@ -97,6 +113,18 @@ public:
     SgLineSetPtr normalVisualization;
     ScopedConnection connection;
 
+    // Instance data buffers for the instanced rendering of the shapes sharing the mesh
+    struct InstanceBuffer
+    {
+        GLuint buffer;
+        size_t capacity;
+        vector<float> data;
+        InstanceBuffer() : buffer(0), capacity(0) { }
+    };
+    vector<InstanceBuffer> instanceBuffers;
+    int numUsedInstanceBuffers;
+    unsigned int instanceBufferFrameId;
+
     VertexResource(const VertexResource&) = delete;
     VertexResource& operator=(const VertexResource&) = delete;
 
@@ -105,6 +133,8 @@ public:
         clearHandles();
         glGenVertexArrays(1, &vao);
         pLocalTransform = nullptr;
+        numUsedInstanceBuffers = 0;
+        instanceBufferFrameId = 0;
 
         connection =
             obj->sigUpdated().connect(
@@ -118,6 +148,7 @@ public:
         }
         numBuffers = 0;
         numVertices = 0;
+        instanceBuffers.clear();
     }
 
     virtual void discard() override { clearHandles(); }
@@ -152,8 +183,74 @@ public:
         return vbos[index];
     }
 
+    /**
+       The buffers are used in order in each frame, and each buffer is only updated
+       when the data differs from the one of the previous frame.
+    */
+    void bindInstanceBuffer(const vector<float>& data, unsigned int frameId){
+        if(frameId != instanceBufferFrameId){
+            instanceBufferFrameId = frameId;
+            numUsedInstanceBuffers = 0;
+        }
+        if(numUsedInstanceBuffers == static_cast<int>(instanceBuffers.size())){
+            instanceBuffers.emplace_back();
+        }
+        auto& instances = instanceBuffers[numUsedInstanceBuffers++];
+        
+        glBindVertexArray(vao);
+        LockVertexArrayAPI lock;
+        if(!instances.buffer){
+            glGenBuffers(1, &instances.buffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+        const size_t size = data.size() * sizeof(float);
+        if(data.size() > instances.capacity){
+            glBufferData(GL_ARRAY_BUFFER, size, data.data(), GL_DYNAMIC_DRAW);
+            instances.capacity = data.size();
+            instances.data = data;
+        } else if(data != instances.data){
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, data.data());
+            instances.data = data;
+        }
+        const GLsizei stride = NumInstanceDataElements * sizeof(float);
+        for(int i=0; i < 4; ++i){
+            const GLuint location = ShaderProgram::InstanceModelMatrixLocation + i;
+            glVertexAttribPointer(
+                location, 4, GL_FLOAT, GL_FALSE, stride, ((GLubyte*)NULL + i * 4 * sizeof(float)));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+        for(int i=0; i < 3; ++i){
+            const GLuint location = ShaderProgram::InstanceNormalMatrixLocation + i;
+            glVertexAttribPointer(
+                location, 3, GL_FLOAT, GL_FALSE, stride, ((GLubyte*)NULL + (16 + i * 3) * sizeof(float)));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+    }
+
+    //! The instance attributes are disabled so that they do not affect the non-instanced draws
+    void unbindInstanceBuffer(){
+        LockVertexArrayAPI lock;
+        for(int i=0; i < 4; ++i){
+            const GLuint location = ShaderProgram::InstanceModelMatrixLocation + i;
+            glDisableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 0);
+        }
+        for(int i=0; i < 3; ++i){
+            const GLuint location = ShaderProgram::InstanceNormalMatrixLocation + i;
+            glDisableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 0);
+        }
+    }
+
     ~VertexResource() {
         deleteBuffers();
+        for(auto& instances : instanceBuffers){
+            if(instances.buffer){
+                glDeleteBuffers(1, &instances.buffer);
+            }
+        }
         if(vao){
             glDeleteVertexArrays(1, &vao);
         }
@@ -361,6 +458,21 @@ public:
     bool isBoundingBoxRenderingMode;
     bool isBoundingBoxRenderingForLightweightRenderingGroupEnabled;
 
+    ViewFrustum viewFrustum;
+    bool isViewFrustumCullingEnabled;
+    bool isViewFrustumCullingAvailable;
+    bool isViewFrustumCullingActive;
+    bool isInsideViewFrustum;
+    bool isDrawListSortingEnabled;
+    bool isInstancingEnabled;
+    bool isPendingImageWaitEnabled;
+    bool isRenderingSortedOpaqueShapes;
+    // Opaque shapes are deferred and sorted while this program is the current one
+    ShaderProgram* programForSortedRendering;
+    TextureResource* lastImageTextureResource;
+    const SgMaterial* lastMaterial;
+    RenderingStatistics statistics;
+
     Affine3Array modelMatrixStack; // stack of the model matrices
     Affine3Array modelMatrixBuffer; // Model matrices used later are stored in this buffer
     Isometry3 viewTransform;
@@ -379,6 +491,20 @@ public:
     };
     vector<DispatchedNodeInfo> pureWireframeRenderingNodes;
     vector<DispatchedNodeInfo> vertexRenderingNodes;
+
+    struct OpaqueShapeInfo
+    {
+        SgShapePtr shape;
+        SgImage* image;
+        const SgMaterial* material;
+        SgMesh* mesh;
+        int modelMatrixIndex;
+        OpaqueShapeInfo(SgShape* shape, SgImage* image, int modelMatrixIndex)
+            : shape(shape), image(image), material(shape->material()), mesh(shape->mesh()),
+              modelMatrixIndex(modelMatrixIndex) { }
+    };
+    vector<OpaqueShapeInfo> opaqueShapes;
+    vector<float> instanceData;
         
     deque<function<void()>> transparentRenderingQueue;
     deque<function<void()>> overlayRenderingQueue;
@@ -411,7 +537,6 @@ public:
     bool hasValidNextResourceMap;
     bool isResourceClearRequested;
 
-    vector<char> scaledImageBuf;
 
     bool isTextureEnabled;
     bool isTextureBeingRendered;
@@ -507,6 +632,9 @@ public:
     void renderChildNodes(SgGroup* group);
     void renderChildNodesWithNodeDecorationCheck(SgGroup* group);
     void renderGroup(SgGroup* group);
+    bool checkViewFrustum(SgGroup* group);
+    bool isOutsideViewFrustum(const BoundingBox& bbox);
+    void renderGroupWithViewFrustumCheck(SgGroup* group);
     void renderTransform(SgTransform* transform);
     void renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup);
     void renderSwitchableGroup(SgSwitchableGroup* group);
@@ -518,6 +646,10 @@ public:
     void drawBoundingBox(VertexResource* resource, const BoundingBox& bbox);
     void renderShape(SgShape* shape);
     void renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex);
+    void renderShapeAppearance(SgShape* shape);
+    void renderSortedOpaqueShapes();
+    void renderShapeInstances(
+        vector<OpaqueShapeInfo>::iterator begin, vector<OpaqueShapeInfo>::iterator end);
     void applyCullingMode(SgMesh* mesh);
     void renderShapeVertices(SgShape* shape);
     void renderPlot(
@@ -659,7 +791,7 @@ void GLSLSceneRenderer::Impl::initialize()
     os_ = &nullout();
 
     normalRenderingFunctions.setFunction<SgGroup>(
-        [&](SgGroup* node){ renderGroup(node); });
+        [&](SgGroup* node){ renderGroupWithViewFrustumCheck(node); });
     normalRenderingFunctions.setFunction<SgTransform>(
         [&](SgTransform* node){ renderTransform(node); });
     normalRenderingFunctions.setFunction<SgFixedPixelSizeGroup>(
@@ -708,6 +840,19 @@ void GLSLSceneRenderer::Impl::initialize()
     isBoundingBoxRenderingMode = false;
     isBoundingBoxRenderingForLightweightRenderingGroupEnabled = false;
 
+    isViewFrustumCullingEnabled = true;
+    isViewFrustumCullingAvailable = false;
+    isViewFrustumCullingActive = false;
+    isInsideViewFrustum = false;
+    isDrawListSortingEnabled = true;
+    isInstancingEnabled = true;
+    isPendingImageWaitEnabled = false;
+    isRenderingSortedOpaqueShapes = false;
+    programForSortedRendering = nullptr;
+    lastImageTextureResource = nullptr;
+    lastMaterial = nullptr;
+    statistics = RenderingStatistics();
+
     defaultFBO = 0;
     
     lightingMode = NormalLighting;
@@ -1263,6 +1408,9 @@ void GLSLSceneRenderer::Impl::doRender()
 
     beginRendering();
 
+    statistics = RenderingStatistics();
+    lastMaterial = nullptr;
+
     isLightweightRenderingBeingProcessed = false;
     isLowMemoryConsumptionRenderingBeingProcessed = isLowMemoryConsumptionMode;
     isTextureBeingRendered = false;
@@ -1305,7 +1453,19 @@ void GLSLSceneRenderer::Impl::doRender()
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+        if(isDrawListSortingEnabled && !isLightweightRenderingBeingProcessed){
+            programForSortedRendering = currentProgram;
+        }
+        isViewFrustumCullingActive = isViewFrustumCullingAvailable;
+        isInsideViewFrustum = false;
+
         renderChildNodes(self->sceneRoot());
+
+        isViewFrustumCullingActive = false;
+        programForSortedRendering = nullptr;
+        if(!opaqueShapes.empty()){
+            renderSortedOpaqueShapes();
+        }
         
         /*
           \todo Render transparent objects directly
@@ -1439,6 +1599,9 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
     isRenderingPickingImage = true;
     isRenderingVisibleImage = false;
     beginRendering();
+
+    // The statistics are only updated by the rendering of the visible image
+    const RenderingStatistics statistics0 = statistics;
     
     pushProgram(solidColorProgram);
     currentNodePath.clear();
@@ -1455,7 +1618,11 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
         
         transparentRenderingQueue.clear();
         overlayRenderingQueue.clear();
+
+        isViewFrustumCullingActive = isViewFrustumCullingAvailable;
+        isInsideViewFrustum = false;
         renderChildNodes(self->sceneRoot());
+        isViewFrustumCullingActive = false;
 
         if(!transparentRenderingQueue.empty()){
             renderTransparentObjects();
@@ -1467,6 +1634,7 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
 
     popProgram();
     isRenderingPickingImage = false;
+    statistics = statistics0;
 
     if(!isPickingImageOutputEnabled){
         glDisable(GL_SCISSOR_TEST);
@@ -1556,7 +1724,11 @@ bool GLSLSceneRenderer::Impl::renderShadowMap(SgLight* light, const Isometry3& T
             renderCamera(shadowMapCamera, Tc);
             fullLightingProgram->setShadowMapViewProjection(PV);
             fullLightingProgram->shadowMapProgram()->initializeShadowMapBuffer();
+
+            isViewFrustumCullingActive = isViewFrustumCullingAvailable;
+            isInsideViewFrustum = false;
             renderChildNodes(self->sceneRoot());
+            isViewFrustumCullingActive = false;
 
             if(USE_GL_FLUSH_FUNCTION_IN_SHADOW_MAP_RENDERING){
                 glFlush();
@@ -1597,6 +1769,7 @@ void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& ca
         viewTransform = cameraPosition.inverse(Eigen::Isometry);
     }
     PV = projectionMatrix * viewTransform.matrix();
+    viewFrustum.setProjectionViewMatrix(PV);
 
     modelMatrixStack.clear();
     modelMatrixStack.push_back(Affine3::Identity());
@@ -1614,6 +1787,11 @@ void GLSLSceneRenderer::Impl::beginRendering()
     self->extractPreprocessedNodes();
 
     isCheckingUnusedResources = isRenderingPickingImage ? false : doUnusedResourceCheck;
+    if(isCheckingUnusedResources && isViewFrustumCullingEnabled){
+        isCheckingUnusedResources =
+            (renderingFrameId % UnusedResourceCheckIntervalWithViewFrustumCulling == 0);
+    }
+    isViewFrustumCullingAvailable = isViewFrustumCullingEnabled && !isCheckingUnusedResources;
 
     if(isResourceClearRequested){
         clearResourceMap();
@@ -2079,6 +2257,55 @@ void GLSLSceneRenderer::Impl::renderGroup(SgGroup* group)
 }
 
 
+/**
+   \return false if the group is outside of the view frustum.
+   isInsideViewFrustum is set to true if the group is entirely inside of it.
+*/
+bool GLSLSceneRenderer::Impl::checkViewFrustum(SgGroup* group)
+{
+    auto& bbox = group->boundingBox();
+    if(!bbox){
+        return true;
+    }
+    auto intersection = viewFrustum.checkBoundingBox(bbox, modelMatrixStack.back());
+    if(intersection == ViewFrustum::Inside){
+        isInsideViewFrustum = true;
+
+    } else if(intersection == ViewFrustum::Outside){
+        // The bounding box does not cover the markers and the unbounded nodes in the group
+        if(group->hasAttribute(SgNode::Unbounded) || group->hasUnboundedNodes()){
+            return true;
+        }
+        ++statistics.numCulledNodes;
+        return false;
+    }
+    return true;
+}
+
+
+bool GLSLSceneRenderer::Impl::isOutsideViewFrustum(const BoundingBox& bbox)
+{
+    if(isViewFrustumCullingActive && !isInsideViewFrustum && bbox){
+        if(viewFrustum.checkBoundingBox(bbox, modelMatrixStack.back()) == ViewFrustum::Outside){
+            ++statistics.numCulledNodes;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void GLSLSceneRenderer::Impl::renderGroupWithViewFrustumCheck(SgGroup* group)
+{
+    if(!isViewFrustumCullingActive || isInsideViewFrustum){
+        renderGroup(group);
+    } else if(checkViewFrustum(group)){
+        renderGroup(group);
+        isInsideViewFrustum = false;
+    }
+}
+
+
 void GLSLSceneRenderer::renderCustomGroup(SgGroup* group, std::function<void()> traverseFunction)
 {
     impl->pushPickNode(group);
@@ -2106,6 +2333,13 @@ void GLSLSceneRenderer::Impl::renderUnpickableGroup(SgUnpickableGroup* group)
 void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
 {
     if(!transform->empty()){
+        const bool wasInsideViewFrustum = isInsideViewFrustum;
+        if(isViewFrustumCullingActive && !isInsideViewFrustum){
+            // The bounding box of the transform node is represented in the parent coordinate
+            if(!checkViewFrustum(transform)){
+                return;
+            }
+        }
         Affine3 T;
         transform->getTransform(T);
         modelMatrixStack.push_back(modelMatrixStack.back() * T);
@@ -2115,6 +2349,7 @@ void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
 
         popPickNode();
         modelMatrixStack.pop_back();
+        isInsideViewFrustum = wasInsideViewFrustum;
     }
 }
 
@@ -2179,6 +2414,7 @@ void GLSLSceneRenderer::Impl::drawVertexResource
     currentProgram->setTransform(PV, viewTransform, modelTransform, resource->pLocalTransform);
     glBindVertexArray(resource->vao);
     glDrawArrays(primitiveMode, 0, resource->numVertices);
+    ++statistics.numDrawCalls;
 }
 
 
@@ -2221,6 +2457,9 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 {
     SgMesh* mesh = shape->mesh();
     if(mesh && mesh->hasVertices()){
+        if(isOutsideViewFrustum(mesh->boundingBox())){
+            return;
+        }
         SgMaterial* material = shape->material();
         bool isTransparent = false;
         if(currentProgram->hasCapability(ShaderProgram::Transparency)){
@@ -2229,9 +2468,22 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
             }
         }
         if(!isTransparent){
-            auto pickIndex = pushPickEndNode(shape, false);
-            renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
-            popPickNode();
+            if(currentProgram == programForSortedRendering &&
+               solidWireframeStyleStack.empty() && !isBoundingBoxRenderingMode){
+                SgImage* image = nullptr;
+                if(isTextureBeingRendered){
+                    if(auto texture = shape->texture()){
+                        image = texture->image();
+                    }
+                }
+                int matrixIndex = modelMatrixBuffer.size();
+                modelMatrixBuffer.push_back(modelMatrixStack.back());
+                opaqueShapes.emplace_back(shape, image, matrixIndex);
+            } else {
+                auto pickIndex = pushPickEndNode(shape, false);
+                renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
+                popPickNode();
+            }
         } else {
             if(!isRenderingShadowMap){
                 SgShapePtr shapePtr = shape;
@@ -2255,20 +2507,7 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
     if(isRenderingPickingImage){
         setPickColor(pickIndex);
     } else {
-        renderMaterial(shape->material());
-        if(mesh->hasColors()){
-            currentProgram->setVertexColorEnabled(true);
-        }
-
-        if(currentMaterialLightingProgram){
-            bool isTextureValid = false;
-            if(isTextureBeingRendered){
-                if(auto texture = shape->texture()){
-                    isTextureValid = renderTexture(texture);
-                }
-            }
-            currentMaterialLightingProgram->setTextureEnabled(isTextureValid);
-        }
+        renderShapeAppearance(shape);
     }
 
     VertexResource* resource = getOrCreateVertexResource(mesh);
@@ -2290,6 +2529,113 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
 }
 
 
+void GLSLSceneRenderer::Impl::renderShapeAppearance(SgShape* shape)
+{
+    renderMaterial(shape->material());
+    if(shape->mesh()->hasColors()){
+        currentProgram->setVertexColorEnabled(true);
+    }
+
+    if(currentMaterialLightingProgram){
+        bool isTextureValid = false;
+        if(isTextureBeingRendered){
+            if(auto texture = shape->texture()){
+                isTextureValid = renderTexture(texture);
+            }
+        }
+        currentMaterialLightingProgram->setTextureEnabled(isTextureValid);
+    }
+}
+
+
+/**
+   The opaque shapes are sorted so that the shapes sharing the same texture and material
+   are rendered successively to reduce the state changes. The shapes that also share
+   the same mesh are rendered with an instanced draw call if the program supports it.
+*/
+void GLSLSceneRenderer::Impl::renderSortedOpaqueShapes()
+{
+    std::stable_sort(
+        opaqueShapes.begin(), opaqueShapes.end(),
+        [](const OpaqueShapeInfo& info1, const OpaqueShapeInfo& info2){
+            return std::tie(info1.image, info1.material, info1.mesh) <
+                std::tie(info2.image, info2.material, info2.mesh); });
+
+    const bool isInstancingAvailable =
+        isInstancingEnabled && currentProgram->hasCapability(ShaderProgram::Instancing) &&
+        !isNormalVisualizationEnabled;
+
+    isRenderingSortedOpaqueShapes = true;
+    auto p = opaqueShapes.begin();
+    while(p != opaqueShapes.end()){
+        auto q = p + 1;
+        if(isInstancingAvailable){
+            while(q != opaqueShapes.end() &&
+                  q->image == p->image && q->material == p->material && q->mesh == p->mesh){
+                ++q;
+            }
+        }
+        if(q - p >= MinNumShapesForInstancing){
+            renderShapeInstances(p, q);
+        } else {
+            for(auto r = p; r != q; ++r){
+                renderShapeMain(r->shape, modelMatrixBuffer[r->modelMatrixIndex], 0);
+            }
+        }
+        p = q;
+    }
+    isRenderingSortedOpaqueShapes = false;
+    lastImageTextureResource = nullptr;
+
+    opaqueShapes.clear();
+}
+
+
+void GLSLSceneRenderer::Impl::renderShapeInstances
+(vector<OpaqueShapeInfo>::iterator begin, vector<OpaqueShapeInfo>::iterator end)
+{
+    auto shape = begin->shape.get();
+    auto mesh = shape->mesh();
+    VertexResource* resource = getOrCreateVertexResource(mesh);
+    if(!resource->isValid()){
+        makeVertexBufferObjects(shape, resource);
+    }
+    // The local transform of the normalized integer vertices cannot be applied to the instances
+    if(resource->pLocalTransform || !resource->isValid()){
+        for(auto p = begin; p != end; ++p){
+            renderShapeMain(p->shape, modelMatrixBuffer[p->modelMatrixIndex], 0);
+        }
+        return;
+    }
+
+    renderShapeAppearance(shape);
+    applyCullingMode(mesh);
+
+    const int numInstances = end - begin;
+    instanceData.resize(numInstances * NumInstanceDataElements);
+    float* data = instanceData.data();
+    for(auto p = begin; p != end; ++p){
+        const Affine3& T = modelMatrixBuffer[p->modelMatrixIndex];
+        Eigen::Map<Matrix4f> M(data);
+        M = T.matrix().cast<float>();
+        // The normals must be transformed by the inverse transpose for the non-uniform scaling
+        Eigen::Map<Matrix3f> N(data + 16);
+        N = T.linear().inverse().transpose().cast<float>();
+        data += NumInstanceDataElements;
+    }
+    resource->bindInstanceBuffer(instanceData, renderingFrameId);
+
+    currentProgram->setTransform(PV, viewTransform, Affine3::Identity(), nullptr);
+    currentProgram->setInstancingEnabled(true);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, resource->numVertices, numInstances);
+    currentProgram->setInstancingEnabled(false);
+    resource->unbindInstanceBuffer();
+
+    ++statistics.numDrawCalls;
+    statistics.numInstancedShapes += numInstances;
+}
+
+
 void GLSLSceneRenderer::Impl::applyCullingMode(SgMesh* mesh)
 {
     if(!stateFlag[CULL_FACE]){
@@ -2332,22 +2678,41 @@ void GLSLSceneRenderer::Impl::applyCullingMode(SgMesh* mesh)
 
 void GLSLSceneRenderer::Impl::renderMaterial(const SgMaterial* material)
 {
-    currentProgram->setMaterial(material ? material : defaultMaterial);
+    if(!material){
+        material = defaultMaterial;
+    }
+    if(material != lastMaterial){
+        ++statistics.numMaterialChanges;
+        lastMaterial = material;
+    }
+    currentProgram->setMaterial(material);
 }
 
 
 bool GLSLSceneRenderer::Impl::renderTexture(SgTexture* texture)
 {
     SgImage* sgImage = texture->image();
-    if(!sgImage || sgImage->empty()){
+    /*
+      The shape is rendered without the texture until the image being decoded by another thread
+      is ready unless the pending image wait is enabled. The update of the image is notified when
+      it gets ready. Note that SgImage::empty blocks until the image is ready.
+    */
+    if(!sgImage || (!isPendingImageWaitEnabled && sgImage->isPending()) || sgImage->empty()){
         return false;
     }
 
     auto resource = getOrCreateGLResource<TextureResource>(sgImage);
     if(resource->isLoaded){
-        glActiveTexture(GL_TEXTURE0 + ImageTextureUnit);
-        glBindTexture(GL_TEXTURE_2D, resource->textureId);
-        glBindSampler(ImageTextureUnit, resource->samplerId);
+        // The texture is kept bound while the sorted shapes sharing it are rendered
+        if(resource != lastImageTextureResource){
+            glActiveTexture(GL_TEXTURE0 + ImageTextureUnit);
+            glBindTexture(GL_TEXTURE_2D, resource->textureId);
+            glBindSampler(ImageTextureUnit, resource->samplerId);
+            ++statistics.numTextureBindings;
+            if(isRenderingSortedOpaqueShapes){
+                lastImageTextureResource = resource;
+            }
+        }
         if(resource->isImageUpdateNeeded){
             loadTextureImage(resource, sgImage->constImage());
         }
@@ -2366,6 +2731,8 @@ bool GLSLSceneRenderer::Impl::renderTexture(SgTexture* texture)
             glSamplerParameteri(samplerId, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
             resource->samplerId = samplerId;
         }
+        ++statistics.numTextureBindings;
+        lastImageTextureResource = isRenderingSortedOpaqueShapes ? resource : nullptr;
     }
 
     return resource->isLoaded;
@@ -2399,20 +2766,8 @@ bool GLSLSceneRenderer::Impl::loadTextureImage(TextureResource* resource, const
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, image.pixels());
 
     } else {
-        double w2 = log2(width);
-        double h2 = log2(height);
-        double pw = ceil(w2);
-        double ph = ceil(h2);
-        if((pw - w2 == 0.0) && (ph - h2 == 0.0)){
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image.pixels());
-        } else{
-            GLsizei potWidth = pow(2.0, pw);
-            GLsizei potHeight = pow(2.0, ph);
-            scaledImageBuf.resize(potWidth * potHeight * image.numComponents());
-            gluScaleImage(format, width, height, GL_UNSIGNED_BYTE, image.pixels(),
-                          potWidth, potHeight, GL_UNSIGNED_BYTE, &scaledImageBuf.front());
-            glTexImage2D(GL_TEXTURE_2D, 0, format, potWidth, potHeight, 0, format, GL_UNSIGNED_BYTE, &scaledImageBuf.front());
-        }
+        // The textures of non-power-of-two sizes are supported by OpenGL 3.3 without scaling
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image.pixels());
         resource->isLoaded = true;
         resource->width = width;
         resource->height = height;
@@ -3616,3 +3971,57 @@ void GLSLSceneRenderer::setLowMemoryConsumptionMode(bool on)
         requestToClearResources();
     }
 }
+
+
+void GLSLSceneRenderer::setViewFrustumCullingEnabled(bool on)
+{
+    impl->isViewFrustumCullingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isViewFrustumCullingEnabled() const
+{
+    return impl->isViewFrustumCullingEnabled;
+}
+
+
+void GLSLSceneRenderer::setDrawListSortingEnabled(bool on)
+{
+    impl->isDrawListSortingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isDrawListSortingEnabled() const
+{
+    return impl->isDrawListSortingEnabled;
+}
+
+
+void GLSLSceneRenderer::setInstancingEnabled(bool on)
+{
+    impl->isInstancingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isInstancingEnabled() const
+{
+    return impl->isInstancingEnabled;
+}
+
+
+void GLSLSceneRenderer::setPendingImageWaitEnabled(bool on)
+{
+    impl->isPendingImageWaitEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isPendingImageWaitEnabled() const
+{
+    return impl->isPendingImageWaitEnabled;
+}
+
+
+const GLSLSceneRenderer::RenderingStatistics& GLSLSceneRenderer::renderingStatistics() const
+{
+    return impl->statistics;
+}
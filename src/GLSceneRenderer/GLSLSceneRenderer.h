@@ -89,6 +89,43 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
 
     void setLowMemoryConsumptionMode(bool on);
 
+    /**
+       The nodes outside the view volume are skipped by checking their bounding boxes.
+       Note that a node may be culled incorrectly if its bounding box is not updated.
+    */
+    void setViewFrustumCullingEnabled(bool on);
+    bool isViewFrustumCullingEnabled() const;
+
+    //! Opaque shapes are rendered after sorted by their textures and materials.
+    void setDrawListSortingEnabled(bool on);
+    bool isDrawListSortingEnabled() const;
+
+    /**
+       The sorted opaque shapes sharing the same mesh, material and texture are rendered
+       with an instanced draw call. This requires the draw list sorting.
+    */
+    void setInstancingEnabled(bool on);
+    bool isInstancingEnabled() const;
+
+    /**
+       The rendering waits for the texture images being decoded by other threads if this is enabled.
+       Otherwise the shapes are rendered without the textures until the images get ready, which
+       makes the rendered images depend on the decoding timing.
+    */
+    void setPendingImageWaitEnabled(bool on);
+    bool isPendingImageWaitEnabled() const;
+
+    struct RenderingStatistics
+    {
+        int numCulledNodes;
+        int numDrawCalls;
+        int numMaterialChanges;
+        int numTextureBindings;
+        int numInstancedShapes;
+    };
+    //! The statistics of the last rendering of the visible image
+    const RenderingStatistics& renderingStatistics() const;
+
     virtual void setPickingImageOutputEnabled(bool on) override;
     virtual bool getPickingImage(Image& out_image) override;
 
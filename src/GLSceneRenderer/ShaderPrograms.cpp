@@ -19,6 +19,8 @@ class ShaderProgram::Impl
 public:
     vector<ShaderSource> shaderSources;
     bool isActive;
+    GLint isInstancingEnabledLocation;
+    bool isInstancingEnabled;
     Impl(std::initializer_list<ShaderSource> sources);
 };
    
@@ -265,6 +267,8 @@ ShaderProgram::Impl::Impl(std::initializer_list<ShaderSource> sources)
     : shaderSources(sources)
 {
     isActive = false;
+    isInstancingEnabledLocation = -1;
+    isInstancingEnabled = false;
 }
 
 
@@ -282,6 +286,12 @@ void ShaderProgram::initialize()
     }
     glslProgram_->link();
     impl->isActive = false;
+
+    impl->isInstancingEnabledLocation = glslProgram_->getUniformLocation("isInstancingEnabled");
+    impl->isInstancingEnabled = false;
+    if(impl->isInstancingEnabledLocation >= 0){
+        setCapability(Instancing);
+    }
 }
 
 
@@ -296,6 +306,10 @@ void ShaderProgram::activate()
 {
     glslProgram_->use();
     impl->isActive = true;
+
+    if(impl->isInstancingEnabledLocation >= 0){
+        glUniform1i(impl->isInstancingEnabledLocation, impl->isInstancingEnabled);
+    }
 }
 
 
@@ -328,6 +342,17 @@ void ShaderProgram::setVertexColorEnabled(bool on)
 }
 
 
+void ShaderProgram::setInstancingEnabled(bool on)
+{
+    if(impl->isInstancingEnabledLocation >= 0 && on != impl->isInstancingEnabled){
+        impl->isInstancingEnabled = on;
+        if(impl->isActive){
+            glUniform1i(impl->isInstancingEnabledLocation, on);
+        }
+    }
+}
+
+
 NolightingProgram::NolightingProgram()
     : NolightingProgram(
         { { ":/GLSceneRenderer/shader/NoLighting.vert", GL_VERTEX_SHADER },
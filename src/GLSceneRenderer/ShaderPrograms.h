@@ -41,10 +41,23 @@ public:
     virtual void setMaterial(const SgMaterial* material);
     virtual void setVertexColorEnabled(bool on);
 
+    /**
+       The model matrix of each instance is given as the vertex attribute of the locations
+       from InstanceModelMatrixLocation to InstanceModelMatrixLocation + 3 when the instancing
+       is enabled, and the inverse transpose of its linear part is given as the vertex attribute
+       of the locations from InstanceNormalMatrixLocation to InstanceNormalMatrixLocation + 2.
+       The model matrix given by setTransform must be the identity in that case.
+       The instancing is available if the shader has the "isInstancingEnabled" uniform variable.
+    */
+    void setInstancingEnabled(bool on);
+    static constexpr int InstanceModelMatrixLocation = 4;
+    static constexpr int InstanceNormalMatrixLocation = 8;
+
     enum Capability {
         NoCapability = 0,
         Lighting = 1,
-        Transparency = 2
+        Transparency = 2,
+        Instancing = 4
     };
 
     int capabilities() const { return capabilities_; }
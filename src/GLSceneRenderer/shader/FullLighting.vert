@@ -6,6 +6,9 @@ layout (location = 0) in vec4 vertexPosition;
 layout (location = 1) in vec3 vertexNormal;
 layout (location = 2) in vec2 vertexTexCoord;
 layout (location = 3) in vec3 vertexColor;
+// The model matrix and the normal matrix of each instance in the instanced rendering
+layout (location = 4) in mat4 instanceModelMatrix;
+layout (location = 8) in mat3 instanceNormalMatrix;
 
 out VertexData {
     vec3 position;
@@ -35,18 +38,29 @@ uniform mat4 MVP;
 uniform mat3 normalMatrix;
 uniform int numShadows;
 uniform mat4 shadowMatrices[MAX_NUM_SHADOWS];
+uniform bool isInstancingEnabled;
 
 void main()
 {
-    outData.normal = normalize(normalMatrix * vertexNormal);
-    outData.position = vec3(modelViewMatrix * vertexPosition);
+    vec4 position;
+    vec3 normal;
+    if(isInstancingEnabled){
+        position = instanceModelMatrix * vertexPosition;
+        normal = instanceNormalMatrix * vertexNormal;
+    } else {
+        position = vertexPosition;
+        normal = vertexNormal;
+    }
+    
+    outData.normal = normalize(normalMatrix * normal);
+    outData.position = vec3(modelViewMatrix * position);
 
     outData.texCoord = vertexTexCoord;
     outData.colorV = vertexColor;
     
     for(int i=0; i < numShadows; ++i){
-        outData.shadowCoords[i] = shadowMatrices[i] * vertexPosition;
+        outData.shadowCoords[i] = shadowMatrices[i] * position;
     }
     
-    gl_Position = MVP * vertexPosition;
+    gl_Position = MVP * position;
 }
@@ -52,6 +52,8 @@ public:
     virtual void output() override { if(output_) output_(); }
 };
 
+enum ComparisonOperator { NoComparison, EqualTo, NotEqualTo, LessThan, GreaterThan, LessOrEqual, GreaterOrEqual };
+
 class OutputOnceFunctionProcessor : public Processor
 {
 public:
@@ -125,6 +127,39 @@ public:
     regex stringPattern;
     regex variablePattern; // for the default variable expression syntax
 
+    /*
+      The expressions of the statements are compiled in the initialization so that
+      they are not parsed in every control step.
+    */
+    struct Term {
+        enum Type { Constant, Variable, CustomVariable };
+        Type type;
+        MprVariable::Value value;
+        /*
+          The variable is looked up by the id in every evaluation because the variable lists
+          may be edited during the execution.
+        */
+        GeneralId variableId;
+        string label;
+    };
+    struct CompiledExpression {
+        // The reference keeps the address of the statement used as the key from being reused
+        MprStatementPtr statement;
+        vector<Term> terms;
+        vector<char> operators;
+        int comparisonOperator;
+        // Used for the assign statement
+        function<bool(MprVariable::Value value)> assignValue;
+        // An invalid expression is also kept so that it is not compiled again in every execution
+        bool isValid;
+        CompiledExpression() : comparisonOperator(NoComparison), isValid(false) { }
+    };
+    unordered_map<MprStatement*, CompiledExpression> compiledExpressions;
+
+    // Used to get the variable id of the default syntax parsed by evalExpressionAsVariableValue
+    bool isParsingVariableExpression;
+    GeneralId parsedVariableId;
+
     Impl(MprControllerItemBase* self);
     bool initialize(ControllerIO* io);
     bool createKinematicBodySetForInternalUse();
@@ -148,9 +183,13 @@ public:
     bool interpretIfStatement(MprIfStatement* statement);
     bool interpretWhileStatement(MprWhileStatement* statement);
     bool interpretCallStatement(MprCallStatement* statement);
-    stdx::optional<bool> evalConditionalExpression(const string& expression);
-    stdx::optional<MprVariable::Value> getTermValue(string::const_iterator& pos, string::const_iterator end);
-    stdx::optional<string> getComparisonOperator(string::const_iterator& pos, string::const_iterator end);
+    bool compileExpressions(MprProgram* program);
+    CompiledExpression* getCompiledExpression(MprStatement* statement);
+    bool compileConditionalExpression(const string& expression, CompiledExpression& out_expression);
+    bool compileAssignExpression(MprAssignStatement* statement, CompiledExpression& out_expression);
+    bool compileTerm(string::const_iterator& pos, string::const_iterator end, Term& out_term);
+    stdx::optional<MprVariable::Value> evalTerm(Term& term);
+    stdx::optional<bool> evalConditionalExpression(CompiledExpression& expression);
     bool interpretAssignStatement(MprAssignStatement* statement);
     bool applyBinaryOperation(MprVariable::Value& lhsValue, char op, const MprVariable::Value& rhsValue);
     bool interpretSetSignalStatement(MprSignalStatement* statement);
@@ -190,6 +229,7 @@ MprControllerItemBase::Impl::Impl(MprControllerItemBase* self)
     isActiveControlState = false;
     speedRatio = 1.0;
     currentLog = new MprControllerLog;
+    isParsingVariableExpression = false;
 }
 
 
@@ -347,6 +387,18 @@ bool MprControllerItemBase::Impl::initialize(ControllerIO* io)
         return false;
     }
 
+    bool compiled = compileExpressions(startupProgram);
+    for(auto& kv : otherProgramMap){
+        if(!compileExpressions(kv.second)){
+            compiled = false;
+        }
+    }
+    if(!compiled){
+        mv->putln(format(_("{} cannot be initialized due to invalid expressions in the programs."),
+                         self->displayName()), MessageView::Error);
+        return false;
+    }
+
     iterator = currentProgram->begin();
 
     auto body = io->body();
@@ -492,6 +544,11 @@ stdx::optional<MprVariable::Value> MprControllerItemBase::evalExpressionAsVariab
     if(regex_search(io_expressionBegin, expressionEnd, match, impl->variablePattern)){
         io_expressionBegin = match[0].second;
         GeneralId id(std::stoi(match.str(1)));
+        if(impl->isParsingVariableExpression){
+            // The variable is looked up when the compiled term is evaluated
+            impl->parsedVariableId = id;
+            return stdx::nullopt;
+        }
         if(auto variable = impl->findVariable(id)){
             return variable->value();
         }
@@ -813,6 +870,7 @@ void MprControllerItemBase::Impl::clear()
     programStack.clear();
     processorStack.clear();
     topLevelProgramToSharedNameMap.clear();
+    compiledExpressions.clear();
 }
 
 
@@ -847,7 +905,11 @@ bool MprControllerItemBase::Impl::interpretGroupStatement(MprGroupStatement* sta
 
 bool MprControllerItemBase::Impl::interpretIfStatement(MprIfStatement* statement)
 {
-    auto condition = evalConditionalExpression(statement->condition());
+    auto expression = getCompiledExpression(statement);
+    if(!expression){
+        return false;
+    }
+    auto condition = evalConditionalExpression(*expression);
 
     if(!condition){
         return false;
@@ -888,7 +950,11 @@ bool MprControllerItemBase::Impl::interpretIfStatement(MprIfStatement* statement
 
 bool MprControllerItemBase::Impl::interpretWhileStatement(MprWhileStatement* statement)
 {
-    auto condition = evalConditionalExpression(statement->condition());
+    auto expression = getCompiledExpression(statement);
+    if(!expression){
+        return false;
+    }
+    auto condition = evalConditionalExpression(*expression);
 
     if(!condition){
         return false;
@@ -927,66 +993,287 @@ bool MprControllerItemBase::Impl::interpretCallStatement(MprCallStatement* state
 }
 
 
-template<class LhsType, class RhsType>
-static stdx::optional<bool> checkNumericalComparison(const string& op, LhsType lhs, RhsType rhs)
-{
-    if(op == "="){
-        return lhs == rhs;
-    } else if(op == "!="){
-        return lhs != rhs;
-    } else if(op == "<"){
-        return lhs < rhs;
-    } else if(op == ">"){
-        return lhs > rhs;
-    } else if(op == "<="){
-        return lhs <= rhs;
-    } else if(op == ">="){
-        return lhs >= rhs;
+bool MprControllerItemBase::Impl::compileExpressions(MprProgram* program)
+{
+    bool result = true;
+    for(auto& statement : *program){
+        if(!statement->isEnabled()){
+            continue;
+        }
+        if(dynamic_cast<MprConditionStatement*>(statement.get()) ||
+           dynamic_cast<MprAssignStatement*>(statement.get())){
+            if(!getCompiledExpression(statement)){
+                result = false;
+            }
+        }
+        if(auto structured = dynamic_cast<MprStructuredStatement*>(statement.get())){
+            if(!compileExpressions(structured->lowerLevelProgram())){
+                result = false;
+            }
+        }
     }
-    return stdx::nullopt;
+    return result;
+}
+
+
+/**
+   The expression of a statement that is enabled after the initialization is compiled
+   when it is executed first. The error of an invalid expression is only reported once.
+*/
+MprControllerItemBase::Impl::CompiledExpression*
+MprControllerItemBase::Impl::getCompiledExpression(MprStatement* statement)
+{
+    auto p = compiledExpressions.find(statement);
+    if(p == compiledExpressions.end()){
+        CompiledExpression expression;
+        expression.statement = statement;
+        if(auto conditionStatement = dynamic_cast<MprConditionStatement*>(statement)){
+            expression.isValid = compileConditionalExpression(conditionStatement->condition(), expression);
+        } else if(auto assignStatement = dynamic_cast<MprAssignStatement*>(statement)){
+            expression.isValid = compileAssignExpression(assignStatement, expression);
+        }
+        p = compiledExpressions.emplace(statement, std::move(expression)).first;
+    }
+    return p->second.isValid ? &p->second : nullptr;
 }
 
 
-stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(const string& expression)
+bool MprControllerItemBase::Impl::compileConditionalExpression
+(const string& expression, CompiledExpression& out_expression)
 {
     if(expression.empty()){
         io->os() << _("Empty conditional expression.") << endl;
-        return stdx::nullopt;
+        return false;
     }
     auto pos = expression.cbegin();
     auto end = expression.cend();
+    std::smatch match;
 
     bool isExpressionValid = false;
-    stdx::optional<string> pCmpOp;
-    stdx::optional<MprVariable::Value> pRhs;
-    stdx::optional<MprVariable::Value> pLhs = getTermValue(pos, end);
-    if(pLhs){
+    Term lhs;
+    if(compileTerm(pos, end, lhs)){
+        out_expression.terms.push_back(std::move(lhs));
         if(pos == end){
             isExpressionValid = true;
-        } else if((pCmpOp = getComparisonOperator(pos, end))){
-            if(pos != end){
-                if((pRhs = getTermValue(pos, end))){
-                    if(pos == end){
-                        isExpressionValid = true;
-                    }
+        } else if(regex_search(pos, end,  match, cmpOperatorPattern)){
+            pos = match[0].second;
+            auto op = match.str(1);
+            if(op == "="){
+                out_expression.comparisonOperator = EqualTo;
+            } else if(op == "!="){
+                out_expression.comparisonOperator = NotEqualTo;
+            } else if(op == "<"){
+                out_expression.comparisonOperator = LessThan;
+            } else if(op == ">"){
+                out_expression.comparisonOperator = GreaterThan;
+            } else if(op == "<="){
+                out_expression.comparisonOperator = LessOrEqual;
+            } else if(op == ">="){
+                out_expression.comparisonOperator = GreaterOrEqual;
+            }
+            Term rhs;
+            if(pos != end && compileTerm(pos, end, rhs)){
+                out_expression.terms.push_back(std::move(rhs));
+                if(pos == end){
+                    isExpressionValid = true;
                 }
             }
         }
     }
     if(!isExpressionValid){
         io->os() << format(_("Conditional expression \"{0}\" is invalid."), expression) << endl;
+    }
+    return isExpressionValid;
+}
+
+
+bool MprControllerItemBase::Impl::compileAssignExpression
+(MprAssignStatement* statement, CompiledExpression& out_expression)
+{
+    auto& expression = statement->valueExpression();
+    if(expression.empty()){
+        io->os() << format(_("Expression assigned to variable {0} is empty."),
+                           statement->variableExpression()) << endl;
+        return false;
+    }
+
+    string invalidTerm;
+    auto pos = expression.cbegin();
+    auto end = expression.cend();
+    std::smatch match;
+    bool isValidExpression = true;
+    bool isNextTermOperator = false;
+        
+    while(pos != end){
+        if(!isNextTermOperator){
+            auto pos0 = pos;
+            Term term;
+            if(compileTerm(pos, end, term)){
+                out_expression.terms.push_back(std::move(term));
+                isNextTermOperator = true;
+            } else {
+                string termString(pos0, end);
+                if(regex_search(termString, match, termPattern)){
+                    invalidTerm = match.str(1);
+                } else {
+                    invalidTerm = termString;
+                }
+                isValidExpression = false;
+            }
+        } else {
+            if(regex_search(pos, end, match, operatorPattern)){
+                char op = match.str(1)[0];
+                out_expression.operators.push_back(op);
+                pos = match[0].second;
+                isNextTermOperator = false;
+            } else {
+                invalidTerm = string(pos, end);
+                isValidExpression = false;
+            }
+        }
+        if(!isValidExpression){
+            io->os() << format(_("Term \"{0}\" is invalid."), invalidTerm) << endl;
+            break;
+        }
+    }
+
+    if(isValidExpression){
+        if(out_expression.terms.empty()){
+            isValidExpression = false;
+        } else if(!isNextTermOperator){
+            io->os() << format(_("Expression ends with operator {0}."), out_expression.operators.back()) << endl;
+            isValidExpression = false;
+        }
+    }
+
+    return isValidExpression;
+}
+
+
+bool MprControllerItemBase::Impl::compileTerm
+(string::const_iterator& pos, string::const_iterator end, Term& out_term)
+{
+    std::smatch match;
+    auto pos0 = pos;
+
+    if(regex_search(pos, end,  match, stringPattern)){
+        out_term.type = Term::Constant;
+        out_term.value = match.str(1);
+        pos = match[0].second;
+                
+    } else if(regex_search(pos, end, match, floatPattern)){
+        out_term.type = Term::Constant;
+        out_term.value = std::stod(match.str(0));
+        pos = match[0].second;
+            
+    } else if(regex_search(pos, end, match, intPattern)){
+        errno = 0;
+        long number = strtol(match.str(0).c_str(), nullptr, 10);
+        if(errno == ERANGE || number < INT_MIN || number > INT_MAX){
+            io->os() << format(_("Integer value {0} is out of range."), match.str(0)) << endl;
+            return false;
+        }
+        out_term.type = Term::Constant;
+        out_term.value = static_cast<int>(number);
+        pos = match[0].second;
+
+    } else if(regex_search(pos, end, match, boolPattern)){
+        auto label = match.str(1);
+        std::transform(label.begin(), label.end(), label.begin(), ::tolower);
+        out_term.type = Term::Constant;
+        out_term.value = (label == "true") ? true : false;
+        pos = match[0].second;
+
+    } else {
+        /*
+          The variable expression is parsed by the virtual function so that a derived class can
+          customize the syntax. The variable of the default syntax is not resolved here because
+          it may be created by an assign statement, and the variable expression customized by a
+          derived class is evaluated in every execution. Only the terms recognized as variable
+          expressions are resolved at runtime, and the other terms are syntax errors.
+        */
+        auto pos1 = pos;
+        parsedVariableId.reset();
+        isParsingVariableExpression = true;
+        self->evalExpressionAsVariableValue(pos1, end);
+        isParsingVariableExpression = false;
+        if(pos1 == pos){
+            return false;
+        }
+        if(parsedVariableId.isValid()){
+            out_term.type = Term::Variable;
+            out_term.variableId = parsedVariableId;
+        } else {
+            out_term.type = Term::CustomVariable;
+        }
+        pos = pos1;
+    }
+
+    out_term.label.assign(pos0, pos);
+    
+    return true;
+}
+
+
+stdx::optional<MprVariable::Value> MprControllerItemBase::Impl::evalTerm(Term& term)
+{
+    switch(term.type){
+    case Term::Constant:
+        return term.value;
+
+    case Term::Variable:
+        if(auto variable = findVariable(term.variableId)){
+            return variable->value();
+        }
+        io->os() << format(_("Variable {0} is not defined."), term.variableId.label()) << endl;
         return stdx::nullopt;
+
+    case Term::CustomVariable:
+    default:
+    {
+        auto pos = term.label.cbegin();
+        return self->evalExpressionAsVariableValue(pos, term.label.cend());
+    }
     }
+}
+
 
+template<class LhsType, class RhsType>
+static stdx::optional<bool> checkNumericalComparison(int op, LhsType lhs, RhsType rhs)
+{
+    switch(op){
+    case EqualTo:        return lhs == rhs;
+    case NotEqualTo:     return lhs != rhs;
+    case LessThan:       return lhs < rhs;
+    case GreaterThan:    return lhs > rhs;
+    case LessOrEqual:    return lhs <= rhs;
+    case GreaterOrEqual: return lhs >= rhs;
+    default: break;
+    }
+    return stdx::nullopt;
+}
+
+
+stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(CompiledExpression& expression)
+{
+    stdx::optional<MprVariable::Value> pLhs = evalTerm(expression.terms[0]);
+    if(!pLhs){
+        return stdx::nullopt;
+    }
     auto& lhs = *pLhs;
 
-    if(!pRhs){
+    if(expression.terms.size() < 2){
         return MprVariable::toBool(lhs);
     }
+
+    stdx::optional<MprVariable::Value> pRhs = evalTerm(expression.terms[1]);
+    if(!pRhs){
+        return stdx::nullopt;
+    }
             
     stdx::optional<bool> pResult;
     auto& rhs = *pRhs;
-    string& cmpOp = *pCmpOp;
+    int cmpOp = expression.comparisonOperator;
 
     int rhsValueType = MprVariable::valueType(rhs);
     switch(MprVariable::valueType(lhs)){
@@ -1011,14 +1298,14 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
         break;
     }
     case MprVariable::Bool:
-        if(rhsValueType == MprVariable::Bool && cmpOp == "="){
+        if(rhsValueType == MprVariable::Bool && cmpOp == EqualTo){
             pResult = checkNumericalComparison(
                 cmpOp, MprVariable::boolValue(lhs), MprVariable::boolValue(rhs));
         }
         break;
 
     case MprVariable::String:
-        if(rhsValueType == MprVariable::String && cmpOp == "="){
+        if(rhsValueType == MprVariable::String && cmpOp == EqualTo){
             pResult = checkNumericalComparison(
                 cmpOp, MprVariable::stringValue(lhs), MprVariable::stringValue(rhs));
         }
@@ -1031,151 +1318,49 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
 
     return pResult;
 }
-    
-    
-stdx::optional<MprVariable::Value> MprControllerItemBase::Impl::getTermValue
-(string::const_iterator& pos, string::const_iterator end)
-{
-    stdx::optional<MprVariable::Value> value;
-    std::smatch match;
-
-    if(regex_search(pos, end,  match, stringPattern)){
-        value = match.str(1);
-        pos = match[0].second;
-                
-    } else if(regex_search(pos, end, match, floatPattern)){
-        value = std::stod(match.str(0));
-        pos = match[0].second;
-            
-    } else if(regex_search(pos, end, match, intPattern)){
-        errno = 0;
-        long number = strtol(match.str(0).c_str(), nullptr, 10);
-        if(errno == ERANGE || number < INT_MIN || number > INT_MAX){
-            io->os() << format(_("Integer value {0} is out of range."), match.str(0)) << endl;
-        } else {
-            value = std::stoi(match.str(0));
-            pos = match[0].second;
-        }
-    } else if(regex_search(pos, end, match, boolPattern)){
-        auto label = match.str(1);
-        std::transform(label.begin(), label.end(), label.begin(), ::tolower);
-        value = (label == "true") ? true : false;
-        pos = match[0].second;
-                
-    } else {
-        value = self->evalExpressionAsVariableValue(pos, end);
-    }
-    
-    return value;
-}
-
-
-stdx::optional<string> MprControllerItemBase::Impl::getComparisonOperator
-(string::const_iterator& pos, string::const_iterator end)
-{
-    std::smatch match;
-    if(regex_search(pos, end,  match, cmpOperatorPattern)){
-        pos = match[0].second;
-        return match.str(1);
-    }
-    return stdx::nullopt;
-}
 
 
 bool MprControllerItemBase::Impl::interpretAssignStatement(MprAssignStatement* statement)
 {
-    auto& expression = statement->valueExpression();
-    if(expression.empty()){
-        io->os() << format(_("Expression assigned to variable {0} is empty."),
-                           statement->variableExpression()) << endl;
-        return false;
-    }
-
-    vector<MprVariable::Value> termValues;
-    vector<char> operators;
-    vector<string> termStrings;
-    string invalidTerm;
-    auto pos = expression.cbegin();
-    auto end = expression.cend();
-    std::smatch match;
-    bool isValidExpression = true;
-    bool isNextTermOperator = false;
-        
-    while(pos != end){
-        if(!isNextTermOperator){
-            auto pos0 = pos;
-            auto termValue = getTermValue(pos, end);
-            string termString(pos0, pos);
-            if(termValue){
-                termValues.push_back(*termValue);
-                termStrings.push_back(termString);
-                isNextTermOperator = true;
-            } else {
-                if(termString.empty()){
-                    termString = string(pos0, end);
-                }
-                if(regex_search(termString, match, termPattern)){
-                    invalidTerm = match.str(1);
-                } else {
-                    invalidTerm = termString;
-                }
-                isValidExpression = false;
-            }
-        } else {
-            if(regex_search(pos, end, match, operatorPattern)){
-                char op = match.str(1)[0];
-                operators.push_back(op);
-                pos = match[0].second;
-                isNextTermOperator = false;
-            } else {
-                invalidTerm = string(match[0].first, match[0].second);
-                isValidExpression = false;
-            }
-        }
-        if(!isValidExpression){
-            io->os() << format(_("Term \"{0}\" is invalid."), invalidTerm) << endl;
-            break;
-        }
-    }
-
-    if(isValidExpression){
-        if(termValues.empty()){
-            isValidExpression = false;
-        } else if(!isNextTermOperator){
-            io->os() << format(_("Expression ends with operator {0}."), operators.back()) << endl;
-            isValidExpression = false;
-        }
-    }
-    if(!isValidExpression){
+    auto expression = getCompiledExpression(statement);
+    if(!expression){
         return false;
     }
 
+    auto& terms = expression->terms;
+    auto& operators = expression->operators;
     size_t termIndex = 0;
     size_t operatorIndex = 0;
-    MprVariable::Value value = termValues[termIndex++];
+    auto pValue = evalTerm(terms[termIndex++]);
+    if(!pValue){
+        return false;
+    }
+    MprVariable::Value& value = *pValue;
     while(operatorIndex < operators.size()){
         char op = operators[operatorIndex++];
-        if(!applyBinaryOperation(value, op, termValues[termIndex++])){
-            isValidExpression = false;
+        auto pRhs = evalTerm(terms[termIndex++]);
+        if(!pRhs){
+            return false;
+        }
+        if(!applyBinaryOperation(value, op, *pRhs)){
             io->os() << format(_("Type mismatch in expresion \"{0} {1} {2}\""),
-                               termStrings[termIndex-2],
+                               terms[termIndex-2].label,
                                op,
-                               termStrings[termIndex-1]) << endl;
-            break;
+                               terms[termIndex-1].label) << endl;
+            return false;
         }
     }
     
-    bool assigned = false;
-    if(isValidExpression){
-        auto assignValue =
+    if(!expression->assignValue){
+        expression->assignValue =
             self->evalExpressionAsVariableToAssginValue(statement->variableExpression());
-        if(assignValue && assignValue(value)){
-            assigned = true;
-            ++iterator;
-        }
+    }
+    if(expression->assignValue && expression->assignValue(value)){
+        ++iterator;
+        return true;
     }
 
-    return assigned;
+    return false;
 }
 
 
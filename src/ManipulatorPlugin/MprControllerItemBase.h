@@ -96,6 +96,12 @@ protected:
     // Virtual functions for customizing variables
     virtual bool initializeVariables();
     void setVariableListSync(MprVariableList* listInGui, MprVariableList* listInController);
+    /**
+       This function is also called to parse the terms of the expressions in the initialization.
+       The function must advance io_expressionBegin over a variable expression even if the variable
+       is not available yet, because the term is evaluated by calling this function again when the
+       statement is executed. A term that is not advanced over is reported as a syntax error.
+    */
     virtual stdx::optional<MprVariable::Value> evalExpressionAsVariableValue(
         std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd);
     virtual std::function<bool(MprVariable::Value value)> evalExpressionAsVariableToAssginValue(
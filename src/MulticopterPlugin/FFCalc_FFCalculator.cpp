@@ -28,6 +28,8 @@ FFCalculator::FFCalculator (
 
     _linkVolume = mass / density;
 
+    _repLength = std::pow (_linkVolume, 1.0/3.0);
+
     return;
 }
 
@@ -169,6 +171,92 @@ void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkFo
     return;
 }
 
+/**
+   This function calculates the same forces as the above function using the precomputed
+   Gauss points, which omits the transformation of the triangles and the evaluation of
+   the power functions for each point.
+*/
+void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkForceT, const SurfaceGaussPoints& gaussPoints)
+{
+    const int numPoints = gaussPoints.size();
+    if (numPoints == 0)
+        return;
+
+    const bool isUniformFluid = _fluidEnv.isNull();
+    if (isUniformFluid && _fluidEnvAll.isFluid == false)
+        return;
+
+    const Matrix3 rot = _linkState.trans().linear();
+    const Vector3 trans = _linkState.trans().translation();
+    const Eigen::Matrix3Xd& positions = gaussPoints.positions();
+    const Eigen::Matrix3Xd& normals = gaussPoints.normals();
+    const Eigen::ArrayXd& coefs = gaussPoints.coefficients();
+
+    // The moments are accumulated around the origin and converted later
+    Vector3 forceN = Vector3::Zero();
+    Vector3 momentN = Vector3::Zero();
+    Vector3 forceT = Vector3::Zero();
+    Vector3 momentT = Vector3::Zero();
+
+    FluidEnvironment::FluidValue fluid = _fluidEnvAll;
+
+    for (int i=0; i<numPoints; ++i)
+    {
+        const Vector3 posIP = rot * positions.col(i) + trans;
+
+        if (isUniformFluid == false)
+        {
+            bool inBounds = _fluidEnv.get (posIP, fluid);
+            if (inBounds==false)
+                fluid = _fluidEnvAll;
+            if (fluid.isFluid == false)
+                continue;
+        }
+
+        const Vector3 normal = rot * normals.col(i);
+        const Vector3 velRelative = fluid.velocity - _linkState.translationalVelocityAt(posIP);
+
+        double velPerp;
+        double velPara;
+        Vector3 vePara;
+        _calcVectorDecomp (velRelative, -normal, &velPerp, &velPara, &vePara);
+
+        if (velPerp >= TINY_VELOCITY)
+        {
+            const Vector3 force = (-coefs[i] * 0.5 * fluid.density * velPerp * velPerp) * normal;
+            forceN += force;
+            momentN += posIP.cross(force);
+        }
+
+        if (velPara >= TINY_VELOCITY)
+        {
+            const double coefReynolds = fluid.density * velPara * _repLength / fluid.viscosity;
+            double scale;
+            if (coefReynolds < 4.0e5)
+            {
+                scale = 0.664 * velPara * std::sqrt (fluid.viscosity * fluid.density * velPara / _repLength);
+            }
+            else
+            {
+                double coefResist = 0.455 / std::pow (std::log10(coefReynolds), 2.58) - 1700.0 / coefReynolds;
+                if (coefReynolds < 6.0e5)
+                    coefResist = std::max (coefResist, 1.328 / std::sqrt(coefReynolds));
+                scale = coefResist * 0.5 * fluid.density * velPara * velPara;
+            }
+            const Vector3 force = (coefs[i] * scale) * vePara;
+            forceT += force;
+            momentT += posIP.cross(force);
+        }
+    }
+
+    pLinkForceN->addForce (forceN, Vector3::Zero());
+    pLinkForceN->addMoment (momentN);
+    pLinkForceT->addForce (forceT, Vector3::Zero());
+    pLinkForceT->addMoment (momentT);
+
+    return;
+}
+
 void FFCalculator::calcGravity_forDebug (LinkForce* pLinkForce)
 {
 
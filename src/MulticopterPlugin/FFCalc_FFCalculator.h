@@ -25,6 +25,8 @@ private:
 
     double _linkVolume;
 
+    double _repLength;
+
     const Vector3 _gravity;
 
     static const double TINY_VELOCITY;
@@ -53,6 +55,8 @@ public:
 
     void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT,int);
 
+    void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT, const SurfaceGaussPoints& gaussPoints);
+
     void calcGravity_forDebug (LinkForce* pLinkForce);
 
 private:
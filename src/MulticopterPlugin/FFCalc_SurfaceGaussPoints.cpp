@@ -0,0 +1,54 @@
+#include "MulticopterPluginHeader.h"
+
+namespace Multicopter {
+namespace FFCalc {
+
+void SurfaceGaussPoints::build (const std::vector<LinkTriangleAttribute>& triAttrAry, int numIP)
+{
+    std::vector<int> triIndices;
+    std::vector<int> ipIndices;
+    triIndices.reserve (triAttrAry.size() * numIP);
+    ipIndices.reserve (triAttrAry.size() * numIP);
+
+    for (int iTri=0; iTri<(int)triAttrAry.size(); ++iTri)
+    {
+        for (int iIP=0; iIP<numIP; ++iIP)
+        {
+            if (triAttrAry[iTri].cutoffCoefficient(iIP) >= 1.0e-12)
+            {
+                triIndices.push_back (iTri);
+                ipIndices.push_back (iIP);
+            }
+        }
+    }
+
+    const int numPoints = triIndices.size();
+    _positions.resize (3, numPoints);
+    _normals.resize (3, numPoints);
+    _coefs.resize (numPoints);
+
+    int index = 0;
+    for (int i=0; i<numPoints; ++i)
+    {
+        const LinkTriangleAttribute& triAttr = triAttrAry[triIndices[i]];
+        const GaussTriangle3d tri (triAttr.triangle());
+
+        // Degenerate triangles do not generate any force
+        if (!(tri.area() > 0.0))
+            continue;
+
+        const int iIP = ipIndices[i];
+        _positions.col(index) = tri.getGaussPoint(iIP, numIP);
+        _normals.col(index) = tri.normal();
+        _coefs[index] = triAttr.cutoffCoefficient(iIP) * tri.getGaussWeight(iIP, numIP) * tri.area();
+        ++index;
+    }
+
+    _positions.conservativeResize (3, index);
+    _normals.conservativeResize (3, index);
+    _coefs.conservativeResize (index);
+
+    return;
+}
+
+}}
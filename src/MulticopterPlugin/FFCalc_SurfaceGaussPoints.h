@@ -0,0 +1,52 @@
+#pragma once
+#include "FFCalc_Common.h"
+
+#include <vector>
+
+namespace Multicopter {
+
+class LinkTriangleAttribute;
+
+namespace FFCalc {
+
+/**
+   Gauss points of the surface triangles of a link in the link local coordinate.
+   The points are stored as flat arrays so that the fluid force of all the points
+   can be evaluated at once. The points whose cutoff coefficients are zero are omitted.
+*/
+class SurfaceGaussPoints
+{
+private:
+    Eigen::Matrix3Xd _positions;
+
+    Eigen::Matrix3Xd _normals;
+
+    // cutoff coefficient * Gauss weight * triangle area
+    Eigen::ArrayXd _coefs;
+
+public:
+
+    void build (const std::vector<LinkTriangleAttribute>& triAttrAry, int numIP);
+
+    int size() const
+    {
+        return _coefs.size();
+    }
+
+    const Eigen::Matrix3Xd& positions() const
+    {
+        return _positions;
+    }
+
+    const Eigen::Matrix3Xd& normals() const
+    {
+        return _normals;
+    }
+
+    const Eigen::ArrayXd& coefficients() const
+    {
+        return _coefs;
+    }
+};
+
+}}
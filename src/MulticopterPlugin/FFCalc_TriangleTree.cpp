@@ -0,0 +1,109 @@
+#include "MulticopterPluginHeader.h"
+#include <algorithm>
+
+namespace Multicopter {
+namespace FFCalc {
+
+namespace {
+
+const int MaxNumLeafTriangles = 4;
+
+}
+
+void TriangleTree::build (const std::vector<const GaussTriangle3d*>& triAry)
+{
+    const int numTri = triAry.size();
+
+    _nodes.clear();
+    _triIndices.resize (numTri);
+    _triBoxes.resize (numTri);
+
+    std::vector<Vector3> centers (numTri);
+    for (int i=0; i<numTri; ++i)
+    {
+        const GaussTriangle3d& tri = *triAry[i];
+        Eigen::AlignedBox3d& box = _triBoxes[i];
+        box.setEmpty();
+        box.extend (tri[0]).extend (tri[1]).extend (tri[2]);
+        centers[i] = box.center();
+        _triIndices[i] = i;
+    }
+
+    if (numTri == 0)
+        return;
+
+    _nodes.reserve (2 * numTri);
+    _nodes.emplace_back();
+    buildNode (0, 0, numTri, centers);
+}
+
+void TriangleTree::buildNode (int nodeIndex, int begin, int end, const std::vector<Vector3>& centers)
+{
+    Eigen::AlignedBox3d box;
+    Eigen::AlignedBox3d centerBox;
+    box.setEmpty();
+    centerBox.setEmpty();
+    for (int i=begin; i<end; ++i)
+    {
+        box.extend (_triBoxes[_triIndices[i]]);
+        centerBox.extend (centers[_triIndices[i]]);
+    }
+    _nodes[nodeIndex].box = box;
+
+    if (end - begin <= MaxNumLeafTriangles)
+    {
+        _nodes[nodeIndex].index = begin;
+        _nodes[nodeIndex].count = end - begin;
+        return;
+    }
+
+    // The triangles are divided at the median of the centers along the longest axis
+    int axis;
+    centerBox.sizes().maxCoeff (&axis);
+    const int mid = (begin + end) / 2;
+    std::nth_element (
+        _triIndices.begin() + begin, _triIndices.begin() + mid, _triIndices.begin() + end,
+        [&](int i1, int i2){ return centers[i1][axis] < centers[i2][axis]; });
+
+    const int childIndex = _nodes.size();
+    _nodes[nodeIndex].index = childIndex;
+    _nodes[nodeIndex].count = 0;
+    _nodes.emplace_back();
+    _nodes.emplace_back();
+    buildNode (childIndex, begin, mid, centers);
+    buildNode (childIndex + 1, mid, end, centers);
+}
+
+void TriangleTree::findTriangles (const Eigen::AlignedBox3d& box, std::vector<int>& out_indices) const
+{
+    if (_nodes.empty())
+        return;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = _nodes[stack[--stackSize]];
+        if (node.box.intersects (box) == false)
+            continue;
+
+        if (node.count > 0)
+        {
+            for (int i=node.index; i<node.index+node.count; ++i)
+            {
+                const int triIndex = _triIndices[i];
+                if (_triBoxes[triIndex].intersects (box))
+                    out_indices.push_back (triIndex);
+            }
+        }
+        else
+        {
+            stack[stackSize++] = node.index;
+            stack[stackSize++] = node.index + 1;
+        }
+    }
+}
+
+}}
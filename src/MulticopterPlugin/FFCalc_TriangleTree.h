@@ -0,0 +1,42 @@
+#pragma once
+#include "FFCalc_Common.h"
+#include "FFCalc_GaussTriangle3d.h"
+
+#include <vector>
+
+namespace Multicopter {
+namespace FFCalc {
+
+/**
+   Bounding volume hierarchy of the axis aligned bounding boxes of triangles.
+   The tree refers to the triangles by the indices of the array given to build().
+*/
+class TriangleTree
+{
+private:
+    struct Node
+    {
+        Eigen::AlignedBox3d box;
+        // The children of an inner node are nodes[index] and nodes[index+1].
+        // A leaf node refers to the triangles of _triIndices[index] ... _triIndices[index+count-1].
+        int index;
+        int count;
+    };
+
+    std::vector<Node> _nodes;
+
+    std::vector<int> _triIndices;
+
+    std::vector<Eigen::AlignedBox3d> _triBoxes;
+
+    void buildNode (int nodeIndex, int begin, int end, const std::vector<Vector3>& centers);
+
+public:
+
+    void build (const std::vector<const GaussTriangle3d*>& triAry);
+
+    //! The indices of the triangles whose bounding boxes intersect the given box are appended.
+    void findTriangles (const Eigen::AlignedBox3d& box, std::vector<int>& out_indices) const;
+};
+
+}}
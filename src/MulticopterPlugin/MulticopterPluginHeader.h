@@ -42,6 +42,7 @@
 #include "FFCalc_INormalizedFunction.h"
 #include "FFCalc_CutoffCoef.h"
 #include "FFCalc_CutoffCoefImpl.h"
+#include "FFCalc_TriangleTree.h"
 
 #include "LinkAttribute.h"
 #include "LinkTriangleAttribute.h"
@@ -49,6 +50,7 @@
 
 #include "FFCalc_LinkForce.h"
 #include "FFCalc_LinkState.h"
+#include "FFCalc_SurfaceGaussPoints.h"
 #include "FFCalc_FFCalculator.h"
 #include "FFCalc_calcFluidForce.h"
 
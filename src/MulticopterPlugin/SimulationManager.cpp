@@ -4,9 +4,13 @@
 
 #include "MulticopterPluginHeader.h"
 #include "MulticopterSimulatorItem.h"
+#include <cnoid/ThreadPool>
 #include <fmt/format.h>
 #include <cmath>
 #include <random>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 
 using namespace std;
 using namespace cnoid;
@@ -152,6 +156,8 @@ SimulationManager::initializeSimulation(SimulatorItem* simItem, MulticopterSimul
 
     calculateSurfaceCuttoffCoefficient(_fluidLinkBodyMap,_linkPolygonMap);
 
+    updateLinkSurface();
+
     double curTime = simItem->currentTime();
     _nextLogTime         = curTime;
 
@@ -311,6 +317,73 @@ SimulationManager::clearLinkPolygon()
     _linkPolygonMap.clear();
 }
 
+void
+SimulationManager::updateLinkSurface()
+{
+    clearLinkSurface();
+
+    const int numIP = getDegreeNumber();
+
+    for(auto& linkPolygon : _linkPolygonMap){
+        Link* link = linkPolygon.first;
+        LinkAttribute linkAttr = linkAttribute(link);
+        if(linkAttr.isNull() == true || linkAttr.linkForceApplyFlgAry()[3] == false){
+            continue;
+        }
+        LinkSurface& surface = _linkSurfaceMap[link];
+        surface.link = link;
+        surface.linkAttr = linkAttr;
+        surface.gaussPoints.build(linkPolygon.second, numIP);
+        _linkSurfaceAry.push_back(&surface);
+    }
+
+    int numThreads = std::min(static_cast<int>(std::thread::hardware_concurrency()), static_cast<int>(_linkSurfaceAry.size()));
+    if(numThreads >= 2){
+        _threadPool.reset(new ThreadPool(numThreads));
+    }
+}
+
+void
+SimulationManager::clearLinkSurface()
+{
+    _linkSurfaceAry.clear();
+    _linkSurfaceMap.clear();
+    _threadPool.reset();
+}
+
+void
+SimulationManager::calcSurfaceForces()
+{
+    const FluidEnvironment& fluidEnv = *fluidEnvironmentSim();
+    const int numSurfaces = _linkSurfaceAry.size();
+    std::atomic<int> nextIndex(0);
+
+    // The links are assigned to the threads dynamically because the numbers of their points differ
+    auto calcForces = [&](){
+        int index;
+        while((index = nextIndex++) < numSurfaces){
+            LinkSurface& surface = *_linkSurfaceAry[index];
+            surface.force = FFCalc::LinkForce(Vector3::Zero());
+            auto linkState = _linkStateMap.find(surface.link);
+            if(linkState == _linkStateMap.end()){
+                continue;
+            }
+            FFCalc::FFCalculator ffc (_gravity, fluidEnv, _fluEnvAllSim, *surface.link, surface.linkAttr,
+                                      *linkState->second, _linkPolygonMap.find(surface.link)->second);
+            ffc.calcSurfaceGeneral (&surface.force, &surface.force, surface.gaussPoints);
+        }
+    };
+
+    if(_threadPool){
+        for(int i=0 ; i < _threadPool->size() ; ++i){
+            _threadPool->start(calcForces);
+        }
+        _threadPool->wait();
+    } else {
+        calcForces();
+    }
+}
+
 void
 SimulationManager::updateLinkState(double time)
 {
@@ -342,6 +415,7 @@ SimulationManager::finalizeSimulation(SimulatorItem* simItem, MulticopterSimulat
 
     clearBodyLinkMap();
     clearLinkPolygon();
+    clearLinkSurface();
     clearLinkState();
 }
 
@@ -391,85 +465,159 @@ SimulationManager::onBodyDelete(const QUuid& id, const cnoid::Body* body, const
 void
 SimulationManager::calculateSurfaceCuttoffCoefficient(map<Link*, tuple<Body*, LinkAttribute>>& fluidLinkBodyMap, map<Link*, vector<LinkTriangleAttribute>>& linkPolygonMap)
 {
-    const size_t numIP = getDegreeNumber();
-
-    const size_t numLink = linkPolygonMap.size();
-
-    vector<Link*> linkAry;
-    vector<vector<FFCalc::GaussTriangle3d>> triAryList;
-    linkAry.reserve(numLink);
-    triAryList.reserve(numLink);
+    const int numIP = getDegreeNumber();
 
+    // The links are sorted by their names so that the cache key does not depend on the link addresses
+    vector<tuple<string, int, Link*>> sortedLinks;
     for(auto& linkPolygon : linkPolygonMap){
-        Link& link = *(linkPolygon.first);
-        vector<LinkTriangleAttribute>& triAttrAry = linkPolygon.second;
-        const size_t numTri = triAttrAry.size();
-
-        vector<FFCalc::GaussTriangle3d> triAry;
-        triAry.reserve(numTri);
-
+        Link* link = linkPolygon.first;
+        Body* body = get<0>(fluidLinkBodyMap[link]);
+        sortedLinks.emplace_back(body ? body->name() : string(), link->index(), link);
+    }
+    std::sort(sortedLinks.begin(), sortedLinks.end());
+    vector<Link*> linkAry;
+    for(auto& sortedLink : sortedLinks){
+        linkAry.push_back(get<2>(sortedLink));
+    }
+    const int numLink = linkAry.size();
+
+    vector<vector<LinkTriangleAttribute>*> triAttrAryList(numLink);
+    vector<vector<FFCalc::GaussTriangle3d>> triAryList(numLink);
+    vector<const FFCalc::GaussTriangle3d*> allTriAry;
+    vector<int> allTriLinkIndices;
+    vector<double> key;
+    key.push_back(numIP);
+
+    for(int i=0 ; i < numLink ; ++i){
+        Link& link = *linkAry[i];
+        vector<LinkTriangleAttribute>& triAttrAry = linkPolygonMap[&link];
+        const LinkAttribute& linkAttr = get<1>(fluidLinkBodyMap[&link]);
+        key.push_back(linkAttr.cutoffDistance());
+        key.push_back(linkAttr.normMiddleValue());
+        key.push_back(triAttrAry.size());
+
+        vector<FFCalc::GaussTriangle3d>& triAry = triAryList[i];
+        triAry.reserve(triAttrAry.size());
         for(auto& triAttr : triAttrAry){
             triAry.push_back (FFCalc::GaussTriangle3d (triAttr.triangle(), link.T()));
+            const FFCalc::GaussTriangle3d& tri = triAry.back();
+            for(int j=0 ; j < 3 ; ++j){
+                key.insert(key.end(), tri[j].data(), tri[j].data() + 3);
+            }
         }
-
-        linkAry.push_back(&link);
-        triAryList.push_back(triAry);
+        for(auto& tri : triAry){
+            allTriAry.push_back(&tri);
+            allTriLinkIndices.push_back(i);
+        }
+        triAttrAryList[i] = &triAttrAry;
     }
 
-    for(size_t i=0 ; i<numLink ; ++i){
-
-        Link& curLink = *(linkAry[i]);
-        const vector<FFCalc::GaussTriangle3d>& curTriAry = triAryList[i];
-
-        const LinkAttribute& linkAttr = get<1>(fluidLinkBodyMap[&curLink]);
-        double cutoffDist = linkAttr.cutoffDistance();
-        double normMidVal = linkAttr.normMiddleValue();
-        FFCalc::CutoffCoef cutoffCalc(cutoffDist, normMidVal);
-        int curTriArySize=curTriAry.size();
-
-        for(size_t j=0 ; j<curTriArySize ; ++j){
+    size_t hash = 0;
+    for(auto& value : key){
+        hash ^= std::hash<double>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
 
-            const FFCalc::GaussTriangle3d& curTri = curTriAry[j];
+    if(hash != _cutoffCoefCache.hash || key != _cutoffCoefCache.key){
+        vector<double> coefs;
+        calcCuttoffCoefs(fluidLinkBodyMap, linkAry, allTriAry, allTriLinkIndices, coefs);
+        _cutoffCoefCache.hash = hash;
+        _cutoffCoefCache.key = std::move(key);
+        _cutoffCoefCache.coefs = std::move(coefs);
+    }
 
-#ifdef _WIN32
-            vector<double> minCoefs(numIP);
-#else
-            double minCoefs[numIP];
-#endif
-            for(int it=0;it<numIP;it++)minCoefs[it]=1.0;
+    const vector<double>& coefs = _cutoffCoefCache.coefs;
+    int index = 0;
+    for(int i=0 ; i < numLink ; ++i){
+        for(auto& triAttr : *triAttrAryList[i]){
+            for(int iIP=0 ; iIP < numIP ; ++iIP){
+                triAttr.setCutoffoefficient(iIP, coefs[index++]);
+            }
+        }
+    }
+}
 
-            for(size_t k=0 ; k<numLink ; ++k){
+void
+SimulationManager::calcCuttoffCoefs(
+    map<Link*, tuple<Body*, LinkAttribute>>& fluidLinkBodyMap,
+    const vector<Link*>& linkAry,
+    const vector<const FFCalc::GaussTriangle3d*>& allTriAry,
+    const vector<int>& allTriLinkIndices,
+    vector<double>& out_coefs)
+{
+    const int numIP = getDegreeNumber();
+    const int numTri = allTriAry.size();
+    const int numLink = linkAry.size();
 
-                Link& trgLink = *(linkAry[k]);
-                const vector<FFCalc::GaussTriangle3d>& trgTriAry = triAryList[k];
+    out_coefs.assign(numTri * numIP, 1.0);
 
-                if( &curLink == &trgLink )
-                    continue;
+    vector<FFCalc::CutoffCoef> cutoffCalcAry;
+    vector<double> influenceRadii;
+    cutoffCalcAry.reserve(numLink);
+    for(auto& link : linkAry){
+        const LinkAttribute& linkAttr = get<1>(fluidLinkBodyMap[link]);
+        double cutoffDist = linkAttr.cutoffDistance();
+        cutoffCalcAry.emplace_back(cutoffDist, linkAttr.normMiddleValue());
+        /*
+          The coefficient for a triangle is 1 when the distance to the triangle is
+          larger than six times the cutoff distance. A negative cutoff distance disables
+          the cutoff and the coefficients are always 1.
+        */
+        if(cutoffDist < -1.0e-9){
+            influenceRadii.push_back(-1.0);
+        } else {
+            influenceRadii.push_back(6.0 * std::max(cutoffDist, 1.0e-9) * (1.0 + 1.0e-6) + 1.0e-9);
+        }
+    }
 
-                if( trgTriAry.empty() == true )
+    FFCalc::TriangleTree tree;
+    tree.build(allTriAry);
+
+    std::atomic<int> nextIndex(0);
+    const int chunkSize = 64;
+
+    auto calcCoefs = [&](){
+        vector<int> candidates;
+        vector<const FFCalc::GaussTriangle3d*> trgTriAry;
+        int begin;
+        while((begin = nextIndex.fetch_add(chunkSize)) < numTri){
+            const int end = std::min(begin + chunkSize, numTri);
+            for(int i=begin ; i < end ; ++i){
+                const int linkIndex = allTriLinkIndices[i];
+                const double radius = influenceRadii[linkIndex];
+                if(radius < 0.0){
                     continue;
-
-#ifdef _WIN32
-                double* coefs = new double[numIP];
-#else
-                double coefs[numIP];
-#endif
-                calcCuttoffCoef(cutoffCalc, curTri, trgTriAry, coefs);
-                for(int iIP=0 ; iIP<numIP ; ++iIP){
-                    if( coefs[iIP] < minCoefs[iIP] ){
-                        minCoefs[iIP] = coefs[iIP];
+                }
+                const FFCalc::GaussTriangle3d& tri = *allTriAry[i];
+                Eigen::AlignedBox3d box;
+                box.setEmpty();
+                box.extend(tri[0]).extend(tri[1]).extend(tri[2]);
+                box.min().array() -= radius;
+                box.max().array() += radius;
+
+                candidates.clear();
+                tree.findTriangles(box, candidates);
+                trgTriAry.clear();
+                for(auto& index : candidates){
+                    if(allTriLinkIndices[index] != linkIndex){
+                        trgTriAry.push_back(allTriAry[index]);
                     }
                 }
-#ifdef _WIN32
-                delete[] coefs;
-#endif
+                if(!trgTriAry.empty()){
+                    calcCuttoffCoef(cutoffCalcAry[linkIndex], tri, trgTriAry, &out_coefs[i * numIP]);
+                }
             }
+        }
+    };
 
-            LinkTriangleAttribute& triAttr = linkPolygonMap[&curLink][j];
-            for(int iIP=0 ; iIP<numIP ; ++iIP){
-                triAttr.setCutoffoefficient(iIP, minCoefs[iIP]);
-            }
+    int numThreads = std::min(static_cast<int>(std::thread::hardware_concurrency()), numTri / chunkSize);
+    if(numThreads >= 2){
+        ThreadPool threadPool(numThreads);
+        for(int i=0 ; i < numThreads ; ++i){
+            threadPool.start(calcCoefs);
         }
+        threadPool.wait();
+    } else {
+        calcCoefs();
     }
 }
 
@@ -477,7 +625,7 @@ void
 SimulationManager::calcCuttoffCoef (
         const FFCalc::CutoffCoef& cutoffCalc,
         const FFCalc::GaussTriangle3d& tri,
-        const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,
+        const std::vector<const FFCalc::GaussTriangle3d*>& trgTriAry,
         double coefs[])
 {
     int numIP = getDegreeNumber();
@@ -486,7 +634,7 @@ SimulationManager::calcCuttoffCoef (
         const Eigen::Vector3d point = tri.getGaussPoint(iIP,numIP);
         int trgTriArySize=trgTriAry.size();
         for(size_t i=0 ; i<trgTriArySize ; ++i){
-            double coef = cutoffCalc.get (point, tri.normal(), trgTriAry[i]);
+            double coef = cutoffCalc.get (point, tri.normal(), *trgTriAry[i]);
             if( coef < coefs[iIP] ){
                 coefs[iIP] = coef;
             }
@@ -520,6 +668,15 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
     _rotorOutValAry.clear();
     _linkOutValAry.clear();
 
+    for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
+        for(auto& link : itb->second){
+            _linkStateMap[link]->update (simItem->currentTime(), *link);
+        }
+    }
+
+    // The surface forces of all the links are calculated in parallel
+    calcSurfaceForces();
+
     for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
         std::map<int,std::tuple<double,Vector3>> effectMap;
         bool calFlag=false;
@@ -557,7 +714,6 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
             try{
                 FFCalc::LinkStatePtr pLinkState;
                 pLinkState = _linkStateMap[*itl];
-                pLinkState->update (simItem->currentTime(), **itl);
 
                 std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
                     simItem, multicopterSimItem, **itl, *pLinkState,effectMap,calFlag);
@@ -620,7 +776,10 @@ std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
         FFCalc::LinkForce lfGenSurface(pLinkForce->point());
 
         if(linkForceApplyTarget[3] == true){
-            ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
+            auto surface = _linkSurfaceMap.find(&link);
+            if(surface != _linkSurfaceMap.end()){
+                lfGenSurface.add(surface->second.force);
+            }
             lfSurface.add(lfGenSurface);
         }
         pLinkForce->add(lfSurface);
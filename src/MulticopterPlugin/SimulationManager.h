@@ -6,6 +6,7 @@
 
 namespace cnoid {
 class MulticopterSimulatorItem;
+class ThreadPool;
 }
 
 namespace Multicopter {
@@ -96,6 +97,24 @@ protected:
         Eigen::Vector3d rotationalAcceleration;
     };
 
+    // The cutoff coefficients computed for the link triangles of the key
+    class CutoffCoefCache{
+    public:
+        CutoffCoefCache() : hash(0) { }
+        std::size_t hash;
+        std::vector<double> key;
+        std::vector<double> coefs;
+    };
+
+    class LinkSurface{
+    public:
+        LinkSurface() : force(cnoid::Vector3::Zero()) { }
+        cnoid::Link* link;
+        LinkAttribute linkAttr;
+        FFCalc::SurfaceGaussPoints gaussPoints;
+        FFCalc::LinkForce force;
+    };
+
     SimulationManager();
 
     ~SimulationManager();
@@ -108,6 +127,12 @@ protected:
 
     void clearLinkPolygon();
 
+    void updateLinkSurface();
+
+    void clearLinkSurface();
+
+    void calcSurfaceForces();
+
     void updateLinkState(double time);
 
     void clearLinkState();
@@ -134,7 +159,13 @@ protected:
                                             std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>& linkPolygonMap);
     
 
-    void calcCuttoffCoef (const FFCalc::CutoffCoef& cutoffCalc, const FFCalc::GaussTriangle3d& tri, const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,double coefs[]);
+    void calcCuttoffCoefs(std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute>>& linkBodyMap,
+                          const std::vector<cnoid::Link*>& linkAry,
+                          const std::vector<const FFCalc::GaussTriangle3d*>& allTriAry,
+                          const std::vector<int>& allTriLinkIndices,
+                          std::vector<double>& out_coefs);
+
+    void calcCuttoffCoef (const FFCalc::CutoffCoef& cutoffCalc, const FFCalc::GaussTriangle3d& tri, const std::vector<const FFCalc::GaussTriangle3d*>& trgTriAry,double coefs[]);
 
     std::unique_ptr<FFCalc::LinkForce>
     midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,std::map<int,std::tuple<double,cnoid::Vector3>> effectMap,bool calFlag);
@@ -156,6 +187,10 @@ private:
     std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute> >_fluidLinkBodyMap;
     std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute> > _effectLinkBodyMap;
     std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>_linkPolygonMap;
+    std::map<cnoid::Link*, LinkSurface> _linkSurfaceMap;
+    std::vector<LinkSurface*> _linkSurfaceAry;
+    std::unique_ptr<cnoid::ThreadPool> _threadPool;
+    CutoffCoefCache _cutoffCoefCache;
     std::map<const cnoid::Link*, FFCalc::LinkStatePtr> _linkStateMap;
 
     std::list<RotorOutValue> _rotorOutValAry;
@@ -13,7 +13,10 @@
 #include <cnoid/BasicSensorSimulationHelper>
 #include <cnoid/BodyItem>
 #include <cnoid/BodyCollisionDetector>
+#include <cnoid/MessageOut>
+#include <cnoid/TraceProfiler>
 #include <QElapsedTimer>
+#include <fmt/format.h>
 #include "gettext.h"
 
 #ifdef GAZEBO_ODE
@@ -27,6 +30,7 @@
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 
@@ -156,11 +160,23 @@ public:
     double surfaceLayerDepth;
     bool useWorldCollisionDetector;
     BodyCollisionDetector bodyCollisionDetector;
+    int numThreads;
+    bool isIslandParallelSolvingEnabled;
+#ifdef ODE_THREADING_ENABLED
+    dThreadingImplementationID threadingImpl;
+    dThreadingThreadPoolID threadPool;
+#endif
 
     double physicsTime;
     QElapsedTimer physicsTimer;
     double collisionTime;
     QElapsedTimer collisionTimer;
+    double dynamicsTime;
+    QElapsedTimer dynamicsTimer;
+    int numSteps;
+    // The average times of the last simulation in milliseconds per step
+    double averageCollisionTime;
+    double averageDynamicsTime;
 
     ODESimulatorItemImpl(ODESimulatorItem* self);
     ODESimulatorItemImpl(ODESimulatorItem* self, const ODESimulatorItemImpl& org);
@@ -168,6 +184,8 @@ public:
     ~ODESimulatorItemImpl();
     void clear();
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
+    void initializeThreading();
+    void clearThreading();
     void addBody(ODEBody* odeBody);
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
     void doPutProperties(PutPropertyFunction& putProperty);
@@ -910,6 +928,8 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self)
     is2Dmode = false;
     doFlipYZ = false;
     useWorldCollisionDetector = false;
+    numThreads = 1;
+    isIslandParallelSolvingEnabled = true;
 }
 
 
@@ -939,6 +959,8 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self, const ODESimu
     is2Dmode = org.is2Dmode;
     doFlipYZ = org.doFlipYZ;
     useWorldCollisionDetector = org.useWorldCollisionDetector;
+    numThreads = org.numThreads;
+    isIslandParallelSolvingEnabled = org.isIslandParallelSolvingEnabled;
 }
 
 
@@ -946,6 +968,12 @@ void ODESimulatorItemImpl::initialize()
 {
     worldID = 0;
     spaceID = 0;
+#ifdef ODE_THREADING_ENABLED
+    threadingImpl = nullptr;
+    threadPool = nullptr;
+#endif
+    averageCollisionTime = 0.0;
+    averageDynamicsTime = 0.0;
     contactJointGroupID = dJointGroupCreate(0);
     self->SimulatorItem::setAllLinkPositionOutputMode(true);
 }
@@ -1045,6 +1073,30 @@ void ODESimulatorItem::useWorldCollisionDetector(bool on)
 }
 
 
+void ODESimulatorItem::setNumThreads(int n)
+{
+    impl->numThreads = std::max(1, n);
+}
+
+
+void ODESimulatorItem::setIslandParallelSolvingEnabled(bool on)
+{
+    impl->isIslandParallelSolvingEnabled = on;
+}
+
+
+double ODESimulatorItem::averageCollisionDetectionTime() const
+{
+    return impl->averageCollisionTime;
+}
+
+
+double ODESimulatorItem::averageDynamicsTime() const
+{
+    return impl->averageDynamicsTime;
+}
+
+
 void ODESimulatorItem::setAllLinkPositionOutputMode(bool)
 {
     // The mode is not changed.
@@ -1063,6 +1115,8 @@ void ODESimulatorItemImpl::clear()
 {
     dJointGroupEmpty(contactJointGroupID);
 
+    clearThreading();
+
     if(worldID){
         dWorldDestroy(worldID);
         worldID = 0;
@@ -1124,6 +1178,8 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     dWorldSetContactMaxCorrectingVel(worldID, enableMaxCorrectingVel ? maxCorrectingVel.value() : dInfinity);
     dWorldSetContactSurfaceLayer(worldID, surfaceLayerDepth);
 
+    initializeThreading();
+
     timeStep = self->worldTimeStep();
 
     for(size_t i=0; i < simBodies.size(); ++i){
@@ -1136,12 +1192,72 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTime = 0;
         collisionTime = 0;
+        dynamicsTime = 0;
+        numSteps = 0;
     }
 
     return true;
 }
 
 
+/**
+   The world step is processed by the threads of the pool. The islands of the bodies connected by
+   the joints or contacts are solved in parallel when the island parallel solving is enabled, and
+   the constraints of an island are solved in parallel by the quick step in any case.
+   The collision detection by dSpaceCollide is not parallelized by ODE.
+*/
+void ODESimulatorItemImpl::initializeThreading()
+{
+#ifdef ODE_THREADING_ENABLED
+    if(numThreads < 2){
+        return;
+    }
+    threadingImpl = dThreadingAllocateMultiThreadedImplementation();
+    if(!threadingImpl){
+        MessageOut::master()->putWarningln(
+            format(_("The multi-threaded simulation of {0} is not available because ODE is built without "
+                     "the threading implementation. The simulation is processed by a single thread."),
+                   self->displayName()));
+        return;
+    }
+    threadPool = dThreadingAllocateThreadPool(numThreads, 0, dAllocateFlagBasicData, nullptr);
+    if(!threadPool){
+        dThreadingFreeImplementation(threadingImpl);
+        threadingImpl = nullptr;
+        return;
+    }
+    dThreadingThreadPoolServeMultiThreadedImplementation(threadPool, threadingImpl);
+    dWorldSetStepThreadingImplementation(
+        worldID, dThreadingImplementationGetFunctions(threadingImpl), threadingImpl);
+    dWorldSetStepIslandsProcessingMaxThreadCount(worldID, isIslandParallelSolvingEnabled ? numThreads : 1);
+#else
+    if(numThreads >= 2){
+        MessageOut::master()->putWarningln(
+            format(_("The multi-threaded simulation of {0} is not available because the ODE library "
+                     "does not support it. The simulation is processed by a single thread."),
+                   self->displayName()));
+    }
+#endif
+}
+
+
+void ODESimulatorItemImpl::clearThreading()
+{
+#ifdef ODE_THREADING_ENABLED
+    if(threadingImpl){
+        dThreadingImplementationShutdownProcessing(threadingImpl);
+        dThreadingFreeThreadPool(threadPool);
+        threadPool = nullptr;
+        if(worldID){
+            dWorldSetStepThreadingImplementation(worldID, nullptr, nullptr);
+        }
+        dThreadingFreeImplementation(threadingImpl);
+        threadingImpl = nullptr;
+    }
+#endif
+}
+
+
 void ODESimulatorItemImpl::addBody(ODEBody* odeBody)
 {
     Body& body = *odeBody->body();
@@ -1273,7 +1389,11 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
 
     dJointGroupEmpty(contactJointGroupID);
 
+    if(MEASURE_PHYSICS_CALCULATION_TIME){
+        collisionTimer.start();
+    }
     if(useWorldCollisionDetector){
+        CNOID_TRACE_ZONE("ODE collision detection");
         bodyCollisionDetector.updatePositions(
             [&](Referenced* object, Isometry3*& out_Position){
                 out_Position = &(static_cast<ODELink*>(object)->link->position()); });
@@ -1282,23 +1402,27 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
             [&](const CollisionPair& collisionPair){ onCollisionPairDetected(collisionPair); });
         
     } else {
-        if(MEASURE_PHYSICS_CALCULATION_TIME){
-            collisionTimer.start();
-        }
+        CNOID_TRACE_ZONE("ODE collision detection");
         dSpaceCollide(spaceID, (void*)this, &nearCallback);
-        if(MEASURE_PHYSICS_CALCULATION_TIME){
-            collisionTime += collisionTimer.nsecsElapsed();
-        }
+    }
+    if(MEASURE_PHYSICS_CALCULATION_TIME){
+        collisionTime += collisionTimer.nsecsElapsed();
+        dynamicsTimer.start();
     }
 
-    if(stepMode.is(ODESimulatorItem::STEP_ITERATIVE)){
-        dWorldQuickStep(worldID, timeStep);
-    } else {
-        dWorldStep(worldID, timeStep);
+    {
+        CNOID_TRACE_ZONE("ODE world step");
+        if(stepMode.is(ODESimulatorItem::STEP_ITERATIVE)){
+            dWorldQuickStep(worldID, timeStep);
+        } else {
+            dWorldStep(worldID, timeStep);
+        }
     }
 
     if(MEASURE_PHYSICS_CALCULATION_TIME){
+        dynamicsTime += dynamicsTimer.nsecsElapsed();
         physicsTime += physicsTimer.nsecsElapsed();
+        ++numSteps;
     }
 
     //! \todo Bodies with sensors should be managed by the specialized container to increase the efficiency
@@ -1394,7 +1518,13 @@ void ODESimulatorItem::finalizeSimulation()
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         cout << "ODE physicsTime= " << impl->physicsTime *1.0e-9 << "[s]"<< endl;
         cout << "ODE collisionTime= " << impl->collisionTime *1.0e-9 << "[s]"<< endl;
+        if(impl->numSteps > 0){
+            impl->averageCollisionTime = impl->collisionTime * 1.0e-6 / impl->numSteps;
+            impl->averageDynamicsTime = impl->dynamicsTime * 1.0e-6 / impl->numSteps;
+            notifyUpdate();
+        }
     }
+    impl->clearThreading();
 }
 
 
@@ -1432,6 +1562,14 @@ void ODESimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
 
     putProperty(_("Use WorldItem's Collision Detector"), useWorldCollisionDetector, changeProperty(useWorldCollisionDetector));
+
+    putProperty.min(1).max(256)(_("Threads"), numThreads, changeProperty(numThreads));
+
+    putProperty(_("Parallel island solving"), isIslandParallelSolvingEnabled,
+                changeProperty(isIslandParallelSolvingEnabled));
+
+    putProperty(_("Collision detection time [ms/step]"), format("{:.4f}", averageCollisionTime));
+    putProperty(_("Dynamics time [ms/step]"), format("{:.4f}", averageDynamicsTime));
 }
 
 
@@ -1457,6 +1595,8 @@ void ODESimulatorItemImpl::store(Archive& archive)
     archive.write("maxCorrectingVel", maxCorrectingVel);
     archive.write("2Dmode", is2Dmode);
     archive.write("useWorldCollisionDetector", useWorldCollisionDetector);
+    archive.write("numThreads", numThreads);
+    archive.write("islandParallelSolving", isIslandParallelSolvingEnabled);
 }
 
 
@@ -1487,4 +1627,6 @@ void ODESimulatorItemImpl::restore(const Archive& archive)
     if(!archive.read("useWorldCollisionDetector", useWorldCollisionDetector)){
         archive.read("UseWorldItem'sCollisionDetector", useWorldCollisionDetector);
     }
+    archive.read("numThreads", numThreads);
+    archive.read("islandParallelSolving", isIslandParallelSolvingEnabled);
 }
@@ -37,6 +37,17 @@ public:
     void setSurfaceLayerDepth(double value);
     void useWorldCollisionDetector(bool on);
 
+    /**
+       The world step is processed by multiple threads when the number of threads is more than one.
+       This requires ODE built with the threading implementation.
+    */
+    void setNumThreads(int n);
+    void setIslandParallelSolvingEnabled(bool on);
+
+    //! The average computation time of the last simulation in milliseconds per step
+    double averageCollisionDetectionTime() const;
+    double averageDynamicsTime() const;
+
     virtual void setAllLinkPositionOutputMode(bool on) override;
     virtual Vector3 getGravity() const override;
 
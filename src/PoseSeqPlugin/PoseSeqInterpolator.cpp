@@ -12,11 +12,16 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/Array2D>
 #include <cnoid/ConnectionSet>
+#include <cnoid/ThreadPool>
 #include <cnoid/stdx/optional>
 #include <list>
 #include <vector>
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <functional>
+#include <memory>
 
 using namespace std;
 using namespace cnoid;
@@ -247,10 +252,28 @@ public:
 
     bool needUpdate;
 
+    /*
+       The following members record the changes of the poses after the last update when the
+       update of all the samples is not required. The joint samples only depend on the poses
+       where the joints are valid, and the link, ZMP and lip sync samples only depend on the poses
+       with IK links or ZMP and the pronunciation symbols, so each kind of the samples is updated
+       only when the poses it depends on are changed.
+    */
+    // The modified poses, whose joint samples can be updated partially
+    vector<PoseSeq::iterator> modifiedPoses;
+    // The joints whose samples must be rebuilt because poses with them are inserted or removed
+    vector<bool> jointsToRebuild;
+    bool hasJointsToRebuild;
+    vector<bool> jointValidityBeforeModification;
+    bool needLinkAndZmpUpdate;
+
     ConnectionSet poseSeqConnections;
 
     vector<JointInfo> jointInfos;
 
+    // The pool is kept to avoid creating threads on every update
+    unique_ptr<ThreadPool> jointThreadPool;
+
     typedef unordered_map<int, LinkInfo, std::hash<int>, std::equal_to<int>,
                           Eigen::aligned_allocator<pair<const int, LinkInfo>>> LinkInfoMap;
     LinkInfoMap ikLinkInfos;
@@ -373,9 +396,18 @@ public:
     void insertAuxKeyPosesForStealthySteps();
     void insertAuxKeyPosesForToeSteps();
     bool update();
+    void updateAllSamples();
+    void updateLinkAndZmpSamples();
+    void forEachJoint(const std::function<void(int jointId)>& func);
+    void buildJointSamples(int jointId);
+    void updateJointSamplesOfModifiedPoses();
+    void requestToRebuildJointSamples(PoseSeq::iterator it);
+    bool updateJointSamplesPartially(int jointId, const unordered_set<const SequentialPose*>& poses);
     LinkInfo* getIkLinkInfo(int linkIndex);
+    bool hasLinkOrZmpSamples(PoseSeq::iterator it);
     void onPoseInserted(PoseSeq::iterator it);
     void onPoseAboutToBeRemoved(PoseSeq::iterator it, bool isMoving);
+    void onPoseAboutToBeModified(PoseSeq::iterator it);
     void onPoseModified(PoseSeq::iterator it);
 };
 }
@@ -801,6 +833,8 @@ PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self)
     isLipSyncMixEnabled = false;
     
     needUpdate = true;
+    hasJointsToRebuild = false;
+    needLinkAndZmpUpdate = false;
 }
 
 
@@ -814,6 +848,7 @@ void PoseSeqInterpolator::Impl::setBody(Body* body0)
 {
     body.reset();
     jointInfos.clear();
+    jointsToRebuild.clear();
     ikLinkInfos.clear();
     footLinkIndices.clear();
     ikJointPathMap.clear();
@@ -824,6 +859,7 @@ void PoseSeqInterpolator::Impl::setBody(Body* body0)
         body = body0->clone();
         int n = body->numJoints();
         jointInfos.resize(n);
+        jointsToRebuild.resize(n, false);
         validIkLinkFlag.resize(body->numLinks(), false);
 
         legged = getLeggedBodyHelper(body);
@@ -977,6 +1013,11 @@ void PoseSeqInterpolator::Impl::setPoseSeq(PoseSeq* seq)
             [this](PoseSeq::iterator it, bool isMoving){
                 onPoseAboutToBeRemoved(it, isMoving);
             }));
+    poseSeqConnections.add(
+        seq->sigPoseAboutToBeModified().connect(
+            [this](PoseSeq::iterator it){
+                onPoseAboutToBeModified(it);
+            }));
     poseSeqConnections.add(
         seq->sigPoseModified().connect(
             [this](PoseSeq::iterator it){
@@ -1010,21 +1051,33 @@ double PoseSeqInterpolator::endingTime() const
 }
 
 
+/*
+   The following functions only request the update when the parameters are actually changed
+   so that the partial update for modified poses is not disabled by setting the same parameters
+   before every update.
+*/
+template<class T> static void updateParameter(T& parameter, const T& value, bool& needUpdate)
+{
+    if(value != parameter){
+        parameter = value;
+        needUpdate = true;
+    }
+}
+
+
 void PoseSeqInterpolator::enableAutoZmpAdjustmentMode(bool on)
 {
-    impl->isAutoZmpAdjustmentMode = on;
-    impl->needUpdate = true;
+    updateParameter(impl->isAutoZmpAdjustmentMode, on, impl->needUpdate);
 }
 
 
 void PoseSeqInterpolator::setZmpAdjustmentParameters
 (double minTransitionTime, double centeringTimeThresh, double timeMarginBeforeLifting, double maxDistanceFromCenter)
 {
-    impl->minZmpTransitionTime = minTransitionTime;
-    impl->zmpCenteringTimeThresh = centeringTimeThresh;
-    impl->zmpTimeMarginBeforeLifting = timeMarginBeforeLifting;
-    impl->zmpMaxDistanceFromCenterSqr = maxDistanceFromCenter * maxDistanceFromCenter;
-    impl->needUpdate = true;
+    updateParameter(impl->minZmpTransitionTime, minTransitionTime, impl->needUpdate);
+    updateParameter(impl->zmpCenteringTimeThresh, centeringTimeThresh, impl->needUpdate);
+    updateParameter(impl->zmpTimeMarginBeforeLifting, timeMarginBeforeLifting, impl->needUpdate);
+    updateParameter(impl->zmpMaxDistanceFromCenterSqr, maxDistanceFromCenter * maxDistanceFromCenter, impl->needUpdate);
 }
 
 
@@ -1036,8 +1089,7 @@ int PoseSeqInterpolator::stepTrajectoryAdjustmentMode() const
 
 void PoseSeqInterpolator::setStepTrajectoryAdjustmentMode(int mode)
 {
-    impl->stepTrajectoryAdjustmentMode = mode;
-    impl->needUpdate = true;
+    updateParameter(impl->stepTrajectoryAdjustmentMode, mode, impl->needUpdate);
 }
 
 
@@ -1046,21 +1098,19 @@ void PoseSeqInterpolator::setStealthyStepParameters
  double flatLiftingHeight, double flatLandingHeight,
  double impactReductionHeight, double impactReductionTime)
 {
-    impl->stealthyHeightRatioThresh = heightRatioThresh;
-    impl->flatLiftingHeight = flatLiftingHeight;
-    impl->flatLandingHeight = flatLandingHeight;
-    impl->impactReductionHeight = impactReductionHeight;
-    impl->impactReductionTime = impactReductionTime;
+    updateParameter(impl->stealthyHeightRatioThresh, heightRatioThresh, impl->needUpdate);
+    updateParameter(impl->flatLiftingHeight, flatLiftingHeight, impl->needUpdate);
+    updateParameter(impl->flatLandingHeight, flatLandingHeight, impl->needUpdate);
+    updateParameter(impl->impactReductionHeight, impactReductionHeight, impl->needUpdate);
+    updateParameter(impl->impactReductionTime, impactReductionTime, impl->needUpdate);
     impl->impactReductionVelocity = -2.0 * impactReductionHeight / impactReductionTime;
-    impl->needUpdate = true;
 }
 
 
 void PoseSeqInterpolator::setToeStepParameters(double toeContactAngle, double toeContactTime)
 {
-    impl->toeContactAngle = toeContactAngle;
-    impl->toeContactTime = toeContactTime;
-    impl->needUpdate = true;
+    updateParameter(impl->toeContactAngle, toeContactAngle, impl->needUpdate);
+    updateParameter(impl->toeContactTime, toeContactTime, impl->needUpdate);
 }
 
 
@@ -1142,7 +1192,7 @@ bool PoseSeqInterpolator::Impl::interpolate(double time, int waistLinkIndex, con
         return false;
     }
 
-    if(needUpdate){
+    if(needUpdate || !modifiedPoses.empty() || hasJointsToRebuild || needLinkAndZmpUpdate){
         if(!update()){
             return false;
         }
@@ -1540,10 +1590,43 @@ bool PoseSeqInterpolator::Impl::update()
     if(!body || !poseSeq){
         return false;
     }
-    
-    for(size_t i=0; i < jointInfos.size(); ++i){
-        jointInfos[i].clear();
+
+    if(needUpdate){
+        updateAllSamples();
+    } else {
+        if(!modifiedPoses.empty() || hasJointsToRebuild){
+            updateJointSamplesOfModifiedPoses();
+        }
+        if(needLinkAndZmpUpdate){
+            updateLinkAndZmpSamples();
+        }
     }
+    modifiedPoses.clear();
+    std::fill(jointsToRebuild.begin(), jointsToRebuild.end(), false);
+    hasJointsToRebuild = false;
+    needLinkAndZmpUpdate = false;
+
+    invalidateCurrentInterpolation();
+    needUpdate = false;
+
+    sigUpdated();
+
+    return true;
+}
+
+
+void PoseSeqInterpolator::Impl::updateAllSamples()
+{
+    // The joint samples do not depend on the other samples
+    forEachJoint([this](int jointId){ buildJointSamples(jointId); });
+
+    updateLinkAndZmpSamples();
+}
+
+
+//! The lip sync samples are also updated in this function
+void PoseSeqInterpolator::Impl::updateLinkAndZmpSamples()
+{
     ikLinkInfos.clear();
     zmpSamples.clear();
     orgZmpSampleIterPairs.clear();
@@ -1576,26 +1659,6 @@ bool PoseSeqInterpolator::Impl::update()
         } else {
             appendLinkSamples(poseIter, pose);
 
-            const int n = std::min(pose->numJoints(), (int)jointInfos.size());
-
-            for(int i=0; i < n; ++i){
-                JointInfo& jointInfo = jointInfos[i];
-                if(pose->isJointValid(i)){
-
-                    // make a flipping point stationary point
-                    double q = pose->jointDisplacement(i);
-                    double sign = q - jointInfo.prev_q;
-                    if(jointInfo.prevSegmentDirectionSign * sign <= 0.0){
-                        if(!jointInfo.samples.empty()){
-                            jointInfo.samples.back().isEndPoint = true;
-                        }
-                    }
-                    jointInfo.prevSegmentDirectionSign = sign;
-                    jointInfo.prev_q = q;
-
-                    appendSample(jointInfo.samples, JointSample(poseIter, i, jointInfo.useLinearInterpolation));
-                }
-            }
             if(pose->isZmpValid()){
                 if(isAutoZmpAdjustmentMode){
                     zmpSamples.push_back(ZmpSample(poseIter));
@@ -1625,13 +1688,6 @@ bool PoseSeqInterpolator::Impl::update()
         }
     }
 
-    for(size_t i=0; i < jointInfos.size(); ++i){
-        JointInfo& info = jointInfos[i];
-        if(!info.useLinearInterpolation){
-            initializeInterpolation<1, JointSample, false>(info.samples);
-        }
-        info.iter = info.samples.begin();
-    }
     for(auto& kv : ikLinkInfos){
         LinkInfo& info = kv.second;
         initializeInterpolation<6, LinkSample, false>(info.samples);
@@ -1646,16 +1702,291 @@ bool PoseSeqInterpolator::Impl::update()
     zmpIter = zmpSamples.begin();
 
     lipSyncIter = lipSyncSeq.begin();
+}
 
-    invalidateCurrentInterpolation();
-    needUpdate = false;
 
-    sigUpdated();
+/**
+   The function is executed for each joint in parallel when the pose sequence is long enough.
+   The function must not access any data other than the data of the given joint.
+*/
+void PoseSeqInterpolator::Impl::forEachJoint(const std::function<void(int jointId)>& func)
+{
+    const int numJoints = jointInfos.size();
+    int numThreads = 1;
+    if(poseSeq->size() >= 100){
+        numThreads = std::min(static_cast<int>(std::thread::hardware_concurrency()), numJoints / 4);
+    }
+    if(numThreads <= 1){
+        for(int i=0; i < numJoints; ++i){
+            func(i);
+        }
+        return;
+    }
+    // The calling thread also processes the joints
+    if(!jointThreadPool || jointThreadPool->size() < numThreads - 1){
+        jointThreadPool.reset(new ThreadPool(numThreads - 1));
+    }
+    auto processJoints = [&func, numThreads, numJoints](int index){
+        for(int jointId = index; jointId < numJoints; jointId += numThreads){
+            func(jointId);
+        }
+    };
+    for(int i=1; i < numThreads; ++i){
+        jointThreadPool->start([&processJoints, i](){ processJoints(i); });
+    }
+    processJoints(0);
+    jointThreadPool->wait();
+}
 
-    return true;
+
+void PoseSeqInterpolator::Impl::buildJointSamples(int jointId)
+{
+    JointInfo& info = jointInfos[jointId];
+    info.clear();
+
+    for(PoseSeq::iterator poseIter = poseSeq->begin(); poseIter != poseSeq->end(); ++poseIter){
+        auto pose = poseIter->get<BodyKeyPose>();
+        if(pose && pose->isJointValid(jointId)){
+            // make a flipping point stationary point
+            double q = pose->jointDisplacement(jointId);
+            double sign = q - info.prev_q;
+            if(info.prevSegmentDirectionSign * sign <= 0.0){
+                if(!info.samples.empty()){
+                    info.samples.back().isEndPoint = true;
+                }
+            }
+            info.prevSegmentDirectionSign = sign;
+            info.prev_q = q;
+
+            appendSample(info.samples, JointSample(poseIter, jointId, info.useLinearInterpolation));
+        }
+    }
+
+    if(!info.useLinearInterpolation){
+        initializeInterpolation<1, JointSample, false>(info.samples);
+    }
+    info.iter = info.samples.begin();
+}
+
+
+void PoseSeqInterpolator::Impl::updateJointSamplesOfModifiedPoses()
+{
+    unordered_set<const SequentialPose*> poses;
+    for(auto& it : modifiedPoses){
+        poses.insert(&(*it));
+    }
+    forEachJoint(
+        [this, &poses](int jointId){
+            if(jointsToRebuild[jointId] || !updateJointSamplesPartially(jointId, poses)){
+                buildJointSamples(jointId);
+            }
+        });
 }
 
 
+/**
+   The samples of the other joints do not refer to the pose and the transition samples
+   of them are not affected by the pose.
+*/
+void PoseSeqInterpolator::Impl::requestToRebuildJointSamples(PoseSeq::iterator it)
+{
+    if(auto pose = it->get<BodyKeyPose>()){
+        const int n = std::min(pose->numJoints(), static_cast<int>(jointsToRebuild.size()));
+        for(int i=0; i < n; ++i){
+            if(pose->isJointValid(i)){
+                jointsToRebuild[i] = true;
+                hasJointsToRebuild = true;
+            }
+        }
+    }
+}
+
+
+/**
+   This function updates the samples and the segments around the samples of the given poses
+   so that the result is the same as that of buildJointSamples.
+   \return false if the samples cannot be updated partially because the validity, the time or
+   the transition time of the joint sample of any given pose is changed.
+*/
+bool PoseSeqInterpolator::Impl::updateJointSamplesPartially
+(int jointId, const unordered_set<const SequentialPose*>& poses)
+{
+    JointInfo& info = jointInfos[jointId];
+    auto& samples = info.samples;
+    const auto end = samples.end();
+
+    /*
+       A sample inserted at the start point of a transition is a copy of the sample of the
+       previous pose, and it is placed just after the copied sample.
+    */
+    auto isTransitionSample = [&](JointSample::Seq::iterator s){
+        if(s == samples.begin()){
+            return false;
+        }
+        auto prev = s;
+        --prev;
+        return prev->poseIter == s->poseIter;
+    };
+    auto prevPoseSample = [&](JointSample::Seq::iterator s){
+        if(s == samples.begin()){
+            return end;
+        }
+        --s;
+        if(isTransitionSample(s)){
+            --s;
+        }
+        return s;
+    };
+    auto nextPoseSample = [&](JointSample::Seq::iterator s){
+        auto next = s;
+        ++next;
+        if(next != end && next->poseIter == s->poseIter){
+            ++next;
+        }
+        return next;
+    };
+
+    int numValidPoses = 0;
+    double minTime = std::numeric_limits<double>::max();
+    double maxTime = -std::numeric_limits<double>::max();
+    for(auto& pose : poses){
+        if(pose->get<BodyKeyPose>()->isJointValid(jointId)){
+            ++numValidPoses;
+        }
+        minTime = std::min(minTime, pose->time());
+        maxTime = std::max(maxTime, pose->time());
+    }
+
+    /*
+       The sample of a pose whose time is changed is not found in the time range,
+       and the mismatch of the number of the found samples results in the full update.
+    */
+    vector<JointSample::Seq::iterator> modifiedSamples;
+    for(auto s = samples.begin(); s != end; ++s){
+        if(s->x < minTime || s->x > maxTime ||
+           poses.find(&(*s->poseIter)) == poses.end() || isTransitionSample(s)){
+            continue;
+        }
+        if(!s->poseIter->get<BodyKeyPose>()->isJointValid(jointId) || s->x != s->poseIter->time()){
+            return false;
+        }
+        // Check the sample at the start point of the transition to the pose
+        auto prev = prevPoseSample(s);
+        const double ttime = s->poseIter->maxTransitionTime();
+        bool hasTransitionSample = (prev != end && ttime > 0.0 && s->x - prev->x > ttime);
+        auto before = s;
+        if(s != samples.begin()){
+            --before;
+        }
+        if(hasTransitionSample != (prev != end && before != prev)){
+            return false;
+        }
+        if(hasTransitionSample && before->x != s->x - ttime){
+            return false;
+        }
+        modifiedSamples.push_back(s);
+    }
+    if(static_cast<int>(modifiedSamples.size()) != numValidPoses){
+        return false; // The joint has become valid in some poses
+    }
+    if(modifiedSamples.empty()){
+        return true;
+    }
+
+    for(auto& s : modifiedSamples){
+        auto pose = s->poseIter->get<BodyKeyPose>();
+        s->c[0].y = pose->jointDisplacement(jointId);
+        auto next = s;
+        ++next;
+        if(next != end && next->poseIter == s->poseIter){
+            next->c[0].y = s->c[0].y;
+        }
+    }
+
+    if(info.useLinearInterpolation){
+        return true;
+    }
+
+    /*
+       The velocity of a sample depends on the values of the adjacent samples, and whether the
+       sample is an end point or not depends on the values of the adjacent pose samples.
+       The segment coefficients depend on the values and velocities of the both ends.
+    */
+    auto updateVelocity = [&](JointSample::Seq::iterator s){
+        auto pose = s->poseIter->get<BodyKeyPose>();
+        bool isEndPoint = pose->isJointStationaryPoint(jointId);
+        auto nextPose = nextPoseSample(s);
+        if(nextPose != end){
+            auto prevPose = prevPoseSample(s);
+            double prev_q = (prevPose != end) ? prevPose->c[0].y : 0.0;
+            double sign0 = s->c[0].y - prev_q;
+            double sign1 = nextPose->c[0].y - s->c[0].y;
+            if(sign0 * sign1 <= 0.0){
+                isEndPoint = true; // flipping point
+            }
+            auto next = s;
+            ++next;
+            if(next != nextPose){
+                isEndPoint = true; // followed by a transition sample
+            }
+        }
+        Coeff& c = s->c[0];
+        c.yp = 0.0;
+        if(!isEndPoint){
+            auto prev = s;
+            if(prev != samples.begin()){
+                --prev;
+            }
+            auto next = s;
+            ++next;
+            if(next == end){
+                next = s;
+            }
+            double dy0 = (c.y - prev->c[0].y);
+            double dy1 = (next->c[0].y - c.y);
+            if(fabs(dy0) >= 1.0e-3 && fabs(dy1) >= 1.0e-3 && dy0 * dy1 > 0.0){
+                c.yp = (dy0 / (s->x - prev->x) + dy1 / (next->x - s->x)) / 2.0;
+            }
+        }
+    };
+
+    for(auto& s : modifiedSamples){
+        auto prevPose = prevPoseSample(s);
+        if(prevPose != end){
+            updateVelocity(prevPose);
+        }
+        updateVelocity(s);
+        auto nextPose = nextPoseSample(s);
+        if(nextPose != end){
+            updateVelocity(nextPose);
+        }
+    }
+
+    for(auto& s : modifiedSamples){
+        auto first = prevPoseSample(s);
+        if(first == end){
+            first = s;
+        } else if(first != samples.begin()){
+            --first;
+        }
+        auto last = nextPoseSample(s);
+        if(last != end){
+            ++last;
+        }
+        for(auto segment = first; segment != last; ++segment){
+            auto next = segment;
+            if(++next == end){
+                break;
+            }
+            updateCubicConnectionSegment<1, JointSample>(segment);
+        }
+    }
+
+    info.iter = samples.begin();
+    
+    return true;
+}
+
 void PoseSeqInterpolator::Impl::appendLinkSamples(PoseSeq::iterator poseIter, BodyKeyPose* pose)
 {
     for(auto it = pose->ikLinkBegin(); it != pose->ikLinkEnd(); ++it){
@@ -2257,19 +2588,82 @@ LinkInfo* PoseSeqInterpolator::Impl::getIkLinkInfo(int linkIndex)
 }
 
 
-void PoseSeqInterpolator::Impl::onPoseInserted(PoseSeq::iterator /* pose */)
+/**
+   \return true if the pose is referred by the link, ZMP or lip sync samples.
+*/
+bool PoseSeqInterpolator::Impl::hasLinkOrZmpSamples(PoseSeq::iterator it)
 {
-    needUpdate = true;
+    auto pose = it->get<BodyKeyPose>();
+    if(!pose){
+        return it->get<PronunSymbol>() != nullptr;
+    }
+    return pose->numIkLinks() > 0 || pose->isZmpValid();
 }
 
 
-void PoseSeqInterpolator::Impl::onPoseAboutToBeRemoved(PoseSeq::iterator /* pose */, bool /* isMoving */)
+void PoseSeqInterpolator::Impl::onPoseInserted(PoseSeq::iterator it)
 {
-    needUpdate = true;
+    if(!needUpdate){
+        requestToRebuildJointSamples(it);
+        if(hasLinkOrZmpSamples(it)){
+            needLinkAndZmpUpdate = true;
+        }
+    }
 }
 
 
-void PoseSeqInterpolator::Impl::onPoseModified(PoseSeq::iterator /* pose */)
+void PoseSeqInterpolator::Impl::onPoseAboutToBeRemoved(PoseSeq::iterator it, bool /* isMoving */)
 {
-    needUpdate = true;
+    if(!needUpdate){
+        requestToRebuildJointSamples(it);
+        if(hasLinkOrZmpSamples(it)){
+            needLinkAndZmpUpdate = true;
+        }
+        modifiedPoses.erase(
+            std::remove(modifiedPoses.begin(), modifiedPoses.end(), it), modifiedPoses.end());
+    }
+}
+
+
+void PoseSeqInterpolator::Impl::onPoseAboutToBeModified(PoseSeq::iterator it)
+{
+    if(!needUpdate){
+        if(hasLinkOrZmpSamples(it)){
+            needLinkAndZmpUpdate = true;
+        }
+        jointValidityBeforeModification.clear();
+        if(auto pose = it->get<BodyKeyPose>()){
+            const int n = jointsToRebuild.size();
+            jointValidityBeforeModification.resize(n);
+            for(int i=0; i < n; ++i){
+                jointValidityBeforeModification[i] = pose->isJointValid(i);
+            }
+        }
+    }
+}
+
+
+/**
+   The modification of the joint displacements of a pose is processed by updating the joint
+   samples around the pose, and the joints which become valid or invalid in the pose are rebuilt.
+   The link and ZMP samples are updated only if the pose has IK links or ZMP before or after the
+   modification because they are affected by the automatic ZMP and step adjustments.
+*/
+void PoseSeqInterpolator::Impl::onPoseModified(PoseSeq::iterator it)
+{
+    if(!needUpdate){
+        if(hasLinkOrZmpSamples(it)){
+            needLinkAndZmpUpdate = true;
+        }
+        if(auto pose = it->get<BodyKeyPose>()){
+            const int n = jointValidityBeforeModification.size();
+            for(int i=0; i < n; ++i){
+                if(pose->isJointValid(i) != jointValidityBeforeModification[i]){
+                    jointsToRebuild[i] = true;
+                    hasJointsToRebuild = true;
+                }
+            }
+            modifiedPoses.push_back(it);
+        }
+    }
 }
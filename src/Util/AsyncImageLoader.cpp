@@ -0,0 +1,263 @@
+#include "AsyncImageLoader.h"
+#include "ImageIO.h"
+#include "MessageOut.h"
+#include "ThreadPool.h"
+#include "UTF8.h"
+#include "ZipFileSystem.h"
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <map>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace fs = stdx::filesystem;
+
+namespace {
+
+std::function<void(const std::function<void()>& func)> mainThreadDispatcher;
+
+class DecodedImage : public SgImage::PendingImage
+{
+public:
+    fs::file_time_type lastWriteTime;
+    uintmax_t fileSize;
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable condition;
+    // The image is not modified after this flag is set
+    std::atomic<bool> isDecoded;
+    shared_ptr<Image> image;
+    vector<weak_ref_ptr<SgImage>> imagesToNotify;
+
+    DecodedImage() : isDecoded(false) { }
+
+    virtual bool isReady() const override {
+        return isDecoded.load(std::memory_order_acquire);
+    }
+
+    virtual const shared_ptr<Image>& get() const override {
+        if(!isDecoded.load(std::memory_order_acquire)){
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this](){ return isDecoded.load(); });
+        }
+        return image;
+    }
+
+    virtual void addImageToNotify(SgImage* sgImage) override {
+        if(mainThreadDispatcher){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!isDecoded){
+                imagesToNotify.push_back(sgImage);
+            }
+        }
+    }
+
+    size_t dataSize() const {
+        if(!isDecoded.load(std::memory_order_acquire) || !image){
+            return 0;
+        }
+        return image->width() * image->height() * image->numComponents();
+    }
+};
+
+typedef shared_ptr<DecodedImage> DecodedImagePtr;
+
+std::mutex cacheMutex;
+typedef list<pair<string, DecodedImagePtr>> CacheList;
+// The front is the most recently used image
+CacheList cacheList;
+map<string, CacheList::iterator> cacheMap;
+size_t cacheSizeLimit = 256 * 1024 * 1024;
+
+ThreadPool* getDecodingThreadPool()
+{
+    // The pool is not deleted to avoid joining the threads in the termination of the process
+    static ThreadPool* pool =
+        new ThreadPool(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    return pool;
+}
+
+void decode(DecodedImagePtr decoded, string filename, bool isUpsideDown)
+{
+    auto image = make_shared<Image>();
+    ImageIO imageIO;
+    imageIO.setUpsideDown(isUpsideDown);
+    ostringstream os;
+    if(!imageIO.load(*image, filename, os)){
+        image.reset();
+    }
+
+    vector<weak_ref_ptr<SgImage>> images;
+    {
+        std::lock_guard<std::mutex> lock(decoded->mutex);
+        decoded->image = image;
+        decoded->isDecoded.store(true, std::memory_order_release);
+        images.swap(decoded->imagesToNotify);
+    }
+    decoded->condition.notify_all();
+
+    /*
+      The errors detected by checking the file are reported by loadImage. An error is only
+      detected here if the file is modified after it is checked, and then it is reported to
+      the master message output because the output of the loader may not be available.
+    */
+    auto message = os.str();
+    if(!message.empty()){
+        MessageOut::master()->putError(message);
+    }
+
+    // Request the renderers to draw the textures of the decoded image
+    if(!images.empty() && mainThreadDispatcher){
+        auto imagesPtr = make_shared<vector<weak_ref_ptr<SgImage>>>(std::move(images));
+        mainThreadDispatcher(
+            [imagesPtr](){
+                for(auto& weakImage : *imagesPtr){
+                    if(auto image = weakImage.lock()){
+                        image->notifyUpdate();
+                    }
+                }
+            });
+    }
+}
+
+void removeOldCachedImages()
+{
+    size_t totalSize = 0;
+    auto it = cacheList.begin();
+    while(it != cacheList.end()){
+        totalSize += it->second->dataSize();
+        if(totalSize > cacheSizeLimit && it != cacheList.begin()){
+            cacheMap.erase(it->first);
+            it = cacheList.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}
+
+
+AsyncImageLoader::AsyncImageLoader()
+{
+    isUpsideDown_ = false;
+}
+
+
+SgImagePtr AsyncImageLoader::loadImage(const std::string& filename, std::ostream& os)
+{
+    // The image file in a mounted archive is extracted when it is loaded for the first time
+    string errorMessage;
+    if(!ZipFileSystem::prepareFile(filename, errorMessage)){
+        os << errorMessage << endl;
+        return nullptr;
+    }
+    
+    fs::path path(fromUTF8(filename));
+    stdx::error_code ec;
+    auto lastWriteTime = fs::last_write_time(path, ec);
+    uintmax_t fileSize = 0;
+    if(!ec){
+        fileSize = fs::file_size(path, ec);
+    }
+    if(ec){
+        os << format(_("Image file \"{0}\" cannot be loaded. {1}"), filename, ec.message()) << endl;
+        return nullptr;
+    }
+
+    string key = filename;
+    if(isUpsideDown_){
+        key += "\n(upside-down)";
+    }
+
+    DecodedImagePtr decoded;
+    bool isNewImage = false;
+    bool isCacheAvailable = false;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto p = cacheMap.find(key);
+        isCacheAvailable =
+            p != cacheMap.end() &&
+            p->second->second->lastWriteTime == lastWriteTime && p->second->second->fileSize == fileSize;
+    }
+
+    // The image which cannot be decoded must be rejected here so that the caller can try another file
+    if(!isCacheAvailable){
+        ImageIO imageIO;
+        if(!imageIO.checkFile(filename, os)){
+            return nullptr;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto p = cacheMap.find(key);
+        if(p != cacheMap.end()){
+            auto it = p->second;
+            if(it->second->lastWriteTime == lastWriteTime && it->second->fileSize == fileSize){
+                decoded = it->second;
+                cacheList.splice(cacheList.begin(), cacheList, it);
+            } else {
+                cacheList.erase(it);
+                cacheMap.erase(p);
+            }
+        }
+        if(!decoded){
+            decoded = make_shared<DecodedImage>();
+            decoded->lastWriteTime = lastWriteTime;
+            decoded->fileSize = fileSize;
+            cacheList.emplace_front(key, decoded);
+            cacheMap[key] = cacheList.begin();
+            isNewImage = true;
+        }
+        removeOldCachedImages();
+    }
+
+    if(decoded->isReady() && !decoded->image){
+        os << format(_("Image file \"{0}\" cannot be loaded."), filename) << endl;
+        return nullptr;
+    }
+
+    SgImagePtr image = new SgImage(decoded);
+
+    if(isNewImage){
+        bool isUpsideDown = isUpsideDown_;
+        getDecodingThreadPool()->start(
+            [decoded, filename, isUpsideDown](){ decode(decoded, filename, isUpsideDown); });
+    }
+
+    return image;
+}
+
+
+void AsyncImageLoader::setMainThreadDispatcher
+(std::function<void(const std::function<void()>& func)> dispatcher)
+{
+    mainThreadDispatcher = dispatcher;
+}
+
+
+void AsyncImageLoader::setCacheSizeLimit(size_t size)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheSizeLimit = size;
+    removeOldCachedImages();
+}
+
+
+void AsyncImageLoader::clearCache()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheList.clear();
+    cacheMap.clear();
+}
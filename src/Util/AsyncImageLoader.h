@@ -0,0 +1,49 @@
+#ifndef CNOID_UTIL_ASYNC_IMAGE_LOADER_H
+#define CNOID_UTIL_ASYNC_IMAGE_LOADER_H
+
+#include "SceneDrawables.h"
+#include "NullOut.h"
+#include <functional>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class decodes the image files with worker threads so that the scene loaders do not wait for
+   the decoding. The image of the returned SgImage is given when the decoding is finished, and the
+   accessors of the image wait for it if it is not finished yet.
+
+   The decoded images are cached and shared between the loaders while the total size of the cached
+   images does not exceed the limit. The cached image is decoded again if the file is modified.
+*/
+class CNOID_EXPORT AsyncImageLoader
+{
+public:
+    AsyncImageLoader();
+
+    void setUpsideDown(bool on) { isUpsideDown_ = on; }
+
+    /**
+       The header of the file is checked before the decoding is started, and the errors are output to os.
+       \return nullptr if the file cannot be read or it is not a valid image file
+    */
+    SgImagePtr loadImage(const std::string& filename, std::ostream& os = nullout());
+
+    /**
+       The dispatcher is used to call the function that notifies the update of the images in the main
+       thread when the decoding is finished. The GUI application sets a dispatcher using callLater.
+    */
+    static void setMainThreadDispatcher(std::function<void(const std::function<void()>& func)> dispatcher);
+
+    //! The default limit is 256 MiB.
+    static void setCacheSizeLimit(size_t size);
+    static void clearCache();
+
+private:
+    bool isUpsideDown_;
+};
+
+}
+
+#endif
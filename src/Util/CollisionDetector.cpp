@@ -182,6 +182,18 @@ bool CollisionDetector::isDynamicGeometryPairChangeEnabled() const
 }
 
 
+void CollisionDetector::setIncrementalDetectionEnabled(bool /* on */)
+{
+
+}
+
+
+bool CollisionDetector::isIncrementalDetectionEnabled() const
+{
+    return false;
+}
+
+
 bool CollisionDetector::removeGeometry(GeometryHandle /* geometry */)
 {
     return false;
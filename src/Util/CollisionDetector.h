@@ -5,6 +5,7 @@
 #include "Referenced.h"
 #include <cnoid/stdx/optional>
 #include <vector>
+#include <limits>
 #include <cstdint>
 #include "exportdecl.h"
 
@@ -70,6 +71,16 @@ public:
     virtual void setDynamicGeometryPairChangeEnabled(bool on);
     virtual bool isDynamicGeometryPairChangeEnabled() const;
 
+    /**
+       If the incremental detection is enabled, the collision detector keeps the results of the
+       geometry pairs and only tests the pairs including the geometries whose positions have been
+       changed since the last detection. This mode is suitable for interactive operations where
+       only a few geometries move at a time. Note that this mode is optional and it is not
+       inherited by the clone of the detector.
+    */
+    virtual void setIncrementalDetectionEnabled(bool on);
+    virtual bool isIncrementalDetectionEnabled() const;
+
     virtual bool removeGeometry(GeometryHandle geometry);
     virtual bool isGeometryRemovalSupported() const;
 
@@ -93,6 +104,28 @@ public:
     virtual double detectDistance(
         CollisionDetector::GeometryHandle geometry1, CollisionDetector::GeometryHandle geometry2,
         Vector3& out_point1, Vector3& out_point2) = 0;
+
+    struct DistanceQuery
+    {
+        CollisionDetector::GeometryHandle geometry1;
+        CollisionDetector::GeometryHandle geometry2;
+        double distance;
+        Vector3 point1;
+        Vector3 point2;
+    };
+
+    /**
+       The distances of the geometry pairs are computed in a batch. When the distance of a pair
+       is not less than maxDistance, the computation of the pair is aborted and a lower bound of
+       the distance that is not less than maxDistance is set without the points.
+       A negative distance is set when the distance of the pair cannot be computed.
+    */
+    virtual void detectDistances(
+        std::vector<DistanceQuery>& queries, double maxDistance = std::numeric_limits<double>::max()) {
+        for(auto& query : queries){
+            query.distance = detectDistance(query.geometry1, query.geometry2, query.point1, query.point2);
+        }
+    }
 };
 
 
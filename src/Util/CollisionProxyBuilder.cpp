@@ -0,0 +1,269 @@
+#include "CollisionProxyBuilder.h"
+#include "MeshSimplifier.h"
+#include "MeshExtractor.h"
+#include "GeometryRegistry.h"
+#include "SceneDrawables.h"
+#include "ValueTree.h"
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/*
+   The proxies are first looked up by the source node so that the meshes of the source
+   are not integrated again for a known node. The entry holds the source weakly and the proxy
+   strongly, so the proxy lives as long as the source node and the entry is removed after the
+   source is released. The content cache makes the sources with the same meshes share a proxy
+   only while the proxy is used, so neither of the caches grows beyond the live sources.
+*/
+struct SourceCacheEntry
+{
+    weak_ref_ptr<SgNode> source;
+    SgNodePtr proxy;
+};
+typedef pair<const SgNode*, CollisionProxyBuilder::Spec> SourceCacheKey;
+typedef pair<uint64_t, CollisionProxyBuilder::Spec> ContentCacheKey;
+
+std::mutex cacheMutex;
+map<SourceCacheKey, SourceCacheEntry> sourceCache;
+map<ContentCacheKey, weak_ref_ptr<SgNode>> contentCache;
+size_t numInsertionsSinceLastCleanup = 0;
+
+void removeExpiredEntries()
+{
+    auto p = sourceCache.begin();
+    while(p != sourceCache.end()){
+        if(p->second.source.expired()){
+            p = sourceCache.erase(p);
+        } else {
+            ++p;
+        }
+    }
+    auto q = contentCache.begin();
+    while(q != contentCache.end()){
+        if(q->second.expired()){
+            q = contentCache.erase(q);
+        } else {
+            ++q;
+        }
+    }
+    numInsertionsSinceLastCleanup = 0;
+}
+
+void registerProxy(const SourceCacheKey& key, SgNode* source, SgNode* proxy)
+{
+    auto& entry = sourceCache[key];
+    entry.source = weak_ref_ptr<SgNode>(source);
+    entry.proxy = proxy;
+
+    if(++numInsertionsSinceLastCleanup > sourceCache.size() / 2){
+        removeExpiredEntries();
+    }
+}
+
+SgNode* createProxy(SgMesh* integrated, const CollisionProxyBuilder::Spec& spec)
+{
+    MeshSimplifier simplifier;
+    SgMeshPtr mesh;
+
+    switch(spec.type){
+
+    case CollisionProxyBuilder::SimplifiedMesh:
+        simplifier.setTargetNumTriangles(spec.maxNumTriangles);
+        simplifier.setMaxError(spec.maxError);
+        mesh = simplifier.simplify(integrated);
+        break;
+
+    case CollisionProxyBuilder::ConvexHull:
+        mesh = simplifier.createConvexHull(integrated);
+        break;
+
+    case CollisionProxyBuilder::BoundingBox:
+    {
+        Vector3 center;
+        mesh = simplifier.createBoundingBox(integrated, &center);
+        if(mesh){
+            auto shape = new SgShape;
+            shape->setMesh(mesh);
+            auto transform = new SgPosTransform;
+            transform->setTranslation(center);
+            transform->addChild(shape);
+            return transform;
+        }
+        return nullptr;
+    }
+    default:
+        return nullptr;
+    }
+
+    if(!mesh){
+        return nullptr;
+    }
+    auto shape = new SgShape;
+    shape->setMesh(mesh);
+    return shape;
+}
+
+}
+
+
+bool CollisionProxyBuilder::Spec::operator<(const Spec& rhs) const
+{
+    if(type != rhs.type){
+        return type < rhs.type;
+    }
+    if(maxNumTriangles != rhs.maxNumTriangles){
+        return maxNumTriangles < rhs.maxNumTriangles;
+    }
+    if(ratio != rhs.ratio){
+        return ratio < rhs.ratio;
+    }
+    return maxError < rhs.maxError;
+}
+
+
+bool CollisionProxyBuilder::readSpec(const ValueNode* node, Spec& out_spec)
+{
+    if(!node || !node->isValid()){
+        return false;
+    }
+    string type;
+    const Mapping* info = nullptr;
+    if(node->isMapping()){
+        info = node->toMapping();
+        if(!info->read("type", type)){
+            return false;
+        }
+    } else if(node->isString()){
+        type = node->toString();
+    } else {
+        return false;
+    }
+
+    if(type == "simplified"){
+        out_spec.type = SimplifiedMesh;
+    } else if(type == "convex_hull"){
+        out_spec.type = ConvexHull;
+    } else if(type == "box"){
+        out_spec.type = BoundingBox;
+    } else if(type == "none"){
+        out_spec.type = NoProxy;
+    } else {
+        return false;
+    }
+
+    out_spec.maxNumTriangles = 0;
+    out_spec.ratio = 0.0;
+    out_spec.maxError = 0.0;
+    if(info){
+        info->read("max_triangles", out_spec.maxNumTriangles);
+        info->read("ratio", out_spec.ratio);
+        info->read("max_error", out_spec.maxError);
+    }
+    if(out_spec.type == SimplifiedMesh &&
+       out_spec.maxNumTriangles <= 0 && out_spec.ratio <= 0.0 && out_spec.maxError <= 0.0){
+        out_spec.ratio = 0.5;
+    }
+
+    return true;
+}
+
+
+MappingPtr CollisionProxyBuilder::writeSpec(const Spec& spec)
+{
+    MappingPtr info = new Mapping;
+    switch(spec.type){
+    case SimplifiedMesh:
+        info->write("type", "simplified");
+        if(spec.maxNumTriangles > 0){
+            info->write("max_triangles", spec.maxNumTriangles);
+        }
+        if(spec.ratio > 0.0){
+            info->write("ratio", spec.ratio);
+        }
+        if(spec.maxError > 0.0){
+            info->write("max_error", spec.maxError);
+        }
+        break;
+    case ConvexHull:
+        info->write("type", "convex_hull");
+        break;
+    case BoundingBox:
+        info->write("type", "box");
+        break;
+    default:
+        info->write("type", "none");
+        break;
+    }
+    return info;
+}
+
+
+SgNodePtr CollisionProxyBuilder::getOrCreateProxy(SgNode* scene, const Spec& spec)
+{
+    if(!scene || spec.type == NoProxy){
+        return nullptr;
+    }
+
+    SourceCacheKey sourceKey(scene, spec);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto p = sourceCache.find(sourceKey);
+        // The expired entry may have the same address as a new node
+        if(p != sourceCache.end() && p->second.source.lock() == scene){
+            return p->second.proxy;
+        }
+    }
+
+    MeshExtractor extractor;
+    SgMeshPtr integrated = extractor.integrate(scene);
+    if(!integrated->hasTriangles()){
+        // Cache the result so that the source is not integrated again
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        registerProxy(sourceKey, scene, nullptr);
+        return nullptr;
+    }
+
+    Spec actualSpec = spec;
+    if(actualSpec.ratio > 0.0){
+        int n = std::max(1, static_cast<int>(actualSpec.ratio * integrated->numTriangles()));
+        if(actualSpec.maxNumTriangles <= 0 || n < actualSpec.maxNumTriangles){
+            actualSpec.maxNumTriangles = n;
+        }
+        actualSpec.ratio = 0.0;
+    }
+    ContentCacheKey contentKey(GeometryRegistry::calcMeshHash(integrated), actualSpec);
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto p = contentCache.find(contentKey);
+        if(p != contentCache.end()){
+            if(auto proxy = p->second.lock()){
+                registerProxy(sourceKey, scene, proxy);
+                return proxy;
+            }
+        }
+    }
+
+    SgNodePtr proxy = createProxy(integrated, actualSpec);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if(proxy){
+        contentCache[contentKey] = weak_ref_ptr<SgNode>(proxy);
+    }
+    registerProxy(sourceKey, scene, proxy);
+    return proxy;
+}
+
+
+void CollisionProxyBuilder::clearCache()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    sourceCache.clear();
+    contentCache.clear();
+    numInsertionsSinceLastCleanup = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef CNOID_UTIL_COLLISION_PROXY_BUILDER_H
+#define CNOID_UTIL_COLLISION_PROXY_BUILDER_H
+
+#include "Referenced.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class ValueNode;
+class Mapping;
+
+/**
+   This class creates simplified shapes used as the collision geometries instead of
+   the detailed shapes. The created proxies are cached and shared by the same source shape
+   and specification. A cached proxy is kept while its source node exists, so a source node
+   must not be modified after its proxy is created.
+*/
+class CNOID_EXPORT CollisionProxyBuilder
+{
+public:
+    enum ProxyType { NoProxy, SimplifiedMesh, ConvexHull, BoundingBox };
+
+    struct Spec
+    {
+        ProxyType type;
+        // The following parameters are used for the SimplifiedMesh type
+        int maxNumTriangles;
+        //! The ratio of the target number of triangles to the original one
+        double ratio;
+        double maxError;
+
+        Spec(ProxyType type = NoProxy, int maxNumTriangles = 0, double ratio = 0.0, double maxError = 0.0)
+            : type(type), maxNumTriangles(maxNumTriangles), ratio(ratio), maxError(maxError) { }
+
+        bool operator<(const Spec& rhs) const;
+    };
+
+    /**
+       The node can be a string of the type name ("simplified", "convex_hull" or "box")
+       or a mapping that has the "type", "max_triangles", "ratio" and "max_error" keys.
+       The ratio of the simplified mesh is 0.5 if none of the parameters is given.
+       \return false if the node is not a valid specification.
+    */
+    static bool readSpec(const ValueNode* node, Spec& out_spec);
+
+    //! \return The mapping of the specification that can be read by readSpec.
+    static ref_ptr<Mapping> writeSpec(const Spec& spec);
+
+    //! \return The proxy node or nullptr if the proxy cannot be created for the scene.
+    static ref_ptr<SgNode> getOrCreateProxy(SgNode* scene, const Spec& spec);
+
+    static void clearCache();
+};
+
+}
+
+#endif
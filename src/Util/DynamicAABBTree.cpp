@@ -0,0 +1,330 @@
+#include "DynamicAABBTree.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int NullNode = -1;
+
+inline double calcSurfaceArea(const Vector3& min, const Vector3& max)
+{
+    const Vector3 d = max - min;
+    return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+inline bool overlaps(const Vector3& min1, const Vector3& max1, const Vector3& min2, const Vector3& max2)
+{
+    return (min1.array() <= max2.array()).all() && (min2.array() <= max1.array()).all();
+}
+
+inline bool contains(const Vector3& outerMin, const Vector3& outerMax, const Vector3& min, const Vector3& max)
+{
+    return (outerMin.array() <= min.array()).all() && (max.array() <= outerMax.array()).all();
+}
+
+}
+
+
+DynamicAABBTree::DynamicAABBTree()
+{
+    root = NullNode;
+    freeList = NullNode;
+    numProxies_ = 0;
+    margin_ = 0.01;
+}
+
+
+void DynamicAABBTree::clear()
+{
+    nodes.clear();
+    root = NullNode;
+    freeList = NullNode;
+    numProxies_ = 0;
+}
+
+
+int DynamicAABBTree::allocateNode()
+{
+    int index;
+    if(freeList != NullNode){
+        index = freeList;
+        freeList = nodes[index].parent;
+    } else {
+        index = nodes.size();
+        nodes.emplace_back();
+    }
+    auto& node = nodes[index];
+    node.parent = NullNode;
+    node.child1 = NullNode;
+    node.child2 = NullNode;
+    node.height = 0;
+    node.userId = -1;
+    return index;
+}
+
+
+void DynamicAABBTree::freeNode(int index)
+{
+    auto& node = nodes[index];
+    node.parent = freeList;
+    node.height = -1;
+    freeList = index;
+}
+
+
+int DynamicAABBTree::insert(const BoundingBox& bbox, int userId)
+{
+    int proxyId = allocateNode();
+    auto& node = nodes[proxyId];
+    const Vector3 margin = Vector3::Constant(margin_);
+    node.min = bbox.min() - margin;
+    node.max = bbox.max() + margin;
+    node.userId = userId;
+    insertLeaf(proxyId);
+    ++numProxies_;
+    return proxyId;
+}
+
+
+void DynamicAABBTree::remove(int proxyId)
+{
+    removeLeaf(proxyId);
+    freeNode(proxyId);
+    --numProxies_;
+}
+
+
+bool DynamicAABBTree::update(int proxyId, const BoundingBox& bbox)
+{
+    auto& node = nodes[proxyId];
+    if(contains(node.min, node.max, bbox.min(), bbox.max())){
+        return false;
+    }
+    removeLeaf(proxyId);
+    const Vector3 margin = Vector3::Constant(margin_);
+    node.min = bbox.min() - margin;
+    node.max = bbox.max() + margin;
+    insertLeaf(proxyId);
+    return true;
+}
+
+
+/**
+   The sibling of the new leaf is searched with the surface area heuristic.
+*/
+void DynamicAABBTree::insertLeaf(int leaf)
+{
+    if(root == NullNode){
+        root = leaf;
+        nodes[root].parent = NullNode;
+        return;
+    }
+
+    const Vector3 leafMin = nodes[leaf].min;
+    const Vector3 leafMax = nodes[leaf].max;
+    int index = root;
+    while(!nodes[index].isLeaf()){
+        const auto& node = nodes[index];
+        const int child1 = node.child1;
+        const int child2 = node.child2;
+
+        const double area = calcSurfaceArea(node.min, node.max);
+        const double combinedArea =
+            calcSurfaceArea(node.min.cwiseMin(leafMin), node.max.cwiseMax(leafMax));
+
+        // The cost of creating a new parent for this node and the new leaf
+        const double cost = 2.0 * combinedArea;
+        // The minimum cost of pushing the leaf further down the tree
+        const double inheritanceCost = 2.0 * (combinedArea - area);
+
+        auto calcDescendingCost = [&](int child){
+            const auto& c = nodes[child];
+            const double newArea = calcSurfaceArea(c.min.cwiseMin(leafMin), c.max.cwiseMax(leafMax));
+            if(c.isLeaf()){
+                return newArea + inheritanceCost;
+            }
+            return (newArea - calcSurfaceArea(c.min, c.max)) + inheritanceCost;
+        };
+        const double cost1 = calcDescendingCost(child1);
+        const double cost2 = calcDescendingCost(child2);
+
+        if(cost < cost1 && cost < cost2){
+            break;
+        }
+        index = (cost1 < cost2) ? child1 : child2;
+    }
+
+    const int sibling = index;
+    const int oldParent = nodes[sibling].parent;
+    const int newParent = allocateNode();
+    auto& parentNode = nodes[newParent];
+    parentNode.parent = oldParent;
+    parentNode.min = leafMin.cwiseMin(nodes[sibling].min);
+    parentNode.max = leafMax.cwiseMax(nodes[sibling].max);
+    parentNode.height = nodes[sibling].height + 1;
+    parentNode.child1 = sibling;
+    parentNode.child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if(oldParent != NullNode){
+        if(nodes[oldParent].child1 == sibling){
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+
+    refitAncestors(nodes[leaf].parent);
+}
+
+
+void DynamicAABBTree::removeLeaf(int leaf)
+{
+    if(leaf == root){
+        root = NullNode;
+        return;
+    }
+
+    const int parent = nodes[leaf].parent;
+    const int grandParent = nodes[parent].parent;
+    const int sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+    if(grandParent != NullNode){
+        if(nodes[grandParent].child1 == parent){
+            nodes[grandParent].child1 = sibling;
+        } else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitAncestors(grandParent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = NullNode;
+        freeNode(parent);
+    }
+}
+
+
+void DynamicAABBTree::refitAncestors(int index)
+{
+    while(index != NullNode){
+        index = balance(index);
+        auto& node = nodes[index];
+        const auto& child1 = nodes[node.child1];
+        const auto& child2 = nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.min = child1.min.cwiseMin(child2.min);
+        node.max = child1.max.cwiseMax(child2.max);
+        index = node.parent;
+    }
+}
+
+
+/**
+   A left or right rotation is performed if the subtree of the node is imbalanced.
+   \return The index of the node that takes the place of the node
+*/
+int DynamicAABBTree::balance(int iA)
+{
+    auto& A = nodes[iA];
+    if(A.isLeaf() || A.height < 2){
+        return iA;
+    }
+
+    const int iB = A.child1;
+    const int iC = A.child2;
+    const int diff = nodes[iC].height - nodes[iB].height;
+
+    // Rotate the higher child up
+    if(diff > 1 || diff < -1){
+        const int iUp = (diff > 1) ? iC : iB;
+        const int iOther = (diff > 1) ? iB : iC;
+        auto& up = nodes[iUp];
+        const int iF = up.child1;
+        const int iG = up.child2;
+
+        up.child1 = iA;
+        up.parent = A.parent;
+        A.parent = iUp;
+
+        if(up.parent != NullNode){
+            auto& upParent = nodes[up.parent];
+            if(upParent.child1 == iA){
+                upParent.child1 = iUp;
+            } else {
+                upParent.child2 = iUp;
+            }
+        } else {
+            root = iUp;
+        }
+
+        // The lower grandchild is given to A
+        const bool isFHigher = nodes[iF].height > nodes[iG].height;
+        const int iHigh = isFHigher ? iF : iG;
+        const int iLow = isFHigher ? iG : iF;
+        up.child2 = iHigh;
+        if(diff > 1){
+            A.child2 = iLow;
+        } else {
+            A.child1 = iLow;
+        }
+        nodes[iLow].parent = iA;
+
+        const auto& other = nodes[iOther];
+        const auto& low = nodes[iLow];
+        A.min = other.min.cwiseMin(low.min);
+        A.max = other.max.cwiseMax(low.max);
+        A.height = 1 + std::max(other.height, low.height);
+
+        const auto& high = nodes[iHigh];
+        up.min = A.min.cwiseMin(high.min);
+        up.max = A.max.cwiseMax(high.max);
+        up.height = 1 + std::max(A.height, high.height);
+
+        return iUp;
+    }
+
+    return iA;
+}
+
+
+int DynamicAABBTree::height() const
+{
+    return (root == NullNode) ? 0 : nodes[root].height;
+}
+
+
+void DynamicAABBTree::query(const BoundingBox& bbox, const std::function<bool(int proxyId)>& callback) const
+{
+    if(root == NullNode || bbox.empty()){
+        return;
+    }
+    const Vector3& min = bbox.min();
+    const Vector3& max = bbox.max();
+
+    // The stack is shared by the queries to avoid the allocation, so the queries are not thread-safe
+    const size_t stackBottom = stack.size();
+    stack.push_back(root);
+    while(stack.size() > stackBottom){
+        const int index = stack.back();
+        stack.pop_back();
+        const auto& node = nodes[index];
+        if(overlaps(node.min, node.max, min, max)){
+            if(node.isLeaf()){
+                if(!callback(index)){
+                    stack.resize(stackBottom);
+                    break;
+                }
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef CNOID_UTIL_DYNAMIC_AABB_TREE_H
+#define CNOID_UTIL_DYNAMIC_AABB_TREE_H
+
+#include "BoundingBox.h"
+#include <vector>
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class is a balanced binary tree of axis-aligned bounding boxes that can be updated
+   incrementally when the objects move. Each object is stored with a fat bounding box enlarged
+   by the margin, and the tree is only modified when the bounding box of an object goes out of
+   its fat bounding box. The tree is used as a persistent broad phase of the collision detection
+   and the spatial index of the regions.
+*/
+class CNOID_EXPORT DynamicAABBTree
+{
+public:
+    DynamicAABBTree();
+
+    void clear();
+
+    //! The margin added to each side of the bounding boxes. The default margin is 0.01.
+    void setMargin(double margin) { margin_ = margin; }
+    double margin() const { return margin_; }
+
+    //! \return The proxy id of the object, which is used to update and remove the object
+    int insert(const BoundingBox& bbox, int userId);
+    void remove(int proxyId);
+
+    /**
+       \return true if the fat bounding box of the object is updated and the object is reinserted
+       into the tree. The tree is not modified when the bounding box is in the fat bounding box.
+    */
+    bool update(int proxyId, const BoundingBox& bbox);
+
+    int userId(int proxyId) const { return nodes[proxyId].userId; }
+    BoundingBox fatBoundingBox(int proxyId) const {
+        auto& node = nodes[proxyId];
+        return BoundingBox(node.min, node.max);
+    }
+
+    int numProxies() const { return numProxies_; }
+    int height() const;
+
+    /**
+       The function is called for the proxy id of each object whose fat bounding box overlaps
+       the given bounding box. The query is aborted when the function returns false.
+    */
+    void query(const BoundingBox& bbox, const std::function<bool(int proxyId)>& callback) const;
+
+private:
+    struct Node
+    {
+        Vector3 min;
+        Vector3 max;
+        //! This is the next free node index for the nodes in the free list
+        int parent;
+        int child1;
+        int child2;
+        int height;
+        int userId;
+
+        bool isLeaf() const { return child1 < 0; }
+    };
+    std::vector<Node> nodes;
+    int root;
+    int freeList;
+    int numProxies_;
+    double margin_;
+    mutable std::vector<int> stack;
+
+    int allocateNode();
+    void freeNode(int index);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int index);
+    void refitAncestors(int index);
+};
+
+}
+
+#endif
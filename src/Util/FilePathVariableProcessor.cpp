@@ -3,6 +3,7 @@
 #include "ExecutablePath.h"
 #include "FileUtil.h"
 #include "UTF8.h"
+#include "ZipFileSystem.h"
 #include <cnoid/stdx/optional>
 #include <fmt/format.h>
 #include <regex>
@@ -514,7 +515,12 @@ std::string FilePathVariableProcessor::Impl::expand
         }
     }
     path = filesystem::lexically_normal(path);
-    return toUTF8(path.make_preferred().string());
+    expanded = toUTF8(path.make_preferred().string());
+
+    // The file may be in a mounted zip archive and extracted on demand
+    ZipFileSystem::prepareFile(expanded);
+
+    return expanded;
 }
 
 
@@ -0,0 +1,240 @@
+#include "GeometryRegistry.h"
+#include "SceneDrawables.h"
+#include <unordered_map>
+#include <mutex>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+std::mutex registryMutex;
+unordered_multimap<uint64_t, weak_ref_ptr<SgMesh>> meshMap;
+// Used to check if a mesh is registered without calculating its hash value
+unordered_map<const SgMesh*, weak_ref_ptr<SgMesh>> registeredMeshes;
+size_t numInsertionsSinceLastCleanup = 0;
+
+constexpr uint64_t FnvOffsetBasis = 14695981039346656037ULL;
+
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for(size_t i=0; i < size; ++i){
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template<class ArrayType>
+uint64_t hashArray(uint64_t hash, const ArrayType* array)
+{
+    size_t n = array ? array->size() : 0;
+    hash = hashBytes(hash, &n, sizeof(n));
+    if(n > 0){
+        hash = hashBytes(hash, array->data(), n * sizeof((*array)[0]));
+    }
+    return hash;
+}
+
+template<class ArrayType>
+bool isSameArray(const ArrayType* array1, const ArrayType* array2)
+{
+    const size_t n1 = array1 ? array1->size() : 0;
+    const size_t n2 = array2 ? array2->size() : 0;
+    if(n1 != n2){
+        return false;
+    }
+    if(n1 == 0 || array1 == array2){
+        return true;
+    }
+    return std::memcmp(array1->data(), array2->data(), n1 * sizeof((*array1)[0])) == 0;
+}
+
+uint64_t calcKeyHash(const SgMesh* mesh)
+{
+    uint64_t hash = GeometryRegistry::calcMeshHash(mesh);
+    if(mesh->hasUri()){
+        auto& uri = mesh->uri();
+        hash = hashBytes(hash, uri.data(), uri.size());
+    }
+    if(mesh->hasUriFragment()){
+        auto& fragment = mesh->uriFragment();
+        hash = hashBytes(hash, fragment.data(), fragment.size());
+    }
+    return hash;
+}
+
+bool isSameUri(const SgMesh* mesh1, const SgMesh* mesh2)
+{
+    if(mesh1->hasUri() != mesh2->hasUri() || mesh1->hasUriFragment() != mesh2->hasUriFragment()){
+        return false;
+    }
+    if(mesh1->hasUri() && mesh1->uri() != mesh2->uri()){
+        return false;
+    }
+    if(mesh1->hasUriFragment() && mesh1->uriFragment() != mesh2->uriFragment()){
+        return false;
+    }
+    return true;
+}
+
+void removeExpiredMeshes()
+{
+    auto p = meshMap.begin();
+    while(p != meshMap.end()){
+        if(p->second.expired()){
+            p = meshMap.erase(p);
+        } else {
+            ++p;
+        }
+    }
+    auto q = registeredMeshes.begin();
+    while(q != registeredMeshes.end()){
+        if(q->second.expired()){
+            q = registeredMeshes.erase(q);
+        } else {
+            ++q;
+        }
+    }
+    numInsertionsSinceLastCleanup = 0;
+}
+
+SgMeshPtr getOrRegisterMeshSub(SgMesh* mesh)
+{
+    // The primitive parameters are not compared, so the mesh must have its vertices
+    if(!mesh->hasVertices()){
+        return mesh;
+    }
+    const uint64_t hash = calcKeyHash(mesh);
+    auto range = meshMap.equal_range(hash);
+    auto p = range.first;
+    while(p != range.second){
+        if(SgMeshPtr registered = p->second.lock()){
+            if(registered == mesh ||
+               (isSameUri(registered, mesh) &&
+                GeometryRegistry::checkIfSameMeshContents(registered, mesh))){
+                return registered;
+            }
+            ++p;
+        } else {
+            p = meshMap.erase(p);
+        }
+    }
+    
+    meshMap.emplace(hash, mesh);
+    registeredMeshes[mesh] = weak_ref_ptr<SgMesh>(mesh);
+
+    if(++numInsertionsSinceLastCleanup > meshMap.size() / 2){
+        removeExpiredMeshes();
+    }
+    
+    return mesh;
+}
+
+void shareMeshesSub(SgNode* node, int& numReplaced)
+{
+    if(auto shape = dynamic_cast<SgShape*>(node)){
+        if(auto mesh = shape->mesh()){
+            auto registered = getOrRegisterMeshSub(mesh);
+            if(registered != mesh){
+                shape->setMesh(registered);
+                ++numReplaced;
+            }
+        }
+    } else if(auto group = dynamic_cast<SgGroup*>(node)){
+        for(auto& child : *group){
+            shareMeshesSub(child, numReplaced);
+        }
+    }
+}
+
+}
+
+
+uint64_t GeometryRegistry::calcMeshHash(const SgMesh* mesh)
+{
+    uint64_t hash = FnvOffsetBasis;
+    hash = hashArray(hash, mesh->vertices());
+    hash = hashArray(hash, &mesh->faceVertexIndices());
+    hash = hashArray(hash, mesh->normals());
+    hash = hashArray(hash, &mesh->normalIndices());
+    hash = hashArray(hash, mesh->colors());
+    hash = hashArray(hash, &mesh->colorIndices());
+    hash = hashArray(hash, mesh->texCoords());
+    hash = hashArray(hash, &mesh->texCoordIndices());
+    int type = mesh->primitiveType();
+    hash = hashBytes(hash, &type, sizeof(type));
+    return hash;
+}
+
+
+bool GeometryRegistry::checkIfSameMeshContents(const SgMesh* mesh1, const SgMesh* mesh2)
+{
+    if(mesh1 == mesh2){
+        return true;
+    }
+    return
+        mesh1->primitiveType() == mesh2->primitiveType() &&
+        mesh1->creaseAngle() == mesh2->creaseAngle() &&
+        mesh1->isSolid() == mesh2->isSolid() &&
+        isSameArray(mesh1->vertices(), mesh2->vertices()) &&
+        isSameArray(&mesh1->faceVertexIndices(), &mesh2->faceVertexIndices()) &&
+        isSameArray(mesh1->normals(), mesh2->normals()) &&
+        isSameArray(&mesh1->normalIndices(), &mesh2->normalIndices()) &&
+        isSameArray(mesh1->colors(), mesh2->colors()) &&
+        isSameArray(&mesh1->colorIndices(), &mesh2->colorIndices()) &&
+        isSameArray(mesh1->texCoords(), mesh2->texCoords()) &&
+        isSameArray(&mesh1->texCoordIndices(), &mesh2->texCoordIndices());
+}
+
+
+SgMeshPtr GeometryRegistry::getOrRegisterMesh(SgMesh* mesh)
+{
+    if(!mesh){
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return getOrRegisterMeshSub(mesh);
+}
+
+
+bool GeometryRegistry::checkIfRegisteredMesh(const SgMesh* mesh)
+{
+    if(!mesh){
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto p = registeredMeshes.find(mesh);
+    // The expired entry may have the same address as a new mesh
+    return (p != registeredMeshes.end()) && (p->second.lock() == mesh);
+}
+
+
+int GeometryRegistry::shareMeshes(SgNode* scene)
+{
+    int numReplaced = 0;
+    if(scene){
+        std::lock_guard<std::mutex> lock(registryMutex);
+        shareMeshesSub(scene, numReplaced);
+    }
+    return numReplaced;
+}
+
+
+int GeometryRegistry::numRegisteredMeshes()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    removeExpiredMeshes();
+    return meshMap.size();
+}
+
+
+void GeometryRegistry::clear()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    meshMap.clear();
+    registeredMeshes.clear();
+    numInsertionsSinceLastCleanup = 0;
+}
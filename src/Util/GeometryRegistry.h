@@ -0,0 +1,49 @@
+#ifndef CNOID_UTIL_GEOMETRY_REGISTRY_H
+#define CNOID_UTIL_GEOMETRY_REGISTRY_H
+
+#include "Referenced.h"
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class SgMesh;
+
+/**
+   This class manages the process-wide registry of the meshes identified by their URIs and contents.
+   The meshes that have the same URI and contents can be shared by this registry so that the
+   identical geometries loaded multiple times are stored only once.
+   Note that a shared mesh should be treated as an immutable object because the modification
+   affects all the shapes sharing it.
+   The registry only keeps weak references to the meshes.
+*/
+class CNOID_EXPORT GeometryRegistry
+{
+public:
+    //! The hash value calculated from the mesh contents. The object identity is not considered.
+    static uint64_t calcMeshHash(const SgMesh* mesh);
+    static bool checkIfSameMeshContents(const SgMesh* mesh1, const SgMesh* mesh2);
+
+    /**
+       \return The registered mesh that has the same URI and contents as the given mesh.
+       The given mesh is registered and returned if there is no such mesh.
+    */
+    static ref_ptr<SgMesh> getOrRegisterMesh(SgMesh* mesh);
+
+    //! This function only checks the object identity and does not calculate the hash value.
+    static bool checkIfRegisteredMesh(const SgMesh* mesh);
+
+    /**
+       The meshes of the shapes in the scene are replaced with the registered ones.
+       \return The number of the replaced meshes
+    */
+    static int shareMeshes(SgNode* scene);
+
+    static int numRegisteredMeshes();
+    static void clear();
+};
+
+}
+
+#endif
@@ -316,6 +316,93 @@ bool loadTGA(Image& image, const std::string& filename, bool isUpsideDown, ostre
     return true;
 }
 
+
+bool checkPNG(const std::string& filename, ostream& os)
+{
+    FILE* fp = fopen(fromUTF8(filename).c_str(), "rb");
+    if(!fp){
+        os << format(_("Image file \"{0}\" cannot be loaded. {1}"), filename, strerror(errno)) << endl;
+        return false;
+    }
+
+    // The signature and the IHDR chunk that must follow it
+    png_byte header[26];
+    size_t n = fread(header, 1, sizeof(header), fp);
+    fclose(fp);
+    if(n != sizeof(header) || png_sig_cmp(header, 0, 8) != 0 || memcmp(header + 12, "IHDR", 4) != 0){
+        os << format(_("Image file \"{0}\" is not the PNG format."), filename) << endl;
+        return false;
+    }
+    png_byte color_type = header[25];
+    if(color_type != PNG_COLOR_TYPE_GRAY && color_type != PNG_COLOR_TYPE_GRAY_ALPHA &&
+       color_type != PNG_COLOR_TYPE_RGB && color_type != PNG_COLOR_TYPE_RGB_ALPHA &&
+       color_type != PNG_COLOR_TYPE_PALETTE){
+        os << format(_("Image file \"{0}\" cannot be loaded because its color type is not supported."), filename)
+           << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool checkJPEG(const std::string& filename, ostream& os)
+{
+    FILE* fp = fopen(fromUTF8(filename).c_str(), "rb");
+    if(!fp){
+        os << format(_("Image file \"{0}\" cannot be loaded. {1}"), filename, strerror(errno)) << endl;
+        return false;
+    }
+
+    // The SOI marker
+    unsigned char header[3];
+    size_t n = fread(header, 1, sizeof(header), fp);
+    fclose(fp);
+    if(n != sizeof(header) || header[0] != 0xff || header[1] != 0xd8 || header[2] != 0xff){
+        os << format(_("Image file \"{0}\" is not the JPEG format."), filename) << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool checkTGA(const std::string& filename, ostream& os)
+{
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if(!fp){
+        os << format(_("Image file \"{0}\" cannot be loaded. {1}"), filename, strerror(errno)) << endl;
+        return false;
+    }
+
+    unsigned char header[12]={0,0,2,0,0,0,0,0,0,0,0,0};
+    unsigned char header_buf[12];
+    unsigned char header_buf2[6];
+
+    if( fread(header_buf,1,sizeof(header),fp)!=sizeof(header) ||
+        memcmp(header,header_buf,sizeof(header))!=0 ||
+        fread(header_buf2, 1, sizeof(header_buf2), fp)!=sizeof(header_buf2) ){
+        fclose(fp);
+        os << format(_("Image file \"{0}\" is not the uncompressed TGA format."), filename) << endl;
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long fileSize = ftell(fp);
+    fclose(fp);
+
+    unsigned int width = header_buf2[1] * 256 + header_buf2[0];
+    unsigned int height = header_buf2[3] * 256 + header_buf2[2];
+    unsigned int bytesPerPixel = header_buf2[4] / 8;
+
+    if( width<=0 || height<=0 || (bytesPerPixel!=3 && bytesPerPixel!=4) ){
+        os << format(_("Image file \"{0}\" is empty."), filename) << endl;
+        return false;
+    }
+    if(fileSize < static_cast<long>(sizeof(header) + sizeof(header_buf2) + width * height * bytesPerPixel)){
+        os << format(_("Internal error in loading \"{0}\"."), filename) << endl;
+        return false;
+    }
+    return true;
+}
+
 }
 
 
@@ -347,6 +434,28 @@ bool ImageIO::load(Image& image, const std::string& filename, std::ostream& os)
 }
 
 
+bool ImageIO::checkFile(const std::string& filename, std::ostream& os)
+{
+    bool isValid = false;
+    
+    filesystem::path fpath(fromUTF8(filename));
+    string ext = fpath.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    
+    if(ext == ".png"){
+        isValid = checkPNG(filename, os);
+    } else if(ext == ".jpg" || ext == ".jpeg"){
+        isValid = checkJPEG(filename, os);
+    } else if(ext == ".tga"){
+        isValid = checkTGA(filename, os);
+    } else {
+        os << format(_("The image file format of \"{0}\" is not supported."), fpath.string()) << endl;
+    }
+
+    return isValid;
+}
+
+
 bool ImageIO::save(const Image& image, const std::string& filename, std::ostream& os)
 {
     bool saved = false;
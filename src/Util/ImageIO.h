@@ -18,6 +18,13 @@ public:
     void allocateAlphaComponent(bool on);
         
     bool load(Image& image, const std::string& filename, std::ostream& os = nullout());
+
+    /**
+       This function checks if the file can be loaded by reading the header of the file
+       without decoding the image.
+    */
+    bool checkFile(const std::string& filename, std::ostream& os = nullout());
+
     bool save(const Image& image, const std::string& filename, std::ostream& os = nullout());
 
 private:
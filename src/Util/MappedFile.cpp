@@ -0,0 +1,99 @@
+#include "MappedFile.h"
+#include "UTF8.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+
+
+MappedFile::MappedFile(const std::string& filename, AccessPattern pattern)
+    : data_(nullptr),
+      size_(0)
+{
+    const string nativeFilename = fromUTF8(filename);
+
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if(pattern == SequentialAccess){
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    } else if(pattern == RandomAccess){
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    }
+    file = CreateFileA(
+        nativeFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    mapping = nullptr;
+    if(file == INVALID_HANDLE_VALUE){
+        throw std::runtime_error(filename + " cannot be opened.");
+    }
+    LARGE_INTEGER fileSize;
+    if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0){
+        size_ = fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping){
+            data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+#else
+    int fd = open(nativeFilename.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error(filename + " cannot be opened.");
+    }
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) == 0 && fileStat.st_size > 0){
+        size_ = fileStat.st_size;
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED){
+            data_ = static_cast<const char*>(p);
+            if(pattern == SequentialAccess){
+                madvise(p, size_, MADV_SEQUENTIAL);
+            } else if(pattern == RandomAccess){
+                madvise(p, size_, MADV_RANDOM);
+            }
+        }
+    }
+    ::close(fd);
+#endif
+
+    if(!data_){
+        close();
+        throw std::runtime_error(filename + " cannot be read.");
+    }
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(data_){
+        UnmapViewOfFile(data_);
+    }
+    if(mapping){
+        CloseHandle(mapping);
+    }
+    if(file != INVALID_HANDLE_VALUE){
+        CloseHandle(file);
+    }
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if(data_){
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+}
@@ -0,0 +1,40 @@
+#ifndef CNOID_UTIL_MAPPED_FILE_H
+#define CNOID_UTIL_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class maps the whole contents of a file to the memory as read-only data.
+   The constructor throws std::runtime_error if the file cannot be mapped.
+*/
+class CNOID_EXPORT MappedFile
+{
+public:
+    enum AccessPattern { NormalAccess, SequentialAccess, RandomAccess };
+    
+    MappedFile(const std::string& filename, AccessPattern pattern = NormalAccess);
+    ~MappedFile();
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    void close();
+
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+};
+
+}
+
+#endif
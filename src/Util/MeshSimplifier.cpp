@@ -0,0 +1,660 @@
+#include "MeshSimplifier.h"
+#include "MeshExtractor.h"
+#include "MeshGenerator.h"
+#include "SceneDrawables.h"
+#include "IdPair.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <queue>
+#include <map>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef Eigen::Matrix<double, 4, 4> Quadric;
+
+struct VertexKey
+{
+    float x, y, z;
+    bool operator==(const VertexKey& rhs) const {
+        return x == rhs.x && y == rhs.y && z == rhs.z;
+    }
+};
+
+struct VertexKeyHash
+{
+    std::size_t operator()(const VertexKey& key) const {
+        std::hash<float> hasher;
+        std::size_t seed = hasher(key.x);
+        seed ^= hasher(key.y) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+        seed ^= hasher(key.z) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+        return seed;
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    int v0;
+    int v1;
+    int stamp0;
+    int stamp1;
+    Vector3 position;
+
+    bool operator>(const Collapse& rhs) const { return cost > rhs.cost; }
+};
+
+struct HullFace
+{
+    int v[3];
+    Vector3 normal;
+    double d;
+    bool isVisible;
+};
+
+}
+
+namespace cnoid {
+
+class MeshSimplifier::Impl
+{
+public:
+    int targetNumTriangles;
+    double maxError;
+    MeshGenerator meshGenerator;
+
+    // Working data for the decimation
+    vector<Vector3> positions;
+    vector<Quadric, Eigen::aligned_allocator<Quadric>> quadrics;
+    vector<Array3i> triangles;
+    vector<bool> isTriangleRemoved;
+    vector<vector<int>> trianglesOfVertex;
+    vector<int> vertexStamps;
+    vector<bool> isVertexRemoved;
+    priority_queue<Collapse, vector<Collapse>, greater<Collapse>> collapseQueue;
+
+    Impl();
+    Impl(const Impl& org);
+    bool weldVertices(SgMesh* mesh, vector<Vector3>& out_positions, vector<Array3i>& out_triangles);
+    SgMesh* simplify(SgMesh* mesh);
+    void initializeQuadrics();
+    void pushCollapse(int v0, int v1);
+    bool checkIfCollapseFlipsTriangles(int v, int other, const Vector3& position);
+    int collapse(const Collapse& c);
+    SgMesh* createSimplifiedMesh();
+    SgMesh* createConvexHull(SgMesh* mesh);
+};
+
+}
+
+
+MeshSimplifier::MeshSimplifier()
+{
+    impl = new Impl;
+}
+
+
+MeshSimplifier::Impl::Impl()
+{
+    targetNumTriangles = 0;
+    maxError = 0.0;
+}
+
+
+MeshSimplifier::MeshSimplifier(const MeshSimplifier& org)
+{
+    impl = new Impl(*org.impl);
+}
+
+
+MeshSimplifier::Impl::Impl(const Impl& org)
+{
+    targetNumTriangles = org.targetNumTriangles;
+    maxError = org.maxError;
+}
+
+
+MeshSimplifier::~MeshSimplifier()
+{
+    delete impl;
+}
+
+
+void MeshSimplifier::setTargetNumTriangles(int n)
+{
+    impl->targetNumTriangles = n;
+}
+
+
+int MeshSimplifier::targetNumTriangles() const
+{
+    return impl->targetNumTriangles;
+}
+
+
+void MeshSimplifier::setMaxError(double e)
+{
+    impl->maxError = e;
+}
+
+
+double MeshSimplifier::maxError() const
+{
+    return impl->maxError;
+}
+
+
+/**
+   Vertices at the same position are merged so that the edge collapse can process
+   the mesh as a connected surface, and degenerate triangles are removed.
+*/
+bool MeshSimplifier::Impl::weldVertices
+(SgMesh* mesh, vector<Vector3>& out_positions, vector<Array3i>& out_triangles)
+{
+    out_positions.clear();
+    out_triangles.clear();
+
+    if(!mesh || !mesh->hasVertices() || !mesh->hasTriangles()){
+        return false;
+    }
+
+    const auto& vertices = *mesh->vertices();
+    const int numVertices = vertices.size();
+    vector<int> indexMap(numVertices);
+    unordered_map<VertexKey, int, VertexKeyHash> keyToIndexMap;
+    keyToIndexMap.reserve(numVertices);
+
+    for(int i=0; i < numVertices; ++i){
+        auto& v = vertices[i];
+        auto inserted = keyToIndexMap.insert(make_pair(VertexKey{ v.x(), v.y(), v.z() }, out_positions.size()));
+        if(inserted.second){
+            out_positions.push_back(v.cast<double>());
+        }
+        indexMap[i] = inserted.first->second;
+    }
+
+    const int numTriangles = mesh->numTriangles();
+    out_triangles.reserve(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        auto src = mesh->triangle(i);
+        Array3i tri(indexMap[src[0]], indexMap[src[1]], indexMap[src[2]]);
+        if(tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0]){
+            out_triangles.push_back(tri);
+        }
+    }
+
+    return !out_triangles.empty();
+}
+
+
+SgMesh* MeshSimplifier::simplify(SgMesh* mesh)
+{
+    return impl->simplify(mesh);
+}
+
+
+SgMesh* MeshSimplifier::simplify(SgNode* scene)
+{
+    MeshExtractor extractor;
+    SgMeshPtr integrated = extractor.integrate(scene);
+    return impl->simplify(integrated);
+}
+
+
+SgMesh* MeshSimplifier::Impl::simplify(SgMesh* mesh)
+{
+    if(!weldVertices(mesh, positions, triangles)){
+        return nullptr;
+    }
+
+    const int numVertices = positions.size();
+    const int numTriangles = triangles.size();
+
+    isTriangleRemoved.assign(numTriangles, false);
+    isVertexRemoved.assign(numVertices, false);
+    vertexStamps.assign(numVertices, 0);
+    trianglesOfVertex.clear();
+    trianglesOfVertex.resize(numVertices);
+    for(int i=0; i < numTriangles; ++i){
+        for(int j=0; j < 3; ++j){
+            trianglesOfVertex[triangles[i][j]].push_back(i);
+        }
+    }
+
+    initializeQuadrics();
+
+    collapseQueue = decltype(collapseQueue)();
+    unordered_set<IdPair<int>> edges;
+    for(int i=0; i < numTriangles; ++i){
+        auto& tri = triangles[i];
+        for(int j=0; j < 3; ++j){
+            IdPair<int> edge(tri[j], tri[(j + 1) % 3]);
+            if(edges.insert(edge).second){
+                pushCollapse(edge(0), edge(1));
+            }
+        }
+    }
+
+    const double maxCost = (maxError > 0.0) ? (maxError * maxError) : numeric_limits<double>::max();
+    const int minNumTriangles = (targetNumTriangles > 0) ? targetNumTriangles : 0;
+    int numRemainingTriangles = numTriangles;
+
+    if(targetNumTriangles <= 0 && maxError <= 0.0){
+        collapseQueue = decltype(collapseQueue)();
+    }
+
+    while(numRemainingTriangles > minNumTriangles && !collapseQueue.empty()){
+        Collapse c = collapseQueue.top();
+        collapseQueue.pop();
+        if(isVertexRemoved[c.v0] || isVertexRemoved[c.v1] ||
+           vertexStamps[c.v0] != c.stamp0 || vertexStamps[c.v1] != c.stamp1){
+            continue; // outdated
+        }
+        if(c.cost > maxCost){
+            break;
+        }
+        if(checkIfCollapseFlipsTriangles(c.v0, c.v1, c.position) ||
+           checkIfCollapseFlipsTriangles(c.v1, c.v0, c.position)){
+            continue;
+        }
+        numRemainingTriangles -= collapse(c);
+    }
+
+    return createSimplifiedMesh();
+}
+
+
+void MeshSimplifier::Impl::initializeQuadrics()
+{
+    quadrics.assign(positions.size(), Quadric::Zero());
+
+    for(auto& tri : triangles){
+        const Vector3& p0 = positions[tri[0]];
+        const Vector3& p1 = positions[tri[1]];
+        const Vector3& p2 = positions[tri[2]];
+        Vector3 n = (p1 - p0).cross(p2 - p0);
+        double area2 = n.norm();
+        if(area2 < 1.0e-20){
+            continue;
+        }
+        n /= area2;
+        // The quadric is not weighted by the area so that the cost can be compared with maxError
+        Eigen::Vector4d plane(n.x(), n.y(), n.z(), -n.dot(p0));
+        Quadric K = plane * plane.transpose();
+        for(int i=0; i < 3; ++i){
+            quadrics[tri[i]] += K;
+        }
+    }
+}
+
+
+void MeshSimplifier::Impl::pushCollapse(int v0, int v1)
+{
+    Quadric Q = quadrics[v0] + quadrics[v1];
+
+    Collapse c;
+    c.v0 = v0;
+    c.v1 = v1;
+    c.stamp0 = vertexStamps[v0];
+    c.stamp1 = vertexStamps[v1];
+
+    auto error = [&Q](const Vector3& p){
+        Eigen::Vector4d h(p.x(), p.y(), p.z(), 1.0);
+        return std::max(0.0, h.dot(Q * h));
+    };
+
+    Matrix3 A = Q.topLeftCorner<3, 3>();
+    Vector3 b = -Q.topRightCorner<3, 1>();
+    bool solved = false;
+    if(std::fabs(A.determinant()) > 1.0e-12){
+        Vector3 p = A.inverse() * b;
+        // Reject the optimal position if it is far from the edge
+        const Vector3& p0 = positions[v0];
+        const Vector3& p1 = positions[v1];
+        double edgeLength = (p1 - p0).norm();
+        if((p - 0.5 * (p0 + p1)).norm() <= 2.0 * edgeLength){
+            c.position = p;
+            c.cost = error(p);
+            solved = true;
+        }
+    }
+    if(!solved){
+        const Vector3 candidates[] = {
+            positions[v0], positions[v1], 0.5 * (positions[v0] + positions[v1]) };
+        c.cost = numeric_limits<double>::max();
+        for(auto& p : candidates){
+            double e = error(p);
+            if(e < c.cost){
+                c.cost = e;
+                c.position = p;
+            }
+        }
+    }
+
+    collapseQueue.push(c);
+}
+
+
+bool MeshSimplifier::Impl::checkIfCollapseFlipsTriangles(int v, int other, const Vector3& position)
+{
+    for(auto& t : trianglesOfVertex[v]){
+        if(isTriangleRemoved[t]){
+            continue;
+        }
+        auto& tri = triangles[t];
+        if(tri[0] == other || tri[1] == other || tri[2] == other){
+            continue; // This triangle will be removed
+        }
+        Vector3 p[3];
+        for(int i=0; i < 3; ++i){
+            p[i] = positions[tri[i]];
+        }
+        Vector3 n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+        for(int i=0; i < 3; ++i){
+            if(tri[i] == v){
+                p[i] = position;
+            }
+        }
+        Vector3 n1 = (p[1] - p[0]).cross(p[2] - p[0]);
+        if(n0.dot(n1) <= 0.0){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+   \return The number of the removed triangles
+*/
+int MeshSimplifier::Impl::collapse(const Collapse& c)
+{
+    const int v0 = c.v0;
+    const int v1 = c.v1;
+
+    positions[v0] = c.position;
+    quadrics[v0] += quadrics[v1];
+    isVertexRemoved[v1] = true;
+    ++vertexStamps[v0];
+
+    int numRemovedTriangles = 0;
+    auto& triangles0 = trianglesOfVertex[v0];
+    for(auto& t : trianglesOfVertex[v1]){
+        if(isTriangleRemoved[t]){
+            continue;
+        }
+        auto& tri = triangles[t];
+        if(tri[0] == v0 || tri[1] == v0 || tri[2] == v0){
+            isTriangleRemoved[t] = true;
+            ++numRemovedTriangles;
+        } else {
+            for(int i=0; i < 3; ++i){
+                if(tri[i] == v1){
+                    tri[i] = v0;
+                }
+            }
+            triangles0.push_back(t);
+        }
+    }
+
+    // Compact the triangle list of v0 and update the collapse candidates around it
+    unordered_set<int> neighbors;
+    int numValidTriangles = 0;
+    for(size_t i=0; i < triangles0.size(); ++i){
+        int t = triangles0[i];
+        if(!isTriangleRemoved[t]){
+            triangles0[numValidTriangles++] = t;
+            for(int j=0; j < 3; ++j){
+                int v = triangles[t][j];
+                if(v != v0){
+                    neighbors.insert(v);
+                }
+            }
+        }
+    }
+    triangles0.resize(numValidTriangles);
+
+    for(auto& v : neighbors){
+        pushCollapse(v0, v);
+    }
+
+    trianglesOfVertex[v1].clear();
+
+    return numRemovedTriangles;
+}
+
+
+SgMesh* MeshSimplifier::Impl::createSimplifiedMesh()
+{
+    auto mesh = new SgMesh;
+    auto& vertices = *mesh->getOrCreateVertices();
+    vector<int> indexMap(positions.size(), -1);
+
+    const int numTriangles = triangles.size();
+    for(int i=0; i < numTriangles; ++i){
+        if(isTriangleRemoved[i]){
+            continue;
+        }
+        auto& tri = triangles[i];
+        for(int j=0; j < 3; ++j){
+            int& index = indexMap[tri[j]];
+            if(index < 0){
+                index = vertices.size();
+                vertices.push_back(positions[tri[j]].cast<float>());
+            }
+        }
+        mesh->addTriangle(indexMap[tri[0]], indexMap[tri[1]], indexMap[tri[2]]);
+    }
+    mesh->updateBoundingBox();
+
+    positions.clear();
+    quadrics.clear();
+    triangles.clear();
+    isTriangleRemoved.clear();
+    trianglesOfVertex.clear();
+    vertexStamps.clear();
+    isVertexRemoved.clear();
+    collapseQueue = decltype(collapseQueue)();
+
+    return mesh;
+}
+
+
+SgMesh* MeshSimplifier::createConvexHull(SgMesh* mesh)
+{
+    return impl->createConvexHull(mesh);
+}
+
+
+SgMesh* MeshSimplifier::createConvexHull(SgNode* scene)
+{
+    MeshExtractor extractor;
+    SgMeshPtr integrated = extractor.integrate(scene);
+    return impl->createConvexHull(integrated);
+}
+
+
+/**
+   The hull is constructed by the incremental algorithm.
+   \return nullptr if the points do not span a volume
+*/
+SgMesh* MeshSimplifier::Impl::createConvexHull(SgMesh* mesh)
+{
+    if(!mesh || !mesh->hasVertices()){
+        return nullptr;
+    }
+    vector<Vector3> points;
+    unordered_set<VertexKey, VertexKeyHash> keys;
+    for(auto& v : *mesh->vertices()){
+        if(keys.insert(VertexKey{ v.x(), v.y(), v.z() }).second){
+            points.push_back(v.cast<double>());
+        }
+    }
+    const int numPoints = points.size();
+    if(numPoints < 4){
+        return nullptr;
+    }
+
+    BoundingBox bbox;
+    for(auto& p : points){
+        bbox.expandBy(p);
+    }
+    const double eps = 1.0e-9 * std::max(1.0, bbox.size().norm());
+
+    // Initial tetrahedron
+    int i0 = 0, i1 = 0;
+    for(int i=1; i < numPoints; ++i){
+        if(points[i].x() < points[i0].x()) i0 = i;
+        if(points[i].x() > points[i1].x()) i1 = i;
+    }
+    if(i0 == i1){
+        i1 = (i0 + 1) % numPoints;
+    }
+    int i2 = -1;
+    double maxDistance = eps;
+    Vector3 axis = (points[i1] - points[i0]).normalized();
+    for(int i=0; i < numPoints; ++i){
+        Vector3 d = points[i] - points[i0];
+        double distance = (d - d.dot(axis) * axis).norm();
+        if(distance > maxDistance){
+            maxDistance = distance;
+            i2 = i;
+        }
+    }
+    if(i2 < 0){
+        return nullptr;
+    }
+    Vector3 n = (points[i1] - points[i0]).cross(points[i2] - points[i0]).normalized();
+    int i3 = -1;
+    maxDistance = eps;
+    for(int i=0; i < numPoints; ++i){
+        double distance = std::fabs(n.dot(points[i] - points[i0]));
+        if(distance > maxDistance){
+            maxDistance = distance;
+            i3 = i;
+        }
+    }
+    if(i3 < 0){
+        return nullptr;
+    }
+
+    const Vector3 center = (points[i0] + points[i1] + points[i2] + points[i3]) / 4.0;
+    vector<HullFace> faces;
+
+    auto addFace = [&](int a, int b, int c){
+        HullFace face;
+        Vector3 normal = (points[b] - points[a]).cross(points[c] - points[a]);
+        double norm = normal.norm();
+        if(norm > 0.0){
+            normal /= norm;
+        }
+        if(normal.dot(points[a] - center) < 0.0){
+            std::swap(b, c);
+            normal = -normal;
+        }
+        face.v[0] = a;
+        face.v[1] = b;
+        face.v[2] = c;
+        face.normal = normal;
+        face.d = -normal.dot(points[a]);
+        face.isVisible = false;
+        faces.push_back(face);
+    };
+
+    addFace(i0, i1, i2);
+    addFace(i0, i1, i3);
+    addFace(i0, i2, i3);
+    addFace(i1, i2, i3);
+
+    map<pair<int, int>, int> directedEdges;
+    vector<pair<int, int>> horizon;
+
+    for(int i=0; i < numPoints; ++i){
+        if(i == i0 || i == i1 || i == i2 || i == i3){
+            continue;
+        }
+        const Vector3& p = points[i];
+        bool isOutside = false;
+        for(auto& face : faces){
+            face.isVisible = (face.normal.dot(p) + face.d > eps);
+            isOutside |= face.isVisible;
+        }
+        if(!isOutside){
+            continue;
+        }
+
+        // The edges of the visible region whose reverse edges are not visible form the horizon
+        directedEdges.clear();
+        for(auto& face : faces){
+            if(face.isVisible){
+                for(int j=0; j < 3; ++j){
+                    directedEdges[make_pair(face.v[j], face.v[(j + 1) % 3])] = 1;
+                }
+            }
+        }
+        horizon.clear();
+        for(auto& kv : directedEdges){
+            auto& edge = kv.first;
+            if(directedEdges.find(make_pair(edge.second, edge.first)) == directedEdges.end()){
+                horizon.push_back(edge);
+            }
+        }
+
+        faces.erase(
+            std::remove_if(faces.begin(), faces.end(), [](const HullFace& face){ return face.isVisible; }),
+            faces.end());
+
+        for(auto& edge : horizon){
+            HullFace face;
+            face.v[0] = edge.first;
+            face.v[1] = edge.second;
+            face.v[2] = i;
+            Vector3 normal = (points[edge.second] - points[edge.first]).cross(p - points[edge.first]);
+            double norm = normal.norm();
+            if(norm > 0.0){
+                normal /= norm;
+            }
+            face.normal = normal;
+            face.d = -normal.dot(p);
+            face.isVisible = false;
+            faces.push_back(face);
+        }
+    }
+
+    auto hull = new SgMesh;
+    auto& vertices = *hull->getOrCreateVertices();
+    vector<int> indexMap(numPoints, -1);
+    for(auto& face : faces){
+        for(int j=0; j < 3; ++j){
+            int& index = indexMap[face.v[j]];
+            if(index < 0){
+                index = vertices.size();
+                vertices.push_back(points[face.v[j]].cast<float>());
+            }
+        }
+        hull->addTriangle(indexMap[face.v[0]], indexMap[face.v[1]], indexMap[face.v[2]]);
+    }
+    hull->updateBoundingBox();
+
+    return hull;
+}
+
+
+SgMesh* MeshSimplifier::createBoundingBox(SgMesh* mesh, Vector3* out_center)
+{
+    if(!mesh || !mesh->hasVertices()){
+        return nullptr;
+    }
+    BoundingBox bbox;
+    for(auto& v : *mesh->vertices()){
+        bbox.expandBy(v.cast<double>());
+    }
+    if(out_center){
+        *out_center = bbox.center();
+    }
+    return impl->meshGenerator.generateBox(bbox.size());
+}
@@ -0,0 +1,53 @@
+#ifndef CNOID_UTIL_MESH_SIMPLIFIER_H
+#define CNOID_UTIL_MESH_SIMPLIFIER_H
+
+#include "EigenTypes.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class SgMesh;
+
+/**
+   This class provides functions to create simplified meshes that can be used as
+   proxies of detailed meshes, mainly for collision detection.
+   The created meshes only have vertices and triangles.
+*/
+class CNOID_EXPORT MeshSimplifier
+{
+public:
+    MeshSimplifier();
+    MeshSimplifier(const MeshSimplifier& org);
+    ~MeshSimplifier();
+
+    //! The decimation stops when the number of triangles reaches this value. Zero means no limit.
+    void setTargetNumTriangles(int n);
+    int targetNumTriangles() const;
+
+    //! The decimation stops when the quadric error of the next edge collapse exceeds this distance.
+    void setMaxError(double e);
+    double maxError() const;
+
+    /**
+       Decimate the mesh by the edge collapse with the quadric error metrics.
+       \return A new mesh object or nullptr if the input mesh does not have any triangles.
+    */
+    SgMesh* simplify(SgMesh* mesh);
+    //! The meshes in the scene are integrated into a mesh with their transforms applied.
+    SgMesh* simplify(SgNode* scene);
+
+    SgMesh* createConvexHull(SgMesh* mesh);
+    SgMesh* createConvexHull(SgNode* scene);
+
+    //! \return A mesh of the box primitive that encloses the mesh. The box is centered at the origin.
+    SgMesh* createBoundingBox(SgMesh* mesh, Vector3* out_center = nullptr);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
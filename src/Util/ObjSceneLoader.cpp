@@ -3,8 +3,9 @@
 #include "SceneDrawables.h"
 #include "SceneLoader.h"
 #include "Triangulator.h"
-#include "ImageIO.h"
+#include "AsyncImageLoader.h"
 #include "NullOut.h"
+#include "ZipFileSystem.h"
 #include <unordered_map>
 #include <algorithm>
 #include "gettext.h"
@@ -103,7 +104,7 @@ public:
     MaterialInfo* currentMaterialDefInfo;
     SgMaterial* currentMaterialDef;
     MaterialInfo dummyMaterialInfo;
-    ImageIO imageIO;
+    AsyncImageLoader imageLoader;
     
     ostream* os_;
     ostream& os() { return *os_; }
@@ -153,7 +154,7 @@ ObjSceneLoader::ObjSceneLoader()
 ObjSceneLoader::Impl::Impl(ObjSceneLoader* self)
     : self(self)
 {
-    imageIO.setUpsideDown(true);
+    imageLoader.setUpsideDown(true);
     os_ = &nullout();
 }
 
@@ -569,6 +570,7 @@ void ObjSceneLoader::Impl::readMaterial(const std::string& name)
 bool ObjSceneLoader::Impl::loadMaterialTemplateLibrary(std::string filename)
 {
     string fullpath = toUTF8((directoryPath / fromUTF8(filename)).string());
+    ZipFileSystem::prepareFile(fullpath);
     if(!subScanner.open(fullpath)){
         os() << format("Material template library file \"{0}\" cannot be open.", filename) << endl;
         return false;
@@ -752,10 +754,11 @@ void ObjSceneLoader::Impl::readTexture(const std::string& mapType)
                 path = directoryPath / path;
             }
             auto filename = toUTF8(path.string());
-            SgTexturePtr texture = new SgTexture;
-            auto image = texture->getOrCreateImage();
-            if(imageIO.load(image->image(), filename, os())){
+            ZipFileSystem::prepareFile(filename);
+            if(auto image = imageLoader.loadImage(filename, os())){
                 image->setUriWithFilePathAndBaseDirectory(token, directory);
+                SgTexturePtr texture = new SgTexture;
+                texture->setImage(image);
                 currentMaterialDefInfo->texture = texture;
             }
         }
@@ -0,0 +1,414 @@
+#include "PointSetOctree.h"
+#include "PolyhedralRegion.h"
+#include <thread>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int MaxDepth = 20;
+constexpr int MinNumPointsForParallelBuilding = 200000;
+const float Sqrt3 = sqrt(3.0f);
+
+}
+
+namespace cnoid {
+
+class PointSetOctree::Builder
+{
+public:
+    const SgVertexArray& points;
+    vector<int>& indices;
+    vector<Node>& nodes;
+    int maxNumLeafPoints;
+
+    Builder(const SgVertexArray& points, vector<int>& indices, vector<Node>& nodes, int maxNumLeafPoints)
+        : points(points), indices(indices), nodes(nodes), maxNumLeafPoints(maxNumLeafPoints) { }
+
+    void splitRange(const Vector3f& center, int begin, int end, int* ranges);
+    int buildNode(const Vector3f& center, float halfSize, int begin, int end, int depth);
+};
+
+}
+
+
+/**
+   The point indices in the range are sorted into the octants.
+   The range of octant i is [ranges[i], ranges[i + 1]), where the bits 0, 1 and 2 of i correspond
+   to the positive sides of the x, y and z axes, respectively.
+*/
+void PointSetOctree::Builder::splitRange(const Vector3f& center, int begin, int end, int* ranges)
+{
+    auto top = indices.begin();
+    auto split = [&](int b, int e, int axis){
+        const float c = center[axis];
+        return static_cast<int>(
+            std::partition(top + b, top + e, [&](int i){ return points[i][axis] < c; }) - top);
+    };
+    ranges[0] = begin;
+    ranges[8] = end;
+    ranges[4] = split(begin, end, 2);
+    ranges[2] = split(begin, ranges[4], 1);
+    ranges[6] = split(ranges[4], end, 1);
+    for(int i=0; i < 8; i += 2){
+        ranges[i + 1] = split(ranges[i], ranges[i + 2], 0);
+    }
+}
+
+
+int PointSetOctree::Builder::buildNode(const Vector3f& center, float halfSize, int begin, int end, int depth)
+{
+    const int index = nodes.size();
+    nodes.emplace_back();
+    Node& node = nodes.back();
+    node.center = center;
+    node.halfSize = halfSize;
+    node.begin = begin;
+    node.end = end;
+    std::fill(node.children, node.children + 8, -1);
+    node.isLeaf = true;
+
+    if(end - begin > maxNumLeafPoints && depth < MaxDepth){
+        nodes[index].isLeaf = false;
+        int ranges[9];
+        splitRange(center, begin, end, ranges);
+        const float h = halfSize / 2.0f;
+        for(int i=0; i < 8; ++i){
+            if(ranges[i] < ranges[i + 1]){
+                Vector3f c(center.x() + ((i & 1) ? h : -h),
+                           center.y() + ((i & 2) ? h : -h),
+                           center.z() + ((i & 4) ? h : -h));
+                // The node reference cannot be used here because the node array may be reallocated
+                int child = buildNode(c, h, ranges[i], ranges[i + 1], depth + 1);
+                nodes[index].children[i] = child;
+            }
+        }
+    }
+
+    return index;
+}
+
+
+PointSetOctree::PointSetOctree()
+{
+    maxNumLeafPoints = 1024;
+}
+
+
+void PointSetOctree::clear()
+{
+    nodes.clear();
+    pointIndices.clear();
+}
+
+
+void PointSetOctree::build(const SgVertexArray& points, int maxNumLeafPoints)
+{
+    clear();
+    this->maxNumLeafPoints = std::max(1, maxNumLeafPoints);
+
+    const int n = points.size();
+    if(n == 0){
+        return;
+    }
+    pointIndices.resize(n);
+    Vector3f min = points[0];
+    Vector3f max = points[0];
+    for(int i=0; i < n; ++i){
+        pointIndices[i] = i;
+        min = min.cwiseMin(points[i]);
+        max = max.cwiseMax(points[i]);
+    }
+    const Vector3f center = (min + max) / 2.0f;
+    const float halfSize = std::max((max - min).maxCoeff() / 2.0f, 1.0e-6f);
+
+    const int numThreads = thread::hardware_concurrency();
+    if(n < MinNumPointsForParallelBuilding || numThreads <= 1 || n <= this->maxNumLeafPoints){
+        Builder builder(points, pointIndices, nodes, this->maxNumLeafPoints);
+        builder.buildNode(center, halfSize, 0, n, 0);
+        return;
+    }
+
+    // The subtrees of the octants of the root node are built in parallel
+    Builder rootBuilder(points, pointIndices, nodes, this->maxNumLeafPoints);
+    nodes.emplace_back();
+    Node& root = nodes.back();
+    root.center = center;
+    root.halfSize = halfSize;
+    root.begin = 0;
+    root.end = n;
+    std::fill(root.children, root.children + 8, -1);
+    root.isLeaf = false;
+    int ranges[9];
+    rootBuilder.splitRange(center, 0, n, ranges);
+
+    vector<Node> subtrees[8];
+    vector<thread> threads;
+    const float h = halfSize / 2.0f;
+    for(int i=0; i < 8; ++i){
+        if(ranges[i] < ranges[i + 1]){
+            Vector3f c(center.x() + ((i & 1) ? h : -h),
+                       center.y() + ((i & 2) ? h : -h),
+                       center.z() + ((i & 4) ? h : -h));
+            threads.emplace_back(
+                [this, &points, &subtrees, &ranges, i, c, h](){
+                    Builder builder(points, pointIndices, subtrees[i], this->maxNumLeafPoints);
+                    builder.buildNode(c, h, ranges[i], ranges[i + 1], 1);
+                });
+        }
+    }
+    for(auto& t : threads){
+        t.join();
+    }
+
+    for(int i=0; i < 8; ++i){
+        auto& subtree = subtrees[i];
+        if(!subtree.empty()){
+            const int offset = nodes.size();
+            nodes[0].children[i] = offset;
+            for(auto& node : subtree){
+                for(int j=0; j < 8; ++j){
+                    if(node.children[j] >= 0){
+                        node.children[j] += offset;
+                    }
+                }
+            }
+            nodes.insert(nodes.end(), subtree.begin(), subtree.end());
+        }
+    }
+}
+
+
+void PointSetOctree::findPointsInRegion
+(const SgVertexArray& points, const PolyhedralRegion& region, const Isometry3& T, std::vector<int>& out_indices) const
+{
+    out_indices.clear();
+    if(nodes.empty()){
+        return;
+    }
+
+    const int numPlanes = region.numBoundingPlanes();
+    vector<double> normalLengths(numPlanes);
+    for(int i=0; i < numPlanes; ++i){
+        normalLengths[i] = region.plane(i).normal.norm();
+    }
+
+    vector<int> nodesToVisit;
+    nodesToVisit.push_back(0);
+    while(!nodesToVisit.empty()){
+        const Node& node = nodes[nodesToVisit.back()];
+        nodesToVisit.pop_back();
+        if(node.begin == node.end){
+            continue;
+        }
+        const Vector3 c = T * node.center.cast<double>();
+        const double r = node.halfSize * Sqrt3;
+        bool isOutside = false;
+        bool isCrossing = false;
+        for(int i=0; i < numPlanes; ++i){
+            auto& plane = region.plane(i);
+            const double d = c.dot(plane.normal) - plane.d;
+            const double rn = r * normalLengths[i];
+            if(d < -rn){
+                isOutside = true;
+                break;
+            } else if(d < rn){
+                isCrossing = true;
+            }
+        }
+        if(isOutside){
+            continue;
+        }
+        if(!isCrossing){
+            out_indices.insert(out_indices.end(), pointIndices.begin() + node.begin, pointIndices.begin() + node.end);
+        } else if(node.isLeaf){
+            for(int i = node.begin; i < node.end; ++i){
+                const int index = pointIndices[i];
+                if(region.checkInside(T * points[index].cast<double>())){
+                    out_indices.push_back(index);
+                }
+            }
+        } else {
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    nodesToVisit.push_back(node.children[i]);
+                }
+            }
+        }
+    }
+
+    std::sort(out_indices.begin(), out_indices.end());
+}
+
+
+int PointSetOctree::findNearestPoint(const SgVertexArray& points, const Vector3f& p, float maxDistance) const
+{
+    int nearest = -1;
+    float minSqrDistance = maxDistance * maxDistance;
+
+    vector<int> nodesToVisit;
+    if(!nodes.empty()){
+        nodesToVisit.push_back(0);
+    }
+    while(!nodesToVisit.empty()){
+        const Node& node = nodes[nodesToVisit.back()];
+        nodesToVisit.pop_back();
+        const Vector3f d = ((p - node.center).cwiseAbs().array() - node.halfSize).cwiseMax(0.0f);
+        if(d.squaredNorm() > minSqrDistance){
+            continue;
+        }
+        if(node.isLeaf){
+            for(int i = node.begin; i < node.end; ++i){
+                const int index = pointIndices[i];
+                const float sqrDistance = (points[index] - p).squaredNorm();
+                if(sqrDistance <= minSqrDistance){
+                    minSqrDistance = sqrDistance;
+                    nearest = index;
+                }
+            }
+        } else {
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    nodesToVisit.push_back(node.children[i]);
+                }
+            }
+        }
+    }
+
+    return nearest;
+}
+
+
+int PointSetOctree::numNodeSamples(const Node& node) const
+{
+    return std::min(node.end - node.begin, maxNumLeafPoints);
+}
+
+
+/**
+   The indices in the range of a node are stored in the order of the octants and the order is
+   kept in the range of its ancestor nodes. The points sampled with a constant stride in the
+   range are therefore distributed over the sub nodes in proportion to their numbers of points.
+*/
+void PointSetOctree::appendNodeSamples(const Node& node, int numSamples, std::vector<int>& out_indices) const
+{
+    const int n = node.end - node.begin;
+    if(n <= numSamples){
+        out_indices.insert(out_indices.end(), pointIndices.begin() + node.begin, pointIndices.begin() + node.end);
+    } else {
+        const double stride = static_cast<double>(n) / numSamples;
+        for(int i=0; i < numSamples; ++i){
+            out_indices.push_back(pointIndices[node.begin + static_cast<int>(i * stride)]);
+        }
+    }
+}
+
+
+int PointSetOctree::selectLodPoints(const Vector3f& viewpoint, int maxNumPoints, std::vector<int>& out_indices) const
+{
+    out_indices.clear();
+    if(nodes.empty() || maxNumPoints <= 0){
+        return 0;
+    }
+    const Node& root = nodes[0];
+    if(numNodeSamples(root) >= maxNumPoints){
+        appendNodeSamples(root, maxNumPoints, out_indices);
+        return out_indices.size();
+    }
+
+    // The nodes that look larger from the viewpoint are subdivided first
+    typedef pair<float, int> NodeEntry;
+    priority_queue<NodeEntry> queue;
+    auto pushNode = [&](int index){
+        const Node& node = nodes[index];
+        const Vector3f d = ((viewpoint - node.center).cwiseAbs().array() - node.halfSize).cwiseMax(0.0f);
+        queue.emplace(node.halfSize / (d.norm() + node.halfSize * 0.01f), index);
+    };
+    pushNode(0);
+    int numSelectedPoints = numNodeSamples(root);
+
+    while(!queue.empty()){
+        const Node& node = nodes[queue.top().second];
+        queue.pop();
+        bool isSubdivided = false;
+        if(!node.isLeaf){
+            int numChildSamples = 0;
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    numChildSamples += numNodeSamples(nodes[node.children[i]]);
+                }
+            }
+            const int numNewPoints = numSelectedPoints - numNodeSamples(node) + numChildSamples;
+            if(numNewPoints <= maxNumPoints){
+                numSelectedPoints = numNewPoints;
+                for(int i=0; i < 8; ++i){
+                    if(node.children[i] >= 0){
+                        pushNode(node.children[i]);
+                    }
+                }
+                isSubdivided = true;
+            }
+        }
+        if(!isSubdivided){
+            appendNodeSamples(node, maxNumLeafPoints, out_indices);
+        }
+    }
+
+    return out_indices.size();
+}
+
+
+void PointSetOctree::removePoints(const std::vector<int>& sortedIndices)
+{
+    if(nodes.empty() || sortedIndices.empty()){
+        return;
+    }
+    const int n = pointIndices.size();
+    vector<int> indexMap(n);
+    int numRemoved = 0;
+    auto p = sortedIndices.begin();
+    for(int i=0; i < n; ++i){
+        if(p != sortedIndices.end() && *p == i){
+            indexMap[i] = -1;
+            ++numRemoved;
+            ++p;
+        } else {
+            indexMap[i] = i - numRemoved;
+        }
+    }
+
+    /*
+      The ranges are compacted in the order of the index array because the ranges of the
+      child nodes are aligned in the range of their parent node.
+    */
+    int cursor = 0;
+    std::function<void(int nodeIndex)> updateNode;
+    updateNode = [&](int nodeIndex){
+        Node& node = nodes[nodeIndex];
+        const int newBegin = cursor;
+        if(node.isLeaf){
+            for(int i = node.begin; i < node.end; ++i){
+                const int index = indexMap[pointIndices[i]];
+                if(index >= 0){
+                    pointIndices[cursor++] = index;
+                }
+            }
+        } else {
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    updateNode(node.children[i]);
+                }
+            }
+        }
+        node.begin = newBegin;
+        node.end = cursor;
+    };
+    updateNode(0);
+
+    pointIndices.resize(cursor);
+}
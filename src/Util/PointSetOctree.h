@@ -0,0 +1,83 @@
+#ifndef CNOID_UTIL_POINT_SET_OCTREE_H
+#define CNOID_UTIL_POINT_SET_OCTREE_H
+
+#include "SceneDrawables.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class PolyhedralRegion;
+
+/**
+   This class is an octree of the points of a point array, which accelerates the spatial queries
+   and the selection of the points rendered with a view-dependent level of detail.
+   The octree does not keep a reference to the point array. It must be rebuilt or updated
+   when the point array is modified.
+*/
+class CNOID_EXPORT PointSetOctree : public Referenced
+{
+public:
+    PointSetOctree();
+
+    //! The octree is built with multiple threads when the number of points is large.
+    void build(const SgVertexArray& points, int maxNumLeafPoints = 1024);
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+    int numPoints() const { return pointIndices.size(); }
+    int numNodes() const { return nodes.size(); }
+
+    /**
+       \param T The transform from the coordinate frame of the points to that of the region
+       \param out_indices The indices of the points in the region are stored in the ascending order.
+    */
+    void findPointsInRegion(
+        const SgVertexArray& points, const PolyhedralRegion& region, const Isometry3& T,
+        std::vector<int>& out_indices) const;
+
+    //! \return The index of the nearest point within the distance, or -1 if there is no such point.
+    int findNearestPoint(const SgVertexArray& points, const Vector3f& p, float maxDistance) const;
+
+    /**
+       The points are selected from the nodes near the viewpoint with higher density
+       so that the number of the selected points does not exceed the given number.
+       The points of a node are sampled uniformly when the node is too far to be subdivided.
+       \return The number of the selected points
+    */
+    int selectLodPoints(const Vector3f& viewpoint, int maxNumPoints, std::vector<int>& out_indices) const;
+
+    /**
+       This function updates the octree without rebuilding it so that it can be used with
+       the point array from which the points of the given indices are removed.
+       \param sortedIndices The indices of the removed points in the ascending order
+    */
+    void removePoints(const std::vector<int>& sortedIndices);
+
+private:
+    struct Node
+    {
+        Vector3f center;
+        float halfSize;
+        int begin;
+        int end;
+        //! -1 for an empty octant
+        int children[8];
+        bool isLeaf;
+    };
+    std::vector<Node> nodes;
+    std::vector<int> pointIndices;
+    int maxNumLeafPoints;
+
+    class Builder;
+    friend class Builder;
+
+    int numNodeSamples(const Node& node) const;
+    void appendNodeSamples(const Node& node, int numSamples, std::vector<int>& out_indices) const;
+};
+
+typedef ref_ptr<PointSetOctree> PointSetOctreePtr;
+
+}
+
+#endif
@@ -1,16 +1,25 @@
 #include "PointSetUtil.h"
-#include <cnoid/EasyScanner>
+#include "MappedFile.h"
 #include <cnoid/UTF8>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
+#include <thread>
+#include <algorithm>
+#include <memory>
+#include <limits>
 #include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
 
 using namespace std;
 using namespace cnoid;
 
 namespace {
 
-enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB };
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB, E_OTHER };
 
 typedef union {
     struct {
@@ -20,152 +29,708 @@ typedef union {
         unsigned char alpha;
     };
     float float_value;
+    uint32_t uint_value;
 } RGBValue;
 
+// The minimum number of points processed by a thread
+constexpr int MinNumPointsPerThread = 100000;
 
-void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints)
+struct Field
 {
-    SgVertexArrayPtr vertices = new SgVertexArray();
-    vertices->reserve(numPoints);
+    Element element;
+    char type;
+    int size;
+    int count;
+    int offset; // byte offset in a point of the binary data
+};
 
-    const int numElements = elements.size();
+struct Header
+{
+    vector<Field> fields;
+    int numPoints;
+    int pointSize;
+    string dataType;
+    size_t dataOffset;
+    bool hasNormals;
+    bool hasColors;
+};
+
+
+template<class Function>
+void parallelFor(int n, Function func)
+{
+    int numThreads = std::min(static_cast<int>(thread::hardware_concurrency()), n / MinNumPointsPerThread);
+    if(numThreads <= 1){
+        func(0, 0, n);
+        return;
+    }
+    vector<thread> threads;
+    const int chunkSize = (n + numThreads - 1) / numThreads;
+    for(int i=0; i < numThreads; ++i){
+        const int begin = i * chunkSize;
+        const int end = std::min(n, begin + chunkSize);
+        threads.emplace_back(func, i, begin, end);
+    }
+    for(auto& t : threads){
+        t.join();
+    }
+}
+
+
+Element getElement(const string& name)
+{
+    if(name == "x"){
+        return E_X;
+    } else if(name == "y"){
+        return E_Y;
+    } else if(name == "z"){
+        return E_Z;
+    } else if(name == "normal_x"){
+        return E_NORMAL_X;
+    } else if(name == "normal_y"){
+        return E_NORMAL_Y;
+    } else if(name == "normal_z"){
+        return E_NORMAL_Z;
+    } else if(name == "rgb" || name == "rgba"){
+        return E_RGB;
+    }
+    return E_OTHER;
+}
+
+
+Header readHeader(const char* data, size_t size)
+{
+    Header header;
+    header.numPoints = -1;
+    header.pointSize = 0;
+    header.hasNormals = false;
+    header.hasColors = false;
+
+    vector<int> sizes;
+    vector<char> types;
+    vector<int> counts;
+    int width = -1;
+    int height = 1;
+
+    size_t pos = 0;
+    while(pos < size){
+        size_t lineEnd = pos;
+        while(lineEnd < size && data[lineEnd] != '\n'){
+            ++lineEnd;
+        }
+        istringstream line(string(data + pos, lineEnd - pos));
+        pos = std::min(size, lineEnd + 1);
+
+        string key;
+        if(!(line >> key) || key[0] == '#'){
+            continue;
+        }
+        if(key == "FIELDS"){
+            string name;
+            while(line >> name){
+                Field field;
+                field.element = getElement(name);
+                header.fields.push_back(field);
+                if(field.element >= E_NORMAL_X && field.element <= E_NORMAL_Z){
+                    header.hasNormals = true;
+                } else if(field.element == E_RGB){
+                    header.hasColors = true;
+                }
+            }
+        } else if(key == "SIZE"){
+            int value;
+            while(line >> value){
+                sizes.push_back(value);
+            }
+        } else if(key == "TYPE"){
+            char value;
+            while(line >> value){
+                types.push_back(value);
+            }
+        } else if(key == "COUNT"){
+            int value;
+            while(line >> value){
+                counts.push_back(value);
+            }
+        } else if(key == "WIDTH"){
+            line >> width;
+        } else if(key == "HEIGHT"){
+            line >> height;
+        } else if(key == "POINTS"){
+            if(!(line >> header.numPoints)){
+                throw std::runtime_error("The 'POINTS' field is not correctly specified.");
+            }
+        } else if(key == "DATA"){
+            if(!(line >> header.dataType)){
+                throw std::runtime_error("The 'DATA' field is not correctly specified.");
+            }
+            header.dataOffset = pos;
+            break;
+        }
+    }
 
+    if(header.dataType.empty()){
+        throw std::runtime_error("The 'DATA' field is not found.");
+    }
+    if(header.fields.empty()){
+        throw std::runtime_error("The specification of field elements is not found.");
+    }
+    if(header.numPoints < 0){
+        header.numPoints = (width >= 0) ? (width * height) : 0;
+    }
+
+    const int numFields = header.fields.size();
+    int64_t pointSize = 0;
+    for(int i=0; i < numFields; ++i){
+        auto& field = header.fields[i];
+        field.size = (i < static_cast<int>(sizes.size())) ? sizes[i] : 4;
+        field.type = (i < static_cast<int>(types.size())) ? types[i] : 'F';
+        field.count = (i < static_cast<int>(counts.size())) ? counts[i] : 1;
+
+        // The other fields are also validated because they determine the offsets of the fields
+        if((field.size != 1 && field.size != 2 && field.size != 4 && field.size != 8) ||
+           (field.type != 'F' && field.type != 'U' && field.type != 'I') ||
+           (field.type == 'F' && field.size != 4 && field.size != 8) ||
+           field.count <= 0){
+            throw std::runtime_error("The type of a point field is not correctly specified.");
+        }
+        if(field.element != E_OTHER){
+            if(field.count != 1 || (field.element == E_RGB && field.size != 4)){
+                throw std::runtime_error("The type of a point field is not supported.");
+            }
+        }
+        field.offset = pointSize;
+        pointSize += static_cast<int64_t>(field.size) * field.count;
+        if(pointSize > std::numeric_limits<int>::max()){
+            throw std::runtime_error("The size of a point is too large.");
+        }
+    }
+    header.pointSize = pointSize;
+
+    return header;
+}
+
+
+/**
+   The types and sizes of the fields must be validated by readHeader.
+*/
+inline double readBinaryValue(const char* p, const Field& field)
+{
+    switch(field.type){
+    case 'F':
+        switch(field.size){
+        case 4: { float value; memcpy(&value, p, 4); return value; }
+        case 8: { double value; memcpy(&value, p, 8); return value; }
+        default: break;
+        }
+        break;
+    case 'U':
+        switch(field.size){
+        case 1: { uint8_t value; memcpy(&value, p, 1); return value; }
+        case 2: { uint16_t value; memcpy(&value, p, 2); return value; }
+        case 4: { uint32_t value; memcpy(&value, p, 4); return value; }
+        case 8: { uint64_t value; memcpy(&value, p, 8); return static_cast<double>(value); }
+        default: break;
+        }
+        break;
+    case 'I':
+        switch(field.size){
+        case 1: { int8_t value; memcpy(&value, p, 1); return value; }
+        case 2: { int16_t value; memcpy(&value, p, 2); return value; }
+        case 4: { int32_t value; memcpy(&value, p, 4); return value; }
+        case 8: { int64_t value; memcpy(&value, p, 8); return static_cast<double>(value); }
+        default: break;
+        }
+        break;
+    default:
+        break;
+    }
+    return 0.0;
+}
+
+
+inline void setColor(Vector3f& color, const RGBValue& rgb)
+{
+    color[0] = rgb.red / 255.0f;
+    color[1] = rgb.green / 255.0f;
+    color[2] = rgb.blue / 255.0f;
+}
+
+
+class PointArrays
+{
+public:
+    SgVertexArrayPtr vertices;
     SgNormalArrayPtr normals;
-    bool hasNormals = false;
     SgColorArrayPtr colors;
-    bool hasColors = false;
-    for(int i=0; i < numElements; ++i){
-        Element element = elements[i];
-        if(element >= E_NORMAL_X && element <= E_NORMAL_Z){
-            hasNormals = true;
-            normals = new SgNormalArray();
-            normals->reserve(numPoints);
-        } else if(element == E_RGB){
-            hasColors = true;
-            colors = new SgColorArray();
-        }
-    }
-
-    Vector3f vertex = Vector3f::Zero();
-    Vector3f normal = Vector3f::Zero();
-    Vector3f color = Vector3f::Zero();
-    RGBValue rgb;
-
-    while(!scanner.isEOF()){
-        scanner.skipBlankLines();
-
-        bool hasIllegalValue = false;
-        for(int i=0; i < numElements; ++i){
-            //double value = scanner.readDoubleEx("Illeagel point values");
-
-            if(!scanner.readDouble()){
-                // put warning here
-                hasIllegalValue = true;
-                scanner.skipToLineEnd();
-                break;
-                    
-            } else {
-                double value = scanner.doubleValue;
-                switch(elements[i]){
-                case E_X: vertex.x() = value; break;
-                case E_Y: vertex.y() = value; break;
-                case E_Z: vertex.z() = value; break;
-                case E_NORMAL_X: normal.x() = value; break;
-                case E_NORMAL_Y: normal.y() = value; break;
-                case E_NORMAL_Z: normal.z() = value; break;
-                case E_RGB:
-                    rgb.float_value = value;
-                    color[0] = rgb.red / 255.0;
-                    color[1] = rgb.green / 255.0;
-                    color[2] = rgb.blue / 255.0;
-                    break;
+
+    PointArrays(const Header& header, int numPoints){
+        vertices = new SgVertexArray(numPoints);
+        if(header.hasNormals){
+            normals = new SgNormalArray(numPoints);
+        }
+        if(header.hasColors){
+            colors = new SgColorArray(numPoints);
+        }
+    }
+
+    /**
+       The points whose coordinates are not finite are removed.
+       Such points are contained in the organized point clouds.
+    */
+    void removeInvalidPoints(){
+        auto& v = *vertices;
+        const int n = v.size();
+        int m = 0;
+        for(int i=0; i < n; ++i){
+            if(v[i].allFinite()){
+                if(m < i){
+                    v[m] = v[i];
+                    if(normals){
+                        (*normals)[m] = (*normals)[i];
+                    }
+                    if(colors){
+                        (*colors)[m] = (*colors)[i];
+                    }
                 }
+                ++m;
             }
         }
-        if(!hasIllegalValue){
-            vertices->push_back(vertex);
-            if(hasNormals){
-                normals->push_back(normal);
+        if(m < n){
+            v.resize(m);
+            if(normals){
+                normals->resize(m);
             }
-            if(hasColors){
-                colors->push_back(color);
+            if(colors){
+                colors->resize(m);
             }
         }
-        scanner.readLFEOF();
     }
 
-    if(vertices->empty()){
-        throw std::runtime_error("No valid points");
-    } else {
-        out_pointSet->setVertices(vertices);
-        out_pointSet->setNormals(normals);
-        out_pointSet->normalIndices().clear();
-        out_pointSet->setColors(colors);
-        out_pointSet->colorIndices().clear();
+    void setValue(int index, Element element, double value){
+        switch(element){
+        case E_X: (*vertices)[index].x() = value; break;
+        case E_Y: (*vertices)[index].y() = value; break;
+        case E_Z: (*vertices)[index].z() = value; break;
+        case E_NORMAL_X: (*normals)[index].x() = value; break;
+        case E_NORMAL_Y: (*normals)[index].y() = value; break;
+        case E_NORMAL_Z: (*normals)[index].z() = value; break;
+        default: break;
+        }
+    }
+
+    void setRgb(int index, const char* p){
+        RGBValue rgb;
+        memcpy(&rgb.uint_value, p, 4);
+        setColor((*colors)[index], rgb);
     }
+};
+
+
+/**
+   \param fieldStrides The byte stride between the values of each field.
+   This is the point size for the binary data and the field size for the
+   decompressed data, where the values of each field are stored contiguously.
+*/
+void readBinaryPoints
+(PointArrays& arrays, const Header& header, const vector<const char*>& fieldData, const vector<int>& fieldStrides)
+{
+    const int numFields = header.fields.size();
+
+    parallelFor(
+        header.numPoints,
+        [&](int, int begin, int end){
+            for(int i=0; i < numFields; ++i){
+                auto& field = header.fields[i];
+                if(field.element == E_OTHER){
+                    continue;
+                }
+                const int stride = fieldStrides[i];
+                const char* p = fieldData[i] + static_cast<size_t>(begin) * stride;
+                if(field.element == E_RGB){
+                    for(int j = begin; j < end; ++j){
+                        arrays.setRgb(j, p);
+                        p += stride;
+                    }
+                } else if(field.type == 'F' && field.size == 4){
+                    auto element = field.element;
+                    for(int j = begin; j < end; ++j){
+                        float value;
+                        memcpy(&value, p, 4);
+                        arrays.setValue(j, element, value);
+                        p += stride;
+                    }
+                } else {
+                    for(int j = begin; j < end; ++j){
+                        arrays.setValue(j, field.element, readBinaryValue(p, field));
+                        p += stride;
+                    }
+                }
+            }
+        });
 }
 
+
+bool decompressLZF(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* ip = in;
+    const unsigned char* const inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* const outEnd = out + outSize;
+
+    while(ip < inEnd){
+        unsigned int ctrl = *ip++;
+        if(ctrl < 32){ // literal run
+            ++ctrl;
+            if(op + ctrl > outEnd || ip + ctrl > inEnd){
+                return false;
+            }
+            memcpy(op, ip, ctrl);
+            op += ctrl;
+            ip += ctrl;
+        } else { // back reference
+            unsigned int length = ctrl >> 5;
+            if(length == 7){
+                if(ip >= inEnd){
+                    return false;
+                }
+                length += *ip++;
+            }
+            if(ip >= inEnd){
+                return false;
+            }
+            const size_t distance = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+            length += 2;
+            if(distance > static_cast<size_t>(op - out) || op + length > outEnd){
+                return false;
+            }
+            const unsigned char* ref = op - distance;
+            // The areas may overlap
+            for(unsigned int i=0; i < length; ++i){
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op == outEnd;
 }
 
 
-void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+void compressLZF(const unsigned char* in, size_t inSize, vector<unsigned char>& out)
 {
-    try {
-        EasyScanner scanner(filename);
-        scanner.setCommentChar('#');
-
-        int numPoints = 0;
-
-        std::vector<Element> elements;
-
-        while(true){
-            scanner.skipBlankLines();
-            scanner.readWordEx("Illegal header key");
-
-            if(scanner.stringValue == "FIELDS"){
-                while(scanner.readWord()){
-                    if(scanner.stringValue == "x"){
-                        elements.push_back(E_X);
-                    } else if(scanner.stringValue == "y"){
-                        elements.push_back(E_Y);
-                    } else if(scanner.stringValue == "z"){
-                        elements.push_back(E_Z);
-                    } else if(scanner.stringValue == "normal_x"){
-                        elements.push_back(E_NORMAL_X);
-                    } else if(scanner.stringValue == "normal_y"){
-                        elements.push_back(E_NORMAL_Y);
-                    } else if(scanner.stringValue == "normal_z"){
-                        elements.push_back(E_NORMAL_Z);
-                    } else if(scanner.stringValue == "rgb"){
-                        elements.push_back(E_RGB);
-                    }
+    constexpr int HashLog = 16;
+    constexpr size_t MaxDistance = 1 << 13;
+    constexpr size_t MaxLength = 264;
+    constexpr size_t MaxLiteralLength = 32;
+    const size_t NoPosition = std::numeric_limits<size_t>::max();
+
+    vector<size_t> hashTable(1 << HashLog, NoPosition);
+    out.clear();
+    out.reserve(inSize + inSize / 32 + 16);
+
+    size_t literalLength = 0;
+    out.push_back(0); // control byte of the current literal run
+
+    auto finishLiteralRun = [&](){
+        if(literalLength > 0){
+            out[out.size() - literalLength - 1] = literalLength - 1;
+        } else {
+            out.pop_back();
+        }
+    };
+
+    size_t ip = 0;
+    while(ip < inSize){
+        if(ip + 2 < inSize){
+            const uint32_t v = (in[ip] << 16) | (in[ip + 1] << 8) | in[ip + 2];
+            const uint32_t hash = ((v * 2654435761u) >> (32 - HashLog)) & ((1 << HashLog) - 1);
+            const size_t ref = hashTable[hash];
+            hashTable[hash] = ip;
+            if(ref != NoPosition && ip - ref <= MaxDistance &&
+               in[ref] == in[ip] && in[ref + 1] == in[ip + 1] && in[ref + 2] == in[ip + 2]){
+                const size_t maxLength = std::min(MaxLength, inSize - ip);
+                size_t length = 3;
+                while(length < maxLength && in[ref + length] == in[ip + length]){
+                    ++length;
                 }
-            } else if(scanner.stringValue == "POINTS"){
-                numPoints = scanner.readIntEx("The 'POINTS' field is not correctly specified.");
-            } else if(scanner.stringValue == "DATA"){
-                scanner.readWordEx("The 'DATA' field is not correctly specified.");
-                if(scanner.stringValue == "ascii"){
-                    scanner.readLFex();
-                    if(elements.empty()){
-                        scanner.throwException("The specification of field elements is not found.");
-                    }
-                    readPoints(out_pointSet, scanner, elements, numPoints);
-                    break;
+                finishLiteralRun();
+                const size_t distance = ip - ref - 1;
+                const size_t encodedLength = length - 2;
+                if(encodedLength < 7){
+                    out.push_back((distance >> 8) + (encodedLength << 5));
                 } else {
-                    scanner.throwException("The 'ascii' format is only supported for the point DATA.");
+                    out.push_back((distance >> 8) + (7 << 5));
+                    out.push_back(encodedLength - 7);
                 }
-            } else {
-                scanner.skipToLineEnd();
+                out.push_back(distance & 0xff);
+                ip += length;
+                literalLength = 0;
+                out.push_back(0);
+                continue;
             }
-            scanner.readLFEOFex("The field value is not correctly specified.");
         }
-    } catch(EasyScanner::Exception& ex){
-        throw std::runtime_error(ex.getFullMessage());
+        out.push_back(in[ip++]);
+        if(++literalLength == MaxLiteralLength){
+            finishLiteralRun();
+            literalLength = 0;
+            out.push_back(0);
+        }
+    }
+    finishLiteralRun();
+}
+
+
+const char* findLineEnd(const char* p, const char* end)
+{
+    auto q = static_cast<const char*>(memchr(p, '\n', end - p));
+    return q ? q : end;
+}
+
+
+/**
+   The token is copied to a terminated buffer because the mapped file data is not
+   terminated and strtod or strtoul may read beyond the end of the data.
+   \return false if there is no token before the line end or the token is not a number.
+*/
+template<class Converter>
+bool readAsciiToken(const char*& p, const char* lineEnd, Converter convert)
+{
+    while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')){
+        ++p;
+    }
+    const char* tokenEnd = p;
+    while(tokenEnd < lineEnd && *tokenEnd != ' ' && *tokenEnd != '\t' && *tokenEnd != '\r'){
+        ++tokenEnd;
+    }
+    const size_t length = tokenEnd - p;
+    char buf[64];
+    if(length == 0 || length >= sizeof(buf)){
+        return false;
+    }
+    memcpy(buf, p, length);
+    buf[length] = '\0';
+    char* valueEnd;
+    convert(buf, &valueEnd);
+    if(valueEnd != buf + length){
+        return false;
+    }
+    p = tokenEnd;
+    return true;
+}
+
+
+/**
+   The values of the points in the lines in the range are read into the local arrays.
+   \return The number of the read points
+*/
+int readAsciiPoints(const Header& header, const char* p, const char* end, PointArrays& arrays)
+{
+    const int numFields = header.fields.size();
+    int numPoints = 0;
+
+    while(p < end){
+        const char* lineEnd = findLineEnd(p, end);
+        if(numPoints >= static_cast<int>(arrays.vertices->size())){
+            const int newSize = std::max(1024, numPoints * 2);
+            arrays.vertices->resize(newSize);
+            if(arrays.normals){
+                arrays.normals->resize(newSize);
+            }
+            if(arrays.colors){
+                arrays.colors->resize(newSize);
+            }
+        }
+        bool isValid = true;
+        bool isBlank = true;
+        const char* q = p;
+        for(int i=0; i < numFields && isValid; ++i){
+            auto& field = header.fields[i];
+            for(int j=0; j < field.count; ++j){
+                bool isRead;
+                if(field.element == E_RGB && field.type != 'F'){
+                    isRead = readAsciiToken(
+                        q, lineEnd,
+                        [&](const char* token, char** valueEnd){
+                            RGBValue rgb;
+                            rgb.uint_value = strtoul(token, valueEnd, 10);
+                            setColor((*arrays.colors)[numPoints], rgb);
+                        });
+                } else {
+                    isRead = readAsciiToken(
+                        q, lineEnd,
+                        [&](const char* token, char** valueEnd){
+                            double value = strtod(token, valueEnd);
+                            if(field.element == E_RGB){
+                                RGBValue rgb;
+                                rgb.float_value = value;
+                                setColor((*arrays.colors)[numPoints], rgb);
+                            } else {
+                                arrays.setValue(numPoints, field.element, value);
+                            }
+                        });
+                }
+                if(!isRead){
+                    isValid = false;
+                    break;
+                }
+                isBlank = false;
+            }
+        }
+        if(isValid){
+            ++numPoints;
+        } else if(!isBlank){
+            // put warning here
+        }
+        p = lineEnd + 1;
+    }
+
+    return numPoints;
+}
+
+
+void readAsciiPoints(PointArrays& arrays, const Header& header, const char* data, const char* end)
+{
+    const size_t dataSize = end - data;
+
+    // The data is divided at the line ends to be read in parallel
+    int numThreads = std::min(
+        static_cast<int>(thread::hardware_concurrency()), header.numPoints / MinNumPointsPerThread);
+    numThreads = std::max(1, numThreads);
+    vector<const char*> chunkBegins(numThreads + 1);
+    chunkBegins[0] = data;
+    for(int i=1; i < numThreads; ++i){
+        const char* p = std::max(chunkBegins[i - 1], data + dataSize * i / numThreads);
+        p = findLineEnd(p, end);
+        chunkBegins[i] = (p < end) ? (p + 1) : end;
+    }
+    chunkBegins[numThreads] = end;
+
+    vector<unique_ptr<PointArrays>> chunkArrays(numThreads);
+    vector<int> numChunkPoints(numThreads, 0);
+    for(int i=0; i < numThreads; ++i){
+        chunkArrays[i] = make_unique<PointArrays>(header, 0);
+    }
+    auto readChunk = [&](int index){
+        numChunkPoints[index] =
+            readAsciiPoints(header, chunkBegins[index], chunkBegins[index + 1], *chunkArrays[index]);
+    };
+    if(numThreads == 1){
+        readChunk(0);
+    } else {
+        vector<thread> threads;
+        for(int i=0; i < numThreads; ++i){
+            threads.emplace_back(readChunk, i);
+        }
+        for(auto& t : threads){
+            t.join();
+        }
+    }
+
+    int numPoints = 0;
+    for(int i=0; i < numThreads; ++i){
+        numPoints += numChunkPoints[i];
+    }
+    arrays.vertices->resize(numPoints);
+    if(arrays.normals){
+        arrays.normals->resize(numPoints);
     }
+    if(arrays.colors){
+        arrays.colors->resize(numPoints);
+    }
+    int index = 0;
+    for(int i=0; i < numThreads; ++i){
+        auto& chunk = *chunkArrays[i];
+        const int n = numChunkPoints[i];
+        std::copy(chunk.vertices->begin(), chunk.vertices->begin() + n, arrays.vertices->begin() + index);
+        if(arrays.normals){
+            std::copy(chunk.normals->begin(), chunk.normals->begin() + n, arrays.normals->begin() + index);
+        }
+        if(arrays.colors){
+            std::copy(chunk.colors->begin(), chunk.colors->begin() + n, arrays.colors->begin() + index);
+        }
+        index += n;
+    }
+}
+
 }
 
 
-void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint)
+void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+{
+    MappedFile file(filename, MappedFile::SequentialAccess);
+    const char* data = file.data();
+    const char* end = data + file.size();
+
+    Header header = readHeader(data, file.size());
+    const int numFields = header.fields.size();
+    unique_ptr<PointArrays> arrays;
+
+    if(header.dataType == "ascii"){
+        arrays = make_unique<PointArrays>(header, 0);
+        readAsciiPoints(*arrays, header, data + header.dataOffset, end);
+
+    } else if(header.dataType == "binary"){
+        if(header.dataOffset + static_cast<size_t>(header.numPoints) * header.pointSize > file.size()){
+            throw std::runtime_error("The binary point data is shorter than the specified size.");
+        }
+        arrays = make_unique<PointArrays>(header, header.numPoints);
+        vector<const char*> fieldData(numFields);
+        vector<int> fieldStrides(numFields, header.pointSize);
+        for(int i=0; i < numFields; ++i){
+            fieldData[i] = data + header.dataOffset + header.fields[i].offset;
+        }
+        readBinaryPoints(*arrays, header, fieldData, fieldStrides);
+
+    } else if(header.dataType == "binary_compressed"){
+        uint32_t compressedSize;
+        uint32_t uncompressedSize;
+        const char* p = data + header.dataOffset;
+        if(p + 8 > end){
+            throw std::runtime_error("The compressed point data is broken.");
+        }
+        memcpy(&compressedSize, p, 4);
+        memcpy(&uncompressedSize, p + 4, 4);
+        p += 8;
+        if(p + compressedSize > end ||
+           uncompressedSize < static_cast<size_t>(header.numPoints) * header.pointSize){
+            throw std::runtime_error("The compressed point data is broken.");
+        }
+        vector<unsigned char> buf(uncompressedSize);
+        if(!decompressLZF(reinterpret_cast<const unsigned char*>(p), compressedSize, buf.data(), buf.size())){
+            throw std::runtime_error("The compressed point data cannot be decompressed.");
+        }
+        arrays = make_unique<PointArrays>(header, header.numPoints);
+        vector<const char*> fieldData(numFields);
+        vector<int> fieldStrides(numFields);
+        const char* fieldTop = reinterpret_cast<const char*>(buf.data());
+        for(int i=0; i < numFields; ++i){
+            auto& field = header.fields[i];
+            fieldData[i] = fieldTop;
+            fieldStrides[i] = field.size * field.count;
+            fieldTop += static_cast<size_t>(header.numPoints) * fieldStrides[i];
+        }
+        readBinaryPoints(*arrays, header, fieldData, fieldStrides);
+
+    } else {
+        throw std::runtime_error(
+            "The '" + header.dataType + "' format is not supported for the point DATA.");
+    }
+
+    arrays->removeInvalidPoints();
+
+    if(arrays->vertices->empty()){
+        throw std::runtime_error("No valid points");
+    } else {
+        out_pointSet->setVertices(arrays->vertices);
+        out_pointSet->setNormals(arrays->normals);
+        out_pointSet->normalIndices().clear();
+        out_pointSet->setColors(arrays->colors);
+        out_pointSet->colorIndices().clear();
+    }
+}
+
+
+void cnoid::savePCD
+(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint, PCDDataType dataType)
 {
     if(!pointSet->hasVertices()){
         throw std::runtime_error("Empty pointset");
@@ -174,7 +739,7 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Iso
     bool hasColors = pointSet->hasColors() && pointSet->colorIndices().empty();
 
     ofstream ofs;
-    ofs.open(fromUTF8(filename.c_str()));
+    ofs.open(fromUTF8(filename.c_str()), ios::out | ios::binary);
     ofs << scientific << setprecision(9);
 
     ofs << "# .PCD v.7 - Point Cloud Data file format\n";
@@ -203,25 +768,66 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Iso
     ofs << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
 
     ofs << "POINTS " << numPoints << "\n";
-    
-    ofs << "DATA ascii\n";
 
-    if(hasColors){
+    auto getRgb = [&](int index){
+        const Vector3f& c = (*pointSet->colors())[index];
         RGBValue rgb;
-        rgb.alpha = 0.0;
-        const SgColorArray& colors = *pointSet->colors();
+        rgb.alpha = 0;
+        rgb.red = (unsigned char)(255.0 * c[0]);
+        rgb.green = (unsigned char)(255.0 * c[1]);
+        rgb.blue = (unsigned char)(255.0 * c[2]);
+        return rgb;
+    };
+
+    if(dataType == PCD_Binary){
+        ofs << "DATA binary\n";
+        const int pointSize = hasColors ? 16 : 12;
+        vector<char> buf(static_cast<size_t>(numPoints) * pointSize);
+        char* p = buf.data();
         for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            const Vector3f& c = colors[i];
-            rgb.red = (unsigned char)(255.0 * c[0]);
-            rgb.green = (unsigned char)(255.0 * c[1]);
-            rgb.blue = (unsigned char)(255.0 * c[2]);
-            ofs << p.x() << " " << p.y() << " " << p.z() << " " << rgb.float_value << "\n";
+            memcpy(p, points[i].data(), 12);
+            if(hasColors){
+                auto rgb = getRgb(i);
+                memcpy(p + 12, &rgb.uint_value, 4);
+            }
+            p += pointSize;
         }
-    } else {
+        ofs.write(buf.data(), buf.size());
+
+    } else if(dataType == PCD_BinaryCompressed){
+        ofs << "DATA binary_compressed\n";
+        // The values of each field are stored contiguously in the compressed data
+        vector<float> buf(static_cast<size_t>(numPoints) * (hasColors ? 4 : 3));
         for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            const Vector3f& v = points[i];
+            buf[i] = v.x();
+            buf[numPoints + i] = v.y();
+            buf[numPoints * 2 + i] = v.z();
+            if(hasColors){
+                auto rgb = getRgb(i);
+                memcpy(&buf[numPoints * 3 + i], &rgb.uint_value, 4);
+            }
+        }
+        vector<unsigned char> compressed;
+        const size_t uncompressedSize = buf.size() * sizeof(float);
+        compressLZF(reinterpret_cast<const unsigned char*>(buf.data()), uncompressedSize, compressed);
+        uint32_t sizes[2] = { static_cast<uint32_t>(compressed.size()), static_cast<uint32_t>(uncompressedSize) };
+        ofs.write(reinterpret_cast<const char*>(sizes), 8);
+        ofs.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+
+    } else {
+        ofs << "DATA ascii\n";
+        if(hasColors){
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                auto rgb = getRgb(i);
+                ofs << p.x() << " " << p.y() << " " << p.z() << " " << rgb.float_value << "\n";
+            }
+        } else {
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            }
         }
     }
 
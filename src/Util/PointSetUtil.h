@@ -11,8 +11,17 @@
 
 namespace cnoid {
 
+enum PCDDataType { PCD_Ascii, PCD_Binary, PCD_BinaryCompressed };
+
+/**
+   The ascii, binary and binary_compressed data formats are supported.
+   The file is read through a memory mapping.
+*/
 CNOID_EXPORT void loadPCD(SgPointSet* out_pointSet, const std::string& filename);
-CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint = Isometry3::Identity());
+
+CNOID_EXPORT void savePCD(
+    SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint = Isometry3::Identity(),
+    PCDDataType dataType = PCD_Ascii);
 
 }
 
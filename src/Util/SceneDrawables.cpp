@@ -88,11 +88,25 @@ SgImage::SgImage(std::shared_ptr<Image> sharedImage)
 }
 
 
+SgImage::SgImage(std::shared_ptr<PendingImage> pendingImage)
+    : image_(std::make_shared<Image>()),
+      pendingImage_(pendingImage)
+{
+    setAttribute(Appearance);
+    if(pendingImage_){
+        pendingImage_->addImageToNotify(this);
+    }
+}
+
+
 SgImage::SgImage(const SgImage& org)
     : SgObject(org),
-      image_(org.image_)
+      image_(org.image_),
+      pendingImage_(org.pendingImage_)
 {
-
+    if(pendingImage_){
+        pendingImage_->addImageToNotify(this);
+    }
 }
 
 
@@ -104,6 +118,9 @@ Referenced* SgImage::doClone(CloneMap*) const
 
 Image& SgImage::image()
 {
+    if(pendingImage_){
+        resolvePendingImage();
+    }
     if(image_.use_count() > 1){
         image_ = std::make_shared<Image>(*image_);
     }
@@ -113,6 +130,9 @@ Image& SgImage::image()
 
 unsigned char* SgImage::pixels()
 {
+    if(pendingImage_){
+        resolvePendingImage();
+    }
     if(image_.use_count() > 1){
         image_ = std::make_shared<Image>(*image_);
     }
@@ -132,6 +152,33 @@ void SgImage::setSize(int width, int height)
 }
 
 
+void SgImage::setPendingImage(std::shared_ptr<PendingImage> pendingImage)
+{
+    pendingImage_ = pendingImage;
+    if(pendingImage_){
+        pendingImage_->addImageToNotify(this);
+    }
+}
+
+
+const Image& SgImage::pendingImage() const
+{
+    if(auto& image = pendingImage_->get()){
+        return *image;
+    }
+    return *image_;
+}
+
+
+void SgImage::resolvePendingImage()
+{
+    if(auto& image = pendingImage_->get()){
+        image_ = image;
+    }
+    pendingImage_.reset();
+}
+
+
 SgTextureTransform::SgTextureTransform()
 {
     setAttribute(Appearance);
@@ -775,7 +822,8 @@ SgTexture* SgShape::getOrCreateTexture()
 SgPlot::SgPlot(int classId)
     : SgNode(classId)
 {
-    setAttribute(Composite | Geometry | Appearance);
+    // The bounding box is often not updated when the plot is dynamically modified
+    setAttribute(Composite | Geometry | Appearance | Unbounded);
 }
         
 
@@ -1092,14 +1140,14 @@ const BoundingBox& SgText::untransformedBoundingBox() const
 SgOverlay::SgOverlay(int classId)
     : SgGroup(classId)
 {
-
+    setAttribute(Unbounded);
 }
 
 
 SgOverlay::SgOverlay()
     : SgGroup(findClassId<SgOverlay>())
 {
-
+    setAttribute(Unbounded);
 }
 
 
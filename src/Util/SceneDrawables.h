@@ -59,33 +59,65 @@ private:
 class CNOID_EXPORT SgImage : public SgObject
 {
 public:
+    /**
+       This interface gives the image that is prepared by another thread such as the image file
+       decoded by AsyncImageLoader.
+    */
+    class PendingImage
+    {
+    public:
+        virtual ~PendingImage() { }
+        virtual bool isReady() const = 0;
+        /**
+           This function waits for the image to be ready.
+           \return nullptr if the image cannot be prepared
+        */
+        virtual const std::shared_ptr<Image>& get() const = 0;
+        //! The update of the image object is notified when the image gets ready.
+        virtual void addImageToNotify(SgImage* image) = 0;
+    };
+    
     SgImage();
     SgImage(const Image& image);
     SgImage(std::shared_ptr<Image> sharedImage);
+    SgImage(std::shared_ptr<PendingImage> pendingImage);
     SgImage(const SgImage& org);
 
+    /**
+       The following accessors of the image wait for the pending image to be ready.
+       Use isPending to check if the image is ready without blocking.
+       The const accessors do not modify the object so that they can be used by multiple threads.
+    */
     Image& image();
-    const Image& image() const { return *image_; }
-    const Image& constImage() const { return *image_; }
+    const Image& image() const { return constImage(); }
+    const Image& constImage() const { return pendingImage_ ? pendingImage() : *image_; }
 
-    bool empty() const { return image_->empty(); }
+    bool empty() const { return constImage().empty(); }
         
     unsigned char* pixels();
-    const unsigned char* pixels() const { return image_->pixels(); }
-    const unsigned char* constPixels() const { return image_->pixels(); }
+    const unsigned char* pixels() const { return constImage().pixels(); }
+    const unsigned char* constPixels() const { return constImage().pixels(); }
 
-    int width() const { return image_->width(); }
-    int height() const { return image_->height(); }
-    int numComponents() const { return image_->numComponents(); }
+    int width() const { return constImage().width(); }
+    int height() const { return constImage().height(); }
+    int numComponents() const { return constImage().numComponents(); }
         
     void setSize(int width, int height, int nComponents);
     void setSize(int width, int height);
 
+    void setPendingImage(std::shared_ptr<PendingImage> pendingImage);
+    //! \return true if the pending image is not ready yet
+    bool isPending() const { return pendingImage_ && !pendingImage_->isReady(); }
+
 protected:
     virtual Referenced* doClone(CloneMap* cloneMap) const override;
 
 private:
     std::shared_ptr<Image> image_;
+    std::shared_ptr<PendingImage> pendingImage_;
+
+    const Image& pendingImage() const;
+    void resolvePendingImage();
 };
 
 
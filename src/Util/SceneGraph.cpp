@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include <typeindex>
 #include <mutex>
+#include <atomic>
 #include <stdexcept>
 
 using namespace std;
@@ -22,6 +23,8 @@ CloneMap::FlagId DisableMetaSceneCloning("SgObjectDisableMetaSceneCloning");
 
 const BoundingBox emptyBoundingBox;
 
+std::atomic<uint64_t> updateNotificationCounter(0);
+
 }
 
 
@@ -29,12 +32,14 @@ SgObject::SgObject()
 {
     attributes_ = 0;
     hasValidBoundingBoxCache_ = false;
+    isUpdatePending_ = false;
 }
 
 
 SgObject::SgObject(const SgObject& org)
     : attributes_(org.attributes_),
       hasValidBoundingBoxCache_(false),
+      isUpdatePending_(false),
       name_(org.name_)
 {
     if(org.uriInfo){
@@ -113,6 +118,7 @@ void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBound
         invalidateBoundingBox();
     }
     sigUpdated_(update);
+    updateNotificationCounter.fetch_add(1, std::memory_order_relaxed);
     for(const_parentIter p = parents.begin(); p != parents.end(); ++p){
         (*p)->notifyUpperNodesOfUpdate(update, doInvalidateBoundingBox);
     }
@@ -120,6 +126,119 @@ void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBound
 }
 
 
+uint64_t SgObject::numUpdateNotifications()
+{
+    return updateNotificationCounter.load(std::memory_order_relaxed);
+}
+
+
+SgUpdateTransaction::SgUpdateTransaction()
+    : update_(nullptr),
+      action(SgUpdate::None)
+{
+
+}
+
+
+SgUpdateTransaction::SgUpdateTransaction(SgUpdate& update)
+    : update_(&update),
+      action(update.action())
+{
+
+}
+
+
+SgUpdateTransaction::~SgUpdateTransaction()
+{
+    commit();
+}
+
+
+void SgUpdateTransaction::begin(SgUpdate& update)
+{
+    if(update_ && update_ != &update){
+        commit();
+    }
+    update_ = &update;
+    action = update.action();
+}
+
+
+void SgUpdateTransaction::addUpdatedObject(SgObject* object)
+{
+    if(update_){
+        updatedObjects.push_back(object);
+    }
+}
+
+
+void SgUpdateTransaction::commit()
+{
+    if(!update_){
+        return;
+    }
+    auto& update = *update_;
+    update_ = nullptr;
+
+    if(!updatedObjects.empty()){
+        // The action may be changed by other notifications done in the transaction
+        update.setAction(action);
+        /*
+          All the bounding boxes are invalidated before emitting any signal so that the
+          handlers of the signals can see the consistent bounding boxes.
+        */
+        bool doInvalidateBoundingBox = update.hasAction(SgUpdate::GeometryModified);
+        for(auto& object : updatedObjects){
+            collectPendingObjects(object, doInvalidateBoundingBox);
+        }
+        for(auto& object : updatedObjects){
+            update.clearPath();
+            notifyPendingObject(object, update);
+        }
+        updatedObjects.clear();
+
+        for(auto& pending : pendingObjects){
+            if(!pending.second.expired()){
+                pending.first->isUpdatePending_ = false;
+            }
+        }
+        pendingObjects.clear();
+    }
+}
+
+
+void SgUpdateTransaction::collectPendingObjects(SgObject* object, bool doInvalidateBoundingBox)
+{
+    if(object->isUpdatePending_){
+        return;
+    }
+    object->isUpdatePending_ = true;
+    pendingObjects.emplace_back(object, object);
+    if(doInvalidateBoundingBox){
+        object->invalidateBoundingBox();
+    }
+    for(auto& parent : object->parents){
+        collectPendingObjects(parent, doInvalidateBoundingBox);
+    }
+}
+
+
+void SgUpdateTransaction::notifyPendingObject(SgObject* object, SgUpdate& update)
+{
+    if(!object->isUpdatePending_){
+        return;
+    }
+    object->isUpdatePending_ = false;
+    update.pushNode(object);
+    object->sigUpdated_(update);
+    updateNotificationCounter.fetch_add(1, std::memory_order_relaxed);
+    for(auto& parent : object->parents){
+        notifyPendingObject(parent, update);
+    }
+    update.popNode();
+}
+
+
 void SgObject::addParent(SgObject* parent, SgUpdateRef update)
 {
     parents.insert(parent);
@@ -430,6 +549,7 @@ SgGroup::SgGroup()
     : SgNode(findClassId<SgGroup>())
 {
     setAttribute(GroupNode);
+    hasUnboundedNodes_ = false;
 }
 
 
@@ -437,12 +557,14 @@ SgGroup::SgGroup(int classId)
     : SgNode(classId)
 {
     setAttribute(GroupNode);
+    hasUnboundedNodes_ = false;
 }
 
 
 SgGroup::SgGroup(const SgGroup& org, CloneMap* cloneMap)
     : SgNode(org)
 {
+    hasUnboundedNodes_ = false;
     children.reserve(org.numChildren());
 
     if(cloneMap){
@@ -508,18 +630,32 @@ const BoundingBox& SgGroup::boundingBox() const
         return bboxCache;
     }
     bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy(node->boundingBox());
-        }
-    }
+    calcBoundingBoxOfChildren(bboxCache);
     setBoundingBoxCacheReady();
 
     return bboxCache;
 }
 
 
+//! The markers are not included in the bounding box
+void SgGroup::calcBoundingBoxOfChildren(BoundingBox& out_bbox) const
+{
+    hasUnboundedNodes_ = false;
+    for(auto& node : children){
+        if(node->hasAttribute(Marker | Unbounded)){
+            hasUnboundedNodes_ = true;
+            if(node->hasAttribute(Marker)){
+                continue;
+            }
+        }
+        out_bbox.expandBy(node->boundingBox());
+        if(node->isGroupNode() && static_cast<SgGroup*>(node.get())->hasUnboundedNodes_){
+            hasUnboundedNodes_ = true;
+        }
+    }
+}
+
+
 bool SgGroup::contains(SgNode* node) const
 {
     for(const_iterator p = begin(); p != end(); ++p){
@@ -827,12 +963,7 @@ const BoundingBox& SgPosTransform::boundingBox() const
         return bboxCache;
     }
     bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy(node->boundingBox());
-        }
-    }
+    calcBoundingBoxOfChildren(bboxCache);
     untransformedBboxCache = bboxCache;
     bboxCache.transform(T_);
     setBoundingBoxCacheReady();
@@ -896,12 +1027,7 @@ const BoundingBox& SgScaleTransform::boundingBox() const
         return bboxCache;
     }
     bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy(node->boundingBox());
-        }
-    }
+    calcBoundingBoxOfChildren(bboxCache);
     untransformedBboxCache = bboxCache;
     bboxCache.transform(Affine3(scale_.asDiagonal()));
     setBoundingBoxCacheReady();
@@ -958,12 +1084,7 @@ const BoundingBox& SgAffineTransform::boundingBox() const
         return bboxCache;
     }
     bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy((*p)->boundingBox());
-        }
-    }
+    calcBoundingBoxOfChildren(bboxCache);
     untransformedBboxCache = bboxCache;
     bboxCache.transform(T_);
     setBoundingBoxCacheReady();
@@ -987,6 +1108,8 @@ SgFixedPixelSizeGroup::SgFixedPixelSizeGroup()
 SgFixedPixelSizeGroup::SgFixedPixelSizeGroup(double pixelSizeRatio)
     : SgGroup(findClassId<SgFixedPixelSizeGroup>())
 {
+    // The bounding box does not reflect the scaling depending on the view
+    setAttribute(Unbounded);
     pixelSizeRatio_ = pixelSizeRatio;
 }
       
@@ -994,6 +1117,7 @@ SgFixedPixelSizeGroup::SgFixedPixelSizeGroup(double pixelSizeRatio)
 SgFixedPixelSizeGroup::SgFixedPixelSizeGroup(int classId)
     : SgGroup(classId)
 {
+    setAttribute(Unbounded);
     pixelSizeRatio_ = 1.0;
 }
 
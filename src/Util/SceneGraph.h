@@ -10,6 +10,7 @@
 #include <set>
 #include <memory>
 #include <functional>
+#include <cstdint>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -19,6 +20,7 @@ class SgNode;
 typedef ref_ptr<SgNode> SgNodePtr;
 class SgGroup;
 class SgTransform;
+class SgUpdateTransaction;
 
 typedef std::vector<SgNodePtr> SgNodePath;
 
@@ -55,7 +57,9 @@ public:
         Marker = 1 << 7,
         Operable = 1 << 8,
         MetaScene = 1 << 9,
-        MaxAttributeBit = 10,
+        // The bounding box does not cover the rendered region of the node
+        Unbounded = 1 << 10,
+        MaxAttributeBit = 11,
 
         // deprecated
         GroupAttribute = GroupNode,
@@ -145,6 +149,12 @@ public:
     void setUriMetadataString(const std::string& data);
     void clearUri() { uriInfo.reset(); }
 
+    /**
+       The total number of the update signals emitted by all the objects.
+       The difference of the values between frames is the number of the notifications in a frame.
+    */
+    static uint64_t numUpdateNotifications();
+
     bool isNode() const { return hasAttribute(Node); }
     SgNode* toNode();
     bool isGroupNode() const { return hasAttribute(GroupNode); }
@@ -162,6 +172,8 @@ protected:
 private:
     unsigned short attributes_;
     mutable bool hasValidBoundingBoxCache_;
+    // Dirty flag of the object whose notification is pending in an update transaction
+    bool isUpdatePending_;
     ParentContainer parents;
     Signal<void(const SgUpdate& update)> sigUpdated_;
     Signal<void(bool on)> sigGraphConnection_;
@@ -178,11 +190,52 @@ private:
     mutable std::unique_ptr<UriInfo> uriInfo;
 
     SgObject* findObject_(std::function<bool(SgObject* object)>& pred);
+
+    friend class SgUpdateTransaction;
 };
 
 typedef ref_ptr<SgObject> SgObjectPtr;
 
 
+/**
+   This class coalesces the update notifications of many objects modified at the same time.
+   Each updated object and each of their ancestors emits the update signal only once when the
+   transaction is committed whereas notifying the objects individually emits the signals of the
+   common ancestors as many times as the number of the objects.
+   The transactions must not be nested on the overlapping sub-graphs.
+*/
+class CNOID_EXPORT SgUpdateTransaction
+{
+public:
+    SgUpdateTransaction();
+    SgUpdateTransaction(SgUpdate& update);
+    ~SgUpdateTransaction();
+
+    void begin(SgUpdate& update);
+    bool isActive() const { return update_ != nullptr; }
+    //! The update is notified when the transaction is committed.
+    void addUpdatedObject(SgObject* object);
+    void commit();
+    
+private:
+    SgUpdate* update_;
+    int action;
+    std::vector<SgObject*> updatedObjects;
+    /*
+      The objects marked as pending are recorded so that the marks are cleared even if the
+      objects are detached from the updated objects by the signal handlers. The weak references
+      are used to skip the objects deleted by the handlers.
+    */
+    std::vector<std::pair<SgObject*, weak_ref_ptr<SgObject>>> pendingObjects;
+
+    void collectPendingObjects(SgObject* object, bool doInvalidateBoundingBox);
+    void notifyPendingObject(SgObject* object, SgUpdate& update);
+
+    SgUpdateTransaction(const SgUpdateTransaction&) = delete;
+    SgUpdateTransaction& operator=(const SgUpdateTransaction&) = delete;
+};
+
+
 class CNOID_EXPORT SgNode : public SgObject
 {
 public:
@@ -332,13 +385,30 @@ public:
         return nullptr;
     }
 
+    /**
+       \return true if the group has descendant nodes whose rendered regions are not covered by
+       the bounding box of the group, which are the nodes with the Marker or Unbounded attribute.
+       A renderer that skips the groups outside of the view volume must not skip such a group.
+       The value is computed together with the bounding box cache, so it follows the updates
+       that invalidate the bounding box.
+    */
+    bool hasUnboundedNodes() const {
+        if(!hasValidBoundingBoxCache()){
+            boundingBox();
+        }
+        return hasUnboundedNodes_;
+    }
+
 protected:
     SgGroup(int classId);
     virtual Referenced* doClone(CloneMap* cloneMap) const override;
+    void calcBoundingBoxOfChildren(BoundingBox& out_bbox) const;
     mutable BoundingBox bboxCache;
 
 private:
     Container children;
+    // Cache of hasUnboundedNodes(), which is valid while the bounding box cache is valid
+    mutable bool hasUnboundedNodes_;
     static void throwTypeMismatchError();
 };
 
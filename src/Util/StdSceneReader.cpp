@@ -12,7 +12,7 @@
 #include "UriSchemeProcessor.h"
 #include "FilePathVariableProcessor.h"
 #include "NullOut.h"
-#include "ImageIO.h"
+#include "AsyncImageLoader.h"
 #include "UTF8.h"
 #include <cnoid/stdx/filesystem>
 #include <cnoid/Config>
@@ -39,7 +39,7 @@ public:
     PolygonMeshTriangulator polygonMeshTriangulator;
     MeshFilter meshFilter;
     SgMaterialPtr defaultMaterial;
-    ImageIO imageIO;
+    AsyncImageLoader imageLoader;
     double scaling;
     bool isGroupOptimizationEnabled;
     ostream* os_;
@@ -215,7 +215,7 @@ StdSceneReader::Impl::Impl(StdSceneReader* self)
     
     os_ = &nullout();
     sceneLoaderConfigurationChanged = false;
-    imageIO.setUpsideDown(true);
+    imageLoader.setUpsideDown(true);
 }
 
 
@@ -1410,12 +1410,10 @@ void StdSceneReader::Impl::readTexture(SgShape* shape, Mapping* info)
                     os() << format(_("Warning: texture URI \"{0}\" is not valid: {1}"),
                                    uri, uriSchemeProcessor->errorMessage()) << endl;
                 } else {
-                    image = new SgImage;
-                    if(imageIO.load(image->image(), filename, os())){
+                    image = imageLoader.loadImage(filename, os());
+                    if(image){
                         image->setUri(uri, filename);
                         imagePathToSgImageMap[uri] = image;
-                    } else {
-                        image.reset();
                     }
                 }
             }
@@ -0,0 +1,266 @@
+#include "TraceProfiler.h"
+#include "UTF8.h"
+#include <fmt/format.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+std::atomic<bool> TraceProfiler::isEnabled_(false);
+
+namespace {
+
+struct Record
+{
+    const char* name;
+    int64_t beginTime;
+    int64_t endTime;
+};
+
+class ThreadBuffer
+{
+public:
+    int threadId;
+    string threadName;
+    vector<Record> records;
+    // The total number of the records added to the ring buffer
+    std::atomic<uint64_t> numRecords;
+    // True when the thread has exited
+    std::atomic<bool> isOrphaned;
+    // The value of clearCounter when the records were cleared last time
+    std::atomic<int> clearCount;
+
+    ThreadBuffer(int threadId, int size, int clearCount)
+        : threadId(threadId), records(size), numRecords(0), isOrphaned(false), clearCount(clearCount) { }
+};
+
+typedef shared_ptr<ThreadBuffer> ThreadBufferPtr;
+
+std::mutex registryMutex;
+vector<ThreadBufferPtr> threadBuffers;
+std::atomic<int> ringBufferSize(65536);
+int threadIdCounter = 0;
+int sessionCounter = 0;
+
+/*
+  The records of a thread are only modified by the thread itself so that no lock is required
+  in adding a record. Clearing the records increments this counter, and each thread clears
+  its own records and resizes the ring buffer when it finds the counter changed.
+*/
+std::atomic<int> clearCounter(0);
+
+class ThreadBufferHolder
+{
+public:
+    ThreadBufferPtr buffer;
+
+    ~ThreadBufferHolder(){
+        if(buffer){
+            buffer->isOrphaned = true;
+        }
+    }
+
+    ThreadBuffer* get(){
+        if(!buffer){
+            std::lock_guard<std::mutex> guard(registryMutex);
+            buffer = make_shared<ThreadBuffer>(
+                ++threadIdCounter, ringBufferSize.load(), clearCounter.load());
+            threadBuffers.push_back(buffer);
+        }
+        return buffer.get();
+    }
+};
+
+thread_local ThreadBufferHolder threadBufferHolder;
+
+// The registry mutex must be locked when this function is called
+void clearBuffers()
+{
+    threadBuffers.erase(
+        std::remove_if(threadBuffers.begin(), threadBuffers.end(),
+                       [](const ThreadBufferPtr& buffer){ return buffer->isOrphaned.load(); }),
+        threadBuffers.end());
+    clearCounter.fetch_add(1, std::memory_order_release);
+}
+
+
+void putEscapedString(ostream& os, const char* s)
+{
+    for(; *s; ++s){
+        const char c = *s;
+        if(c == '"' || c == '\\'){
+            os << '\\' << c;
+        } else if(static_cast<unsigned char>(c) < 0x20){
+            os << format("\\u{:04x}", static_cast<int>(c));
+        } else {
+            os << c;
+        }
+    }
+}
+
+}
+
+
+void TraceProfiler::setEnabled(bool on)
+{
+    isEnabled_.store(on, std::memory_order_relaxed);
+}
+
+
+void TraceProfiler::beginSession()
+{
+    std::lock_guard<std::mutex> guard(registryMutex);
+    if(sessionCounter++ == 0){
+        clearBuffers();
+    }
+    setEnabled(true);
+}
+
+
+bool TraceProfiler::endSession()
+{
+    std::lock_guard<std::mutex> guard(registryMutex);
+    if(sessionCounter > 0){
+        if(--sessionCounter == 0){
+            setEnabled(false);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void TraceProfiler::setRingBufferSize(int size)
+{
+    ringBufferSize = std::max(size, 1);
+}
+
+
+void TraceProfiler::clear()
+{
+    std::lock_guard<std::mutex> guard(registryMutex);
+    clearBuffers();
+}
+
+
+void TraceProfiler::setCurrentThreadName(const std::string& name)
+{
+    auto buffer = threadBufferHolder.get();
+    std::lock_guard<std::mutex> guard(registryMutex);
+    buffer->threadName = name;
+}
+
+
+int64_t TraceProfiler::currentTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void TraceProfiler::addRecord(const char* name, int64_t beginTime, int64_t endTime)
+{
+    auto buffer = threadBufferHolder.get();
+    const int clearCount = clearCounter.load(std::memory_order_acquire);
+    if(buffer->clearCount.load(std::memory_order_relaxed) != clearCount){
+        buffer->records.resize(ringBufferSize.load());
+        buffer->numRecords.store(0, std::memory_order_relaxed);
+        buffer->clearCount.store(clearCount, std::memory_order_release);
+    }
+    const uint64_t n = buffer->numRecords.load(std::memory_order_relaxed);
+    auto& record = buffer->records[n % buffer->records.size()];
+    record.name = name;
+    record.beginTime = beginTime;
+    record.endTime = endTime;
+    buffer->numRecords.store(n + 1, std::memory_order_release);
+}
+
+
+bool TraceProfiler::exportChromeTrace(const std::string& filename, std::string& out_errorMessage)
+{
+    ofstream ofs(fromUTF8(filename), ios::out | ios::binary);
+    if(!ofs){
+        out_errorMessage = format(_("\"{0}\" cannot be opened. {1}"), filename, strerror(errno));
+        return false;
+    }
+    exportChromeTrace(ofs);
+    if(!ofs){
+        out_errorMessage = format(_("The trace records cannot be written to \"{0}\"."), filename);
+        return false;
+    }
+    return true;
+}
+
+
+void TraceProfiler::exportChromeTrace(std::ostream& os)
+{
+    std::lock_guard<std::mutex> guard(registryMutex);
+
+    struct Range {
+        ThreadBuffer* buffer;
+        uint64_t begin;
+        uint64_t end;
+    };
+    vector<Range> ranges;
+    int64_t originTime = std::numeric_limits<int64_t>::max();
+    const int clearCount = clearCounter.load(std::memory_order_acquire);
+    for(auto& buffer : threadBuffers){
+        // The records which have not been cleared by the thread yet are old ones
+        if(buffer->clearCount.load(std::memory_order_acquire) != clearCount){
+            ranges.push_back({ buffer.get(), 0, 0 });
+            continue;
+        }
+        const uint64_t end = buffer->numRecords.load(std::memory_order_acquire);
+        const uint64_t size = buffer->records.size();
+        const uint64_t begin = (end > size) ? (end - size) : 0;
+        for(uint64_t i = begin; i < end; ++i){
+            originTime = std::min(originTime, buffer->records[i % size].beginTime);
+        }
+        ranges.push_back({ buffer.get(), begin, end });
+    }
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool isFirst = true;
+    auto putSeparator = [&](){
+        if(isFirst){
+            isFirst = false;
+        } else {
+            os << ",";
+        }
+        os << "\n";
+    };
+
+    for(auto& range : ranges){
+        auto buffer = range.buffer;
+        if(!buffer->threadName.empty()){
+            putSeparator();
+            os << format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"",
+                         buffer->threadId);
+            putEscapedString(os, buffer->threadName.c_str());
+            os << "\"}}";
+        }
+        const uint64_t size = buffer->records.size();
+        for(uint64_t i = range.begin; i < range.end; ++i){
+            auto& record = buffer->records[i % size];
+            putSeparator();
+            os << "{\"name\":\"";
+            putEscapedString(os, record.name);
+            os << format("\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                         buffer->threadId,
+                         (record.beginTime - originTime) / 1.0e3,
+                         (record.endTime - record.beginTime) / 1.0e3);
+        }
+    }
+
+    os << "\n]}\n";
+}
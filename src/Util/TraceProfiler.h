@@ -0,0 +1,91 @@
+#ifndef CNOID_UTIL_TRACE_PROFILER_H
+#define CNOID_UTIL_TRACE_PROFILER_H
+
+#include <string>
+#include <iosfwd>
+#include <atomic>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the time intervals of the zones executed in any threads and exports them
+   in the Chrome trace event format, which can be viewed with chrome://tracing or Perfetto UI.
+   The records are stored in the ring buffer of each thread only while the profiler is enabled,
+   so the overhead of a zone is a flag check when the profiler is disabled.
+*/
+class CNOID_EXPORT TraceProfiler
+{
+public:
+    static void setEnabled(bool on);
+    static bool isEnabled() { return isEnabled_.load(std::memory_order_relaxed); }
+
+    /**
+       The profiler is shared by all the clients in the process. A client which records the
+       zones only for a certain period should enclose the period with the following functions
+       instead of calling setEnabled directly. The records are cleared when the first session
+       begins and the profiler is disabled when the last session ends.
+       \return endSession returns true when the last session ends. The records should not be
+       exported before that because the other sessions may still be recording.
+    */
+    static void beginSession();
+    static bool endSession();
+
+    //! The maximum number of the records kept for each thread. The oldest records are overwritten.
+    static void setRingBufferSize(int size);
+
+    /**
+       The records of each thread are actually cleared by the thread itself when it adds the next
+       record, so the zones being recorded in the other threads are not affected by this function.
+    */
+    static void clear();
+
+    //! The name of the current thread shown in the trace viewer
+    static void setCurrentThreadName(const std::string& name);
+
+    //! \note The profiler should be disabled before exporting the records.
+    static bool exportChromeTrace(const std::string& filename, std::string& out_errorMessage);
+    static void exportChromeTrace(std::ostream& os);
+
+    //! The monotonic time in nanoseconds
+    static int64_t currentTime();
+    static void addRecord(const char* name, int64_t beginTime, int64_t endTime);
+
+private:
+    static std::atomic<bool> isEnabled_;
+};
+
+/**
+   The zone records the interval from the construction to the destruction.
+   The name must be a string literal because only the pointer to it is recorded.
+*/
+class TraceZone
+{
+public:
+    template<std::size_t N>
+    TraceZone(const char (&name)[N])
+        : name(name),
+          beginTime(TraceProfiler::isEnabled() ? TraceProfiler::currentTime() : -1) { }
+
+    ~TraceZone() {
+        if(beginTime >= 0){
+            TraceProfiler::addRecord(name, beginTime, TraceProfiler::currentTime());
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* name;
+    int64_t beginTime;
+};
+
+}
+
+#define CNOID_TRACE_ZONE_CONCAT_(x, y) x##y
+#define CNOID_TRACE_ZONE_CONCAT(x, y) CNOID_TRACE_ZONE_CONCAT_(x, y)
+#define CNOID_TRACE_ZONE(name) cnoid::TraceZone CNOID_TRACE_ZONE_CONCAT(cnoidTraceZone, __LINE__)(name)
+
+#endif
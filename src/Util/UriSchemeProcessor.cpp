@@ -1,5 +1,6 @@
 #include "UriSchemeProcessor.h"
 #include "FilePathVariableProcessor.h"
+#include "ZipFileSystem.h"
 #include "UTF8.h"
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
@@ -156,6 +157,9 @@ std::string UriSchemeProcessor::Impl::getFilePath(const std::string& uri)
         if(hasFileScheme){
             filePath = uriPath;
             hasSupportedScheme = true;
+        } else if(scheme == "zip"){
+            filePath = ZipFileSystem::getFilePathOfUriPath(uriPath, errorStream);
+            hasSupportedScheme = true;
         } else {
             std::lock_guard<std::mutex> guard(uriSchemeHandlerMutex);
             auto it = uriSchemeHandlerMap.find(scheme);
@@ -187,6 +191,15 @@ std::string UriSchemeProcessor::Impl::getFilePath(const std::string& uri)
         }
     }
 
+    // The file may be in a mounted zip archive and extracted on demand
+    if(!filePath.empty()){
+        string errorMessage;
+        if(!ZipFileSystem::prepareFile(filePath, errorMessage)){
+            errorStream << errorMessage;
+            errorStream.flush();
+        }
+    }
+
     return filePath;
 }
 
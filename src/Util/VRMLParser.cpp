@@ -9,6 +9,7 @@
 #include "EasyScanner.h"
 #include "NullOut.h"
 #include "UTF8.h"
+#include "ZipFileSystem.h"
 #include <cnoid/stdx/filesystem>
 #include <list>
 #include <cmath>
@@ -852,7 +853,10 @@ string VRMLParserImpl::getRealPath(string url)
             stdx::filesystem::path parentPath(fromUTF8(scanner->filename));
             path = stdx::filesystem::lexically_normal(parentPath.parent_path() / path);
         }
-        return toUTF8(stdx::filesystem::absolute(path).string());
+        string realPath = toUTF8(stdx::filesystem::absolute(path).string());
+        // The file in a mounted archive is extracted to be read by the inline parser or loader
+        ZipFileSystem::prepareFile(realPath);
+        return realPath;
     }
 }
 
@@ -1981,6 +1985,8 @@ void VRMLParserImpl::setAbsoluteFilepathInformation(const MFString& urls, MFStri
                 path = stdx::filesystem::lexically_normal(parentPath.parent_path() / path);
             }
             filepaths.push_back(toUTF8(stdx::filesystem::absolute(path).string()));
+            // The file in a mounted archive such as a texture image is extracted to be loaded
+            ZipFileSystem::prepareFile(filepaths.back());
         } else {
             // Not file protocol implements   
             scanner->throwException("Not file protocol is unsupported");
@@ -6,7 +6,7 @@
 #include "PolygonMeshTriangulator.h"
 #include "MeshFilter.h"
 #include "MeshGenerator.h"
-#include "ImageIO.h"
+#include "AsyncImageLoader.h"
 #include "SceneLoader.h"
 #include "NullOut.h"
 #include "EigenUtil.h"
@@ -46,7 +46,7 @@ public:
     MeshFilter meshFilter;
     MeshGenerator meshGenerator;
 
-    ImageIO imageIO;
+    AsyncImageLoader imageLoader;
 
     VRMLMaterialPtr defaultMaterial;
 
@@ -123,7 +123,7 @@ VRMLToSGConverterImpl::VRMLToSGConverterImpl(VRMLToSGConverter* self)
     os_ = &nullout();
     isTriangulationEnabled = true;
     isNormalGenerationEnabled = true;
-    imageIO.setUpsideDown(true);
+    imageLoader.setUpsideDown(true);
     defaultMaterial = new VRMLMaterial();
 }
 
@@ -1220,7 +1220,6 @@ SgTexture* VRMLToSGConverterImpl::createTexture(VRMLTexture* vt)
     VRMLImageTexturePtr imageTextureNode = dynamic_node_cast<VRMLImageTexture>(vt);
     if(imageTextureNode){
         SgImagePtr image;
-        SgImagePtr imageForLoading;
         const MFString& filepaths = imageTextureNode->filepath;
         for(size_t i=0; i < filepaths.size(); ++i){
             auto& filepath = filepaths[i];
@@ -1230,11 +1229,8 @@ SgTexture* VRMLToSGConverterImpl::createTexture(VRMLTexture* vt)
                     image = p->second;
                     break;
                 } else {
-                    if(!imageForLoading){
-                        imageForLoading = new SgImage;
-                    }
-                    if(imageIO.load(imageForLoading->image(), filepath, os())){
-                        image = imageForLoading;
+                    image = imageLoader.loadImage(filepath, os());
+                    if(image){
                         image->setUri(imageTextureNode->url[i], filepath);
                         imagePathToSgImageMap[filepath] = image;
                         break;
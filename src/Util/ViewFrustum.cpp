@@ -0,0 +1,75 @@
+#include "ViewFrustum.h"
+#include "BoundingBox.h"
+
+using namespace cnoid;
+
+
+ViewFrustum::ViewFrustum()
+{
+    // Nothing is culled with the default planes
+    planes_.setZero();
+    planes_.col(3).setOnes();
+}
+
+
+ViewFrustum::ViewFrustum(const Matrix4& projectionViewMatrix)
+{
+    setProjectionViewMatrix(projectionViewMatrix);
+}
+
+
+void ViewFrustum::setProjectionViewMatrix(const Matrix4& PV)
+{
+    // Left, right, bottom, top, near, far
+    planes_.row(0) = PV.row(3) + PV.row(0);
+    planes_.row(1) = PV.row(3) - PV.row(0);
+    planes_.row(2) = PV.row(3) + PV.row(1);
+    planes_.row(3) = PV.row(3) - PV.row(1);
+    planes_.row(4) = PV.row(3) + PV.row(2);
+    planes_.row(5) = PV.row(3) - PV.row(2);
+
+    for(int i=0; i < 6; ++i){
+        double norm = planes_.row(i).head<3>().norm();
+        if(norm > 0.0){
+            planes_.row(i) /= norm;
+        }
+    }
+}
+
+
+ViewFrustum::Intersection ViewFrustum::checkBoundingBox(const BoundingBox& bbox) const
+{
+    if(bbox.empty()){
+        return Outside;
+    }
+    return checkBox(0.5 * (bbox.min() + bbox.max()), 0.5 * (bbox.max() - bbox.min()));
+}
+
+
+ViewFrustum::Intersection ViewFrustum::checkBoundingBox(const BoundingBox& bbox, const Affine3& T) const
+{
+    if(bbox.empty()){
+        return Outside;
+    }
+    const Vector3 center = T * (0.5 * (bbox.min() + bbox.max()));
+    const Vector3 extents = T.linear().cwiseAbs() * (0.5 * (bbox.max() - bbox.min()));
+    return checkBox(center, extents);
+}
+
+
+ViewFrustum::Intersection ViewFrustum::checkBox(const Vector3& center, const Vector3& extents) const
+{
+    Intersection result = Inside;
+    for(int i=0; i < 6; ++i){
+        auto n = planes_.row(i).head<3>();
+        double distance = n.dot(center) + planes_(i, 3);
+        double radius = n.cwiseAbs().dot(extents);
+        if(distance < -radius){
+            return Outside;
+        }
+        if(distance < radius){
+            result = Intersecting;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,43 @@
+#ifndef CNOID_UTIL_VIEW_FRUSTUM_H
+#define CNOID_UTIL_VIEW_FRUSTUM_H
+
+#include "EigenTypes.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class BoundingBox;
+
+/**
+   This class represents the view volume of a camera as six planes and is used to check
+   whether bounding boxes are visible or not. The class does not depend on any graphics API.
+*/
+class CNOID_EXPORT ViewFrustum
+{
+public:
+    enum Intersection { Outside, Intersecting, Inside };
+    
+    ViewFrustum();
+    ViewFrustum(const Matrix4& projectionViewMatrix);
+
+    //! The planes are extracted from the product of the projection matrix and the view matrix.
+    void setProjectionViewMatrix(const Matrix4& PV);
+
+    //! Each row is a plane (a, b, c, d) where ax + by + cz + d >= 0 is the inner side.
+    const Eigen::Matrix<double, 6, 4>& planes() const { return planes_; }
+
+    //! \param bbox A bounding box in the global coordinate
+    Intersection checkBoundingBox(const BoundingBox& bbox) const;
+
+    //! \param bbox A bounding box in the local coordinate whose global transform is T
+    Intersection checkBoundingBox(const BoundingBox& bbox, const Affine3& T) const;
+
+private:
+    Eigen::Matrix<double, 6, 4> planes_;
+
+    Intersection checkBox(const Vector3& center, const Vector3& extents) const;
+};
+
+}
+
+#endif
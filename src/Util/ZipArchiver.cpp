@@ -2,8 +2,11 @@
 #include <cnoid/FileUtil>
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
+#include <cnoid/ThreadPool>
 #include <zip.h>
 #include <fmt/format.h>
+#include <thread>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -20,10 +23,27 @@ public:
     std::string systemErrorMessage;
     std::string errorMessage;
     std::vector<std::string> extractedFiles;
+    int numCompressionThreads;
+
+    struct FileInfo
+    {
+        string sourcePath;
+        string localPath;
+        uintmax_t size;
+        int partialZipIndex;
+        int indexInPartialZip;
+    };
+    vector<FileInfo> files;
+    vector<zip_t*> partialZips;
+    vector<fs::path> partialZipPaths;
 
     Impl();
     bool createZipFile(const std::string& zipFilename, const std::string& directory);
     bool addDirectoryToZip(zip_t* zip, fs::path dirPath, const fs::path& srcTopDirPath, const fs::path& zipTopDirPath);
+    bool addFileToZip(zip_t* zip, const FileInfo& file);
+    bool addFilesToZip(zip_t* zip, const fs::path& zipFilePath);
+    bool addFilesCompressedInParallel(zip_t* zip, const fs::path& zipFilePath, int numThreads);
+    void clearPartialZips();
     bool extractZipFile(const std::string& zipFilename, const std::string& directory);
     bool extractFilesFromZipFile(
         zip_t* zip, const string& zipFilename, const fs::path&  zipFilePath, const fs::path& topDirPath);
@@ -41,6 +61,7 @@ ZipArchiver::ZipArchiver()
 ZipArchiver::Impl::Impl()
 {
     errorType = NoError;
+    numCompressionThreads = std::thread::hardware_concurrency();
 }
 
 
@@ -68,6 +89,12 @@ const std::string& ZipArchiver::errorMessage() const
 }
 
 
+void ZipArchiver::setNumCompressionThreads(int n)
+{
+    impl->numCompressionThreads = n;
+}
+
+
 bool ZipArchiver::createZipFile(const std::string& zipFilename, const std::string& directory)
 {
     return impl->createZipFile(zipFilename, directory);
@@ -106,8 +133,24 @@ bool ZipArchiver::Impl::createZipFile(const std::string& zipFilename, const std:
 
     fs::path zipTopDirPath(zipFilePath.stem());
     fs::path dirPath(fromUTF8(directory));
+    files.clear();
     bool zipped = addDirectoryToZip(zip, dirPath, dirPath, zipTopDirPath);
-    zip_close(zip);
+    if(zipped){
+        zipped = addFilesToZip(zip, zipFilePath);
+    }
+    if(!zipped){
+        zip_discard(zip);
+    } else if(zip_close(zip) < 0){
+        errorType = ZipFileCreationError;
+        systemErrorMessage = zip_strerror(zip);
+        errorMessage =
+            format(_("Failed to create the zip file \"{0}\": {1}"),
+                   zipFilename, systemErrorMessage);
+        zip_discard(zip);
+        zipped = false;
+    }
+    clearPartialZips();
+    files.clear();
 
     if(zipped){
         errorType = NoError;
@@ -146,38 +189,207 @@ bool ZipArchiver::Impl::addDirectoryToZip
                 return false;
             }
         } else {
+            // The files are added after all the directories are added
             auto localPath = zipTopDirPath / (*getRelativePath(entryPath, srcTopDirPath));
-            auto localPathStr = toUTF8(localPath.generic_string());
-            auto sourcePath = toUTF8(entryPath.make_preferred().string());
-            zip_source_t* source = zip_source_file(zip, sourcePath.c_str(), 0, 0);
-            if(!source){
-                errorType = FileAdditionError;
-                systemErrorMessage = zip_strerror(zip);
-                errorMessage =
-                    format(_("Failed to add file \"{0}\" to the zip file: {1}"),
-                           localPathStr, systemErrorMessage);
-                return false;
+            FileInfo file;
+            file.sourcePath = toUTF8(entryPath.make_preferred().string());
+            file.localPath = toUTF8(localPath.generic_string());
+            stdx::error_code ec;
+            file.size = fs::file_size(entryPath, ec);
+            if(ec){
+                file.size = 0;
             }
-            int index = zip_file_add(zip, localPathStr.c_str(), source, ZIP_FL_ENC_UTF_8);
-            if(index < 0){
-                zip_source_free(source);
-                errorType = FileAdditionError;
-                systemErrorMessage = zip_strerror(zip);
-                errorMessage =
-                    format(_("Failed to add file \"{0}\" to the zip file: {1}"),
-                           localPathStr, systemErrorMessage);
-                return false;
+            files.push_back(file);
+        }
+    }
+
+    return true;
+}
+
+
+bool ZipArchiver::Impl::addFileToZip(zip_t* zip, const FileInfo& file)
+{
+    zip_source_t* source = zip_source_file(zip, file.sourcePath.c_str(), 0, 0);
+    if(!source){
+        errorType = FileAdditionError;
+        systemErrorMessage = zip_strerror(zip);
+        errorMessage =
+            format(_("Failed to add file \"{0}\" to the zip file: {1}"),
+                   file.localPath, systemErrorMessage);
+        return false;
+    }
+    // The deflate compression is applied by default.
+    int index = zip_file_add(zip, file.localPath.c_str(), source, ZIP_FL_ENC_UTF_8);
+    if(index < 0){
+        zip_source_free(source);
+        errorType = FileAdditionError;
+        systemErrorMessage = zip_strerror(zip);
+        errorMessage =
+            format(_("Failed to add file \"{0}\" to the zip file: {1}"),
+                   file.localPath, systemErrorMessage);
+        return false;
+    }
+    return true;
+}
+
+
+bool ZipArchiver::Impl::addFilesToZip(zip_t* zip, const fs::path& zipFilePath)
+{
+    int numThreads = std::min(numCompressionThreads, static_cast<int>(files.size()));
+    if(numThreads >= 2){
+        return addFilesCompressedInParallel(zip, zipFilePath, numThreads);
+    }
+    for(auto& file : files){
+        if(!addFileToZip(zip, file)){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+  libzip compresses the files one by one when the archive is closed. To compress the files in
+  parallel, each thread compresses a subset of the files into its own partial zip file, and then
+  the compressed data in the partial zip files are copied to the final zip file without recompression.
+*/
+bool ZipArchiver::Impl::addFilesCompressedInParallel(zip_t* zip, const fs::path& zipFilePath, int numThreads)
+{
+    // Assign the largest file first to the thread with the smallest total size
+    vector<int> order(files.size());
+    for(size_t i=0; i < files.size(); ++i){
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int i, int j){ return files[i].size > files[j].size; });
+    vector<uintmax_t> totalSizes(numThreads, 0);
+    vector<vector<int>> assignedFiles(numThreads);
+    for(auto& fileIndex : order){
+        // The thread with fewer files is chosen if the total sizes are the same so that
+        // the empty files are distributed to the threads having no files
+        int thread = 0;
+        for(int i=1; i < numThreads; ++i){
+            if(totalSizes[i] < totalSizes[thread] ||
+               (totalSizes[i] == totalSizes[thread] && assignedFiles[i].size() < assignedFiles[thread].size())){
+                thread = i;
             }
-            // The deflate compression is applied by default. The following code is not necessary.
-            /*
-            if(zip_set_file_compression(zip, index, ZIP_CM_DEFLATE, 0) < 0){
+        }
+        assignedFiles[thread].push_back(fileIndex);
+        totalSizes[thread] += files[fileIndex].size;
+    }
+
+    /*
+      A partial zip file without any files must not be created because libzip removes
+      the file of an empty archive when it is closed.
+    */
+    assignedFiles.erase(
+        std::remove_if(assignedFiles.begin(), assignedFiles.end(),
+                       [](const vector<int>& fileIndices){ return fileIndices.empty(); }),
+        assignedFiles.end());
+    numThreads = assignedFiles.size();
+    for(int i=0; i < numThreads; ++i){
+        for(size_t j=0; j < assignedFiles[i].size(); ++j){
+            auto& file = files[assignedFiles[i][j]];
+            file.partialZipIndex = i;
+            file.indexInPartialZip = j;
+        }
+    }
+
+    partialZipPaths.clear();
+    for(int i=0; i < numThreads; ++i){
+        auto path = zipFilePath;
+        path += format(".part{}", i);
+        partialZipPaths.push_back(path);
+    }
+    vector<string> errorMessages(numThreads);
+    vector<string> systemErrorMessages(numThreads);
+
+    {
+        ThreadPool threadPool(numThreads);
+        for(int i=0; i < numThreads; ++i){
+            threadPool.start([this, i, &assignedFiles, &errorMessages, &systemErrorMessages](){
+                auto pathString = partialZipPaths[i].make_preferred().string();
+                int errorp;
+                zip_t* partialZip = zip_open(pathString.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &errorp);
+                if(!partialZip){
+                    zip_error_t error;
+                    zip_error_init_with_code(&error, errorp);
+                    systemErrorMessages[i] = zip_error_strerror(&error);
+                    errorMessages[i] =
+                        format(_("Failed to create the temporary zip file \"{0}\": {1}"),
+                               toUTF8(pathString), systemErrorMessages[i]);
+                    zip_error_fini(&error);
+                    return;
+                }
+                for(auto& fileIndex : assignedFiles[i]){
+                    auto& file = files[fileIndex];
+                    zip_source_t* source = zip_source_file(partialZip, file.sourcePath.c_str(), 0, 0);
+                    if(!source || zip_file_add(partialZip, file.localPath.c_str(), source, ZIP_FL_ENC_UTF_8) < 0){
+                        if(source){
+                            zip_source_free(source);
+                        }
+                        systemErrorMessages[i] = zip_strerror(partialZip);
+                        errorMessages[i] =
+                            format(_("Failed to add file \"{0}\" to the zip file: {1}"),
+                                   file.localPath, systemErrorMessages[i]);
+                        zip_discard(partialZip);
+                        return;
+                    }
+                }
+                // The files are compressed here
+                if(zip_close(partialZip) < 0){
+                    systemErrorMessages[i] = zip_strerror(partialZip);
+                    errorMessages[i] =
+                        format(_("Failed to compress the files to the temporary zip file \"{0}\": {1}"),
+                               toUTF8(pathString), systemErrorMessages[i]);
+                    zip_discard(partialZip);
+                }
+            });
+        }
+        threadPool.wait();
+    }
+
+    for(int i=0; i < numThreads; ++i){
+        if(!errorMessages[i].empty()){
+            errorType = FileAdditionError;
+            systemErrorMessage = systemErrorMessages[i];
+            errorMessage = errorMessages[i];
+            return false;
+        }
+    }
+
+    // The partial zip files must be open until the final zip file is closed
+    for(int i=0; i < numThreads; ++i){
+        int errorp;
+        zip_t* partialZip = zip_open(partialZipPaths[i].make_preferred().string().c_str(), ZIP_RDONLY, &errorp);
+        if(!partialZip){
+            zip_error_t error;
+            zip_error_init_with_code(&error, errorp);
+            errorType = FileAdditionError;
+            systemErrorMessage = zip_error_strerror(&error);
+            errorMessage =
+                format(_("Failed to open the temporary zip file \"{0}\": {1}"),
+                       toUTF8(partialZipPaths[i].string()), systemErrorMessage);
+            zip_error_fini(&error);
+            return false;
+        }
+        partialZips.push_back(partialZip);
+    }
+
+    for(auto& file : files){
+        auto partialZip = partialZips[file.partialZipIndex];
+        zip_source_t* source =
+            zip_source_zip(zip, partialZip, file.indexInPartialZip, ZIP_FL_COMPRESSED, 0, -1);
+        if(!source || zip_file_add(zip, file.localPath.c_str(), source, ZIP_FL_ENC_UTF_8) < 0){
+            if(source){
                 zip_source_free(source);
-                mout->putErrorln(
-                    format(_("Failed to compress file \"{0}\": {1}"),
-                           localPathStr, zip_strerror(zip)));
-                return false;
             }
-            */
+            errorType = FileAdditionError;
+            systemErrorMessage = zip_strerror(zip);
+            errorMessage =
+                format(_("Failed to add file \"{0}\" to the zip file: {1}"),
+                       file.localPath, systemErrorMessage);
+            return false;
         }
     }
 
@@ -185,6 +397,21 @@ bool ZipArchiver::Impl::addDirectoryToZip
 }
 
 
+void ZipArchiver::Impl::clearPartialZips()
+{
+    for(auto& partialZip : partialZips){
+        zip_discard(partialZip);
+    }
+    partialZips.clear();
+
+    stdx::error_code ec;
+    for(auto& path : partialZipPaths){
+        fs::remove(path, ec);
+    }
+    partialZipPaths.clear();
+}
+
+
 bool ZipArchiver::extractZipFile(const std::string& zipFilename, const std::string& directory)
 {
     return impl->extractZipFile(zipFilename, directory);
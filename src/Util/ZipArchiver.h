@@ -13,6 +13,12 @@ public:
     ZipArchiver();
     virtual ~ZipArchiver();
 
+    /**
+       The files are compressed in parallel by the specified number of threads.
+       The default number is the number of the hardware threads.
+    */
+    void setNumCompressionThreads(int n);
+    
     bool createZipFile(const std::string& zipFilename, const std::string& directory);
     bool extractZipFile(const std::string& zipFilename, const std::string& directory);
     const std::vector<std::string>& extractedFiles() const;
@@ -0,0 +1,626 @@
+#include "ZipFileSystem.h"
+#include "MappedFile.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <zip.h>
+#include <fmt/format.h>
+#include <unordered_map>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <ostream>
+#include <random>
+#include <cstdio>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace fs = stdx::filesystem;
+
+namespace {
+
+std::mutex registryMutex;
+unordered_map<string, weak_ref_ptr<ZipFileSystem>> archiveMap;
+vector<ZipFileSystemPtr> mountedArchives;
+std::atomic<bool> hasMountedArchives(false);
+std::atomic<size_t> cacheSizeLimit(64 * 1024 * 1024);
+
+fs::path getNormalizedPath(const string& filename)
+{
+    fs::path path(fromUTF8(filename));
+    if(!path.is_absolute()){
+        path = fs::current_path() / path;
+    }
+    return fs::lexically_normal(path);
+}
+
+/*
+  The archives mounted on the temporary directories are unmounted and the directories are
+  removed when the program exits. The archives must be unmounted before the registry is destroyed.
+*/
+struct MountedArchiveCleaner
+{
+    ~MountedArchiveCleaner(){
+        vector<ZipFileSystemPtr> archives;
+        {
+            std::lock_guard<std::mutex> guard(registryMutex);
+            archives = mountedArchives;
+        }
+        for(auto& archive : archives){
+            archive->unmount();
+        }
+    }
+} mountedArchiveCleaner;
+
+}
+
+namespace cnoid {
+
+class ZipFileSystem::Impl
+{
+public:
+    string zipFilename;
+    unique_ptr<MappedFile> mappedFile;
+    vector<string> entryNames;
+    unordered_map<string, int> entryIndexMap;
+
+    // An archive object cannot be used by multiple threads at the same time
+    std::mutex archivePoolMutex;
+    vector<zip_t*> archivePool;
+
+    struct CacheEntry
+    {
+        int index;
+        shared_ptr<const string> data;
+    };
+    std::mutex cacheMutex;
+    list<CacheEntry> cache; // The front entry is the most recently used one
+    unordered_map<int, list<CacheEntry>::iterator> cacheIteratorMap;
+    size_t cacheSize;
+
+    /*
+       The mutex only guards the following mount information. The entries are decompressed and
+       written without locking it, and the threads preparing the same entry wait for the thread
+       extracting the entry with the condition variable.
+    */
+    std::mutex mountMutex;
+    std::condition_variable extractionCondition;
+    fs::path mountDirPath;
+    string mountDirectory; // Generic format path ending with '/'
+    enum ExtractionState : char { NotExtracted, Extracting, Extracted };
+    vector<ExtractionState> extractionStates;
+    int mountId; // Incremented in every mount to ignore the extractions of the previous mount
+    bool isTemporaryMount;
+
+    Impl();
+    ~Impl();
+    bool open(const string& filename, string& out_errorMessage);
+    zip_t* acquireArchive(string& out_errorMessage);
+    void releaseArchive(zip_t* zip);
+    shared_ptr<const string> findCachedEntry(int index);
+    void addCacheEntry(int index, const shared_ptr<const string>& data);
+    shared_ptr<const string> decompressEntry(int index, string& out_errorMessage);
+    bool mount(const string& directory, string& out_errorMessage);
+    static bool checkIfEntryInDirectory(const fs::path& path, const string& directory);
+    bool extractEntry(int index, string& out_errorMessage);
+    bool writeEntryFile(int index, const fs::path& filePath, string& out_errorMessage);
+};
+
+}
+
+
+ZipFileSystemPtr ZipFileSystem::open(const std::string& zipFilename, std::string& out_errorMessage)
+{
+    string key = toUTF8(getNormalizedPath(zipFilename).generic_string());
+
+    std::lock_guard<std::mutex> guard(registryMutex);
+
+    auto it = archiveMap.find(key);
+    if(it != archiveMap.end()){
+        if(auto archive = it->second.lock()){
+            return archive;
+        }
+        archiveMap.erase(it);
+    }
+    ZipFileSystemPtr archive = new ZipFileSystem;
+    if(!archive->impl->open(zipFilename, out_errorMessage)){
+        return nullptr;
+    }
+    archiveMap[key] = archive;
+    return archive;
+}
+
+
+ZipFileSystem::ZipFileSystem()
+{
+    impl = new Impl;
+}
+
+
+ZipFileSystem::Impl::Impl()
+{
+    cacheSize = 0;
+    mountId = 0;
+    isTemporaryMount = false;
+}
+
+
+ZipFileSystem::~ZipFileSystem()
+{
+    delete impl;
+}
+
+
+ZipFileSystem::Impl::~Impl()
+{
+    for(auto& zip : archivePool){
+        zip_discard(zip);
+    }
+}
+
+
+bool ZipFileSystem::Impl::open(const string& filename, string& out_errorMessage)
+{
+    zipFilename = filename;
+
+    try {
+        mappedFile.reset(new MappedFile(filename, MappedFile::RandomAccess));
+    }
+    catch(const std::exception&){
+        out_errorMessage = format(_("The zip file \"{0}\" cannot be opened."), filename);
+        return false;
+    }
+
+    auto zip = acquireArchive(out_errorMessage);
+    if(!zip){
+        return false;
+    }
+    int numEntries = zip_get_num_entries(zip, 0);
+    entryNames.reserve(numEntries);
+    for(int i=0; i < numEntries; ++i){
+        const char* name = zip_get_name(zip, i, 0);
+        entryNames.emplace_back(name ? name : "");
+        entryIndexMap[entryNames.back()] = i;
+    }
+    releaseArchive(zip);
+
+    return true;
+}
+
+
+zip_t* ZipFileSystem::Impl::acquireArchive(string& out_errorMessage)
+{
+    {
+        std::lock_guard<std::mutex> guard(archivePoolMutex);
+        if(!archivePool.empty()){
+            auto zip = archivePool.back();
+            archivePool.pop_back();
+            return zip;
+        }
+    }
+
+    // The archive objects share the mapped data of the archive file
+    zip_error_t error;
+    zip_error_init(&error);
+    zip_t* zip = nullptr;
+    if(auto source = zip_source_buffer_create(mappedFile->data(), mappedFile->size(), 0, &error)){
+        zip = zip_open_from_source(source, ZIP_RDONLY, &error);
+        if(!zip){
+            zip_source_free(source);
+        }
+    }
+    if(!zip){
+        out_errorMessage =
+            format(_("Failed to open the zip file \"{0}\": {1}"), zipFilename, zip_error_strerror(&error));
+    }
+    zip_error_fini(&error);
+    return zip;
+}
+
+
+void ZipFileSystem::Impl::releaseArchive(zip_t* zip)
+{
+    std::lock_guard<std::mutex> guard(archivePoolMutex);
+    archivePool.push_back(zip);
+}
+
+
+const std::string& ZipFileSystem::zipFilename() const
+{
+    return impl->zipFilename;
+}
+
+
+int ZipFileSystem::numEntries() const
+{
+    return impl->entryNames.size();
+}
+
+
+const std::string& ZipFileSystem::entryName(int index) const
+{
+    return impl->entryNames[index];
+}
+
+
+int ZipFileSystem::findEntry(const std::string& name) const
+{
+    auto it = impl->entryIndexMap.find(name);
+    if(it != impl->entryIndexMap.end()){
+        return it->second;
+    }
+    return -1;
+}
+
+
+void ZipFileSystem::setCacheSizeLimit(size_t size)
+{
+    cacheSizeLimit = size;
+}
+
+
+std::shared_ptr<const std::string> ZipFileSystem::readEntry(int index, std::string& out_errorMessage)
+{
+    if(index < 0 || index >= numEntries()){
+        out_errorMessage = format(_("Entry {0} does not exist in the zip file \"{1}\"."), index, impl->zipFilename);
+        return nullptr;
+    }
+    auto data = impl->findCachedEntry(index);
+    if(!data){
+        data = impl->decompressEntry(index, out_errorMessage);
+        if(data){
+            impl->addCacheEntry(index, data);
+        }
+    }
+    return data;
+}
+
+
+shared_ptr<const string> ZipFileSystem::Impl::findCachedEntry(int index)
+{
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    auto it = cacheIteratorMap.find(index);
+    if(it == cacheIteratorMap.end()){
+        return nullptr;
+    }
+    cache.splice(cache.begin(), cache, it->second);
+    return it->second->data;
+}
+
+
+void ZipFileSystem::Impl::addCacheEntry(int index, const shared_ptr<const string>& data)
+{
+    const size_t limit = cacheSizeLimit;
+    if(data->size() > limit){
+        return;
+    }
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    if(cacheIteratorMap.find(index) != cacheIteratorMap.end()){
+        return;
+    }
+    cache.push_front({ index, data });
+    cacheIteratorMap[index] = cache.begin();
+    cacheSize += data->size();
+    while(cacheSize > limit){
+        auto& lru = cache.back();
+        cacheSize -= lru.data->size();
+        cacheIteratorMap.erase(lru.index);
+        cache.pop_back();
+    }
+}
+
+
+shared_ptr<const string> ZipFileSystem::Impl::decompressEntry(int index, string& out_errorMessage)
+{
+    auto zip = acquireArchive(out_errorMessage);
+    if(!zip){
+        return nullptr;
+    }
+
+    shared_ptr<string> data;
+    bool failed = true;
+    zip_stat_t stat;
+    if(zip_stat_index(zip, index, 0, &stat) == 0 && (stat.valid & ZIP_STAT_SIZE)){
+        if(zip_file_t* zf = zip_fopen_index(zip, index, 0)){
+            data = make_shared<string>(stat.size, '\0');
+            zip_uint64_t sum = 0;
+            while(sum < stat.size){
+                zip_int64_t len = zip_fread(zf, &(*data)[sum], stat.size - sum);
+                if(len <= 0){
+                    break;
+                }
+                sum += len;
+            }
+            failed = (sum != stat.size);
+            zip_fclose(zf);
+        }
+    }
+    releaseArchive(zip);
+
+    if(failed){
+        out_errorMessage =
+            format(_("File \"{0}\" in the zip file \"{1}\" cannot be read."), entryNames[index], zipFilename);
+        return nullptr;
+    }
+    return data;
+}
+
+
+bool ZipFileSystem::mount(const std::string& directory, std::string& out_errorMessage)
+{
+    auto dirPath = getNormalizedPath(directory);
+    if(isMounted()){
+        if(dirPath == impl->mountDirPath){
+            return true;
+        }
+        unmount();
+    }
+
+    if(!impl->mount(directory, out_errorMessage)){
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(registryMutex);
+    mountedArchives.push_back(this);
+    hasMountedArchives = true;
+    return true;
+}
+
+
+bool ZipFileSystem::Impl::mount(const string& directory, string& out_errorMessage)
+{
+    std::lock_guard<std::mutex> guard(mountMutex);
+
+    mountDirPath = getNormalizedPath(directory);
+    mountDirectory = toUTF8(mountDirPath.generic_string());
+    isTemporaryMount = false;
+    if(mountDirectory.empty() || mountDirectory.back() != '/'){
+        mountDirectory += '/';
+    }
+
+    stdx::error_code ec;
+    fs::create_directories(mountDirPath, ec);
+    for(auto& name : entryNames){
+        if(!name.empty()){
+            auto path = fs::lexically_normal(mountDirPath / fromUTF8(name));
+            if(!checkIfEntryInDirectory(path, mountDirectory)){
+                continue;
+            }
+            if(name.back() != '/'){
+                path = path.parent_path();
+            }
+            if(!fs::is_directory(path)){
+                fs::create_directories(path, ec);
+            }
+        }
+        if(ec){
+            out_errorMessage =
+                format(_("Directory \"{0}\" for the zip file \"{1}\" cannot be created: {2}"),
+                       name, zipFilename, toUTF8(ec.message()));
+            mountDirectory.clear();
+            mountDirPath.clear();
+            return false;
+        }
+    }
+
+    extractionStates.assign(entryNames.size(), NotExtracted);
+    ++mountId;
+    return true;
+}
+
+
+// The entries whose names contain ".." must not be extracted to the outside of the mount directory
+bool ZipFileSystem::Impl::checkIfEntryInDirectory(const fs::path& path, const string& directory)
+{
+    auto pathString = toUTF8(path.generic_string());
+    return pathString.size() > directory.size() &&
+        pathString.compare(0, directory.size(), directory) == 0;
+}
+
+
+void ZipFileSystem::unmount()
+{
+    // Keep this object alive until the mount information is cleared
+    ZipFileSystemPtr self = this;
+    fs::path temporaryMountDirPath;
+    {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        auto it = std::find(mountedArchives.begin(), mountedArchives.end(), this);
+        if(it == mountedArchives.end()){
+            return;
+        }
+        mountedArchives.erase(it);
+        hasMountedArchives = !mountedArchives.empty();
+
+        std::lock_guard<std::mutex> mountGuard(impl->mountMutex);
+        if(impl->isTemporaryMount){
+            temporaryMountDirPath = impl->mountDirPath;
+            impl->isTemporaryMount = false;
+        }
+        impl->mountDirPath.clear();
+        impl->mountDirectory.clear();
+        impl->extractionStates.clear();
+        impl->extractionCondition.notify_all();
+    }
+    if(!temporaryMountDirPath.empty()){
+        stdx::error_code ec;
+        fs::remove_all(temporaryMountDirPath, ec);
+    }
+}
+
+
+bool ZipFileSystem::isMounted() const
+{
+    std::lock_guard<std::mutex> guard(impl->mountMutex);
+    return !impl->mountDirectory.empty();
+}
+
+
+std::string ZipFileSystem::mountDirectory() const
+{
+    std::lock_guard<std::mutex> guard(impl->mountMutex);
+    return impl->mountDirectory;
+}
+
+
+bool ZipFileSystem::Impl::extractEntry(int index, string& out_errorMessage)
+{
+    fs::path filePath;
+    int currentMountId;
+    {
+        std::unique_lock<std::mutex> lock(mountMutex);
+        while(!extractionStates.empty() && extractionStates[index] == Extracting){
+            extractionCondition.wait(lock);
+        }
+        if(extractionStates.empty()){
+            return true; // unmounted
+        }
+        if(extractionStates[index] == Extracted){
+            return true;
+        }
+        extractionStates[index] = Extracting;
+        filePath = mountDirPath / fromUTF8(entryNames[index]);
+        currentMountId = mountId;
+    }
+
+    bool extracted = writeEntryFile(index, filePath, out_errorMessage);
+
+    std::lock_guard<std::mutex> guard(mountMutex);
+    if(!extractionStates.empty() && mountId == currentMountId){
+        extractionStates[index] = extracted ? Extracted : NotExtracted;
+        extractionCondition.notify_all();
+    }
+    return extracted;
+}
+
+
+bool ZipFileSystem::Impl::writeEntryFile(int index, const fs::path& filePath, string& out_errorMessage)
+{
+    auto data = findCachedEntry(index);
+    if(!data){
+        data = decompressEntry(index, out_errorMessage);
+        if(!data){
+            return false;
+        }
+    }
+
+    // The file is renamed after it is written so that the incomplete file is not read by others
+    auto tmpFilePath = filePath;
+    tmpFilePath += ".extracting";
+    bool failed = true;
+    if(FILE* file = fopen(tmpFilePath.make_preferred().string().c_str(), "wb")){
+        failed = (fwrite(data->data(), 1, data->size(), file) < data->size());
+        if(fclose(file) != 0){
+            failed = true;
+        }
+    }
+    stdx::error_code ec;
+    if(!failed){
+        fs::rename(tmpFilePath, filePath, ec);
+        failed = bool(ec);
+    }
+    if(failed){
+        fs::remove(tmpFilePath, ec);
+        out_errorMessage =
+            format(_("File \"{0}\" in the zip file \"{1}\" cannot be extracted."), entryNames[index], zipFilename);
+        return false;
+    }
+    return true;
+}
+
+
+bool ZipFileSystem::prepareFile(const std::string& filePath, std::string& out_errorMessage)
+{
+    if(!hasMountedArchives){
+        return true;
+    }
+
+    auto path = toUTF8(getNormalizedPath(filePath).generic_string());
+    ZipFileSystemPtr archive;
+    int index = -1;
+    {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        for(auto& mounted : mountedArchives){
+            auto& dir = mounted->impl->mountDirectory;
+            if(path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0){
+                index = mounted->findEntry(path.substr(dir.size()));
+                if(index >= 0){
+                    archive = mounted;
+                    break;
+                }
+            }
+        }
+    }
+    if(!archive){
+        return true;
+    }
+    return archive->impl->extractEntry(index, out_errorMessage);
+}
+
+
+bool ZipFileSystem::prepareFile(const std::string& filePath)
+{
+    string errorMessage;
+    return prepareFile(filePath, errorMessage);
+}
+
+
+std::string ZipFileSystem::getFilePathOfUriPath(const std::string& uriPath, std::ostream& os)
+{
+    auto pos = uriPath.find("!/");
+    if(pos == string::npos){
+        os << format(_("The path \"{0}\" of the zip URI scheme must be \"(zip file)!/(entry name)\"."), uriPath);
+        os.flush();
+        return string();
+    }
+    string zipFilename = uriPath.substr(0, pos);
+    string entryName = uriPath.substr(pos + 2);
+
+    string errorMessage;
+    auto archive = open(zipFilename, errorMessage);
+    if(!archive){
+        os << errorMessage;
+        os.flush();
+        return string();
+    }
+    if(archive->findEntry(entryName) < 0){
+        os << format(_("\"{0}\" is not found in the zip file \"{1}\"."), entryName, zipFilename);
+        os.flush();
+        return string();
+    }
+    if(!archive->isMounted()){
+        // The directory name includes the id of this program instance so that the directory is not
+        // removed by another process using the same archive
+        static const unsigned int instanceId = std::random_device()();
+        auto key = toUTF8(getNormalizedPath(zipFilename).generic_string());
+        auto cacheDirPath =
+            fs::temp_directory_path() /
+            format("choreonoid-zip-{:08x}-{:016x}", instanceId, std::hash<string>()(key));
+        if(!archive->mount(toUTF8(cacheDirPath.string()), errorMessage)){
+            os << errorMessage;
+            os.flush();
+            return string();
+        }
+        std::lock_guard<std::mutex> guard(archive->impl->mountMutex);
+        archive->impl->isTemporaryMount = true;
+    }
+    auto mountDirectory = archive->mountDirectory();
+    auto path = fs::lexically_normal(fs::path(fromUTF8(mountDirectory + entryName)));
+    if(!Impl::checkIfEntryInDirectory(path, mountDirectory)){
+        os << format(_("\"{0}\" in the zip file \"{1}\" is out of the archive."), entryName, zipFilename);
+        os.flush();
+        return string();
+    }
+    auto filePath = toUTF8(path.generic_string());
+    if(!prepareFile(filePath, errorMessage)){
+        os << errorMessage;
+        os.flush();
+        return string();
+    }
+    return filePath;
+}
@@ -0,0 +1,82 @@
+#ifndef CNOID_UTIL_ZIP_FILE_SYSTEM_H
+#define CNOID_UTIL_ZIP_FILE_SYSTEM_H
+
+#include <cnoid/Referenced>
+#include <string>
+#include <memory>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class provides the access to the files in a zip archive without extracting the whole archive.
+   The archive file is memory-mapped and each entry is decompressed only when it is accessed.
+
+   The "zip" URI scheme is also supported by this class. The URI "zip://archive.zip!/dir/file"
+   specifies the file "dir/file" in the archive file "archive.zip".
+*/
+class CNOID_EXPORT ZipFileSystem : public Referenced
+{
+public:
+    /**
+       The instance of an archive file is shared while it is referenced.
+       \return nullptr if the archive cannot be opened
+    */
+    static ref_ptr<ZipFileSystem> open(const std::string& zipFilename, std::string& out_errorMessage);
+
+    ~ZipFileSystem();
+
+    const std::string& zipFilename() const;
+    int numEntries() const;
+    //! The names of directory entries end with '/'.
+    const std::string& entryName(int index) const;
+    //! \return -1 if the entry is not found
+    int findEntry(const std::string& name) const;
+
+    /**
+       The decompressed data is cached and shared between the callers while the total size of the
+       cached data does not exceed the limit.
+       \return nullptr if the entry cannot be read
+    */
+    std::shared_ptr<const std::string> readEntry(int index, std::string& out_errorMessage);
+
+    //! The limit of the cache size of each archive. The default limit is 64 MiB.
+    static void setCacheSizeLimit(size_t size);
+
+    /**
+       Mounting the archive on a directory creates the directory tree of the archive in it, and
+       each file of the archive is extracted to the directory when the file path is given to the
+       prepareFile function for the first time.
+    */
+    bool mount(const std::string& directory, std::string& out_errorMessage);
+    void unmount();
+    bool isMounted() const;
+    std::string mountDirectory() const;
+
+    /**
+       The file path resolvers such as FilePathVariableProcessor and UriSchemeProcessor call this
+       function so that the loaders can read the files of the mounted archives as usual files.
+       \return false if the file belongs to a mounted archive and it cannot be extracted
+    */
+    static bool prepareFile(const std::string& filePath, std::string& out_errorMessage);
+    static bool prepareFile(const std::string& filePath);
+
+    /**
+       This function is used by UriSchemeProcessor to get the file path of the "zip" URI scheme.
+       The archive is mounted on a cache directory in the temporary directory if it is not mounted.
+    */
+    static std::string getFilePathOfUriPath(const std::string& uriPath, std::ostream& os);
+
+private:
+    ZipFileSystem();
+
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<ZipFileSystem> ZipFileSystemPtr;
+
+}
+
+#endif